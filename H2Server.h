@@ -6,6 +6,8 @@
 
 #include "H2Server_Request.h"
 #include "H2Server_Request_Message.h"
+#include "H2Server_Resource_Store.h"
+#include "H2Server_Proxy.h"
 
 using Request_Processor = std::function<bool(boost::asio::io_service*,
                                              uint64_t,
@@ -17,6 +19,8 @@ class H2Server_Response_Group
 {
 public:
     std::vector<H2Server_Response> responses;
+    H2Server_Resource_Action resource_action;
+    H2Server_Proxy proxy;
 
     void init_distribution_map_and_total_weight(const std::vector<Schema_Response_To_Return>& responses_schema)
     {
@@ -32,9 +36,16 @@ public:
       }
       total_weight = distribution_map.size() ? distribution_map.rbegin()->first : 1;
     }
-    H2Server_Response_Group(const std::vector<Schema_Response_To_Return>& responses_schema)
-    :generator((std::random_device())())
+    H2Server_Response_Group(const std::vector<Schema_Response_To_Return>& responses_schema,
+                            const Schema_Resource_Store_Action& resource_store_schema,
+                            const Schema_Proxy& proxy_schema)
+    :resource_action(resource_store_schema), proxy(proxy_schema), generator((std::random_device())())
     {
+      if (responses_schema.empty() && !proxy.enabled())
+      {
+          std::cerr << "no Responses, and no Proxy, in the service" << std::endl;
+          exit(1);
+      }
       for (auto i = 0; i < responses_schema.size(); i++)
       {
           responses.emplace_back(H2Server_Response(responses_schema[i], i));
@@ -42,6 +53,12 @@ public:
 
       init_distribution_map_and_total_weight(responses_schema);
       distr.param(std::uniform_int_distribution<>::param_type(0, total_weight - 1));
+
+      responses_need_payload = false;
+      for (auto& response : responses)
+      {
+          responses_need_payload = responses_need_payload || response.payload_needed;
+      }
     }
     size_t select_response()
     {
@@ -77,7 +94,14 @@ public:
         return request_processor;
     }
 
+    // the request body is used by the service, not only counted
+    bool payload_needed() const
+    {
+        return request_processor || responses_need_payload || resource_action.payload_needed() || proxy.payload_needed();
+    }
+
 private:
+    bool responses_need_payload;
     std::map<uint64_t, size_t> distribution_map;
     uint64_t total_weight;
     std::mt19937_64 generator;
@@ -92,7 +116,7 @@ public:
     H2Server_Response_Group response_group;
     H2Server_Service(const Schema_Service& service, size_t index):
         request(service.request, index),
-        response_group(service.responses)
+        response_group(service.responses, service.resource_store, service.proxy)
     {
     }
 };
@@ -227,6 +251,28 @@ public:
         return services.rend();
     }
 
+    /*
+     * Whether the body of a request is to be kept, with the headers of the request only:
+     * the first service in match order whose header match rules match is the one matched, if it has no payload
+     * match rule, so it decides; a service with payload match rules needs the body to tell if it matches.
+     */
+    bool payload_needed(H2Server_Request_Message& msg)
+    {
+        for (auto iter = services.rbegin(); iter != services.rend(); iter++)
+        {
+            if (!iter->first.match_headers(msg))
+            {
+                continue;
+            }
+            if (iter->first.payload_match_present)
+            {
+                return true;
+            }
+            return iter->second.payload_needed();
+        }
+        return false;
+    }
+
     H2Server_Response* get_response_to_return(std::map<H2Server_Request, H2Server_Response_Group>::reverse_iterator service, size_t& matched_response_index)
     {
         size_t index = service->second.select_response();
@@ -103,6 +103,32 @@ public:
     }
 };
 
+class Schema_Response_Delay
+{
+public:
+    std::string distribution;
+    double mean_ms;
+    double sd_ms;
+    double min_ms;
+    double max_ms;
+    std::string histogram_file;
+    explicit Schema_Response_Delay():
+        mean_ms(0),
+        sd_ms(0),
+        min_ms(0),
+        max_ms(0)
+    {
+    }
+    void staticjson_init(staticjson::ObjectHandler* h)
+    {
+        h->add_property("distribution", &this->distribution);
+        h->add_property("mean-ms", &this->mean_ms, staticjson::Flags::Optional);
+        h->add_property("sd-ms", &this->sd_ms, staticjson::Flags::Optional);
+        h->add_property("min-ms", &this->min_ms, staticjson::Flags::Optional);
+        h->add_property("max-ms", &this->max_ms, staticjson::Flags::Optional);
+        h->add_property("histogram-file", &this->histogram_file, staticjson::Flags::Optional);
+    }
+};
 
 class Schema_Response_To_Return
 {
@@ -115,6 +141,7 @@ public:
     bool lua_offload;
     uint32_t weight;
     std::string name;
+    Schema_Response_Delay delay;
     explicit Schema_Response_To_Return()
     {
         lua_offload = false;
@@ -129,6 +156,66 @@ public:
         h->add_property("lua-offload", &this->lua_offload, staticjson::Flags::Optional);
         h->add_property("name", &this->name);
         h->add_property("weight", &this->weight, staticjson::Flags::Optional);
+        h->add_property("delay", &this->delay, staticjson::Flags::Optional);
+    }
+};
+
+class Schema_Resource_Store_Action
+{
+public:
+    std::string action;
+    Schema_Argument key;
+    uint32_t ttl_seconds;
+    uint32_t not_found_status_code;
+    explicit Schema_Resource_Store_Action():
+        ttl_seconds(0),
+        not_found_status_code(404)
+    {
+    }
+    void staticjson_init(staticjson::ObjectHandler* h)
+    {
+        h->add_property("action", &this->action);
+        h->add_property("key", &this->key);
+        h->add_property("ttl-seconds", &this->ttl_seconds, staticjson::Flags::Optional);
+        h->add_property("not-found-status-code", &this->not_found_status_code, staticjson::Flags::Optional);
+    }
+};
+
+class Schema_Proxy
+{
+public:
+    std::vector<std::string> upstreams;
+    std::string load_balancing;
+    std::string hash_header;
+    std::vector<Schema_Response_Header> set_headers;
+    std::vector<std::string> remove_headers;
+    std::string path_regex;
+    std::string path_replacement;
+    uint32_t connections_per_upstream;
+    uint32_t timeout_ms;
+    uint32_t upstream_error_status_code;
+    uint64_t max_response_size;
+    explicit Schema_Proxy():
+        load_balancing("round-robin"),
+        connections_per_upstream(1),
+        timeout_ms(0),
+        upstream_error_status_code(502),
+        max_response_size(16 * 1024 * 1024)
+    {
+    }
+    void staticjson_init(staticjson::ObjectHandler* h)
+    {
+        h->add_property("upstreams", &this->upstreams);
+        h->add_property("load-balancing", &this->load_balancing, staticjson::Flags::Optional);
+        h->add_property("hash-header", &this->hash_header, staticjson::Flags::Optional);
+        h->add_property("set-headers", &this->set_headers, staticjson::Flags::Optional);
+        h->add_property("remove-headers", &this->remove_headers, staticjson::Flags::Optional);
+        h->add_property("path-regex", &this->path_regex, staticjson::Flags::Optional);
+        h->add_property("path-replacement", &this->path_replacement, staticjson::Flags::Optional);
+        h->add_property("connections-per-upstream", &this->connections_per_upstream, staticjson::Flags::Optional);
+        h->add_property("timeout-ms", &this->timeout_ms, staticjson::Flags::Optional);
+        h->add_property("upstream-error-status-code", &this->upstream_error_status_code, staticjson::Flags::Optional);
+        h->add_property("max-response-size", &this->max_response_size, staticjson::Flags::Optional);
     }
 };
 
@@ -137,10 +224,14 @@ class Schema_Service
 public:
     Schema_Request_Match request;
     std::vector<Schema_Response_To_Return> responses;
+    Schema_Resource_Store_Action resource_store;
+    Schema_Proxy proxy;
     void staticjson_init(staticjson::ObjectHandler* h)
     {
         h->add_property("Request", &this->request);
-        h->add_property("Responses", &this->responses);
+        h->add_property("Responses", &this->responses, staticjson::Flags::Optional);
+        h->add_property("Resource-Store", &this->resource_store, staticjson::Flags::Optional);
+        h->add_property("Proxy", &this->proxy, staticjson::Flags::Optional);
     }
 };
 
@@ -155,6 +246,7 @@ public:
     std::string cert_file;
     std::string ca_cert_file;
     bool enable_mTLS;
+    bool kernel_tls;
     uint32_t max_concurrent_streams;
     uint64_t skt_recv_buffer_size;
     uint64_t skt_send_buffer_size;
@@ -162,9 +254,14 @@ public:
     uint64_t connection_window_bits;
     uint64_t header_table_size;
     uint64_t encoder_header_table_size;
+    uint64_t connection_bandwidth_limit;
+    uint32_t lua_offload_threads;
+    bool always_buffer_request_body;
+    uint64_t request_body_consume_rate;
     std::vector<Schema_Service> service;
     explicit H2Server_Config_Schema():
         enable_mTLS(false),
+        kernel_tls(false),
         verbose(false),
         skt_recv_buffer_size(4 * 1024 * 1024),
         skt_send_buffer_size(4 * 1024 * 1024),
@@ -172,7 +269,11 @@ public:
         window_bits(30),
         connection_window_bits(30),
         header_table_size(4096),
-        encoder_header_table_size(4096)
+        encoder_header_table_size(4096),
+        connection_bandwidth_limit(0),
+        lua_offload_threads(0),
+        always_buffer_request_body(false),
+        request_body_consume_rate(0)
     {
     }
     void staticjson_init(staticjson::ObjectHandler* h)
@@ -185,6 +286,7 @@ public:
         h->add_property("cert-file", &this->cert_file, staticjson::Flags::Optional);
         h->add_property("caCert-file", &this->ca_cert_file, staticjson::Flags::Optional);
         h->add_property("mTLS", &this->enable_mTLS, staticjson::Flags::Optional);
+        h->add_property("kernel-tls", &this->kernel_tls, staticjson::Flags::Optional);
         h->add_property("max-concurrent-streams", &this->max_concurrent_streams, staticjson::Flags::Optional);
         h->add_property("socket-receive-buffer-size", &this->skt_recv_buffer_size, staticjson::Flags::Optional);
         h->add_property("socket-send-buffer-size", &this->skt_send_buffer_size, staticjson::Flags::Optional);
@@ -192,6 +294,10 @@ public:
         h->add_property("encoder-header-table-size", &this->encoder_header_table_size, staticjson::Flags::Optional);
         h->add_property("window-bits", &this->window_bits, staticjson::Flags::Optional);
         h->add_property("connection-window-bits", &this->connection_window_bits, staticjson::Flags::Optional);
+        h->add_property("connection-bandwidth-limit", &this->connection_bandwidth_limit, staticjson::Flags::Optional);
+        h->add_property("lua-offload-threads", &this->lua_offload_threads, staticjson::Flags::Optional);
+        h->add_property("always-buffer-request-body", &this->always_buffer_request_body, staticjson::Flags::Optional);
+        h->add_property("request-body-consume-rate", &this->request_body_consume_rate, staticjson::Flags::Optional);
         h->add_property("Service", &this->service);
     }
 };
@@ -0,0 +1,304 @@
+#ifndef H2SERVER_PROXY_H
+#define H2SERVER_PROXY_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <regex>
+#include <iostream>
+#include <functional>
+#include <algorithm>
+
+#include "H2Server_Config_Schema.h"
+#include "H2Server_Request.h"
+#include "H2Server_Request_Message.h"
+#include "H2Server_Response.h"
+
+struct H2Server_Upstream
+{
+    std::string schema;
+    // host:port
+    std::string authority;
+    // schema://host:port, the key of the connections to the upstream
+    std::string base_uri;
+};
+
+/*
+ * The "Proxy" of a service: the upstream to forward a request to, and the headers and path to forward it with.
+ * Each server thread has its own instance, like the rest of H2Server, so the balancing state needs no lock;
+ * the forwarding itself is in asio_util.cc, over the connections the server thread keeps to the upstreams.
+ */
+class H2Server_Proxy
+{
+public:
+    std::vector<H2Server_Upstream> upstreams;
+    uint32_t connections_per_upstream;
+    uint32_t timeout_ms;
+    uint32_t upstream_error_status_code;
+    uint64_t max_response_size;
+
+    explicit H2Server_Proxy(const Schema_Proxy& schema):
+        connections_per_upstream(std::max(schema.connections_per_upstream, static_cast<uint32_t>(1))),
+        timeout_ms(schema.timeout_ms),
+        upstream_error_status_code(schema.upstream_error_status_code),
+        max_response_size(schema.max_response_size),
+        load_balancing(ROUND_ROBIN),
+        hash_header(schema.hash_header),
+        path_replacement(schema.path_replacement),
+        rewrite_path(false),
+        next_upstream(0)
+    {
+        if (schema.upstreams.empty())
+        {
+            return;
+        }
+        for (auto& uri : schema.upstreams)
+        {
+            upstreams.emplace_back(parse_upstream(uri));
+        }
+        outstanding_requests.resize(upstreams.size(), 0);
+
+        if (schema.load_balancing == "round-robin")
+        {
+            load_balancing = ROUND_ROBIN;
+        }
+        else if (schema.load_balancing == "least-outstanding")
+        {
+            load_balancing = LEAST_OUTSTANDING;
+        }
+        else if (schema.load_balancing == "consistent-hash")
+        {
+            load_balancing = CONSISTENT_HASH;
+            if (hash_header.empty())
+            {
+                std::cerr << "consistent-hash load-balancing needs hash-header: " << staticjson::to_pretty_json_string(
+                              schema) << std::endl;
+                exit(1);
+            }
+            std::transform(hash_header.begin(), hash_header.end(), hash_header.begin(), ::tolower);
+            build_hash_ring();
+        }
+        else
+        {
+            std::cerr << "invalid proxy load-balancing: " << schema.load_balancing << std::endl;
+            exit(1);
+        }
+
+        for (auto& header : schema.set_headers)
+        {
+            set_headers.emplace_back(H2Server_Response_Header(header));
+        }
+        for (auto& header : schema.remove_headers)
+        {
+            std::string name = header;
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            remove_headers.insert(name);
+        }
+        if (schema.path_regex.size())
+        {
+            try
+            {
+                path_regex.assign(schema.path_regex, std::regex_constants::ECMAScript);
+                rewrite_path = true;
+            }
+            catch (std::regex_error& e)
+            {
+                std::cerr << "invalid proxy path-regex: " << schema.path_regex << ", " << e.what() << std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    bool enabled() const
+    {
+        return upstreams.size() > 0;
+    }
+
+    // the request body is forwarded
+    bool payload_needed() const
+    {
+        return enabled();
+    }
+
+    size_t select_upstream(const H2Server_Request_Message& msg)
+    {
+        switch (load_balancing)
+        {
+            case LEAST_OUTSTANDING:
+            {
+                // starting from the round robin position, so ties are spread
+                size_t selected = next_upstream++ % upstreams.size();
+                for (size_t i = 1; i < upstreams.size(); i++)
+                {
+                    auto index = (selected + i) % upstreams.size();
+                    if (outstanding_requests[index] < outstanding_requests[selected])
+                    {
+                        selected = index;
+                    }
+                }
+                return selected;
+            }
+            case CONSISTENT_HASH:
+            {
+                auto header = msg.headers.find(hash_header);
+                if (header == msg.headers.end())
+                {
+                    break;
+                }
+                auto point = hash_ring.lower_bound(std::hash<std::string>()(header->second));
+                if (point == hash_ring.end())
+                {
+                    point = hash_ring.begin();
+                }
+                return point->second;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        return next_upstream++ % upstreams.size();
+    }
+
+    void request_forwarded(size_t upstream_index)
+    {
+        outstanding_requests[upstream_index]++;
+    }
+
+    void response_returned(size_t upstream_index)
+    {
+        outstanding_requests[upstream_index]--;
+    }
+
+    // the request headers to forward, with no pseudo header and no connection specific header,
+    // content-length is for the caller to set from the body forwarded;
+    // authority is left empty unless set by set-headers, the authority of the upstream is used then
+    void produce_request(H2Server_Request_Message& msg, std::map<std::string, std::string, ci_less>& headers,
+                         std::string& method, std::string& path, std::string& authority) const
+    {
+        for (auto& header : msg.headers)
+        {
+            if (header.first == ":method")
+            {
+                method = header.second;
+            }
+            else if (header.first == ":path")
+            {
+                path = header.second;
+            }
+            else if (header.first.size() && header.first[0] != ':' && !is_connection_header(header) &&
+                     !remove_headers.count(header.first))
+            {
+                auto& value = headers[header.first];
+                if (value.size())
+                {
+                    value.append(header.first == "cookie" ? "; " : ", ");
+                }
+                value.append(header.second);
+            }
+        }
+        for (auto& header_with_var : set_headers)
+        {
+            auto header = header_with_var.produce(msg);
+            std::transform(header.first.begin(), header.first.end(), header.first.begin(), ::tolower);
+            header.second.erase(0, header.second.find_first_not_of(' '));
+            if (header.first == ":method")
+            {
+                method = header.second;
+            }
+            else if (header.first == ":path")
+            {
+                path = header.second;
+            }
+            else if (header.first == ":authority")
+            {
+                authority = header.second;
+            }
+            else if (header.first.size() && header.first[0] != ':')
+            {
+                headers[header.first] = header.second;
+            }
+        }
+        if (rewrite_path)
+        {
+            path = std::regex_replace(path, path_regex, path_replacement);
+        }
+    }
+
+private:
+    enum Load_Balancing
+    {
+        ROUND_ROBIN,
+        LEAST_OUTSTANDING,
+        CONSISTENT_HASH
+    };
+
+    // points of each upstream on the hash ring, for an even spread of the keys
+    static constexpr size_t virtual_nodes_per_upstream = 160;
+
+    static H2Server_Upstream parse_upstream(const std::string& uri)
+    {
+        H2Server_Upstream upstream;
+        auto schema_end = uri.find("://");
+        if (schema_end != std::string::npos)
+        {
+            upstream.schema = uri.substr(0, schema_end);
+            std::transform(upstream.schema.begin(), upstream.schema.end(), upstream.schema.begin(), ::tolower);
+        }
+        if (upstream.schema != "http" && upstream.schema != "https")
+        {
+            std::cerr << "invalid proxy upstream, http:// or https:// expected: " << uri << std::endl;
+            exit(1);
+        }
+        auto authority_start = schema_end + 3;
+        upstream.authority = uri.substr(authority_start, uri.find('/', authority_start) - authority_start);
+        // an IPv6 address is in brackets, and has colons of its own
+        auto host_end = upstream.authority.size() && upstream.authority[0] == '[' ? upstream.authority.find(']') : 0;
+        if (upstream.authority.empty() || host_end == std::string::npos)
+        {
+            std::cerr << "invalid proxy upstream, no host: " << uri << std::endl;
+            exit(1);
+        }
+        if (upstream.authority.find(':', host_end) == std::string::npos)
+        {
+            upstream.authority.append(upstream.schema == "https" ? ":443" : ":80");
+        }
+        upstream.base_uri = upstream.schema + "://" + upstream.authority;
+        return upstream;
+    }
+
+    static bool is_connection_header(const std::pair<const std::string, std::string>& header)
+    {
+        static const std::set<std::string> connection_headers =
+        {
+            "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade", "host", "content-length"
+        };
+        // te is allowed in HTTP/2 with trailers only, which gRPC needs
+        return connection_headers.count(header.first) || (header.first == "te" && header.second != "trailers");
+    }
+
+    void build_hash_ring()
+    {
+        for (size_t index = 0; index < upstreams.size(); index++)
+        {
+            for (size_t node = 0; node < virtual_nodes_per_upstream; node++)
+            {
+                hash_ring[std::hash<std::string>()(upstreams[index].base_uri + "#" + std::to_string(node))] = index;
+            }
+        }
+    }
+
+    Load_Balancing load_balancing;
+    std::string hash_header;
+    std::vector<H2Server_Response_Header> set_headers;
+    std::set<std::string> remove_headers;
+    std::regex path_regex;
+    std::string path_replacement;
+    bool rewrite_path;
+    std::map<size_t, size_t> hash_ring;
+    std::vector<uint64_t> outstanding_requests;
+    uint64_t next_upstream;
+};
+
+#endif
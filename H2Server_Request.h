@@ -259,9 +259,11 @@ public:
     std::set<Match_Rule> match_rules;
     std::string name;
     size_t request_index;
+    bool payload_match_present;
 
     H2Server_Request(const Schema_Request_Match& request_match, size_t index)
     {
+        payload_match_present = request_match.payload_match.size() > 0;
         for (auto& schema_header_match : request_match.header_match)
         {
             match_rules.emplace(Match_Rule(schema_header_match));
@@ -286,6 +288,18 @@ public:
         }
         return true;
     }
+    // with the header match rules only, before the request body is received
+    bool match_headers(H2Server_Request_Message& request) const
+    {
+        for (auto match_rule = match_rules.rbegin(); match_rule != match_rules.rend(); match_rule++)
+        {
+            if (match_rule->header_name.size() && !match_rule->match(request))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
     bool operator<(const H2Server_Request& rhs) const
     {
         if (match_rules.size() < rhs.match_rules.size())
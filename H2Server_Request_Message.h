@@ -6,6 +6,7 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <memory>
 #include <nghttp2/asio_http2_server.h>
 
 #include "H2Server_Config_Schema.h"
@@ -18,9 +19,19 @@ public:
     rapidjson::Document  json_payload;
     const std::string* json_payload_string;
     std::map<size_t, bool> match_result;
+    // of the Resource-Store action of the matched service
+    std::string resource_key;
+    std::string stored_document;
+    // decoded on first use only, most requests never need it
+    std::unique_ptr<rapidjson::Document> stored_json;
+    // of the request body, also when it is not kept
+    uint64_t payload_length;
+    const nghttp2::asio_http2::server::request* request;
     H2Server_Request_Message(const nghttp2::asio_http2::server::request& req)
     {
         json_payload_string = &(req.unmutable_payload());
+        payload_length = req.payload_length();
+        request = &req;
         std::string path_header_name = ":path";
         std::string header_val = req.uri().path;
         if (req.uri().raw_query.size())
@@ -54,6 +65,14 @@ public:
             json_payload_string == nullptr;
         }
     }
+    void decode_stored_document_if_not_yet()
+    {
+        if (!stored_json)
+        {
+            stored_json.reset(new rapidjson::Document());
+            stored_json->Parse(stored_document.c_str());
+        }
+    }
 };
 
 #endif
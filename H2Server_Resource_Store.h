@@ -0,0 +1,319 @@
+#ifndef H2SERVER_RESOURCE_STORE_H
+#define H2SERVER_RESOURCE_STORE_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <queue>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "H2Server_Config_Schema.h"
+#include "H2Server_Request_Message.h"
+#include "H2Server_Response.h"
+
+/*
+ * Documents of the stateful services, see "Resource-Store".
+ * The keys are spread over shards by hash, each shard with a lock of its own, and there are several shards
+ * per server thread, so the server threads seldom wait on each other; the thread of the connection does
+ * the action itself, with no hop to another thread.
+ * Expired documents are removed when they are accessed, and a few at each action from the expiry queue of the shard.
+ */
+class H2Server_Resource_Store
+{
+public:
+    explicit H2Server_Resource_Store(size_t number_of_shards):
+        shards(std::max(number_of_shards, static_cast<size_t>(1)))
+    {
+    }
+
+    void store(const std::string& key, const std::string& document, std::chrono::seconds ttl)
+    {
+        auto& shard = get_shard(key);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto now = std::chrono::steady_clock::now();
+        remove_expired(shard, now);
+        auto& resource = shard.resources[key];
+        resource.document = document;
+        set_expiry(shard, key, resource, now, ttl);
+    }
+
+    bool fetch(const std::string& key, std::string& document)
+    {
+        auto& shard = get_shard(key);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto resource = find_resource(shard, key, std::chrono::steady_clock::now());
+        if (resource == shard.resources.end())
+        {
+            return false;
+        }
+        document = resource->second.document;
+        return true;
+    }
+
+    // Json merge patch of the document with patch, the result is returned in document
+    bool update(const std::string& key, const std::string& patch, std::chrono::seconds ttl, std::string& document)
+    {
+        auto& shard = get_shard(key);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto now = std::chrono::steady_clock::now();
+        auto resource = find_resource(shard, key, now);
+        if (resource == shard.resources.end())
+        {
+            return false;
+        }
+        merge_patch_document(resource->second.document, patch);
+        // with no ttl, the update keeps the expiry the document has
+        if (ttl.count() > 0)
+        {
+            set_expiry(shard, key, resource->second, now, ttl);
+        }
+        document = resource->second.document;
+        return true;
+    }
+
+    bool remove(const std::string& key, std::string& document)
+    {
+        auto& shard = get_shard(key);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto resource = find_resource(shard, key, std::chrono::steady_clock::now());
+        if (resource == shard.resources.end())
+        {
+            return false;
+        }
+        document = std::move(resource->second.document);
+        shard.resources.erase(resource);
+        return true;
+    }
+
+private:
+    struct Resource
+    {
+        std::string document;
+        bool expires = false;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    using Expiry = std::pair<std::chrono::steady_clock::time_point, std::string>;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, Resource> resources;
+        std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>> expiries;
+    };
+
+    // per action, to spread the cost of a burst of expiries
+    static constexpr size_t max_expired_removed = 4;
+
+    Shard& get_shard(const std::string& key)
+    {
+        return shards[std::hash<std::string>()(key) % shards.size()];
+    }
+
+    void set_expiry(Shard& shard, const std::string& key, Resource& resource,
+                    std::chrono::steady_clock::time_point now, std::chrono::seconds ttl)
+    {
+        resource.expires = ttl.count() > 0;
+        if (resource.expires)
+        {
+            resource.expiry = now + ttl;
+            shard.expiries.push(std::make_pair(resource.expiry, key));
+        }
+    }
+
+    std::unordered_map<std::string, Resource>::iterator find_resource(Shard& shard, const std::string& key,
+                                                                       std::chrono::steady_clock::time_point now)
+    {
+        remove_expired(shard, now);
+        auto resource = shard.resources.find(key);
+        if (resource != shard.resources.end() && resource->second.expires && resource->second.expiry <= now)
+        {
+            shard.resources.erase(resource);
+            return shard.resources.end();
+        }
+        return resource;
+    }
+
+    void remove_expired(Shard& shard, std::chrono::steady_clock::time_point now)
+    {
+        for (size_t i = 0; i < max_expired_removed && shard.expiries.size() && shard.expiries.top().first <= now; i++)
+        {
+            auto& expiry = shard.expiries.top();
+            auto resource = shard.resources.find(expiry.second);
+            // the document may have been stored again since, with another expiry
+            if (resource != shard.resources.end() && resource->second.expires && resource->second.expiry == expiry.first)
+            {
+                shard.resources.erase(resource);
+            }
+            shard.expiries.pop();
+        }
+    }
+
+    static void merge_patch(rapidjson::Value& target, const rapidjson::Value& patch,
+                            rapidjson::Document::AllocatorType& allocator)
+    {
+        if (!patch.IsObject())
+        {
+            target.CopyFrom(patch, allocator);
+            return;
+        }
+        if (!target.IsObject())
+        {
+            target.SetObject();
+        }
+        for (auto member = patch.MemberBegin(); member != patch.MemberEnd(); ++member)
+        {
+            auto target_member = target.FindMember(member->name);
+            if (member->value.IsNull())
+            {
+                if (target_member != target.MemberEnd())
+                {
+                    target.RemoveMember(target_member);
+                }
+            }
+            else if (target_member != target.MemberEnd())
+            {
+                merge_patch(target_member->value, member->value, allocator);
+            }
+            else
+            {
+                rapidjson::Value name(member->name, allocator);
+                rapidjson::Value value;
+                merge_patch(value, member->value, allocator);
+                target.AddMember(name, value, allocator);
+            }
+        }
+    }
+
+    static void merge_patch_document(std::string& document, const std::string& patch)
+    {
+        rapidjson::Document target;
+        rapidjson::Document patch_json;
+        target.Parse(document.c_str());
+        patch_json.Parse(patch.c_str());
+        if (patch_json.HasParseError() || !patch_json.IsObject())
+        {
+            document = patch;
+            return;
+        }
+        if (target.HasParseError())
+        {
+            target.SetObject();
+        }
+        merge_patch(target, patch_json, target.GetAllocator());
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        target.Accept(writer);
+        document.assign(buffer.GetString(), buffer.GetSize());
+    }
+
+    std::vector<Shard> shards;
+};
+
+/*
+ * The "Resource-Store" action of a service, done on the request before the response is produced;
+ * the key and the document are left in the request message, for the StoredDocument and ResourceKey arguments.
+ */
+class H2Server_Resource_Action
+{
+public:
+    enum Action
+    {
+        NO_ACTION,
+        RESOURCE_STORE,
+        RESOURCE_FETCH,
+        RESOURCE_UPDATE,
+        RESOURCE_DELETE
+    };
+
+    Action action;
+    Argument key;
+    std::chrono::seconds ttl;
+    uint32_t not_found_status_code;
+
+    explicit H2Server_Resource_Action(const Schema_Resource_Store_Action& schema):
+        action(NO_ACTION),
+        key(schema.key),
+        ttl(schema.ttl_seconds),
+        not_found_status_code(schema.not_found_status_code)
+    {
+        if (schema.action.empty())
+        {
+            return;
+        }
+        else if (schema.action == "store")
+        {
+            action = RESOURCE_STORE;
+        }
+        else if (schema.action == "fetch")
+        {
+            action = RESOURCE_FETCH;
+        }
+        else if (schema.action == "update")
+        {
+            action = RESOURCE_UPDATE;
+        }
+        else if (schema.action == "delete")
+        {
+            action = RESOURCE_DELETE;
+        }
+        else
+        {
+            std::cerr << "invalid Resource-Store action: " << schema.action << std::endl;
+            exit(1);
+        }
+    }
+
+    bool enabled() const
+    {
+        return action != NO_ACTION;
+    }
+
+    bool payload_needed() const
+    {
+        return action == RESOURCE_STORE || action == RESOURCE_UPDATE || (enabled() && key.payload_needed());
+    }
+
+    // false if the key cannot be got, or there is no document of the key
+    bool apply(H2Server_Resource_Store& store, H2Server_Request_Message& msg, const std::string& req_payload) const
+    {
+        msg.resource_key = key.getValue(msg);
+        if (msg.resource_key.empty())
+        {
+            return false;
+        }
+        switch (action)
+        {
+            case RESOURCE_STORE:
+            {
+                store.store(msg.resource_key, req_payload, ttl);
+                msg.stored_document = req_payload;
+                return true;
+            }
+            case RESOURCE_FETCH:
+            {
+                return store.fetch(msg.resource_key, msg.stored_document);
+            }
+            case RESOURCE_UPDATE:
+            {
+                return store.update(msg.resource_key, req_payload, ttl, msg.stored_document);
+            }
+            case RESOURCE_DELETE:
+            {
+                return store.remove(msg.resource_key, msg.stored_document);
+            }
+            default:
+            {
+                return true;
+            }
+        }
+    }
+};
+
+#endif
@@ -15,6 +15,7 @@
 #include <memory>
 #include "H2Server_Config_Schema.h"
 #include "H2Server_Request_Message.h"
+#include "H2Server_Response_Delay.h"
 #include <rapidjson/writer.h>
 extern "C" {
 #include "lua.h"
@@ -266,6 +267,24 @@ std::string getValueFromJsonPtr(const RapidJsonType& d, const std::string& json_
     return convertRapidVJsonValueToStr(value);
 }
 
+// random version 4 UUID, e.g. 0b5ed1a6-3c5e-4d4a-9f35-2f1e5a0c7d21
+inline std::string generate_uuid()
+{
+    static thread_local std::mt19937_64 generator((std::random_device())());
+    uint64_t high = generator();
+    uint64_t low = generator();
+    high = (high & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL;
+    low = (low & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+    std::stringstream stream;
+    stream << std::hex << std::setfill('0')
+           << std::setw(8) << (high >> 32) << "-"
+           << std::setw(4) << ((high >> 16) & 0xFFFF) << "-"
+           << std::setw(4) << (high & 0xFFFF) << "-"
+           << std::setw(4) << (low >> 48) << "-"
+           << std::setw(12) << (low & 0xFFFFFFFFFFFFULL);
+    return stream.str();
+}
+
 class Argument
 {
 public:
@@ -275,9 +294,14 @@ public:
     std::string header_name;
     std::regex reg_exp;
     std::string regex;
-    bool regex_present;
-    bool random_hex;
-    bool timestamp;
+    bool regex_present = false;
+    bool random_hex = false;
+    bool timestamp = false;
+    bool uuid = false;
+    bool stored_document = false;
+    bool resource_key = false;
+    bool payload_length = false;
+    bool payload_digest = false;
     Argument(const Schema_Argument& payload_argument)
     {
         if (payload_argument.type_of_value == "JsonPointer")
@@ -305,6 +329,28 @@ public:
             header_name = "";
             timestamp = true;
         }
+        else if (payload_argument.type_of_value == "UUID")
+        {
+            uuid = true;
+        }
+        else if (payload_argument.type_of_value == "StoredDocument")
+        {
+            // a Json pointer into the stored document, or the whole document
+            json_pointer = payload_argument.value_identifier;
+            stored_document = true;
+        }
+        else if (payload_argument.type_of_value == "ResourceKey")
+        {
+            resource_key = true;
+        }
+        else if (payload_argument.type_of_value == "PayloadLength")
+        {
+            payload_length = true;
+        }
+        else if (payload_argument.type_of_value == "PayloadDigest")
+        {
+            payload_digest = true;
+        }
         substring_start = payload_argument.substring_start;
         substring_length = payload_argument.substring_length;
         if (payload_argument.regex.size())
@@ -321,10 +367,31 @@ public:
             regex_present = true;
         }
     }
+    // the request body is kept only if an argument, or else, needs it
+    bool payload_needed() const
+    {
+        return json_pointer.size() && !stored_document;
+    }
     std::string getValue(H2Server_Request_Message& msg) const
     {
         std::string str;
-        if (json_pointer.size())
+        if (stored_document)
+        {
+            if (json_pointer.empty())
+            {
+                str = msg.stored_document;
+            }
+            else
+            {
+                msg.decode_stored_document_if_not_yet();
+                str = getValueFromJsonPtr(*msg.stored_json, json_pointer);
+            }
+        }
+        else if (resource_key)
+        {
+            str = msg.resource_key;
+        }
+        else if (json_pointer.size())
         {
             msg.decode_json_if_not_yet();
             str = getValueFromJsonPtr(msg.json_payload, json_pointer);
@@ -350,6 +417,20 @@ public:
             buffer << std::put_time(&tm, "%a, %d %b %Y %H:%M:%S %Z");
             str = buffer.str();
         }
+        else if (uuid)
+        {
+            str = generate_uuid();
+        }
+        else if (payload_length)
+        {
+            str = std::to_string(msg.payload_length);
+        }
+        else if (payload_digest)
+        {
+            std::stringstream stream;
+            stream << std::hex << std::setw(16) << std::setfill('0') << msg.request->payload_digest();
+            str = stream.str();
+        }
 
         if (debug_mode)
         {
@@ -417,6 +498,31 @@ public:
             exit(1);
         }
     }
+
+    std::pair<std::string, std::string> produce(H2Server_Request_Message& msg) const
+    {
+        std::string header_with_value;
+        for (size_t index = 0; index < tokenizedHeader.size(); index++)
+        {
+            header_with_value.append(tokenizedHeader[index]);
+            if (index < header_arguments.size())
+            {
+                header_with_value.append(header_arguments[index].getValue(msg));
+            }
+        }
+
+        size_t t = header_with_value.find(":", 1);
+        std::string header_name = header_with_value.substr(0, t);
+        std::string header_value = header_with_value.substr(t + 1);
+        /*
+        header_value.erase(header_value.begin(), std::find_if(header_value.begin(), header_value.end(),
+                                                              [](unsigned char ch)
+        {
+            return !std::isspace(ch);
+        }));
+        */
+        return std::make_pair<std::string, std::string>(std::move(header_name), std::move(header_value));
+    }
 };
 class H2Server_Response
 {
@@ -432,7 +538,12 @@ public:
     std::string name;
     uint32_t weight;
     size_t response_index;
-    explicit H2Server_Response(const Schema_Response_To_Return& resp, size_t index)
+    H2Server_Response_Delay delay;
+    // the request body is used to produce the response
+    bool payload_needed;
+    explicit H2Server_Response(const Schema_Response_To_Return& resp, size_t index):
+        delay(resp.delay),
+        payload_needed(false)
     {
         status_code = resp.status_code;
         name = resp.name;
@@ -465,33 +576,52 @@ public:
 
         if (luaScript.size())
         {
-            luaState = std::shared_ptr<lua_State>(luaL_newstate(), &lua_close);
-            luaL_openlibs(luaState.get());
-            luaL_dostring(luaState.get(), resp.luaScript.c_str());
-            lua_getglobal(luaState.get(), customize_response.c_str());
-            if (!lua_isfunction(luaState.get(), -1))
-            {
-                lua_settop(luaState.get(), 0);
-                std::cerr<<"required function not present or ill-formed: "<<customize_response<<std::endl;
-                luaState.reset();
-                exit(1);
-            }
-            lua_settop(luaState.get(), 0);
+            luaState = create_lua_state();
         }
         lua_offload = resp.lua_offload;
         throttle_ratio = resp.throttle_ratio;
         response_index = index;
+
+        payload_needed = luaScript.size() > 0;
+        for (auto& arg : payload_arguments)
+        {
+            payload_needed = payload_needed || arg.payload_needed();
+        }
+        for (auto& header : additonalHeaders)
+        {
+            for (auto& arg : header.header_arguments)
+            {
+                payload_needed = payload_needed || arg.payload_needed();
+            }
+        }
+    }
+
+    // a Lua state of its own with luaScript loaded, for a thread which runs customize_response of this response
+    std::shared_ptr<lua_State> create_lua_state() const
+    {
+        std::shared_ptr<lua_State> state(luaL_newstate(), &lua_close);
+        luaL_openlibs(state.get());
+        luaL_dostring(state.get(), luaScript.c_str());
+        lua_getglobal(state.get(), customize_response.c_str());
+        if (!lua_isfunction(state.get(), -1))
+        {
+            lua_settop(state.get(), 0);
+            std::cerr<<"required function not present or ill-formed: "<<customize_response<<std::endl;
+            exit(1);
+        }
+        lua_settop(state.get(), 0);
+        return state;
     }
 
     // TODO: add trailer_response support
-    bool update_response_with_lua(const std::multimap<std::string, std::string>& req_headers,
-                                            const std::string& req_body,
-                                            std::map<std::string, std::string>& resp_headers,
-                                            std::map<std::string, std::string>& trailers,
-                                            std::string& response_body) const
+    bool update_response_with_lua(lua_State* L,
+                                  const std::multimap<std::string, std::string>& req_headers,
+                                  const std::string& req_body,
+                                  std::map<std::string, std::string>& resp_headers,
+                                  std::map<std::string, std::string>& trailers,
+                                  std::string& response_body) const
     {
         bool retCode = true;
-        auto L = luaState.get();
         if (!L)
         {
             return retCode;
@@ -620,27 +750,7 @@ public:
 
     std::pair<std::string, std::string> produce_header(const H2Server_Response_Header& header_with_var, H2Server_Request_Message& msg) const
     {
-        std::string header_with_value;
-        for (size_t index = 0; index < header_with_var.tokenizedHeader.size(); index++)
-        {
-            header_with_value.append(header_with_var.tokenizedHeader[index]);
-            if (index < header_with_var.header_arguments.size())
-            {
-                header_with_value.append(header_with_var.header_arguments[index].getValue(msg));
-            }
-        }
-
-        size_t t = header_with_value.find(":", 1);
-        std::string header_name = header_with_value.substr(0, t);
-        std::string header_value = header_with_value.substr(t + 1);
-        /*
-        header_value.erase(header_value.begin(), std::find_if(header_value.begin(), header_value.end(),
-                                                              [](unsigned char ch)
-        {
-            return !std::isspace(ch);
-        }));
-        */
-        return std::make_pair<std::string, std::string>(std::move(header_name), std::move(header_value));
+        return header_with_var.produce(msg);
     }
 
     std::map<std::string, std::string> produce_headers(H2Server_Request_Message& msg) const
@@ -0,0 +1,190 @@
+#ifndef H2SERVER_RESPONSE_DELAY_H
+#define H2SERVER_RESPONSE_DELAY_H
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "H2Server_Config_Schema.h"
+
+/*
+ * Delay of a response, drawn for each response from the distribution configured with "delay";
+ * drawing costs a few arithmetic operations on a generator of the server thread, and allocates nothing.
+ */
+class H2Server_Response_Delay
+{
+public:
+    explicit H2Server_Response_Delay(const Schema_Response_Delay& schema):
+        distribution(NO_DELAY),
+        mean_ms(schema.mean_ms),
+        sd_ms(schema.sd_ms),
+        min_ms(schema.min_ms),
+        max_ms(schema.max_ms),
+        log_mu(0),
+        log_sigma(0)
+    {
+        if (schema.distribution.empty())
+        {
+            return;
+        }
+        else if (schema.distribution == "fixed")
+        {
+            distribution = FIXED;
+        }
+        else if (schema.distribution == "uniform")
+        {
+            distribution = UNIFORM;
+            if (max_ms < min_ms)
+            {
+                std::cerr << "uniform delay, max-ms is less than min-ms: " << staticjson::to_pretty_json_string(
+                              schema) << std::endl;
+                exit(1);
+            }
+        }
+        else if (schema.distribution == "normal")
+        {
+            distribution = NORMAL;
+        }
+        else if (schema.distribution == "log-normal")
+        {
+            distribution = LOG_NORMAL;
+            if (mean_ms <= 0)
+            {
+                std::cerr << "log-normal delay needs mean-ms larger than 0: " << staticjson::to_pretty_json_string(
+                              schema) << std::endl;
+                exit(1);
+            }
+            // parameters of the underlying normal distribution, for the mean and sd of the delay itself
+            log_sigma = std::sqrt(std::log(1 + (sd_ms * sd_ms) / (mean_ms * mean_ms)));
+            log_mu = std::log(mean_ms) - log_sigma * log_sigma / 2;
+        }
+        else if (schema.distribution == "histogram")
+        {
+            distribution = HISTOGRAM;
+            load_histogram(schema.histogram_file);
+        }
+        else
+        {
+            std::cerr << "invalid delay distribution: " << schema.distribution << std::endl;
+            exit(1);
+        }
+    }
+
+    bool enabled() const
+    {
+        return distribution != NO_DELAY;
+    }
+
+    std::chrono::microseconds sample() const
+    {
+        static thread_local std::mt19937_64 generator((std::random_device())());
+        double delay_ms = 0;
+        switch (distribution)
+        {
+            case FIXED:
+            {
+                delay_ms = mean_ms;
+                break;
+            }
+            case UNIFORM:
+            {
+                delay_ms = std::uniform_real_distribution<double>(min_ms, max_ms)(generator);
+                break;
+            }
+            case NORMAL:
+            {
+                delay_ms = std::normal_distribution<double>(mean_ms, sd_ms)(generator);
+                break;
+            }
+            case LOG_NORMAL:
+            {
+                delay_ms = std::lognormal_distribution<double>(log_mu, log_sigma)(generator);
+                break;
+            }
+            case HISTOGRAM:
+            {
+                auto count = std::uniform_real_distribution<double>(0, cumulative_counts.back())(generator);
+                auto bucket = std::upper_bound(cumulative_counts.begin(), cumulative_counts.end(), count) - cumulative_counts.begin();
+                bucket = std::min(bucket, static_cast<decltype(bucket)>(cumulative_counts.size() - 1));
+                double lower_bound = bucket ? bucket_upper_bounds[bucket - 1] : 0;
+                delay_ms = std::uniform_real_distribution<double>(lower_bound, bucket_upper_bounds[bucket])(generator);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        delay_ms = std::max(delay_ms, min_ms);
+        if (max_ms > 0)
+        {
+            delay_ms = std::min(delay_ms, max_ms);
+        }
+        return std::chrono::microseconds(static_cast<int64_t>(delay_ms * 1000));
+    }
+
+private:
+    enum Distribution
+    {
+        NO_DELAY,
+        FIXED,
+        UNIFORM,
+        NORMAL,
+        LOG_NORMAL,
+        HISTOGRAM
+    };
+
+    void load_histogram(const std::string& file_name)
+    {
+        std::ifstream histogram_file(file_name);
+        if (!histogram_file.good())
+        {
+            std::cerr << "cannot open delay histogram-file: " << file_name << std::endl;
+            exit(1);
+        }
+        std::string line;
+        double total_count = 0;
+        while (std::getline(histogram_file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::istringstream bucket(line);
+            double upper_bound;
+            double count;
+            if (!(bucket >> upper_bound >> count) || upper_bound < 0 || count < 0 ||
+                (bucket_upper_bounds.size() && upper_bound < bucket_upper_bounds.back()))
+            {
+                std::cerr << "invalid bucket in delay histogram-file " << file_name << ": " << line << std::endl;
+                exit(1);
+            }
+            total_count += count;
+            bucket_upper_bounds.push_back(upper_bound);
+            cumulative_counts.push_back(total_count);
+        }
+        if (total_count <= 0)
+        {
+            std::cerr << "delay histogram-file has no count: " << file_name << std::endl;
+            exit(1);
+        }
+    }
+
+    Distribution distribution;
+    double mean_ms;
+    double sd_ms;
+    double min_ms;
+    double max_ms;
+    double log_mu;
+    double log_sigma;
+    std::vector<double> bucket_upper_bounds;
+    std::vector<double> cumulative_counts;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef H2SERVER_TIMER_WHEEL_H
+#define H2SERVER_TIMER_WHEEL_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <string>
+#include <chrono>
+#include <limits>
+#include <functional>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/noncopyable.hpp>
+
+// a response held back by "delay", until its tick is due
+struct H2Server_Delayed_Response
+{
+    uint32_t status_code = 0;
+    std::map<std::string, std::string> headers;
+    std::string payload;
+    std::map<std::string, std::string> trailers;
+    uint64_t handler_id = 0;
+    int32_t stream_id = 0;
+    uint64_t* response_sent = nullptr;
+    uint64_t due_tick = 0;
+    size_t next = 0;
+};
+
+/*
+ * Hashed timer wheel of a server thread, with 1ms ticks, holding the delayed responses until they are due.
+ * The entries come from a pool which only grows to the max number of responses in delay at a time,
+ * and the content of a response is swapped in and out, so a delayed response costs no allocation;
+ * the wheel has one steady_timer, armed only while there is a response in delay, for the nearest due tick.
+ */
+class H2Server_Timer_Wheel: private boost::noncopyable
+{
+public:
+    // sends the response, it must not schedule into the wheel
+    using Fire_Handler = std::function<void(H2Server_Delayed_Response&)>;
+
+    H2Server_Timer_Wheel(boost::asio::io_service& ios, Fire_Handler fire_handler):
+        timer(ios),
+        fire_handler(fire_handler),
+        slots(wheel_size, std::numeric_limits<size_t>::max()),
+        free_entries(no_entry),
+        start_time(std::chrono::steady_clock::now()),
+        processed_tick(0),
+        entries_in_wheel(0),
+        timer_armed(false),
+        armed_tick(0)
+    {
+    }
+
+    void schedule(std::chrono::microseconds delay,
+                  uint32_t status_code,
+                  std::map<std::string, std::string>& headers,
+                  std::string& payload,
+                  std::map<std::string, std::string>& trailers,
+                  uint64_t handler_id,
+                  int32_t stream_id,
+                  uint64_t& response_sent)
+    {
+        auto now_tick = get_tick(std::chrono::steady_clock::now());
+        uint64_t delay_ticks = (delay.count() + tick_us - 1) / tick_us;
+        auto due_tick = std::max(now_tick + delay_ticks, processed_tick + 1);
+
+        auto index = get_free_entry();
+        auto& entry = entries[index];
+        entry.status_code = status_code;
+        entry.headers.swap(headers);
+        entry.payload.swap(payload);
+        entry.trailers.swap(trailers);
+        entry.handler_id = handler_id;
+        entry.stream_id = stream_id;
+        entry.response_sent = &response_sent;
+        entry.due_tick = due_tick;
+        auto& slot = slots[due_tick & wheel_mask];
+        entry.next = slot;
+        slot = index;
+        entries_in_wheel++;
+        arm_timer(due_tick);
+    }
+
+private:
+    static constexpr size_t wheel_size = 1024;
+    static constexpr size_t wheel_mask = wheel_size - 1;
+    static constexpr size_t no_entry = std::numeric_limits<size_t>::max();
+    static constexpr int64_t tick_us = 1000;
+
+    uint64_t get_tick(std::chrono::steady_clock::time_point time_point) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time_point - start_time).count() / tick_us;
+    }
+
+    size_t get_free_entry()
+    {
+        if (free_entries == no_entry)
+        {
+            entries.emplace_back();
+            return entries.size() - 1;
+        }
+        auto index = free_entries;
+        free_entries = entries[index].next;
+        return index;
+    }
+
+    // the earliest due tick of the entries in the wheel, there must be one
+    uint64_t get_next_due_tick() const
+    {
+        auto next_due_tick = std::numeric_limits<uint64_t>::max();
+        for (auto tick = processed_tick + 1; tick <= processed_tick + wheel_size; tick++)
+        {
+            for (auto index = slots[tick & wheel_mask]; index != no_entry; index = entries[index].next)
+            {
+                if (entries[index].due_tick == tick)
+                {
+                    return tick;
+                }
+                // due in a later turn of the wheel
+                next_due_tick = std::min(next_due_tick, entries[index].due_tick);
+            }
+        }
+        return next_due_tick;
+    }
+
+    void arm_timer(uint64_t due_tick)
+    {
+        if (timer_armed && armed_tick <= due_tick)
+        {
+            return;
+        }
+        timer_armed = true;
+        armed_tick = due_tick;
+        // cancels the wait for a later tick, if any
+        timer.expires_at(start_time + std::chrono::microseconds(tick_us * due_tick));
+        timer.async_wait([this](const boost::system::error_code & ec)
+        {
+            if (ec)
+            {
+                // re-armed for an earlier tick, which has a wait of its own
+                return;
+            }
+            timer_armed = false;
+            on_tick();
+        });
+    }
+
+    void on_tick()
+    {
+        auto now_tick = get_tick(std::chrono::steady_clock::now());
+        // when far behind, one pass over the wheel covers all the ticks missed
+        auto first_tick = std::max(processed_tick + 1, now_tick >= wheel_size ? now_tick - wheel_size + 1 : 0);
+        for (auto tick = first_tick; tick <= now_tick; tick++)
+        {
+            fire_slot(tick & wheel_mask, now_tick);
+        }
+        processed_tick = std::max(processed_tick, now_tick);
+        if (entries_in_wheel)
+        {
+            arm_timer(get_next_due_tick());
+        }
+    }
+
+    void fire_slot(size_t slot_index, uint64_t now_tick)
+    {
+        auto* link = &slots[slot_index];
+        while (*link != no_entry)
+        {
+            auto index = *link;
+            auto& entry = entries[index];
+            if (entry.due_tick > now_tick)
+            {
+                link = &entry.next;
+                continue;
+            }
+            *link = entry.next;
+            entries_in_wheel--;
+            fire_handler(entry);
+            entry.headers.clear();
+            entry.payload.clear();
+            entry.trailers.clear();
+            entry.next = free_entries;
+            free_entries = index;
+        }
+    }
+
+    boost::asio::steady_timer timer;
+    Fire_Handler fire_handler;
+    std::vector<size_t> slots;
+    std::vector<H2Server_Delayed_Response> entries;
+    size_t free_entries;
+    std::chrono::steady_clock::time_point start_time;
+    uint64_t processed_tick;
+    size_t entries_in_wheel;
+    bool timer_armed;
+    uint64_t armed_tick;
+};
+
+#endif
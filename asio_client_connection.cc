@@ -4,6 +4,7 @@
 #include <string>
 #include <array>
 #include <cstring>
+#include <algorithm>
 #ifdef _WINDOWS
 #include <sdkddkver.h>
 #include <WinError.h>
@@ -22,10 +23,19 @@
 #include "config_schema.h"
 #include "asio_client_connection.h"
 #include "base_worker.h"
+#include "h2load_dns_cache.h"
+#include "asio_worker.h"
 
 namespace h2load
 {
 
+namespace
+{
+// reads of a connection per readiness event, so a busy connection does not hold up the rest of the worker
+const size_t reads_per_readiness = 4;
+const size_t max_shared_input_buffer_size = 256 * 1024;
+}
+
 asio_client_connection::asio_client_connection
 (
     boost::asio::io_service& io_ctx,
@@ -40,24 +50,11 @@ asio_client_connection::asio_client_connection
 )
     : base_client(id, wrker, req_todo, conf, parent, dest_schema, dest_authority),
       io_context(io_ctx),
-      dns_resolver(io_ctx),
+      dns_query_guard(std::make_shared<bool>(true)),
       client_socket(io_ctx),
       client_probe_socket(io_ctx),
-      input_buffer(16 * 1024, 0),
-      output_buffers(2, std::vector<uint8_t>(16 * 1024, 0)),
-      connect_timer(io_ctx),
-      delay_request_execution_timer(io_ctx),
-      rps_timer(io_ctx),
-      conn_activity_timer(io_ctx),
-      ping_timer(io_ctx),
-      conn_inactivity_timer(io_ctx),
-      stream_timeout_timer(io_ctx),
-      timing_script_request_timeout_timer(io_ctx),
-      connect_back_to_preferred_host_timer(io_ctx),
-      delayed_reconnect_timer(io_ctx),
       ssl_ctx(ssl_context),
-      ssl_socket(io_ctx, ssl_context),
-      ssl_handshake_timer(io_ctx),
+      output_buffers(2),
       do_read_fn(&asio_client_connection::do_tcp_read),
       do_write_fn(&asio_client_connection::do_tcp_write)
 {
@@ -77,8 +74,9 @@ void asio_client_connection::start_conn_active_watcher()
     {
         return;
     }
-    conn_activity_timer.expires_from_now(boost::posix_time::millisec((size_t)(1000 * config->conn_active_timeout)));
-    conn_activity_timer.async_wait
+    auto timeout = boost::posix_time::millisec((size_t)(1000 * config->conn_active_timeout));
+    conn_activity_timer.get(io_context).expires_from_now(timeout);
+    conn_activity_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -88,8 +86,8 @@ void asio_client_connection::start_conn_active_watcher()
 
 void asio_client_connection::start_ssl_handshake_watcher()
 {
-    ssl_handshake_timer.expires_from_now(boost::posix_time::millisec((size_t)(1000 * 2)));
-    ssl_handshake_timer.async_wait
+    ssl_handshake_timer.get(io_context).expires_from_now(boost::posix_time::millisec((size_t)(1000 * 2)));
+    ssl_handshake_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -104,20 +102,21 @@ void asio_client_connection::start_conn_inactivity_watcher()
         return;
     }
 
-    conn_inactivity_timer.expires_from_now(boost::posix_time::millisec((size_t)(1000 * config->conn_inactivity_timeout)));
-    conn_inactivity_timer.async_wait
+    auto timeout = boost::posix_time::millisec((size_t)(1000 * config->conn_inactivity_timeout));
+    conn_inactivity_timer.get(io_context).expires_from_now(timeout);
+    conn_inactivity_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
-        handle_con_activity_timer_timeout(ec);
+        handle_con_inactivity_timer_timeout(ec);
     });
 }
 
 void asio_client_connection::start_stream_timeout_timer()
 {
-    stream_timeout_timer.expires_from_now(boost::posix_time::millisec(10));
+    stream_timeout_timer.get(io_context).expires_from_now(boost::posix_time::millisec(10));
 
-    stream_timeout_timer.async_wait
+    stream_timeout_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -138,8 +137,9 @@ void asio_client_connection::stop_rps_timer()
 
 void asio_client_connection::start_timing_script_request_timeout_timer(double duration)
 {
-    timing_script_request_timeout_timer.expires_from_now(boost::posix_time::millisec((size_t)(duration * 1000)));
-    timing_script_request_timeout_timer.async_wait
+    auto timeout = boost::posix_time::millisec((size_t)(duration * 1000));
+    timing_script_request_timeout_timer.get(io_context).expires_from_now(timeout);
+    timing_script_request_timeout_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -154,8 +154,8 @@ void asio_client_connection::stop_timing_script_request_timeout_timer()
 
 void asio_client_connection::start_connect_timeout_timer()
 {
-    connect_timer.expires_from_now(boost::posix_time::seconds(2));
-    connect_timer.async_wait
+    connect_timer.get(io_context).expires_from_now(boost::posix_time::seconds(2));
+    connect_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -170,8 +170,8 @@ void asio_client_connection::stop_connect_timeout_timer()
 
 void asio_client_connection::start_connect_to_preferred_host_timer()
 {
-    connect_back_to_preferred_host_timer.expires_from_now(boost::posix_time::millisec(1000));
-    connect_back_to_preferred_host_timer.async_wait
+    connect_back_to_preferred_host_timer.get(io_context).expires_from_now(boost::posix_time::millisec(1000));
+    connect_back_to_preferred_host_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -181,8 +181,8 @@ void asio_client_connection::start_connect_to_preferred_host_timer()
 
 void asio_client_connection::start_delayed_reconnect_timer()
 {
-    delayed_reconnect_timer.expires_from_now(boost::posix_time::millisec(1000));
-    delayed_reconnect_timer.async_wait
+    delayed_reconnect_timer.get(io_context).expires_from_now(boost::posix_time::millisec(1000));
+    delayed_reconnect_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -258,15 +258,13 @@ void asio_client_connection::feed_timing_script_request_timeout_timer()
 
 size_t asio_client_connection::push_data_to_output_buffer(const uint8_t* data, size_t length)
 {
-    if (output_buffers[output_buffer_index].capacity() - output_data_length < length)
+    auto& buffer = output_buffers[output_buffer_index];
+    if (buffer.capacity() == 0)
     {
-        std::vector<uint8_t> tempBuffer(output_data_length, 0);
-        std::memcpy(tempBuffer.data(), output_buffers[output_buffer_index].data(), output_data_length);
-        output_buffers[output_buffer_index].reserve(output_data_length + length);
-        std::memcpy(output_buffers[output_buffer_index].data(), tempBuffer.data(), output_data_length);
+        // allocated on the first write after the connection was idle, see handle_write_complete
+        buffer.reserve(std::max<size_t>(length, 16 * 1024));
     }
-    std::memcpy(output_buffers[output_buffer_index].data() + output_data_length, data, length);
-    output_data_length += length;
+    buffer.insert(buffer.end(), data, data + length);
     return length;
 }
 void asio_client_connection::signal_write()
@@ -283,7 +281,7 @@ void asio_client_connection::signal_write()
 }
 bool asio_client_connection::any_pending_data_to_write()
 {
-    return (output_data_length > 0);
+    return !output_buffers[output_buffer_index].empty();
 }
 
 std::shared_ptr<base_client> asio_client_connection::create_dest_client(const std::string& dst_sch,
@@ -314,22 +312,48 @@ int asio_client_connection::connect_to_host(const std::string& dest_schema, cons
         exit(1);
     }
 
-    if (schema == "https")
+    if (schema == "https" && config->json_config_schema.kernel_tls)
     {
+        if (!ktls_socket)
+        {
+            ktls_socket.reset(new nghttp2::asio_http2::ktls_stream(io_context, ssl_ctx));
+        }
+        ktls_socket->reset();
+        do_read_fn = &asio_client_connection::do_ktls_read;
+        do_write_fn = &asio_client_connection::do_ktls_write;
+        ssl = ktls_socket->native_handle();
+    }
+    else if (schema == "https")
+    {
+        if (!ssl_socket)
+        {
+            ssl_socket.reset(new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(io_context, ssl_ctx));
+        }
         do_read_fn = &asio_client_connection::do_ssl_read;
         do_write_fn = &asio_client_connection::do_ssl_write;
-        ssl = ssl_socket.native_handle();
+        ssl = ssl_socket->native_handle();
     }
     else
     {
         do_read_fn = &asio_client_connection::do_tcp_read;
         do_write_fn = &asio_client_connection::do_tcp_write;
+#ifdef USE_IO_URING
+        if (get_io_uring_engine())
+        {
+            do_read_fn = &asio_client_connection::do_uring_read;
+            do_write_fn = &asio_client_connection::do_uring_write;
+        }
+#endif
     }
 
-    boost::asio::ip::tcp::resolver::query query(host, port);
-    dns_resolver.async_resolve(query,
-                               [this](const boost::system::error_code & err, boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
+    std::weak_ptr<bool> guard = dns_query_guard;
+    DNS_Cache::instance().resolve(io_context, host, port,
+                                  [this, guard](const boost::system::error_code & err, boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
     {
+        if (guard.expired())
+        {
+            return;
+        }
         on_resolve_result_event(err, endpoint_iterator);
     });
     start_connect_timeout_timer();
@@ -350,10 +374,14 @@ void asio_client_connection::probe_and_connect_to(const std::string& schema, con
         return;
     }
 
-    boost::asio::ip::tcp::resolver::query query(host, port);
-    dns_resolver.async_resolve(query,
-                               [this](const boost::system::error_code & err, boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
+    std::weak_ptr<bool> guard = dns_query_guard;
+    DNS_Cache::instance().resolve(io_context, host, port,
+                                  [this, guard](const boost::system::error_code & err, boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
     {
+        if (guard.expired())
+        {
+            return;
+        }
         on_probe_resolve_result_event(err, endpoint_iterator);
     });
 }
@@ -402,9 +430,9 @@ void asio_client_connection::start_ping_watcher()
     {
         return;
     }
-    ping_timer.expires_from_now(boost::posix_time::millisec((size_t)(1000 *
+    ping_timer.get(io_context).expires_from_now(boost::posix_time::millisec((size_t)(1000 *
                                                                      config->json_config_schema.interval_to_send_ping)));
-    ping_timer.async_wait
+    ping_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -414,8 +442,8 @@ void asio_client_connection::start_ping_watcher()
 
 void asio_client_connection::restart_rps_timer()
 {
-    rps_timer.expires_from_now(boost::posix_time::millisec(std::max(100, 1000 / (int)rps)));
-    rps_timer.async_wait
+    rps_timer.get(io_context).expires_from_now(boost::posix_time::millisec(std::max(100, 1000 / (int)rps)));
+    rps_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -423,7 +451,7 @@ void asio_client_connection::restart_rps_timer()
     });
 }
 
-bool asio_client_connection::timer_common_check(boost::asio::deadline_timer& timer, const boost::system::error_code& ec,
+bool asio_client_connection::timer_common_check(lazy_deadline_timer& timer, const boost::system::error_code& ec,
                                                 void (asio_client_connection::*handler)(const boost::system::error_code&))
 {
     if (ec)
@@ -436,10 +464,10 @@ bool asio_client_connection::timer_common_check(boost::asio::deadline_timer& tim
         return false;
     }
 
-    if (timer.expires_at() >
+    if (timer->expires_at() >
         boost::asio::deadline_timer::traits_type::now())
     {
-        timer.async_wait
+        timer->async_wait
         (
             [this, handler](const boost::system::error_code & ec)
         {
@@ -541,7 +569,7 @@ void asio_client_connection::handle_con_activity_timer_timeout(const boost::syst
 
 void asio_client_connection::handle_con_inactivity_timer_timeout(const boost::system::error_code& ec)
 {
-    if (!timer_common_check(conn_activity_timer, ec, &asio_client_connection::handle_con_inactivity_timer_timeout))
+    if (!timer_common_check(conn_inactivity_timer, ec, &asio_client_connection::handle_con_inactivity_timer_timeout))
     {
         return;
     }
@@ -573,8 +601,8 @@ void asio_client_connection::graceful_restart_connection()
 
 void asio_client_connection::start_request_delay_execution_timer()
 {
-    delay_request_execution_timer.expires_from_now(boost::posix_time::millisec(10));
-    delay_request_execution_timer.async_wait
+    delay_request_execution_timer.get(io_context).expires_from_now(boost::posix_time::millisec(10));
+    delay_request_execution_timer->async_wait
     (
         [this](const boost::system::error_code & ec)
     {
@@ -606,9 +634,7 @@ void asio_client_connection::on_probe_connected_event(const boost::system::error
 
 void asio_client_connection::start_async_handshake()
 {
-    ssl_socket.async_handshake(
-        boost::asio::ssl::stream_base::client,
-        [this](const boost::system::error_code & e)
+    auto handshake_handler = [this](const boost::system::error_code & e)
     {
         if (e)
         {
@@ -617,12 +643,25 @@ void asio_client_connection::start_async_handshake()
         else
         {
             ssl_handshake_timer.cancel();
+            if (config->verbose && config->json_config_schema.kernel_tls)
+            {
+                std::cerr << "kTLS send: " << (ktls_socket->ktls_send_active() ? "on" : "off")
+                          << ", kTLS receive: " << (ktls_socket->ktls_receive_active() ? "on" : "off") << std::endl;
+            }
             if (connected() != 0)
             {
                 handle_connection_error();
             }
         }
-    });
+    };
+    if (config->json_config_schema.kernel_tls)
+    {
+        ktls_socket->async_handshake(boost::asio::ssl::stream_base::client, handshake_handler);
+    }
+    else
+    {
+        ssl_socket->async_handshake(boost::asio::ssl::stream_base::client, handshake_handler);
+    }
 }
 
 template<typename SOCKET>
@@ -641,6 +680,17 @@ void asio_client_connection::on_connected_event(const boost::system::error_code&
         socket.lowest_layer().set_option(rcv_option);
         boost::asio::socket_base::receive_buffer_size snd_option(config->json_config_schema.skt_send_buffer_size);
         socket.lowest_layer().set_option(snd_option);
+#ifdef SO_BUSY_POLL
+        if (config->json_config_schema.socket_busy_poll_time_us)
+        {
+            int busy_poll_time = config->json_config_schema.socket_busy_poll_time_us;
+            if (setsockopt(socket.lowest_layer().native_handle(), SOL_SOCKET, SO_BUSY_POLL,
+                           &busy_poll_time, sizeof(busy_poll_time)) != 0 && config->verbose)
+            {
+                std::cerr << "setting SO_BUSY_POLL failed: " << strerror(errno) << std::endl;
+            }
+        }
+#endif
 
         if (schema != "https")
         {
@@ -742,11 +792,9 @@ void asio_client_connection::handle_read_complete(const boost::system::error_cod
         // a read finish callback gets scheduled while a connection switch is ongoing, do nothing
         return;
     }
-    worker->stats.bytes_total += bytes_transferred;
-    restart_timeout_timer();
-    if (session->on_read(input_buffer.data(), bytes_transferred) != 0)
+    if (!handle_read_data(input_buffer.data(), bytes_transferred))
     {
-        return handle_connection_error();
+        return;
     }
     if (bytes_transferred >= input_buffer.size())
     {
@@ -755,6 +803,18 @@ void asio_client_connection::handle_read_complete(const boost::system::error_cod
     do_read();
 }
 
+bool asio_client_connection::handle_read_data(const uint8_t* data, std::size_t length)
+{
+    worker->stats.bytes_total += length;
+    restart_timeout_timer();
+    if (session->on_read(data, length) != 0)
+    {
+        handle_connection_error();
+        return false;
+    }
+    return true;
+}
+
 template<typename SOCKET>
 void asio_client_connection::common_read(SOCKET& socket)
 {
@@ -762,6 +822,10 @@ void asio_client_connection::common_read(SOCKET& socket)
     {
         return;
     }
+    if (input_buffer.empty())
+    {
+        input_buffer.resize(16 * 1024);
+    }
     socket.async_read_some(
         boost::asio::buffer(input_buffer),
         [this](const boost::system::error_code & e, std::size_t bytes_transferred)
@@ -770,14 +834,77 @@ void asio_client_connection::common_read(SOCKET& socket)
     });
 }
 
+template<typename SOCKET>
+void asio_client_connection::common_reactive_read(SOCKET& socket)
+{
+    if (is_client_stopped)
+    {
+        return;
+    }
+    socket.lowest_layer().async_wait(boost::asio::socket_base::wait_read,
+                                     [this, &socket](const boost::system::error_code & e)
+    {
+        if (e)
+        {
+            return handle_read_complete(e, 0);
+        }
+        read_available_data(socket);
+    });
+}
+
+template<typename SOCKET>
+void asio_client_connection::read_available_data(SOCKET& socket)
+{
+    // the session consumes what is read before this returns, so all connections of a worker can share one buffer,
+    // and a connection holds no read buffer of its own while it waits for data
+    auto& buffer = static_cast<asio_worker*>(worker)->get_shared_input_buffer();
+    for (size_t reads = 0; reads < reads_per_readiness; reads++)
+    {
+        if (is_client_stopped || !session)
+        {
+            return;
+        }
+        boost::system::error_code ec;
+        auto bytes_transferred = socket.read_some(boost::asio::buffer(buffer), ec);
+        if (ec == boost::asio::error::would_block)
+        {
+            return common_reactive_read(socket);
+        }
+        if (ec)
+        {
+            return handle_read_complete(ec, 0);
+        }
+        if (!handle_read_data(buffer.data(), bytes_transferred))
+        {
+            return;
+        }
+        if (bytes_transferred >= buffer.size() && buffer.size() < max_shared_input_buffer_size)
+        {
+            buffer.resize(std::min(2 * bytes_transferred, max_shared_input_buffer_size));
+        }
+    }
+    // there may be more to read, it is picked up after the handlers already queued on the worker have run
+    common_reactive_read(socket);
+}
+
 void asio_client_connection::do_tcp_read()
 {
-    common_read(client_socket);
+    if (!client_socket.non_blocking())
+    {
+        boost::system::error_code ignored_ec;
+        client_socket.non_blocking(true, ignored_ec);
+    }
+    common_reactive_read(client_socket);
 }
 
 void asio_client_connection::do_ssl_read()
 {
-    common_read(ssl_socket);
+    common_read(*ssl_socket);
+}
+
+void asio_client_connection::do_ktls_read()
+{
+    common_reactive_read(*ktls_socket);
 }
 
 void asio_client_connection::do_read()
@@ -815,6 +942,16 @@ void asio_client_connection::handle_write_complete(const boost::system::error_co
     }
 
     do_write();
+
+    if (!is_write_in_progress && output_buffers[output_buffer_index].empty() && streams.empty())
+    {
+        // nothing in flight, give the memory back until the connection is busy again
+        for (auto& buffer : output_buffers)
+        {
+            std::vector<uint8_t>().swap(buffer);
+        }
+        streams.shrink();
+    }
 }
 
 void asio_client_connection::handle_write_signal()
@@ -826,9 +963,9 @@ void asio_client_connection::handle_write_signal()
     }
     for (;;)
     {
-        auto output_data_length_before = output_data_length;
+        auto output_data_length_before = output_buffers[output_buffer_index].size();
         session->on_write();
-        auto bytes_to_write = output_data_length - output_data_length_before;
+        auto bytes_to_write = output_buffers[output_buffer_index].size() - output_data_length_before;
         if (!bytes_to_write)
         {
             break;
@@ -840,17 +977,18 @@ void asio_client_connection::handle_write_signal()
 template<typename SOCKET>
 void asio_client_connection::common_write(SOCKET& socket)
 {
-    if (is_write_in_progress || is_client_stopped || output_data_length <= 0)
+    if (is_write_in_progress || is_client_stopped || output_buffers[output_buffer_index].empty())
     {
         return;
     }
 
     auto& buffer = output_buffers[output_buffer_index];
-    auto length = output_data_length;
+    auto length = buffer.size();
 
     is_write_in_progress = true;
-    output_data_length = 0;
     output_buffer_index = ((++output_buffer_index) % output_buffers.size());
+    // the other buffer was sent before this write started, what it held is done with
+    output_buffers[output_buffer_index].clear();
 
     boost::asio::async_write(
         socket, boost::asio::buffer(buffer.data(), length),
@@ -867,7 +1005,12 @@ void asio_client_connection::do_tcp_write()
 
 void asio_client_connection::do_ssl_write()
 {
-    common_write(ssl_socket);
+    common_write(*ssl_socket);
+}
+
+void asio_client_connection::do_ktls_write()
+{
+    common_write(*ktls_socket);
 }
 
 void asio_client_connection::do_write()
@@ -875,6 +1018,101 @@ void asio_client_connection::do_write()
     do_write_fn(*this);
 }
 
+#ifdef USE_IO_URING
+io_uring_engine* asio_client_connection::get_io_uring_engine()
+{
+    return static_cast<asio_worker*>(worker)->get_io_uring_engine();
+}
+
+void asio_client_connection::do_uring_read()
+{
+    if (is_client_stopped || uring_receive_operation)
+    {
+        // multishot receive, armed once per connection
+        return;
+    }
+    uring_receive_operation =
+        get_io_uring_engine()->start_receive(client_socket.native_handle(),
+                                             [this](int result, const uint8_t* data, size_t length)
+    {
+        handle_uring_read(result, data, length);
+    });
+}
+
+void asio_client_connection::handle_uring_read(int result, const uint8_t* data, size_t length)
+{
+    if (result <= 0)
+    {
+        uring_receive_operation = 0;
+        boost::system::error_code ec = boost::asio::error::eof;
+        if (result < 0)
+        {
+            ec.assign(-result, boost::system::system_category());
+        }
+        if (config->verbose)
+        {
+            std::cerr << "read error code: " << ec << std::endl;
+        }
+        return handle_connection_error();
+    }
+    if (!session)
+    {
+        return;
+    }
+    handle_read_data(data, length);
+}
+
+void asio_client_connection::do_uring_write()
+{
+    if (is_write_in_progress || is_client_stopped || output_buffers[output_buffer_index].empty())
+    {
+        return;
+    }
+
+    auto& buffer = output_buffers[output_buffer_index];
+    auto length = buffer.size();
+
+    is_write_in_progress = true;
+    uring_send_buffer_index = output_buffer_index;
+    output_buffer_index = ((++output_buffer_index) % output_buffers.size());
+    // the other buffer was sent before this write started, what it held is done with
+    output_buffers[output_buffer_index].clear();
+
+    uring_send_operation =
+        get_io_uring_engine()->send(client_socket.native_handle(), buffer.data(), length,
+                                    [this](int result)
+    {
+        uring_send_operation = 0;
+        boost::system::error_code ec;
+        if (result < 0)
+        {
+            ec.assign(-result, boost::system::system_category());
+        }
+        handle_write_complete(ec, result < 0 ? 0 : result);
+    });
+}
+
+void asio_client_connection::cancel_uring_operations()
+{
+    auto engine = get_io_uring_engine();
+    if (!engine)
+    {
+        return;
+    }
+    if (uring_receive_operation)
+    {
+        engine->cancel(uring_receive_operation);
+        uring_receive_operation = 0;
+    }
+    if (uring_send_operation)
+    {
+        // the kernel may still read from the buffer, hand it over to the engine until the send is done
+        engine->cancel(uring_send_operation, std::move(output_buffers[uring_send_buffer_index]));
+        uring_send_operation = 0;
+    }
+}
+#endif
+
 void asio_client_connection::stop()
 {
     if (is_client_stopped)
@@ -882,9 +1120,19 @@ void asio_client_connection::stop()
         return;
     }
     is_client_stopped = true;
+#ifdef USE_IO_URING
+    cancel_uring_operations();
+#endif
     boost::system::error_code ignored_ec;
     client_socket.lowest_layer().close(ignored_ec);
-    ssl_socket.lowest_layer().close(ignored_ec);
+    if (ssl_socket)
+    {
+        ssl_socket->lowest_layer().close(ignored_ec);
+    }
+    if (ktls_socket)
+    {
+        ktls_socket->lowest_layer().close(ignored_ec);
+    }
     connect_timer.cancel();
     rps_timer.cancel();
     delay_request_execution_timer.cancel();
@@ -923,9 +1171,13 @@ void asio_client_connection::on_resolve_result_event(const boost::system::error_
         {
             start_async_connect(endpoint_iterator, client_socket);
         }
+        else if (config->json_config_schema.kernel_tls)
+        {
+            start_async_connect(endpoint_iterator, *ktls_socket);
+        }
         else
         {
-            start_async_connect(endpoint_iterator, ssl_socket);
+            start_async_connect(endpoint_iterator, *ssl_socket);
         }
     }
     else
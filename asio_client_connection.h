@@ -34,10 +34,44 @@
 #include "h2load_Config.h"
 #include "h2load_stats.h"
 #include "config_schema.h"
+#include "asio_ktls_stream.h"
+#ifdef USE_IO_URING
+#include "io_uring_engine.h"
+#endif
 
 namespace h2load
 {
 
+// deadline_timer allocated on first use; most timers of a connection never run, and idle connections are many
+class lazy_deadline_timer
+{
+public:
+    boost::asio::deadline_timer& get(boost::asio::io_service& io_ctx)
+    {
+        if (!timer)
+        {
+            timer.reset(new boost::asio::deadline_timer(io_ctx));
+        }
+        return *timer;
+    }
+
+    boost::asio::deadline_timer* operator->()
+    {
+        return timer.get();
+    }
+
+    void cancel()
+    {
+        if (timer)
+        {
+            timer->cancel();
+        }
+    }
+
+private:
+    std::unique_ptr<boost::asio::deadline_timer> timer;
+};
+
 class asio_client_connection
     : public h2load::base_client, private boost::noncopyable
 {
@@ -124,7 +158,7 @@ private:
 
     void restart_rps_timer();
 
-    bool timer_common_check(boost::asio::deadline_timer& timer, const boost::system::error_code& ec,
+    bool timer_common_check(lazy_deadline_timer& timer, const boost::system::error_code& ec,
                             void (asio_client_connection::*handler)(const boost::system::error_code&));
 
     virtual void start_rps_timer();
@@ -170,13 +204,24 @@ private:
 
     void handle_read_complete(const boost::system::error_code& e, const std::size_t bytes_transferred);
 
+    bool handle_read_data(const uint8_t* data, std::size_t length);
+
     template<typename SOCKET>
     void common_read(SOCKET& socket);
 
+    // waits for readability, then reads into the worker's shared input buffer; for streams with a non-blocking read_some
+    template<typename SOCKET>
+    void common_reactive_read(SOCKET& socket);
+
+    template<typename SOCKET>
+    void read_available_data(SOCKET& socket);
+
     void do_tcp_read();
 
     void do_ssl_read();
 
+    void do_ktls_read();
+
     void do_read();
 
     void handle_write_complete(const boost::system::error_code& e, std::size_t bytes_transferred);
@@ -190,8 +235,22 @@ private:
 
     void do_ssl_write();
 
+    void do_ktls_write();
+
     void do_write();
 
+#ifdef USE_IO_URING
+    io_uring_engine* get_io_uring_engine();
+
+    void do_uring_read();
+
+    void handle_uring_read(int result, const uint8_t* data, size_t length);
+
+    void do_uring_write();
+
+    void cancel_uring_operations();
+#endif
+
     void stop();
 
     template <typename SOCKET>
@@ -204,32 +263,42 @@ private:
                                        boost::asio::ip::tcp::resolver::iterator endpoint_iterator);
 
     boost::asio::io_service& io_context;
-    boost::asio::ip::tcp::resolver dns_resolver;
+    // resolution results come from the shared DNS_Cache, and are dropped if this connection is gone by then
+    std::shared_ptr<bool> dns_query_guard;
     boost::asio::ip::tcp::socket client_socket;
     boost::asio::ip::tcp::socket client_probe_socket;
     boost::asio::ssl::context& ssl_ctx;
-    boost::asio::ssl::stream<boost::asio::ip::tcp::socket> ssl_socket;
+    // TLS streams are created by the first https connect; a boost ssl stream alone holds close to 80 KB
+    std::unique_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> ssl_socket;
+    // used instead of ssl_socket with kernel-tls
+    std::unique_ptr<nghttp2::asio_http2::ktls_stream> ktls_socket;
     bool is_write_in_progress = false;
     bool is_client_stopped = false;
     bool write_signaled = false;
 
+    // only used by the boost ssl stream, other streams read into the worker's shared input buffer
     std::vector<uint8_t> input_buffer;
+    // allocated on demand, and released when the connection goes idle
     std::vector<std::vector<uint8_t>> output_buffers;
-    size_t output_data_length = 0;
     size_t output_buffer_index = 0;
 
-    boost::asio::deadline_timer connect_timer;
-    boost::asio::deadline_timer delay_request_execution_timer;
-    boost::asio::deadline_timer rps_timer;
-    boost::asio::deadline_timer conn_activity_timer;
-    boost::asio::deadline_timer ping_timer;
-    boost::asio::deadline_timer conn_inactivity_timer;
-    boost::asio::deadline_timer stream_timeout_timer;
-    boost::asio::deadline_timer timing_script_request_timeout_timer;
-    boost::asio::deadline_timer connect_back_to_preferred_host_timer;
-    boost::asio::deadline_timer delayed_reconnect_timer;
-    boost::asio::deadline_timer ssl_handshake_timer;
+    lazy_deadline_timer connect_timer;
+    lazy_deadline_timer delay_request_execution_timer;
+    lazy_deadline_timer rps_timer;
+    lazy_deadline_timer conn_activity_timer;
+    lazy_deadline_timer ping_timer;
+    lazy_deadline_timer conn_inactivity_timer;
+    lazy_deadline_timer stream_timeout_timer;
+    lazy_deadline_timer timing_script_request_timeout_timer;
+    lazy_deadline_timer connect_back_to_preferred_host_timer;
+    lazy_deadline_timer delayed_reconnect_timer;
+    lazy_deadline_timer ssl_handshake_timer;
     std::function<void(asio_client_connection&)> do_read_fn, do_write_fn;
+#ifdef USE_IO_URING
+    uint64_t uring_receive_operation = 0;
+    uint64_t uring_send_operation = 0;
+    size_t uring_send_buffer_index = 0;
+#endif
 
     std::function<bool(void)> write_clear_callback;
 };
@@ -180,30 +180,5 @@ boost::system::error_code host_service_from_uri(boost::system::error_code& ec,
     return ec;
 }
 
-bool tls_h2_negotiated(ssl_socket& socket)
-{
-    auto ssl = socket.native_handle();
-
-    const unsigned char* next_proto = nullptr;
-    unsigned int next_proto_len = 0;
-
-#ifndef OPENSSL_NO_NEXTPROTONEG
-    SSL_get0_next_proto_negotiated(ssl, &next_proto, &next_proto_len);
-#endif // !OPENSSL_NO_NEXTPROTONEG
-#if OPENSSL_VERSION_NUMBER >= 0x10002000L
-    if (next_proto == nullptr)
-    {
-        SSL_get0_alpn_selected(ssl, &next_proto, &next_proto_len);
-    }
-#endif // OPENSSL_VERSION_NUMBER >= 0x10002000L
-
-    if (next_proto == nullptr)
-    {
-        return false;
-    }
-
-    return util::check_h2_is_selected(StringRef{next_proto, next_proto_len});
-}
-
 } // namespace asio_http2
 } // namespace nghttp2
@@ -32,6 +32,7 @@
 #include <nghttp2/asio_http2.h>
 
 #include "util.h"
+#include "asio_ktls_stream.h"
 
 namespace nghttp2 {
 
@@ -64,7 +65,7 @@ using boost::asio::ip::tcp;
 
 using ssl_socket = boost::asio::ssl::stream<tcp::socket>;
 
-bool tls_h2_negotiated(ssl_socket &socket);
+using ktls_socket = ktls_stream;
 
 } // namespace asio_http2
 
@@ -0,0 +1,268 @@
+#ifndef ASIO_KTLS_STREAM_H
+#define ASIO_KTLS_STREAM_H
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/noncopyable.hpp>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/bio.h>
+
+namespace nghttp2
+{
+
+namespace asio_http2
+{
+
+/*
+ * TLS stream with the same async interface as boost::asio::ssl::stream<tcp::socket>,
+ * but with OpenSSL working directly on the socket instead of on memory BIOs,
+ * so that with SSL_OP_ENABLE_KTLS (OpenSSL 3 built with ktls, Linux tls module loaded)
+ * the negotiated keys are installed into the kernel after the handshake, and reads/writes go straight to the socket,
+ * with record encryption done by the kernel (or the NIC).
+ * Without kernel support, OpenSSL falls back to encrypting in user space on the same socket.
+ */
+class ktls_stream: private boost::noncopyable
+{
+public:
+    using lowest_layer_type = boost::asio::ip::tcp::socket;
+    using executor_type = boost::asio::ip::tcp::socket::executor_type;
+
+    ktls_stream(boost::asio::io_service& io_ctx, boost::asio::ssl::context& ssl_context):
+        socket(io_ctx),
+        ssl_ctx(ssl_context.native_handle()),
+        ssl(nullptr)
+    {
+        reset();
+    }
+
+    ~ktls_stream()
+    {
+        SSL_free(ssl);
+    }
+
+    // prepares a fresh SSL session, for the next connection of the same stream
+    void reset()
+    {
+        SSL_free(ssl);
+        ssl = SSL_new(ssl_ctx);
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
+        SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    }
+
+    lowest_layer_type& lowest_layer()
+    {
+        return socket;
+    }
+
+    lowest_layer_type& next_layer()
+    {
+        return socket;
+    }
+
+    executor_type get_executor()
+    {
+        return socket.get_executor();
+    }
+
+    SSL* native_handle()
+    {
+        return ssl;
+    }
+
+    bool ktls_send_active() const
+    {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+        return BIO_get_ktls_send(SSL_get_wbio(ssl));
+#else
+        return false;
+#endif
+    }
+
+    bool ktls_receive_active() const
+    {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+        return BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#else
+        return false;
+#endif
+    }
+
+    // the socket has to be connected (client) or accepted (server) already
+    template <typename Handler>
+    void async_handshake(boost::asio::ssl::stream_base::handshake_type type, Handler handler)
+    {
+        boost::system::error_code ec;
+        socket.non_blocking(true, ec);
+        if (ec || !SSL_set_fd(ssl, socket.native_handle()))
+        {
+            post(std::move(handler), ec ? ec : boost::asio::error::bad_descriptor);
+            return;
+        }
+        if (type == boost::asio::ssl::stream_base::client)
+        {
+            SSL_set_connect_state(ssl);
+        }
+        else
+        {
+            SSL_set_accept_state(ssl);
+        }
+        continue_handshake(std::move(handler));
+    }
+
+    template <typename MutableBufferSequence, typename Handler>
+    void async_read_some(const MutableBufferSequence& buffers, Handler handler)
+    {
+        boost::asio::mutable_buffer buffer = *boost::asio::buffer_sequence_begin(buffers);
+        continue_io(false, buffer.data(), buffer.size(), std::move(handler));
+    }
+
+    template <typename ConstBufferSequence, typename Handler>
+    void async_write_some(const ConstBufferSequence& buffers, Handler handler)
+    {
+        boost::asio::const_buffer buffer = *boost::asio::buffer_sequence_begin(buffers);
+        continue_io(true, const_cast<void*>(buffer.data()), buffer.size(), std::move(handler));
+    }
+
+    // non-blocking read, would_block if nothing is buffered in the session or readable on the socket;
+    // to be used after the socket is reported readable, e.g. by lowest_layer().async_wait()
+    template <typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers, boost::system::error_code& ec)
+    {
+        boost::asio::mutable_buffer buffer = *boost::asio::buffer_sequence_begin(buffers);
+        ERR_clear_error();
+        size_t bytes_transferred = 0;
+        auto rv = SSL_read_ex(ssl, buffer.data(), buffer.size(), &bytes_transferred);
+        if (rv == 1)
+        {
+            ec = boost::system::error_code();
+            return bytes_transferred;
+        }
+        auto ssl_error = SSL_get_error(ssl, rv);
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+        {
+            ec = boost::asio::error::would_block;
+        }
+        else
+        {
+            ec = error_from_ssl(ssl_error);
+        }
+        return 0;
+    }
+
+private:
+    template <typename Handler>
+    void post(Handler handler, const boost::system::error_code& ec)
+    {
+        boost::asio::post(socket.get_executor(), [handler = std::move(handler), ec]() mutable
+        {
+            handler(ec);
+        });
+    }
+
+    template <typename Handler>
+    void post(Handler handler, const boost::system::error_code& ec, std::size_t bytes_transferred)
+    {
+        boost::asio::post(socket.get_executor(), [handler = std::move(handler), ec, bytes_transferred]() mutable
+        {
+            handler(ec, bytes_transferred);
+        });
+    }
+
+    static boost::system::error_code error_from_ssl(int ssl_error)
+    {
+        if (ssl_error == SSL_ERROR_ZERO_RETURN)
+        {
+            return boost::asio::error::eof;
+        }
+        auto error = ERR_get_error();
+        if (error)
+        {
+            return boost::system::error_code(static_cast<int>(error), boost::asio::error::get_ssl_category());
+        }
+        if (ssl_error == SSL_ERROR_SYSCALL && errno)
+        {
+            return boost::system::error_code(errno, boost::system::system_category());
+        }
+        return boost::asio::error::connection_reset;
+    }
+
+    template <typename Handler>
+    void continue_handshake(Handler handler)
+    {
+        ERR_clear_error();
+        auto rv = SSL_do_handshake(ssl);
+        if (rv == 1)
+        {
+            post(std::move(handler), boost::system::error_code());
+            return;
+        }
+        auto ssl_error = SSL_get_error(ssl, rv);
+        if (ssl_error != SSL_ERROR_WANT_READ && ssl_error != SSL_ERROR_WANT_WRITE)
+        {
+            post(std::move(handler), error_from_ssl(ssl_error));
+            return;
+        }
+        auto wait_type = (ssl_error == SSL_ERROR_WANT_READ) ? boost::asio::ip::tcp::socket::wait_read :
+                         boost::asio::ip::tcp::socket::wait_write;
+        socket.async_wait(wait_type, [this, handler = std::move(handler)](const boost::system::error_code & ec) mutable
+        {
+            if (ec)
+            {
+                handler(ec);
+                return;
+            }
+            continue_handshake(std::move(handler));
+        });
+    }
+
+    // data must stay valid until the handler is called, same as for the other asio streams
+    template <typename Handler>
+    void continue_io(bool write, void* data, std::size_t length, Handler handler)
+    {
+        if (!length)
+        {
+            post(std::move(handler), boost::system::error_code(), 0);
+            return;
+        }
+        ERR_clear_error();
+        size_t bytes_transferred = 0;
+        auto rv = write ? SSL_write_ex(ssl, data, length, &bytes_transferred) :
+                  SSL_read_ex(ssl, data, length, &bytes_transferred);
+        if (rv == 1)
+        {
+            post(std::move(handler), boost::system::error_code(), bytes_transferred);
+            return;
+        }
+        auto ssl_error = SSL_get_error(ssl, rv);
+        if (ssl_error != SSL_ERROR_WANT_READ && ssl_error != SSL_ERROR_WANT_WRITE)
+        {
+            post(std::move(handler), error_from_ssl(ssl_error), 0);
+            return;
+        }
+        auto wait_type = (ssl_error == SSL_ERROR_WANT_READ) ? boost::asio::ip::tcp::socket::wait_read :
+                         boost::asio::ip::tcp::socket::wait_write;
+        socket.async_wait(wait_type,
+                          [this, write, data, length, handler = std::move(handler)](const boost::system::error_code & ec) mutable
+        {
+            if (ec)
+            {
+                handler(ec, 0);
+                return;
+            }
+            continue_io(write, data, length, std::move(handler));
+        });
+    }
+
+    boost::asio::ip::tcp::socket socket;
+    SSL_CTX* ssl_ctx;
+    SSL* ssl;
+};
+
+}
+
+}
+
+#endif
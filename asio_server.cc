@@ -128,12 +128,22 @@ boost::system::error_code server::bind_and_listen(boost::system::error_code &ec,
 
 void server::start_accept(boost::asio::ssl::context &tls_context,
                           tcp::acceptor &acceptor, serve_mux &mux) {
+  if (config.kernel_tls) {
+    start_tls_accept<ktls_socket>(tls_context, acceptor, mux);
+  } else {
+    start_tls_accept<ssl_socket>(tls_context, acceptor, mux);
+  }
+}
+
+template <typename tls_socket_type>
+void server::start_tls_accept(boost::asio::ssl::context &tls_context,
+                              tcp::acceptor &acceptor, serve_mux &mux) {
 
   if (!acceptor.is_open()) {
     return;
   }
 
-  auto new_connection = std::make_shared<connection<ssl_socket>>(
+  auto new_connection = std::make_shared<connection<tls_socket_type>>(
       mux, tls_handshake_timeout_, read_timeout_,
       io_service_pool_.get_io_service(), tls_context);
 
@@ -158,11 +168,6 @@ void server::start_accept(boost::asio::ssl::context &tls_context,
                   return;
                 }
 
-                if (!tls_h2_negotiated(new_connection->socket())) {
-                  new_connection->stop();
-                  return;
-                }
-
                 new_connection->start(conf);
               });
         }
@@ -90,6 +90,10 @@ private:
   /// Same as above but with tls_context
   void start_accept(boost::asio::ssl::context &tls_context,
                     tcp::acceptor &acceptor, serve_mux &mux);
+  /// TLS accept over ssl_socket, or ktls_socket with kernel-tls
+  template <typename tls_socket_type>
+  void start_tls_accept(boost::asio::ssl::context &tls_context,
+                        tcp::acceptor &acceptor, serve_mux &mux);
 
   /// Resolves address and bind socket to the resolved addresses.
   boost::system::error_code bind_and_listen(boost::system::error_code &ec,
@@ -40,9 +40,14 @@
 #include "nghttp2_config.h"
 
 #include <memory>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
 
 #include <boost/noncopyable.hpp>
 #include <boost/array.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <nghttp2/asio_http2_server.h>
 
@@ -65,6 +70,16 @@ namespace asio_http2 {
 
 namespace server {
 
+/// The read buffer starts at min_read_size, doubles while the reads fill
+/// it, up to max_read_size, and halves when they use less than an eighth.
+constexpr std::size_t min_read_size = 8_k;
+constexpr std::size_t max_read_size = 256_k;
+/// A write is gathered up to max_write_size; with
+/// connection-bandwidth-limit, to about 100ms of it, but not less than
+/// min_write_size.
+constexpr std::size_t min_write_size = 16_k;
+constexpr std::size_t max_write_size = 256_k;
+
 /// Represents a single connection from a client.
 template <typename socket_type>
 class connection : public std::enable_shared_from_this<connection<socket_type>>,
@@ -82,11 +97,18 @@ public:
         deadline_(GET_IO_SERVICE(socket_)),
         tls_handshake_timeout_(tls_handshake_timeout),
         read_timeout_(read_timeout),
+        buffer_(min_read_size),
+        // only a plain socket writes all the buffers of a sequence at once
+        output_(std::is_same<socket_type, boost::asio::ip::tcp::socket>::value),
+        pacing_timer_(GET_IO_SERVICE(socket_)),
+        bandwidth_limit_(0),
         writing_(false),
+        pacing_(false),
         stopped_(false) {}
 
   /// Start the first asynchronous operation for the connection.
   void start(const H2Server_Config_Schema& conf) {
+    bandwidth_limit_ = conf.connection_bandwidth_limit;
     auto start_in_own_thread = [this, &conf]()
     {
         boost::system::error_code ec;
@@ -151,14 +173,16 @@ public:
             return;
           }
 
-          if (handler_->on_read(buffer_, bytes_transferred) != 0) {
+          if (handler_->on_read(buffer_.data(), bytes_transferred) != 0) {
             stop();
             return;
           }
 
+          adapt_read_size(bytes_transferred);
+
           do_write();
 
-          if (!writing_ && handler_->should_stop()) {
+          if (!writing_ && !pacing_ && handler_->should_stop()) {
             stop();
             return;
           }
@@ -173,6 +197,26 @@ public:
         });
   }
 
+  void adapt_read_size(std::size_t nread) {
+    if (nread == buffer_.size() && buffer_.size() < max_read_size) {
+      buffer_.resize(buffer_.size() * 2);
+    } else if (nread < buffer_.size() / 8 && buffer_.size() > min_read_size) {
+      buffer_.resize(buffer_.size() / 2);
+      if (buffer_.size() == min_read_size) {
+        buffer_.shrink_to_fit();
+      }
+    }
+  }
+
+  std::size_t write_limit() const {
+    if (!bandwidth_limit_) {
+      return max_write_size;
+    }
+    return std::min(max_write_size,
+                    std::max(min_write_size,
+                             static_cast<std::size_t>(bandwidth_limit_ / 10)));
+  }
+
   void do_write() {
     if (stopped_) {
         return;
@@ -180,21 +224,20 @@ public:
 
     auto self = this->shared_from_this();
 
-    if (writing_) {
+    if (writing_ || pacing_) {
       return;
     }
 
     int rv;
-    std::size_t nwrite;
 
-    rv = handler_->on_write(outbuf_, nwrite);
+    rv = handler_->on_write(output_, write_limit());
 
     if (rv != 0) {
       stop();
       return;
     }
 
-    if (nwrite == 0) {
+    if (output_.size() == 0) {
       if (handler_->should_stop()) {
         stop();
       }
@@ -208,14 +251,19 @@ public:
     deadline_.expires_from_now(read_timeout_);
 
     boost::asio::async_write(
-        socket_, boost::asio::buffer(outbuf_, nwrite),
-        [this, self](const boost::system::error_code &e, std::size_t) {
+        socket_, output_.buffers(),
+        [this, self](const boost::system::error_code &e, std::size_t nwritten) {
           if (e) {
             stop();
             return;
           }
 
           writing_ = false;
+          output_.clear();
+
+          if (pace_write(nwritten)) {
+            return;
+          }
 
           do_write();
         });
@@ -226,6 +274,38 @@ public:
     // returns. The connection class's destructor closes the socket.
   }
 
+  /// With connection-bandwidth-limit, holds the next write until the
+  /// bytes written so far fit into the limit; returns true if held.
+  bool pace_write(std::size_t nwritten) {
+    if (!bandwidth_limit_) {
+      return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (next_write_time_ < now) {
+      next_write_time_ = now;
+    }
+    next_write_time_ +=
+        std::chrono::microseconds(nwritten * 1000000 / bandwidth_limit_);
+    if (next_write_time_ <= now) {
+      return false;
+    }
+
+    pacing_ = true;
+    auto self = this->shared_from_this();
+    pacing_timer_.expires_at(next_write_time_);
+    pacing_timer_.async_wait(
+        [this, self](const boost::system::error_code &e) {
+          pacing_ = false;
+          if (e) {
+            return;
+          }
+
+          do_write();
+        });
+    return true;
+  }
+
   void stop() {
     if (stopped_) {
       return;
@@ -235,6 +315,7 @@ public:
     boost::system::error_code ignored_ec;
     socket_.lowest_layer().close(ignored_ec);
     deadline_.cancel();
+    pacing_timer_.cancel();
   }
 
 private:
@@ -244,16 +325,23 @@ private:
 
   std::shared_ptr<http2_handler> handler_;
 
-  /// Buffer for incoming data.
-  boost::array<uint8_t, 8_k> buffer_;
+  /// Buffer for incoming data, see adapt_read_size().
+  std::vector<uint8_t> buffer_;
 
-  boost::array<uint8_t, 64_k> outbuf_;
+  /// The output being written, see output_buffers.
+  output_buffers output_;
 
   boost::asio::deadline_timer deadline_;
   boost::posix_time::time_duration tls_handshake_timeout_;
   boost::posix_time::time_duration read_timeout_;
 
+  /// Paces the writes with connection-bandwidth-limit.
+  boost::asio::steady_timer pacing_timer_;
+  std::chrono::steady_clock::time_point next_write_time_;
+  uint64_t bandwidth_limit_;
+
   bool writing_;
+  bool pacing_;
   bool stopped_;
 };
 
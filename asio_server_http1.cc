@@ -0,0 +1,518 @@
+/*
+ * HTTP/1.1 connections of the builtin server, served by http2_handler
+ * with llhttp, so that the requests get to the same request handlers,
+ * and the responses are sent with the same stream and response API as
+ * over HTTP/2.
+ *
+ * A request is given a stream of its own, with an odd stream id as of
+ * HTTP/2; the responses are written in the order of the requests, so a
+ * response which is ready waits for the ones of the requests before it
+ * (pipelining).
+ */
+#include "asio_server_http2_handler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+#include "asio_common.h"
+#include "asio_server_stream.h"
+#include "asio_server_request_impl.h"
+#include "asio_server_response_impl.h"
+#include "http2.h"
+#include "util.h"
+#include "template.h"
+
+namespace nghttp2 {
+
+namespace asio_http2 {
+
+namespace server {
+
+namespace {
+// first line of the HTTP/2 client connection preface
+constexpr char h2_preface_line[] = "PRI * HTTP/2.0\r\n";
+
+// the size of a chunk is written before the chunk is read, with a fixed
+// number of hex digits
+constexpr size_t chunk_size_digits = 8;
+constexpr size_t chunk_overhead = chunk_size_digits + 2 + 2;
+} // namespace
+
+const llhttp_settings_t http2_handler::http1_hooks = {
+    http2_handler::http1_on_message_begin,    // llhttp_cb      on_message_begin;
+    http2_handler::http1_on_url,              // llhttp_data_cb on_url;
+    nullptr,                                  // llhttp_data_cb on_status;
+    http2_handler::http1_on_header_field,     // llhttp_data_cb on_header_field;
+    http2_handler::http1_on_header_value,     // llhttp_data_cb on_header_value;
+    http2_handler::http1_on_headers_complete, // llhttp_cb      on_headers_complete;
+    http2_handler::http1_on_body,             // llhttp_data_cb on_body;
+    http2_handler::http1_on_message_complete, // llhttp_cb      on_message_complete;
+    nullptr,                                  // llhttp_cb      on_chunk_header
+    nullptr,                                  // llhttp_cb      on_chunk_complete
+};
+
+int http2_handler::detect_protocol(const uint8_t *data, std::size_t len) {
+  // the first read may have less than the first line
+  preface_.append(reinterpret_cast<const char *>(data), len);
+
+  auto n = std::min(preface_.size(), str_size(h2_preface_line));
+  if (std::equal(std::begin(preface_), std::begin(preface_) + n,
+                 h2_preface_line)) {
+    if (n < str_size(h2_preface_line)) {
+      return 0;
+    }
+
+    protocol_ = handler_protocol::HTTP2;
+
+    auto rv = nghttp2_session_mem_recv(
+        session_, reinterpret_cast<const uint8_t *>(preface_.data()),
+        preface_.size());
+    std::string().swap(preface_);
+
+    return rv < 0 ? -1 : 0;
+  }
+
+  protocol_ = handler_protocol::HTTP1;
+
+  htp_ = std::make_unique<llhttp_t>();
+  llhttp_init(htp_.get(), HTTP_REQUEST, &http1_hooks);
+  htp_->data = this;
+
+  std::string input;
+  input.swap(preface_);
+
+  return http1_on_read(reinterpret_cast<const uint8_t *>(input.data()),
+                       input.size());
+}
+
+int http2_handler::http1_on_read(const uint8_t *data, std::size_t len) {
+  auto first = reinterpret_cast<const char *>(data);
+  auto last = first + len;
+
+  while (first != last && !http1_read_closed_) {
+    auto rv = llhttp_execute(htp_.get(), first, last - first);
+    switch (rv) {
+    case HPE_OK:
+    case HPE_PAUSED:
+      return 0;
+    case HPE_PAUSED_UPGRADE:
+      // no upgrade is done, what follows is the next request
+      first = llhttp_get_error_pos(htp_.get());
+      llhttp_resume_after_upgrade(htp_.get());
+      break;
+    case HPE_CLOSED_CONNECTION:
+      // bytes after a request with "connection: close"
+      return 0;
+    default:
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int http2_handler::http1_on_message_begin(llhttp_t *htp) {
+  auto handler = static_cast<http2_handler *>(htp->data);
+
+  handler->http1_request_id_ = handler->http1_next_stream_id_;
+  if (handler->http1_next_stream_id_ >
+      std::numeric_limits<int32_t>::max() - 2) {
+    handler->http1_next_stream_id_ = 1;
+  } else {
+    handler->http1_next_stream_id_ += 2;
+  }
+
+  handler->http1_url_.clear();
+  handler->http1_header_name_.clear();
+  handler->http1_header_value_.clear();
+  handler->http1_header_value_started_ = false;
+
+  handler->create_stream(handler->http1_request_id_);
+
+  return 0;
+}
+
+int http2_handler::http1_on_url(llhttp_t *htp, const char *data, size_t len) {
+  auto handler = static_cast<http2_handler *>(htp->data);
+
+  if (handler->http1_url_.size() + len > 64_k) {
+    return -1;
+  }
+
+  handler->http1_url_.append(data, len);
+
+  return 0;
+}
+
+int http2_handler::http1_store_header() {
+  auto strm = find_stream(http1_request_id_);
+  if (!strm) {
+    return -1;
+  }
+
+  auto &req = strm->request().impl();
+
+  if (req.header_buffer_size() + http1_header_name_.size() +
+          http1_header_value_.size() >
+      64_k) {
+    return -1;
+  }
+  req.update_header_buffer_size(http1_header_name_.size() +
+                                http1_header_value_.size());
+
+  // as of HTTP/2, the names are in lower case
+  util::inp_strlower(http1_header_name_);
+  req.header().emplace(std::move(http1_header_name_),
+                       header_value{std::move(http1_header_value_), false});
+
+  http1_header_name_.clear();
+  http1_header_value_.clear();
+  http1_header_value_started_ = false;
+
+  return 0;
+}
+
+int http2_handler::http1_on_header_field(llhttp_t *htp, const char *data,
+                                         size_t len) {
+  auto handler = static_cast<http2_handler *>(htp->data);
+
+  if (handler->http1_header_value_started_ &&
+      handler->http1_store_header() != 0) {
+    return -1;
+  }
+
+  if (handler->http1_header_name_.size() + len > 64_k) {
+    return -1;
+  }
+
+  handler->http1_header_name_.append(data, len);
+
+  return 0;
+}
+
+int http2_handler::http1_on_header_value(llhttp_t *htp, const char *data,
+                                         size_t len) {
+  auto handler = static_cast<http2_handler *>(htp->data);
+
+  if (handler->http1_header_value_.size() + len > 64_k) {
+    return -1;
+  }
+
+  handler->http1_header_value_started_ = true;
+  handler->http1_header_value_.append(data, len);
+
+  return 0;
+}
+
+int http2_handler::http1_on_headers_complete(llhttp_t *htp) {
+  auto handler = static_cast<http2_handler *>(htp->data);
+
+  if (handler->http1_header_value_started_ &&
+      handler->http1_store_header() != 0) {
+    return -1;
+  }
+
+  auto strm = handler->find_stream(handler->http1_request_id_);
+  if (!strm) {
+    return -1;
+  }
+
+  auto &req = strm->request().impl();
+  req.method(llhttp_method_name(static_cast<llhttp_method_t>(htp->method)));
+  req.remote_endpoint(handler->remote_endpoint());
+
+  auto &uref = req.uri();
+  auto &url = handler->http1_url_;
+  auto scheme_end = url.find("://");
+  if (scheme_end != std::string::npos && url[0] != '/') {
+    // absolute-form, as sent to a proxy
+    auto authority_first = scheme_end + 3;
+    auto path_first = url.find('/', authority_first);
+    if (path_first == std::string::npos) {
+      path_first = url.size();
+    }
+    uref.scheme = url.substr(0, scheme_end);
+    uref.host = url.substr(authority_first, path_first - authority_first);
+    if (path_first == url.size()) {
+      url = "/";
+    } else {
+      url.erase(0, path_first);
+    }
+  } else {
+    uref.scheme = "http";
+  }
+  split_path(uref, std::begin(url), std::end(url));
+
+  if (uref.host.empty()) {
+    auto host = req.header().find("host");
+    if (host != std::end(req.header())) {
+      uref.host = (*host).second.value;
+    }
+  }
+
+  if ((htp->flags & F_CHUNKED) ||
+      ((htp->flags & F_CONTENT_LENGTH) && htp->content_length > 0)) {
+    req.keep_payload(handler->body_needed(*strm));
+
+    // the client waits for it before sending the body, unless a response
+    // of an earlier request is yet to be written
+    auto expect = req.header().find("expect");
+    if (expect != std::end(req.header()) &&
+        util::strieq_l("100-continue", (*expect).second.value) &&
+        handler->http1_responses_.empty() && handler->http1_pending_.empty()) {
+      handler->http1_pending_ = "HTTP/1.1 100 Continue\r\n\r\n";
+    }
+  }
+
+  return 0;
+}
+
+int http2_handler::http1_on_body(llhttp_t *htp, const char *data, size_t len) {
+  auto handler = static_cast<http2_handler *>(htp->data);
+
+  auto strm = handler->find_stream(handler->http1_request_id_);
+  if (!strm) {
+    return 0;
+  }
+
+  auto &req = strm->request().impl();
+  req.append_payload(reinterpret_cast<const uint8_t *>(data), len);
+  req.call_on_data(reinterpret_cast<const uint8_t *>(data), len);
+
+  return 0;
+}
+
+int http2_handler::http1_on_message_complete(llhttp_t *htp) {
+  auto handler = static_cast<http2_handler *>(htp->data);
+
+  auto strm = handler->find_stream(handler->http1_request_id_);
+  if (!strm) {
+    return -1;
+  }
+
+  auto keep_alive = llhttp_should_keep_alive(htp) != 0;
+  auto http10 = htp->http_major == 1 && htp->http_minor == 0;
+
+  // queued before the request handler is called, as it may respond at once
+  handler->http1_responses_.push_back(http1_response{
+      handler->http1_request_id_, keep_alive, http10, false, false, false,
+      false, header_map{}});
+
+  if (!keep_alive) {
+    handler->http1_read_closed_ = true;
+  }
+
+  strm->request().impl().call_on_data(nullptr, 0);
+  handler->call_on_request(*strm);
+
+  // what follows the last request is not parsed
+  return keep_alive ? 0 : HPE_PAUSED;
+}
+
+int http2_handler::http1_start_response(stream &strm) {
+  auto res = std::find_if(std::begin(http1_responses_),
+                          std::end(http1_responses_),
+                          [&strm](const http1_response &r) {
+                            return r.stream_id == strm.get_stream_id();
+                          });
+  if (res == std::end(http1_responses_)) {
+    return -1;
+  }
+
+  (*res).started = true;
+
+  signal_write();
+
+  return 0;
+}
+
+void http2_handler::http1_close(int32_t stream_id) {
+  http1_read_closed_ = true;
+
+  auto res = std::find_if(std::begin(http1_responses_),
+                          std::end(http1_responses_),
+                          [stream_id](const http1_response &r) {
+                            return r.stream_id == stream_id;
+                          });
+  http1_responses_.erase(res, std::end(http1_responses_));
+
+  signal_write();
+}
+
+bool http2_handler::http1_should_stop() const {
+  return http1_read_closed_ && http1_responses_.empty() &&
+         http1_pending_.empty();
+}
+
+void http2_handler::http1_response_header(stream &strm, http1_response &res) {
+  auto &req = strm.request().impl();
+  auto &response = strm.response().impl();
+  auto status_code = response.status_code();
+  auto reason = ::nghttp2::http2::get_reason_phrase(status_code);
+
+  res.body_expected =
+      ::nghttp2::http2::expect_response_body(req.method(), status_code);
+
+  auto &out = http1_pending_;
+  out += "HTTP/1.1 ";
+  out += util::utos(status_code);
+  out += ' ';
+  out.append(reason.c_str(), reason.size());
+  out += "\r\ndate: ";
+  out += http_date();
+  out += "\r\n";
+
+  auto content_length = false;
+  for (auto &hd : response.header()) {
+    // the framing of the body is of this connection
+    if (util::strieq_l("transfer-encoding", hd.first) ||
+        util::strieq_l("connection", hd.first)) {
+      continue;
+    }
+    if (util::strieq_l("content-length", hd.first)) {
+      content_length = true;
+    }
+    out += hd.first;
+    out += ": ";
+    out += hd.second.value;
+    out += "\r\n";
+  }
+
+  if (res.body_expected && !content_length) {
+    if (res.http10) {
+      // the end of the body is the end of the connection
+      res.keep_alive = false;
+    } else {
+      res.chunked = true;
+      out += "transfer-encoding: chunked\r\n";
+    }
+  }
+
+  if (!res.keep_alive) {
+    out += "connection: close\r\n";
+  }
+
+  out += "\r\n";
+}
+
+int http2_handler::http1_on_write(output_buffers &out, std::size_t limit) {
+  for (;;) {
+    if (http1_pending_.size()) {
+      out.append(reinterpret_cast<const uint8_t *>(http1_pending_.data()),
+                 http1_pending_.size());
+      http1_pending_.clear();
+    }
+
+    if (out.size() >= limit || http1_responses_.empty()) {
+      return 0;
+    }
+
+    auto &res = http1_responses_.front();
+    auto strm = find_stream(res.stream_id);
+    if (!strm) {
+      // the response is dropped (e.g. throttled); HTTP/1.1 cannot skip a
+      // response, but by closing the connection
+      http1_close(res.stream_id);
+      continue;
+    }
+
+    if (!res.started) {
+      return 0;
+    }
+
+    if (!res.header_sent) {
+      http1_response_header(*strm, res);
+      res.header_sent = true;
+      continue;
+    }
+
+    if (res.body_expected) {
+      auto &response = strm->response().impl();
+      uint32_t data_flags = 0;
+      ssize_t nread;
+
+      auto room = limit - out.size();
+
+      if (response.body_in_place()) {
+        nread = response.read_in_place(room, &data_flags);
+        if (nread > 0) {
+          if (res.chunked) {
+            char chunk_size[chunk_size_digits + 3];
+            std::snprintf(chunk_size, sizeof(chunk_size), "%08zx\r\n",
+                          static_cast<size_t>(nread));
+            out.append(reinterpret_cast<const uint8_t *>(chunk_size),
+                       chunk_size_digits + 2);
+          }
+          std::shared_ptr<const std::string> owner;
+          auto data = response.take_body(nread, owner);
+          out.append_in_place(data, nread, std::move(owner));
+          if (res.chunked) {
+            out.append(reinterpret_cast<const uint8_t *>("\r\n"), 2);
+          }
+        }
+      } else if (res.chunked) {
+        auto chunk = out.prepare(room + chunk_overhead);
+        nread = response.call_read(chunk + chunk_size_digits + 2, room,
+                                   &data_flags);
+        if (nread > 0) {
+          std::snprintf(reinterpret_cast<char *>(chunk), chunk_size_digits + 1,
+                        "%08zx", static_cast<size_t>(nread));
+          chunk[chunk_size_digits] = '\r';
+          chunk[chunk_size_digits + 1] = '\n';
+          chunk[chunk_size_digits + 2 + nread] = '\r';
+          chunk[chunk_size_digits + 2 + nread + 1] = '\n';
+          out.commit(nread + chunk_overhead);
+        }
+      } else {
+        nread = response.call_read(out.prepare(room), room, &data_flags);
+        if (nread > 0) {
+          out.commit(nread);
+        }
+      }
+
+      if (nread == NGHTTP2_ERR_DEFERRED) {
+        return 0;
+      }
+
+      if (nread < 0) {
+        http1_close(res.stream_id);
+        continue;
+      }
+
+      if (!(data_flags & NGHTTP2_DATA_FLAG_EOF)) {
+        if (nread == 0) {
+          return 0;
+        }
+        continue;
+      }
+
+      if (res.chunked) {
+        // the trailers were submitted by call_read
+        http1_pending_ += "0\r\n";
+        for (auto &hd : res.trailers) {
+          http1_pending_ += hd.first;
+          http1_pending_ += ": ";
+          http1_pending_ += hd.second.value;
+          http1_pending_ += "\r\n";
+        }
+        http1_pending_ += "\r\n";
+      }
+    }
+
+    auto stream_id = res.stream_id;
+    if (!res.keep_alive) {
+      http1_read_closed_ = true;
+    }
+    http1_responses_.pop_front();
+
+    strm->response().impl().call_on_close(NGHTTP2_NO_ERROR);
+    close_stream(stream_id);
+  }
+}
+
+} // namespace server
+
+} // namespace asio_http2
+
+} // namespace nghttp2
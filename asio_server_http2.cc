@@ -81,6 +81,10 @@ bool http2::handle(std::string pattern, request_cb cb) {
   return impl_->handle(std::move(pattern), std::move(cb));
 }
 
+void http2::body_needed(body_needed_cb cb) {
+  impl_->body_needed(std::move(cb));
+}
+
 void http2::stop() { impl_->stop(); }
 
 void http2::join() { return impl_->join(); }
@@ -24,7 +24,9 @@
  */
 #include "asio_server_http2_handler.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 #include "asio_common.h"
 #include "asio_server_serve_mux.h"
@@ -154,6 +156,8 @@ int on_frame_recv_callback(nghttp2_session *session, const nghttp2_frame *frame,
 
     if (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) {
       strm->request().impl().call_on_data(nullptr, 0);
+    } else {
+      req.keep_payload(handler->body_needed(*strm));
     }
 
     if (frame->hd.flags & NGHTTP2_FLAG_END_STREAM)
@@ -177,10 +181,12 @@ int on_data_chunk_recv_callback(nghttp2_session *session, uint8_t flags,
   auto strm = handler->find_stream(stream_id);
 
   if (!strm) {
+    handler->consume_unknown_stream_data(len);
     return 0;
   }
 
-  strm->request().impl().payload().append((const char*)data, len);
+  strm->request().impl().append_payload(data, len);
+  handler->consume_request_body(stream_id, len);
 
   strm->request().impl().call_on_data(data, len);
 
@@ -229,6 +235,17 @@ int on_frame_send_callback(nghttp2_session *session, const nghttp2_frame *frame,
 }
 } // namespace
 
+namespace {
+int send_data_callback(nghttp2_session *session, nghttp2_frame *frame,
+                       const uint8_t *framehd, size_t length,
+                       nghttp2_data_source *source, void *user_data) {
+  auto handler = static_cast<http2_handler *>(user_data);
+  auto &strm = *static_cast<stream *>(source->ptr);
+
+  return handler->send_data(strm, frame, framehd, length);
+}
+} // namespace
+
 namespace {
 int on_frame_not_send_callback(nghttp2_session *session,
                                const nghttp2_frame *frame, int lib_error_code,
@@ -245,9 +262,54 @@ int on_frame_not_send_callback(nghttp2_session *session,
 }
 } // namespace
 
-thread_local std::atomic<uint64_t> http2_handler::handler_unique_id(0);
-thread_local std::map<uint64_t, http2_handler*> http2_handler::alive_handlers;
-thread_local std::map<uint64_t, boost::asio::io_service*> http2_handler::handler_io_service;
+namespace {
+constexpr uint32_t no_handler_slot = std::numeric_limits<uint32_t>::max();
+} // namespace
+
+thread_local std::vector<http2_handler::handler_slot> http2_handler::handler_slots;
+thread_local uint32_t http2_handler::free_handler_slot = no_handler_slot;
+
+uint64_t http2_handler::acquire_handler_slot(http2_handler *h) {
+  uint32_t index;
+  if (free_handler_slot != no_handler_slot) {
+    index = free_handler_slot;
+    free_handler_slot = handler_slots[index].next_free;
+  } else {
+    index = handler_slots.size();
+    // generation starts at 1, so that 0 is never a handler id
+    handler_slots.push_back(handler_slot{1, no_handler_slot, nullptr, nullptr});
+  }
+  auto &slot = handler_slots[index];
+  slot.handler = h;
+  slot.io_service = &h->io_service_;
+  return (static_cast<uint64_t>(slot.generation) << 32) | index;
+}
+
+void http2_handler::release_handler_slot(uint64_t handler_id) {
+  auto index = static_cast<uint32_t>(handler_id);
+  auto &slot = handler_slots[index];
+  slot.handler = nullptr;
+  slot.io_service = nullptr;
+  if (++slot.generation == 0) {
+    slot.generation = 1;
+  }
+  slot.next_free = free_handler_slot;
+  free_handler_slot = index;
+}
+
+http2_handler::handler_slot *
+http2_handler::find_handler_slot(uint64_t handler_id) {
+  auto index = static_cast<uint32_t>(handler_id);
+  if (index >= handler_slots.size()) {
+    return nullptr;
+  }
+  auto &slot = handler_slots[index];
+  if (!slot.handler ||
+      slot.generation != static_cast<uint32_t>(handler_id >> 32)) {
+    return nullptr;
+  }
+  return &slot;
+}
 
 
 
@@ -260,48 +322,45 @@ http2_handler::http2_handler(boost::asio::io_service &io_service,
       io_service_(io_service),
       remote_ep_(ep),
       session_(nullptr),
-      buf_(nullptr),
-      buflen_(0),
+      output_(nullptr),
+      output_limit_(0),
       inside_callback_(false),
       write_signaled_(false),
       tstamp_cached_(time(nullptr)),
       formatted_date_(util::http_date(tstamp_cached_)),
-      this_handler_id(handler_unique_id++),
-      config(conf)
+      this_handler_id(0),
+      config(conf),
+      protocol_(handler_protocol::UNKNOWN),
+      http1_request_id_(0),
+      http1_next_stream_id_(1),
+      http1_header_value_started_(false),
+      http1_read_closed_(false),
+      consume_timer_(io_service),
+      consume_budget_(0),
+      consume_timer_armed_(false)
 {
-      alive_handlers[this_handler_id] = this;
-      handler_io_service[this_handler_id] = &io_service_;
+      this_handler_id = acquire_handler_slot(this);
 }
 
 http2_handler::~http2_handler() {
-  for (auto &p : streams_) {
-    auto &strm = p.second;
-    strm->response().impl().call_on_close(NGHTTP2_INTERNAL_ERROR);
-  }
+  streams_.for_each([](stream &strm) {
+    strm.response().impl().call_on_close(NGHTTP2_INTERNAL_ERROR);
+  });
 
   nghttp2_session_del(session_);
-  alive_handlers.erase(this_handler_id);
-  handler_io_service.erase(this_handler_id);
+  release_handler_slot(this_handler_id);
 }
 
 http2_handler* http2_handler::find_http2_handler(uint64_t handler_id)
 {
-    auto it = alive_handlers.find(handler_id);
-    if (it != alive_handlers.end())
-    {
-        return it->second;
-    }
-    return nullptr;
+    auto slot = find_handler_slot(handler_id);
+    return slot ? slot->handler : nullptr;
 }
 
 boost::asio::io_service* http2_handler::find_io_service(uint64_t handler_id)
 {
-    auto it = handler_io_service.find(handler_id);
-    if (it != handler_io_service.end())
-    {
-        return it->second;
-    }
-    return nullptr;
+    auto slot = find_handler_slot(handler_id);
+    return slot ? slot->io_service : nullptr;
 }
 
 uint64_t http2_handler::get_handler_id()
@@ -343,6 +402,8 @@ int http2_handler::start() {
                                                        on_frame_send_callback);
   nghttp2_session_callbacks_set_on_frame_not_send_callback(
       callbacks, on_frame_not_send_callback);
+  nghttp2_session_callbacks_set_send_data_callback(callbacks,
+                                                   send_data_callback);
 
   nghttp2_option* opt;
 
@@ -353,6 +414,11 @@ int http2_handler::start() {
       nghttp2_option_set_max_deflate_dynamic_table_size(
           opt, config.encoder_header_table_size);
   }
+  if (config.request_body_consume_rate)
+  {
+      // the window is given back by consume_request_body
+      nghttp2_option_set_no_auto_window_update(opt, 1);
+  }
 
   rv = nghttp2_session_server_new2(&session_, callbacks, this, opt);
 
@@ -388,23 +454,177 @@ int http2_handler::start() {
 }
 
 stream *http2_handler::create_stream(int32_t stream_id) {
-  auto p =
-      streams_.emplace(stream_id, std::make_unique<stream>(this, stream_id));
-  assert(p.second);
-  return (*p.first).second.get();
+  assert(!streams_.find(stream_id));
+  return streams_.emplace(stream_id, stream::make(this, stream_id));
 }
 
 void http2_handler::close_stream(int32_t stream_id) {
-  streams_.erase(stream_id);
+  auto strm = streams_.erase(stream_id);
+  if (strm) {
+    stream::recycle(std::move(strm));
+  }
+  if (protocol_ == handler_protocol::HTTP1) {
+    // the response queued for the stream may be due
+    signal_write();
+  }
 }
 
 stream *http2_handler::find_stream(int32_t stream_id) {
-  auto i = streams_.find(stream_id);
-  if (i == std::end(streams_)) {
-    return nullptr;
+  return streams_.find(stream_id);
+}
+
+int http2_handler::on_read(const uint8_t *data, std::size_t len) {
+  callback_guard cg(*this);
+
+  if (protocol_ == handler_protocol::UNKNOWN) {
+    return detect_protocol(data, len);
+  }
+
+  if (protocol_ == handler_protocol::HTTP1) {
+    return http1_on_read(data, len);
+  }
+
+  int rv;
+
+  rv = nghttp2_session_mem_recv(session_, data, len);
+
+  if (rv < 0) {
+    return -1;
+  }
+
+  return 0;
+}
+
+int http2_handler::on_write(output_buffers &out, std::size_t limit) {
+  callback_guard cg(*this);
+
+  if (protocol_ == handler_protocol::UNKNOWN) {
+    return 0;
+  }
+
+  if (protocol_ == handler_protocol::HTTP1) {
+    return http1_on_write(out, limit);
+  }
+
+  output_ = &out;
+  output_limit_ = limit;
+  auto output_done = defer([this]() { output_ = nullptr; });
+
+  while (out.size() < limit) {
+    const uint8_t *data;
+    auto nread = nghttp2_session_mem_send(session_, &data);
+    if (nread < 0) {
+      return -1;
+    }
+
+    if (nread == 0) {
+      break;
+    }
+
+    // valid until the next nghttp2_session_mem_send()
+    out.append(data, nread);
   }
 
-  return (*i).second.get();
+  return 0;
+}
+
+int http2_handler::send_data(stream &strm, const nghttp2_frame *frame,
+                             const uint8_t *framehd, std::size_t length) {
+  auto &out = *output_;
+  auto padlen = frame->data.padlen;
+
+  out.append(framehd, 9);
+  if (padlen > 0) {
+    auto padlen_field = static_cast<uint8_t>(padlen - 1);
+    out.append(&padlen_field, 1);
+  }
+
+  std::shared_ptr<const std::string> owner;
+  auto data = strm.response().impl().take_body(length, owner);
+  out.append_in_place(data, length, std::move(owner));
+
+  if (padlen > 1) {
+    auto padding = out.prepare(padlen - 1);
+    std::fill_n(padding, padlen - 1, 0);
+    out.commit(padlen - 1);
+  }
+
+  // nghttp2_session_mem_send() would go on through all the DATA frames
+  // the flow control allows, with no frame to return in between
+  return out.size() < output_limit_ ? 0 : NGHTTP2_ERR_PAUSE;
+}
+
+bool http2_handler::body_needed(stream &strm) {
+  return mux_.body_needed(strm.request());
+}
+
+void http2_handler::consume_request_body(int32_t stream_id, std::size_t len) {
+  if (!config.request_body_consume_rate) {
+    return;
+  }
+  if (unconsumed_.empty() && !consume_timer_armed_) {
+    // the budget accrues from now on
+    consume_time_ = std::chrono::steady_clock::now();
+  }
+  if (unconsumed_.size() && unconsumed_.back().first == stream_id) {
+    unconsumed_.back().second += len;
+  } else {
+    unconsumed_.emplace_back(stream_id, len);
+  }
+  arm_consume_timer();
+}
+
+void http2_handler::consume_unknown_stream_data(std::size_t len) {
+  if (!config.request_body_consume_rate) {
+    return;
+  }
+  // nobody waits for the stream, so there is nothing to pace
+  nghttp2_session_consume_connection(session_, len);
+}
+
+void http2_handler::arm_consume_timer() {
+  if (consume_timer_armed_ || unconsumed_.empty()) {
+    return;
+  }
+  consume_timer_armed_ = true;
+  consume_timer_.expires_from_now(std::chrono::milliseconds(10));
+  std::weak_ptr<http2_handler> weak_self = shared_from_this();
+  consume_timer_.async_wait([weak_self](const boost::system::error_code &ec) {
+    auto self = weak_self.lock();
+    if (ec || !self) {
+      return;
+    }
+    self->consume_timer_armed_ = false;
+    self->on_consume_timer();
+  });
+}
+
+void http2_handler::on_consume_timer() {
+  auto now = std::chrono::steady_clock::now();
+  auto elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(now - consume_time_);
+  consume_time_ = now;
+  consume_budget_ += static_cast<double>(config.request_body_consume_rate) *
+                     elapsed.count() / 1000000;
+
+  while (unconsumed_.size() && consume_budget_ >= 1) {
+    auto &front = unconsumed_.front();
+    auto n = std::min(front.second, static_cast<std::size_t>(consume_budget_));
+    nghttp2_session_consume(session_, front.first, n);
+    consume_budget_ -= n;
+    front.second -= n;
+    if (front.second == 0) {
+      unconsumed_.pop_front();
+    }
+  }
+
+  if (unconsumed_.empty()) {
+    // no credit is saved up while there is nothing to consume
+    consume_budget_ = 0;
+  }
+
+  signal_write();
+  arm_consume_timer();
 }
 
 void http2_handler::call_on_request(stream &strm) {
@@ -413,11 +633,18 @@ void http2_handler::call_on_request(stream &strm) {
 }
 
 bool http2_handler::should_stop() const {
+  if (protocol_ == handler_protocol::HTTP1) {
+    return http1_should_stop();
+  }
   return !nghttp2_session_want_read(session_) &&
          !nghttp2_session_want_write(session_);
 }
 
 int http2_handler::start_response(stream &strm) {
+  if (protocol_ == handler_protocol::HTTP1) {
+    return http1_start_response(strm);
+  }
+
   int rv;
 
   auto &res = strm.response().impl();
@@ -442,7 +669,12 @@ int http2_handler::start_response(stream &strm) {
                            nghttp2_data_source *source,
                            void *user_data) -> ssize_t {
       auto &strm = *static_cast<stream *>(source->ptr);
-      return strm.response().impl().call_read(buf, length, data_flags);
+      auto &res = strm.response().impl();
+      if (res.body_in_place()) {
+        // sent by send_data
+        return res.read_in_place(length, data_flags);
+      }
+      return res.call_read(buf, length, data_flags);
     };
     prd_ptr = &prd;
   }
@@ -459,6 +691,17 @@ int http2_handler::start_response(stream &strm) {
 }
 
 int http2_handler::submit_trailer(stream &strm, header_map h) {
+  if (protocol_ == handler_protocol::HTTP1) {
+    // written with the last chunk of the body
+    for (auto &res : http1_responses_) {
+      if (res.stream_id == strm.get_stream_id()) {
+        res.trailers = std::move(h);
+        break;
+      }
+    }
+    return 0;
+  }
+
   int rv;
   auto nva = std::vector<nghttp2_nv>();
   nva.reserve(h.size());
@@ -490,6 +733,10 @@ void http2_handler::leave_callback() {
 }
 
 void http2_handler::stream_error(int32_t stream_id, uint32_t error_code) {
+  if (protocol_ == handler_protocol::HTTP1) {
+    http1_close(stream_id);
+    return;
+  }
   ::nghttp2::asio_http2::server::stream_error(session_, stream_id, error_code);
   signal_write();
 }
@@ -508,7 +755,9 @@ void http2_handler::initiate_write() {
 }
 
 void http2_handler::resume(stream &strm) {
-  nghttp2_session_resume_data(session_, strm.get_stream_id());
+  if (protocol_ != handler_protocol::HTTP1) {
+    nghttp2_session_resume_data(session_, strm.get_stream_id());
+  }
   signal_write();
 }
 
@@ -520,6 +769,11 @@ response *http2_handler::push_promise(boost::system::error_code &ec,
 
   ec.clear();
 
+  if (protocol_ == handler_protocol::HTTP1) {
+    ec = make_error_code(static_cast<nghttp2_error>(NGHTTP2_ERR_INVALID_STATE));
+    return nullptr;
+  }
+
   auto &req = strm.request().impl();
 
   auto nva = std::vector<nghttp2_nv>();
@@ -567,6 +821,72 @@ const boost::asio::ip::tcp::endpoint &http2_handler::remote_endpoint() {
   return remote_ep_;
 }
 
+output_buffers::output_buffers(bool gather)
+    : copied_len_(0), size_(0), gather_(gather) {}
+
+void output_buffers::append(const uint8_t *data, std::size_t len) {
+  std::copy_n(data, len, prepare(len));
+  commit(len);
+}
+
+void output_buffers::append_in_place(const uint8_t *data, std::size_t len,
+                                     std::shared_ptr<const std::string> owner) {
+  if (!gather_) {
+    append(data, len);
+    return;
+  }
+
+  if (len == 0) {
+    return;
+  }
+
+  segments_.push_back(segment{data, 0, len});
+  owners_.push_back(std::move(owner));
+  size_ += len;
+}
+
+uint8_t *output_buffers::prepare(std::size_t len) {
+  if (copied_.size() < copied_len_ + len) {
+    copied_.resize(std::max(copied_len_ + len, copied_.size() * 2));
+  }
+  return copied_.data() + copied_len_;
+}
+
+void output_buffers::commit(std::size_t len) {
+  if (len == 0) {
+    return;
+  }
+
+  // the bytes copied one after another make one buffer
+  if (segments_.size() && !segments_.back().data &&
+      segments_.back().offset + segments_.back().len == copied_len_) {
+    segments_.back().len += len;
+  } else {
+    segments_.push_back(segment{nullptr, copied_len_, len});
+  }
+  copied_len_ += len;
+  size_ += len;
+}
+
+std::size_t output_buffers::size() const { return size_; }
+
+const std::vector<boost::asio::const_buffer> &output_buffers::buffers() {
+  // copied_ may have moved, while the segments were appended
+  buffers_.clear();
+  for (auto &seg : segments_) {
+    buffers_.emplace_back(seg.data ? seg.data : copied_.data() + seg.offset,
+                          seg.len);
+  }
+  return buffers_;
+}
+
+void output_buffers::clear() {
+  copied_len_ = 0;
+  segments_.clear();
+  owners_.clear();
+  size_ = 0;
+}
+
 callback_guard::callback_guard(http2_handler &h) : handler(h) {
   handler.enter_callback();
 }
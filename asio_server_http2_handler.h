@@ -28,14 +28,22 @@
 #include "nghttp2_config.h"
 
 #include <map>
+#include <deque>
+#include <memory>
 #include <functional>
 #include <string>
 #include <mutex>
+#include <vector>
 
 #include <boost/array.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <nghttp2/asio_http2_server.h>
 
+#include "llhttp.h"
+#include "asio_server_stream.h"
+
 namespace nghttp2 {
 namespace asio_http2 {
 namespace server {
@@ -52,6 +60,46 @@ struct callback_guard {
 
 using connection_write = std::function<void(void)>;
 
+/// The output of a connection gathered for one write: frames and headers
+/// are copied into a buffer reused from write to write, and the bodies
+/// set by response::end(std::string) are referenced where they are, unless
+/// the socket writes only the first buffer of a sequence (TLS), in which
+/// case they are copied too.
+class output_buffers {
+public:
+  explicit output_buffers(bool gather);
+
+  void append(const uint8_t *data, std::size_t len);
+  // data is kept alive by owner until clear()
+  void append_in_place(const uint8_t *data, std::size_t len,
+                       std::shared_ptr<const std::string> owner);
+  // room for len bytes to be copied into, then commit() what was
+  uint8_t *prepare(std::size_t len);
+  void commit(std::size_t len);
+
+  std::size_t size() const;
+  // valid until the next change
+  const std::vector<boost::asio::const_buffer> &buffers();
+  // after the write is done
+  void clear();
+
+private:
+  struct segment {
+    // nullptr for the bytes copied, at offset
+    const uint8_t *data;
+    std::size_t offset;
+    std::size_t len;
+  };
+
+  std::vector<uint8_t> copied_;
+  std::size_t copied_len_;
+  std::vector<segment> segments_;
+  std::vector<std::shared_ptr<const std::string>> owners_;
+  std::vector<boost::asio::const_buffer> buffers_;
+  std::size_t size_;
+  bool gather_;
+};
+
 class http2_handler : public std::enable_shared_from_this<http2_handler> {
 public:
   http2_handler(boost::asio::io_service &io_service,
@@ -69,6 +117,17 @@ public:
 
   void call_on_request(stream &s);
 
+  // whether the body of the request is to be kept, see body_needed_cb
+  bool body_needed(stream &s);
+
+  // request body data received, given back to the flow control of the
+  // client at request-body-consume-rate, if set
+  void consume_request_body(int32_t stream_id, std::size_t len);
+
+  // data of a stream the handler no longer has, given back to the
+  // connection window at once
+  void consume_unknown_stream_data(std::size_t len);
+
   bool should_stop() const;
 
   int start_response(stream &s);
@@ -100,82 +159,114 @@ public:
 
   uint64_t get_handler_id();
 
-  template <size_t N>
-  int on_read(const boost::array<uint8_t, N> &buffer, std::size_t len) {
-    callback_guard cg(*this);
-
-    int rv;
-
-    rv = nghttp2_session_mem_recv(session_, buffer.data(), len);
-
-    if (rv < 0) {
-      return -1;
-    }
-
-    return 0;
-  }
-
-  template <size_t N>
-  int on_write(boost::array<uint8_t, N> &buffer, std::size_t &len) {
-    callback_guard cg(*this);
-
-    len = 0;
-
-    if (buf_) {
-      std::copy_n(buf_, buflen_, std::begin(buffer));
-
-      len += buflen_;
-
-      buf_ = nullptr;
-      buflen_ = 0;
-    }
-
-    for (;;) {
-      const uint8_t *data;
-      auto nread = nghttp2_session_mem_send(session_, &data);
-      if (nread < 0) {
-        return -1;
-      }
-
-      if (nread == 0) {
-        break;
-      }
-
-      if (len + nread > buffer.size()) {
-        buf_ = data;
-        buflen_ = nread;
-
-        break;
-      }
-
-      std::copy_n(data, nread, std::begin(buffer) + len);
+  int on_read(const uint8_t *data, std::size_t len);
 
-      len += nread;
-    }
+  // Gathers the output into out, until it holds limit bytes or more.
+  int on_write(output_buffers &out, std::size_t limit);
 
-    return 0;
-  }
+  // a DATA frame of a body sent in place, see NGHTTP2_DATA_FLAG_NO_COPY
+  int send_data(stream &s, const nghttp2_frame *frame,
+                const uint8_t *framehd, std::size_t length);
 
 private:
-  std::map<int32_t, std::shared_ptr<stream>> streams_;
+  /// The protocol is known from the first bytes received: the HTTP/2
+  /// client connection preface, or else an HTTP/1.1 request.
+  enum class handler_protocol { UNKNOWN, HTTP2, HTTP1 };
+
+  /// A request received over HTTP/1.1, in the order of the requests,
+  /// as the responses go out in that order.
+  struct http1_response {
+    int32_t stream_id;
+    bool keep_alive;
+    // HTTP/1.0 request, no chunked body in the response
+    bool http10;
+    // write_head was called
+    bool started;
+    bool header_sent;
+    bool body_expected;
+    bool chunked;
+    header_map trailers;
+  };
+
+  int detect_protocol(const uint8_t *data, std::size_t len);
+
+  // HTTP/1.1, see asio_server_http1.cc
+  int http1_on_read(const uint8_t *data, std::size_t len);
+  int http1_on_write(output_buffers &out, std::size_t limit);
+  int http1_start_response(stream &s);
+  bool http1_should_stop() const;
+  void http1_response_header(stream &s, http1_response &res);
+  // drops the response of stream_id, and the ones queued after it
+  void http1_close(int32_t stream_id);
+  int http1_store_header();
+  void arm_consume_timer();
+  void on_consume_timer();
+  static int http1_on_message_begin(llhttp_t *htp);
+  static int http1_on_url(llhttp_t *htp, const char *data, size_t len);
+  static int http1_on_header_field(llhttp_t *htp, const char *data,
+                                   size_t len);
+  static int http1_on_header_value(llhttp_t *htp, const char *data,
+                                   size_t len);
+  static int http1_on_headers_complete(llhttp_t *htp);
+  static int http1_on_body(llhttp_t *htp, const char *data, size_t len);
+  static int http1_on_message_complete(llhttp_t *htp);
+  static const llhttp_settings_t http1_hooks;
+
+  stream_map streams_;
   connection_write writefun_;
   serve_mux &mux_;
   boost::asio::io_service &io_service_;
   boost::asio::ip::tcp::endpoint remote_ep_;
   nghttp2_session *session_;
-  const uint8_t *buf_;
-  std::size_t buflen_;
+  // while on_write is in progress
+  output_buffers *output_;
+  std::size_t output_limit_;
   bool inside_callback_;
   // true if we have pending on_write call.  This avoids repeated call
   // of io_service::post.
   bool write_signaled_;
   time_t tstamp_cached_;
   std::string formatted_date_;
-  thread_local static std::atomic<uint64_t> handler_unique_id;
-  thread_local static std::map<uint64_t, http2_handler*> alive_handlers;
-  thread_local static std::map<uint64_t, boost::asio::io_service*> handler_io_service;
+  // The handlers of the thread, by the low 32 bits of the handler id; the
+  // high 32 bits are the generation of the slot, bumped when the handler
+  // is gone, so that an id outliving its handler finds nothing.
+  struct handler_slot {
+    uint32_t generation;
+    uint32_t next_free;
+    http2_handler *handler;
+    boost::asio::io_service *io_service;
+  };
+  static uint64_t acquire_handler_slot(http2_handler *h);
+  static void release_handler_slot(uint64_t handler_id);
+  static handler_slot *find_handler_slot(uint64_t handler_id);
+  thread_local static std::vector<handler_slot> handler_slots;
+  thread_local static uint32_t free_handler_slot;
   uint64_t this_handler_id;
   const H2Server_Config_Schema& config;
+  handler_protocol protocol_;
+  // first bytes, until the protocol is known
+  std::string preface_;
+  std::unique_ptr<llhttp_t> htp_;
+  // stream of the HTTP/1.1 request being received
+  int32_t http1_request_id_;
+  int32_t http1_next_stream_id_;
+  std::string http1_url_;
+  std::string http1_header_name_;
+  std::string http1_header_value_;
+  bool http1_header_value_started_;
+  std::deque<http1_response> http1_responses_;
+  // bytes which did not fit into the write buffer
+  std::string http1_pending_;
+  // no more requests are read, and the connection is closed once the
+  // responses queued are written
+  bool http1_read_closed_;
+  // request body data not consumed yet, in the order received
+  std::deque<std::pair<int32_t, std::size_t>> unconsumed_;
+  boost::asio::steady_timer consume_timer_;
+  std::chrono::steady_clock::time_point consume_time_;
+  // bytes which may be consumed, accrued at request-body-consume-rate
+  double consume_budget_;
+  bool consume_timer_armed_;
 };
 
 } // namespace server
@@ -70,6 +70,10 @@ bool http2_impl::handle(std::string pattern, request_cb cb) {
   return mux_.handle(std::move(pattern), std::move(cb));
 }
 
+void http2_impl::body_needed(body_needed_cb cb) {
+  mux_.body_needed(std::move(cb));
+}
+
 void http2_impl::stop() { return server_->stop(); }
 
 void http2_impl::join() { return server_->join(); }
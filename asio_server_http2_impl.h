@@ -51,6 +51,7 @@ public:
   void tls_handshake_timeout(const boost::posix_time::time_duration &t);
   void read_timeout(const boost::posix_time::time_duration &t);
   bool handle(std::string pattern, request_cb cb);
+  void body_needed(body_needed_cb cb);
   void stop();
   void join();
   const std::vector<std::shared_ptr<boost::asio::io_service>> &
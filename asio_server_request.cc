@@ -64,6 +64,10 @@ const std::string& request::unmutable_payload() const
   return impl_->unmutable_payload();
 }
 
+uint64_t request::payload_length() const { return impl_->payload_length(); }
+
+uint64_t request::payload_digest() const { return impl_->payload_digest(); }
+
 
 } // namespace server
 } // namespace asio_http2
@@ -28,7 +28,46 @@ namespace nghttp2 {
 namespace asio_http2 {
 namespace server {
 
-request_impl::request_impl() : strm_(nullptr), header_buffer_size_(0) {}
+namespace {
+constexpr uint64_t fnv1a_offset_basis = 14695981039346656037ULL;
+constexpr uint64_t fnv1a_prime = 1099511628211ULL;
+
+uint64_t fnv1a(uint64_t hash, const uint8_t *data, std::size_t len) {
+  for (auto end = data + len; data != end; ++data) {
+    hash = (hash ^ *data) * fnv1a_prime;
+  }
+  return hash;
+}
+} // namespace
+
+request_impl::request_impl()
+    : strm_(nullptr), header_buffer_size_(0), keep_payload_(true),
+      payload_length_(0), payload_digest_(fnv1a_offset_basis) {}
+
+void request_impl::reset() {
+  // a large body is not kept for the requests after
+  constexpr std::size_t max_payload_capacity_kept = 64 * 1024;
+
+  header_.clear();
+  method_.clear();
+  uri_.scheme.clear();
+  uri_.host.clear();
+  uri_.path.clear();
+  uri_.raw_path.clear();
+  uri_.raw_query.clear();
+  uri_.fragment.clear();
+  on_data_cb_ = nullptr;
+  remote_ep_ = boost::asio::ip::tcp::endpoint();
+  header_buffer_size_ = 0;
+  if (payload_.capacity() > max_payload_capacity_kept) {
+    std::string().swap(payload_);
+  } else {
+    payload_.clear();
+  }
+  keep_payload_ = true;
+  payload_length_ = 0;
+  payload_digest_ = fnv1a_offset_basis;
+}
 
 const header_map &request_impl::header() const { return header_; }
 
@@ -78,6 +117,28 @@ const std::string& request_impl::unmutable_payload() const
   return payload_;
 }
 
+void request_impl::keep_payload(bool keep) { keep_payload_ = keep; }
+
+void request_impl::append_payload(const uint8_t *data, std::size_t len) {
+  payload_length_ += len;
+  if (keep_payload_) {
+    payload_.append(reinterpret_cast<const char *>(data), len);
+  } else {
+    payload_digest_ = fnv1a(payload_digest_, data, len);
+  }
+}
+
+uint64_t request_impl::payload_length() const { return payload_length_; }
+
+uint64_t request_impl::payload_digest() const {
+  if (keep_payload_) {
+    return fnv1a(fnv1a_offset_basis,
+                 reinterpret_cast<const uint8_t *>(payload_.data()),
+                 payload_.size());
+  }
+  return payload_digest_;
+}
+
 
 } // namespace server
 } // namespace asio_http2
@@ -63,6 +63,15 @@ public:
   std::string& payload();
   const std::string& unmutable_payload() const;
 
+  // false to count and hash the body only, set before the body is received
+  void keep_payload(bool keep);
+  void append_payload(const uint8_t *data, std::size_t len);
+  uint64_t payload_length() const;
+  uint64_t payload_digest() const;
+
+  // back to the state of a new request, for the reuse of its stream
+  void reset();
+
 private:
   class stream *strm_;
   header_map header_;
@@ -72,6 +81,10 @@ private:
   boost::asio::ip::tcp::endpoint remote_ep_;
   size_t header_buffer_size_;
   std::string payload_;
+  bool keep_payload_;
+  uint64_t payload_length_;
+  // of the body not kept
+  uint64_t payload_digest_;
 };
 
 } // namespace server
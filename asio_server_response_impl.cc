@@ -38,11 +38,25 @@ namespace server {
 response_impl::response_impl()
     : strm_(nullptr),
       generator_cb_(deferred_generator()),
+      body_offset_(0),
       status_code_(200),
       state_(response_state::INITIAL),
       pushed_(false),
       push_promise_sent_(false) {}
 
+void response_impl::reset() {
+  header_.clear();
+  trailers_.clear();
+  generator_cb_ = deferred_generator();
+  close_cb_ = nullptr;
+  body_.reset();
+  body_offset_ = 0;
+  status_code_ = 200;
+  state_ = response_state::INITIAL;
+  pushed_ = false;
+  push_promise_sent_ = false;
+}
+
 unsigned int response_impl::status_code() const { return status_code_; }
 
 void response_impl::write_head(unsigned int status_code, header_map h) {
@@ -63,11 +77,57 @@ void response_impl::write_head(unsigned int status_code, header_map h) {
 }
 
 void response_impl::end(std::string data) {
-  end(string_generator(std::move(data)));
+  if (state_ == response_state::BODY_STARTED) {
+    return;
+  }
+
+  body_ = std::make_shared<const std::string>(std::move(data));
+  body_offset_ = 0;
+  end(body_generator());
 }
 void response_impl::send_data_no_eos(std::string data)
 {
-    end(string_generator(std::move(data)));
+    end(std::move(data));
+}
+
+generator_cb response_impl::body_generator() {
+  return [this](uint8_t *buf, std::size_t len, uint32_t *data_flags) {
+    std::shared_ptr<const std::string> owner;
+    auto n = std::min(len, body_->size() - body_offset_);
+    if (body_offset_ + n == body_->size()) {
+      *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    std::copy_n(take_body(n, owner), n, buf);
+    return static_cast<generator_cb::result_type>(n);
+  };
+}
+
+bool response_impl::body_in_place() const {
+  return body_ && generator_cb_;
+}
+
+generator_cb::result_type response_impl::read_in_place(std::size_t len,
+                                                       uint32_t *data_flags) {
+  auto n = std::min(len, body_->size() - body_offset_);
+  *data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
+  if (body_offset_ + n == body_->size()) {
+    *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    generator_cb_ = nullptr;
+    if (trailers_.size()) {
+      *data_flags |= NGHTTP2_DATA_FLAG_NO_END_STREAM;
+      send_trailer();
+    }
+  }
+  return static_cast<generator_cb::result_type>(n);
+}
+
+const uint8_t *
+response_impl::take_body(std::size_t len,
+                         std::shared_ptr<const std::string> &owner) {
+  auto data = reinterpret_cast<const uint8_t *>(body_->data()) + body_offset_;
+  body_offset_ += len;
+  owner = body_;
+  return data;
 }
 
 void response_impl::end(generator_cb cb) {
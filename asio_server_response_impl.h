@@ -73,14 +73,32 @@ public:
                                       uint32_t *data_flags);
   void call_on_close(uint32_t error_code);
 
+  // true while there is a body set by end(std::string) to be sent, which
+  // can be sent from where it is rather than copied by call_read
+  bool body_in_place() const;
+  // like call_read, with NGHTTP2_DATA_FLAG_NO_COPY, the data to be taken
+  // by take_body
+  generator_cb::result_type read_in_place(std::size_t len,
+                                          uint32_t *data_flags);
+  // the next len bytes of the body, kept alive by owner
+  const uint8_t *take_body(std::size_t len,
+                           std::shared_ptr<const std::string> &owner);
+
+  // back to the state of a new response, for the reuse of its stream
+  void reset();
+
 private:
 
   void send_trailer();
+  generator_cb body_generator();
   class stream *strm_;
   header_map header_;
   header_map trailers_;
   generator_cb generator_cb_;
   close_cb close_cb_;
+  // set by end(std::string)
+  std::shared_ptr<const std::string> body_;
+  std::size_t body_offset_;
   unsigned int status_code_;
   response_state state_;
   // true if this is pushed stream's response
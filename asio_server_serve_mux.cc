@@ -74,6 +74,17 @@ bool serve_mux::handle(std::string pattern, request_cb cb) {
   return true;
 }
 
+void serve_mux::body_needed(body_needed_cb cb) {
+  body_needed_cb_ = std::move(cb);
+}
+
+bool serve_mux::body_needed(const request &req) const {
+  if (!body_needed_cb_) {
+    return true;
+  }
+  return body_needed_cb_(req);
+}
+
 request_cb serve_mux::handler(request_impl &req) const {
   auto &path = req.uri().path;
   if (req.method() != "CONNECT") {
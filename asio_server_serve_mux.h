@@ -50,9 +50,13 @@ public:
   bool handle(std::string pattern, request_cb cb);
   request_cb handler(request_impl &req) const;
   request_cb match(const std::string &path) const;
+  void body_needed(body_needed_cb cb);
+  // true if no callback is set
+  bool body_needed(const request &req) const;
 
 private:
   std::map<std::string, handler_entry> mux_;
+  body_needed_cb body_needed_cb_;
 };
 
 } // namespace server
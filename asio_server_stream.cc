@@ -24,6 +24,8 @@
  */
 #include "asio_server_stream.h"
 
+#include <cassert>
+
 #include "asio_server_http2_handler.h"
 #include "asio_server_request_impl.h"
 #include "asio_server_response_impl.h"
@@ -32,12 +34,49 @@ namespace nghttp2 {
 namespace asio_http2 {
 namespace server {
 
+namespace {
+// streams kept for reuse, per thread
+constexpr std::size_t max_free_streams = 4096;
+thread_local std::vector<std::unique_ptr<stream>> free_streams;
+
+constexpr std::size_t initial_stream_map_capacity = 16;
+} // namespace
+
 stream::stream(http2_handler *h, int32_t stream_id)
     : handler_(h), stream_id_(stream_id) {
   request_.impl().stream(this);
   response_.impl().stream(this);
 }
 
+std::unique_ptr<stream> stream::make(http2_handler *h, int32_t stream_id) {
+  if (free_streams.empty()) {
+    return std::make_unique<stream>(h, stream_id);
+  }
+
+  auto s = std::move(free_streams.back());
+  free_streams.pop_back();
+  s->handler_ = h;
+  s->stream_id_ = stream_id;
+  return s;
+}
+
+void stream::recycle(std::unique_ptr<stream> s) {
+  if (free_streams.size() >= max_free_streams) {
+    return;
+  }
+
+  // what the request and response hold is released now, not at reuse
+  s->reset();
+  free_streams.push_back(std::move(s));
+}
+
+void stream::reset() {
+  handler_ = nullptr;
+  stream_id_ = 0;
+  request_.impl().reset();
+  response_.impl().reset();
+}
+
 int32_t stream::get_stream_id() const { return stream_id_; }
 
 class request &stream::request() {
@@ -50,6 +89,85 @@ class response &stream::response() {
 
 http2_handler *stream::handler() const { return handler_; }
 
+stream_map::stream_map()
+    : slots_(initial_stream_map_capacity),
+      mask_(initial_stream_map_capacity - 1),
+      size_(0) {}
+
+std::size_t stream_map::home(int32_t stream_id) const {
+  return (static_cast<uint32_t>(stream_id) >> 1) & mask_;
+}
+
+std::size_t stream_map::probe(int32_t stream_id) const {
+  auto i = home(stream_id);
+  while (slots_[i].strm && slots_[i].stream_id != stream_id) {
+    i = (i + 1) & mask_;
+  }
+  return i;
+}
+
+stream *stream_map::emplace(int32_t stream_id, std::unique_ptr<stream> s) {
+  // at most half full, so the probes stay short
+  if ((size_ + 1) * 2 > slots_.size()) {
+    grow();
+  }
+
+  auto &slot = slots_[probe(stream_id)];
+  assert(!slot.strm);
+  slot.stream_id = stream_id;
+  slot.strm = std::move(s);
+  ++size_;
+  return slot.strm.get();
+}
+
+stream *stream_map::find(int32_t stream_id) const {
+  return slots_[probe(stream_id)].strm.get();
+}
+
+std::unique_ptr<stream> stream_map::erase(int32_t stream_id) {
+  auto i = probe(stream_id);
+  if (!slots_[i].strm) {
+    return nullptr;
+  }
+
+  auto s = std::move(slots_[i].strm);
+  --size_;
+
+  // backward shift deletion: the streams after the hole, up to the next
+  // empty slot, which would not be found past the hole, are moved into it
+  auto j = i;
+  for (;;) {
+    j = (j + 1) & mask_;
+    if (!slots_[j].strm) {
+      break;
+    }
+    auto k = home(slots_[j].stream_id);
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+      continue;
+    }
+    slots_[i].stream_id = slots_[j].stream_id;
+    slots_[i].strm = std::move(slots_[j].strm);
+    i = j;
+  }
+
+  return s;
+}
+
+std::size_t stream_map::size() const { return size_; }
+
+void stream_map::grow() {
+  std::vector<slot> old(slots_.size() * 2);
+  old.swap(slots_);
+  mask_ = slots_.size() - 1;
+  for (auto &slot : old) {
+    if (slot.strm) {
+      auto &dst = slots_[probe(slot.stream_id)];
+      dst.stream_id = slot.stream_id;
+      dst.strm = std::move(slot.strm);
+    }
+  }
+}
+
 } // namespace server
 } // namespace asio_http2
 } // namespace nghttp2
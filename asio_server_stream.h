@@ -27,6 +27,9 @@
 
 #include "nghttp2_config.h"
 
+#include <vector>
+#include <memory>
+
 #include <nghttp2/asio_http2_server.h>
 
 namespace nghttp2 {
@@ -45,13 +48,60 @@ public:
 
   http2_handler *handler() const;
 
+  // A stream from the free list of the thread, or a new one if it is
+  // empty; the request and response of a stream are allocated once.
+  static std::unique_ptr<stream> make(http2_handler *h, int32_t stream_id);
+  // Resets the stream, and keeps it in the free list of the thread, up to
+  // a limit.
+  static void recycle(std::unique_ptr<stream> s);
+
 private:
+  void reset();
+
   http2_handler *handler_;
   class request request_;
   class response response_;
   int32_t stream_id_;
 };
 
+// Open addressing hash map of the streams of a connection, with linear
+// probing.  The stream ids of a connection grow by 2, so the home slot of
+// an id is (id >> 1) modulo the capacity, and the streams opened one
+// after another take slots one after another.
+class stream_map {
+public:
+  stream_map();
+
+  stream *emplace(int32_t stream_id, std::unique_ptr<stream> s);
+  stream *find(int32_t stream_id) const;
+  // Returns the stream removed, nullptr if there is none of stream_id.
+  std::unique_ptr<stream> erase(int32_t stream_id);
+  std::size_t size() const;
+
+  template <typename F> void for_each(F f) {
+    for (auto &slot : slots_) {
+      if (slot.strm) {
+        f(*slot.strm);
+      }
+    }
+  }
+
+private:
+  struct slot {
+    int32_t stream_id;
+    std::unique_ptr<stream> strm;
+  };
+
+  std::size_t home(int32_t stream_id) const;
+  // the slot of stream_id, or the empty slot where it would go
+  std::size_t probe(int32_t stream_id) const;
+  void grow();
+
+  std::vector<slot> slots_;
+  std::size_t mask_;
+  std::size_t size_;
+};
+
 } // namespace server
 } // namespace asio_http2
 } // namespace nghttp2
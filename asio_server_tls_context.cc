@@ -49,7 +49,10 @@ namespace {
 int alpn_select_proto_cb(SSL *ssl, const unsigned char **out,
                          unsigned char *outlen, const unsigned char *in,
                          unsigned int inlen, void *arg) {
-  if (!util::select_h2(out, outlen, in, inlen)) {
+  // h2 is preferred, http/1.1 is served too, see asio_server_http1.cc
+  if (!util::select_h2(out, outlen, in, inlen) &&
+      !util::select_protocol(out, outlen, in, inlen,
+                             {NGHTTP2_H1_1_ALPN.str()})) {
     return SSL_TLSEXT_ERR_NOACK;
   }
   return SSL_TLSEXT_ERR_OK;
@@ -1,4 +1,7 @@
 #include "asio_util.h"
+#include "asio_worker.h"
+#include "base_client.h"
+#include "h2load_Config.h"
 
 
 bool debug_mode = false;
@@ -45,6 +48,13 @@ size_t get_resp_name_max_size(const H2Server_Config_Schema& config_schema)
     return width;
 }
 
+// the statistics of the Proxy of a service come after those of its Responses, as response "proxy"; its upstream errors have a column of their own
+std::string get_resp_name(const H2Server_Config_Schema& config_schema, size_t req_index, size_t resp_index)
+{
+    auto& responses = config_schema.service[req_index].responses;
+    return resp_index < responses.size() ? responses[resp_index].name : "proxy";
+}
+
 void send_response(uint32_t status_code,
                    std::map<std::string, std::string>& resp_headers,
                    std::string& resp_payload,
@@ -128,6 +138,38 @@ void send_response(uint32_t status_code,
     matchedResponsesSent++;
 };
 
+void send_delayed_response(H2Server_Delayed_Response& delayed_response)
+{
+    send_response(delayed_response.status_code,
+                  delayed_response.headers,
+                  delayed_response.payload,
+                  delayed_response.trailers,
+                  delayed_response.handler_id,
+                  delayed_response.stream_id,
+                  *delayed_response.response_sent);
+}
+
+void send_or_delay_response(const H2Server_Response* matched_response,
+                            boost::asio::io_service& ios,
+                            uint32_t status_code,
+                            std::map<std::string, std::string>& resp_headers,
+                            std::string& resp_payload,
+                            std::map<std::string, std::string>& trailer_headers,
+                            uint64_t handler_id,
+                            int32_t stream_id,
+                            uint64_t& matchedResponsesSent
+                           )
+{
+    if (!matched_response->delay.enabled())
+    {
+        send_response(status_code, resp_headers, resp_payload, trailer_headers, handler_id, stream_id, matchedResponsesSent);
+        return;
+    }
+    // one wheel per server thread, on the io_service of the thread
+    static thread_local H2Server_Timer_Wheel timer_wheel(ios, send_delayed_response);
+    timer_wheel.schedule(matched_response->delay.sample(), status_code, resp_headers, resp_payload, trailer_headers,
+                         handler_id, stream_id, matchedResponsesSent);
+}
 
 void send_response_from_another_thread(boost::asio::io_service* target_io_service,
                                        uint64_t handler_id,
@@ -166,7 +208,379 @@ void send_response_from_another_thread(boost::asio::io_service* target_io_servic
     target_io_service->post(call_send_response);
 }
 
+h2load::asio_worker* get_proxy_worker(boost::asio::io_service& ios)
+{
+    // the client side of the Proxy of the services, the same for all the server threads
+    static h2load::Config conf;
+    auto init_config = []()
+    {
+        conf.max_concurrent_streams = config_schema.max_concurrent_streams;
+        conf.window_bits = config_schema.window_bits;
+        // a relayed response gives the stream window back as it is sent downstream only,
+        // so with the window within max-response-size, no more than that is ever waiting for a slow downstream
+        for (auto& service : config_schema.service)
+        {
+            auto max_response_size = service.proxy.max_response_size;
+            while (service.proxy.upstreams.size() && max_response_size && conf.window_bits > 1 &&
+                   (1ULL << conf.window_bits) - 1 > max_response_size)
+            {
+                conf.window_bits--;
+            }
+        }
+        conf.connection_window_bits = config_schema.connection_window_bits;
+        conf.header_table_size = config_schema.header_table_size;
+        conf.encoder_header_table_size = config_schema.encoder_header_table_size;
+        conf.verbose = config_schema.verbose;
+        for (auto proto : {"h2", "http/1.1"})
+        {
+            std::string npn(proto);
+            npn.insert(npn.begin(), static_cast<unsigned char>(npn.size()));
+            conf.npn_list.push_back(npn);
+        }
+        Request request;
+        Scenario scenario;
+        scenario.requests.push_back(request);
+        conf.json_config_schema.scenarios.push_back(scenario);
+        return true;
+    };
+    static auto init_config_ret_code = init_config();
+
+    // one per server thread, on the io_service of the thread, so the upstream connections need no other thread
+    static thread_local std::unique_ptr<h2load::asio_worker> worker(new h2load::asio_worker(0, 0xFFFFFFFF, 1, 0, 1000,
+                                                                                            &conf, &ios));
+    return worker.get();
+}
+
+void connect_to_upstream(h2load::asio_worker* worker, const H2Server_Proxy& proxy, const H2Server_Upstream& upstream,
+                         std::function<void(bool, h2load::base_client*)> connected_callback)
+{
+    static thread_local uint64_t next_connection = 0;
+    auto& clients = worker->get_client_pool()[upstream.base_uri];
+    if (clients.size() < proxy.connections_per_upstream)
+    {
+        auto client = worker->create_new_client(0xFFFFFFFF);
+        worker->check_in_client(client);
+        clients.insert(client.get());
+        client->install_connected_callback(connected_callback);
+        client->set_prefered_authority(upstream.authority);
+        client->connect_to_host(upstream.schema, upstream.authority);
+        return;
+    }
+    auto iter = clients.begin();
+    std::advance(iter, next_connection++ % clients.size());
+    auto client = *iter;
+    if (h2load::CLIENT_IDLE == client->state)
+    {
+        client->install_connected_callback(connected_callback);
+        client->connect_to_host(upstream.schema, upstream.authority);
+    }
+    else if (h2load::CLIENT_CONNECTING == client->state)
+    {
+        client->install_connected_callback(connected_callback);
+    }
+    else
+    {
+        connected_callback(true, client);
+    }
+}
+
+namespace
+{
+// the response of the upstream to a forwarded request, on its way back to the downstream stream
+struct Upstream_Response_Relay
+{
+    uint64_t handler_id;
+    int32_t stream_id;
+    h2load::base_client* client = nullptr;
+    int32_t upstream_stream_id = -1;
+    // received and not sent downstream yet; each part is given back to the flow control window of the upstream once sent,
+    // so this stays within the stream window of the upstream connections, see get_proxy_worker
+    std::string pending;
+    size_t pending_offset = 0;
+    // limit of pending for an upstream without flow control, i.e. HTTP/1.1
+    uint64_t max_pending = 0;
+    bool headers_sent = false;
+    bool upstream_open = false;
+    bool upstream_done = false;
+    bool downstream_closed = false;
+};
+
+const nghttp2::asio_http2::server::response* find_downstream_response(const Upstream_Response_Relay& relay)
+{
+    auto h2_handler = nghttp2::asio_http2::server::http2_handler::find_http2_handler(relay.handler_id);
+    if (!h2_handler)
+    {
+        return nullptr;
+    }
+    auto orig_stream = h2_handler->find_stream(relay.stream_id);
+    return orig_stream ? &orig_stream->response() : nullptr;
+}
+
+// nothing more goes to the downstream: the upstream stream, if still open, is reset, and what it holds given back
+void drop_downstream(Upstream_Response_Relay& relay)
+{
+    relay.downstream_closed = true;
+    if (relay.upstream_open)
+    {
+        relay.client->consume_response_data(relay.upstream_stream_id, relay.pending.size() - relay.pending_offset);
+        relay.client->reset_stream(relay.upstream_stream_id);
+    }
+    std::string().swap(relay.pending);
+    relay.pending_offset = 0;
+}
+
+nghttp2::asio_http2::header_map to_header_map(const std::map<std::string, std::string, ci_less>& headers)
+{
+    nghttp2::asio_http2::header_map header_map;
+    for (auto& header : headers)
+    {
+        if (header.first.size() && header.first[0] != ':' && header.first != "connection" &&
+            header.first != "keep-alive" && header.first != "transfer-encoding")
+        {
+            nghttp2::asio_http2::header_value hdr_val;
+            hdr_val.sensitive = false;
+            hdr_val.value = header.second;
+            header_map.insert(std::make_pair(header.first, hdr_val));
+            if (debug_mode)
+            {
+                std::cout << "relaying header " << header.first << ": " << header.second << std::endl;
+            }
+        }
+    }
+    return header_map;
+}
+
+nghttp2::asio_http2::generator_cb relay_generator(std::shared_ptr<Upstream_Response_Relay> relay)
+{
+    return [relay](uint8_t* buf, std::size_t len, uint32_t* data_flags)
+    {
+        auto n = std::min(len, relay->pending.size() - relay->pending_offset);
+        if (!n && !relay->upstream_done)
+        {
+            return static_cast<nghttp2::asio_http2::generator_cb::result_type>(NGHTTP2_ERR_DEFERRED);
+        }
+        std::copy_n(relay->pending.data() + relay->pending_offset, n, buf);
+        relay->pending_offset += n;
+        if (relay->pending_offset == relay->pending.size())
+        {
+            relay->pending.clear();
+            relay->pending_offset = 0;
+        }
+        if (relay->upstream_open && n)
+        {
+            relay->client->consume_response_data(relay->upstream_stream_id, n);
+        }
+        if (relay->upstream_done && relay->pending.empty())
+        {
+            *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+        }
+        return static_cast<nghttp2::asio_http2::generator_cb::result_type>(n);
+    };
+}
+}
+
+void forward_request_to_upstream(H2Server_Proxy& proxy,
+                                 H2Server_Request_Message& msg,
+                                 const std::string& req_payload,
+                                 boost::asio::io_service& ios,
+                                 uint64_t handler_id,
+                                 int32_t stream_id,
+                                 ResponseStatistics& proxy_stats)
+{
+    static std::map<std::string, std::string, ci_less> dummyHeaders;
+    auto worker = get_proxy_worker(ios);
+    auto upstream_index = proxy.select_upstream(msg);
+    auto& upstream = proxy.upstreams[upstream_index];
+
+    std::map<std::string, std::string, ci_less> headers;
+    std::string method;
+    std::string path;
+    std::string authority;
+    proxy.produce_request(msg, headers, method, path, authority);
+    if (authority.empty())
+    {
+        authority = upstream.authority;
+    }
+    if (req_payload.size())
+    {
+        headers["content-length"] = std::to_string(req_payload.size());
+    }
+    proxy.request_forwarded(upstream_index);
+
+    auto relay = std::make_shared<Upstream_Response_Relay>();
+    relay->handler_id = handler_id;
+    relay->stream_id = stream_id;
+    relay->max_pending = proxy.max_response_size;
+    auto res = find_downstream_response(*relay);
+    if (res)
+    {
+        res->on_close([relay](uint32_t)
+        {
+            if (!relay->downstream_closed)
+            {
+                drop_downstream(*relay);
+            }
+        });
+    }
+
+    // the headers go downstream as soon as they come, the payload follows through relay_generator
+    auto relay_headers = [relay](uint16_t status_code, std::map<std::string, std::string, ci_less>& resp_headers)
+    {
+        if (relay->downstream_closed)
+        {
+            return;
+        }
+        auto res = find_downstream_response(*relay);
+        if (!res)
+        {
+            drop_downstream(*relay);
+            return;
+        }
+        if (debug_mode)
+        {
+            std::cout << "relaying status code: " << status_code << std::endl;
+        }
+        relay->headers_sent = true;
+        res->write_head(status_code, to_header_map(resp_headers));
+        res->end(relay_generator(relay));
+    };
+
+    auto relay_data = [relay, &proxy_stats](const uint8_t* data, size_t len)
+    {
+        if (relay->downstream_closed)
+        {
+            relay->client->consume_response_data(relay->upstream_stream_id, len);
+            return;
+        }
+        auto res = find_downstream_response(*relay);
+        if (!res)
+        {
+            drop_downstream(*relay);
+            return;
+        }
+        if (relay->pending_offset > relay->pending.size() / 2)
+        {
+            relay->pending.erase(0, relay->pending_offset);
+            relay->pending_offset = 0;
+        }
+        relay->pending.append(reinterpret_cast<const char*>(data), len);
+        if (relay->max_pending && relay->pending.size() - relay->pending_offset > relay->max_pending)
+        {
+            // only an upstream with no flow control can get that far ahead of the downstream
+            proxy_stats.upstream_errors++;
+            res->cancel(NGHTTP2_INTERNAL_ERROR);
+            drop_downstream(*relay);
+            return;
+        }
+        res->resume();
+    };
+
+    auto return_response = [relay, &proxy, upstream_index, &proxy_stats](h2load::Stream_Callback_Data * response)
+    {
+        proxy.response_returned(upstream_index);
+        relay->upstream_open = false;
+        if (relay->downstream_closed)
+        {
+            return;
+        }
+        if (!relay->headers_sent)
+        {
+            proxy_stats.upstream_errors++;
+            relay->downstream_closed = true;
+            std::map<std::string, std::string> resp_headers;
+            std::string resp_payload;
+            std::map<std::string, std::string> trailer_headers;
+            uint64_t error_sent = 0;
+            send_response(proxy.upstream_error_status_code, resp_headers, resp_payload, trailer_headers,
+                          relay->handler_id, relay->stream_id, error_sent);
+            return;
+        }
+        auto res = find_downstream_response(*relay);
+        if (!res)
+        {
+            relay->downstream_closed = true;
+            return;
+        }
+        if (!response || !response->resp_complete)
+        {
+            // the status is gone already, the downstream stream is reset instead
+            proxy_stats.upstream_errors++;
+            relay->downstream_closed = true;
+            res->cancel(NGHTTP2_INTERNAL_ERROR);
+            return;
+        }
+        if (response->resp_headers.size() > 1 && response->resp_trailer_present)
+        {
+            res->write_trailer(to_header_map(response->resp_headers.back()));
+        }
+        relay->upstream_done = true;
+        res->resume();
+        proxy_stats.response_sent++;
+    };
+
+    auto request_sent_callback = [relay, return_response](int32_t upstream_stream_id, h2load::base_client * client)
+    {
+        if (upstream_stream_id < 0 || !client)
+        {
+            return_response(nullptr);
+            return;
+        }
+        relay->client = client;
+        relay->upstream_stream_id = upstream_stream_id;
+        relay->upstream_open = true;
+        client->queue_stream_for_user_callback(upstream_stream_id);
+        client->pass_response_to_callback(upstream_stream_id, return_response);
+        if (relay->downstream_closed)
+        {
+            client->reset_stream(upstream_stream_id);
+        }
+    };
+
+    auto connected_callback = [request_sent_callback, relay_headers, relay_data, headers, method, path, authority,
+                                          req_payload, &upstream, &proxy](bool success, h2load::base_client * client) mutable
+    {
+        if (!success)
+        {
+            request_sent_callback(-1, nullptr);
+            return;
+        }
+        h2load::Request_Data request_to_send;
+        request_to_send.request_sent_callback = request_sent_callback;
+        request_to_send.string_collection.emplace_back(std::move(req_payload));
+        request_to_send.req_payload = &(request_to_send.string_collection.back());
+        request_to_send.string_collection.emplace_back(std::move(method));
+        request_to_send.method = &(request_to_send.string_collection.back());
+        request_to_send.string_collection.emplace_back(std::move(path));
+        request_to_send.path = &(request_to_send.string_collection.back());
+        request_to_send.string_collection.emplace_back(std::move(authority));
+        request_to_send.authority = &(request_to_send.string_collection.back());
+        request_to_send.string_collection.emplace_back(upstream.schema);
+        request_to_send.schema = &(request_to_send.string_collection.back());
+        request_to_send.req_headers_of_individual = std::move(headers);
+        request_to_send.req_headers_from_config = &dummyHeaders;
+        request_to_send.stream_timeout_in_ms = proxy.timeout_ms;
+        request_to_send.resp_headers_callback = relay_headers;
+        request_to_send.resp_data_callback = relay_data;
+        client->requests_to_submit.emplace_back(std::move(request_to_send));
+        client->submit_request();
+    };
+    connect_to_upstream(worker, proxy, upstream, connected_callback);
+}
+
+lua_State* get_offload_thread_lua_state(const H2Server_Response* matched_response, size_t req_index)
+{
+    // each lua-offload thread has a Lua state of its own for each response, shared by all the server threads
+    static thread_local std::map<std::pair<size_t, size_t>, std::shared_ptr<lua_State>> lua_states;
+    auto& state = lua_states[std::make_pair(req_index, matched_response->response_index)];
+    if (!state)
+    {
+        state = matched_response->create_lua_state();
+    }
+    return state.get();
+}
+
 void update_response_with_lua(const H2Server_Response* matched_response,
+                              size_t req_index,
                               std::multimap<std::string, std::string>& req_headers,
                               std::string& req_payload,
                               std::map<std::string, std::string>& resp_headers,
@@ -175,9 +589,13 @@ void update_response_with_lua(const H2Server_Response* matched_response,
                               boost::asio::io_service* ios,
                               uint64_t handler_id,
                               int32_t stream_id,
-                              uint64_t& matchedResponsesSent)
+                              ResponseStatistics& responseStatistics)
 {
-    matched_response->update_response_with_lua(req_headers, req_payload, resp_headers, trailers, resp_payload);
+    auto lua_start = std::chrono::steady_clock::now();
+    matched_response->update_response_with_lua(get_offload_thread_lua_state(matched_response, req_index),
+                                               req_headers, req_payload, resp_headers, trailers, resp_payload);
+    uint64_t lua_time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                  lua_start).count();
     if (!ios)
     {
         return;
@@ -190,15 +608,14 @@ void update_response_with_lua(const H2Server_Response* matched_response,
     resp_headers.erase(status);
     // TODO: 
     std::map<std::string, std::string> trailer_headers;
-    auto send_response_routine = std::bind(send_response,
-                                           status_code,
-                                           resp_headers,
-                                           resp_payload,
-                                           trailer_headers,
-                                           handler_id,
-                                           stream_id,
-                                           std::ref(matchedResponsesSent)
-                                          );
+    auto send_response_routine = [matched_response, ios, status_code, resp_headers, resp_payload, trailer_headers,
+                                  handler_id, stream_id, lua_time_us, &responseStatistics]() mutable
+    {
+        responseStatistics.lua_calls++;
+        responseStatistics.lua_time_us += lua_time_us;
+        send_or_delay_response(matched_response, *ios, status_code, resp_headers, resp_payload, trailer_headers,
+                               handler_id, stream_id, responseStatistics.response_sent);
+    };
     ios->post(send_response_routine);
 };
 
@@ -267,22 +684,46 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
         boost::asio::io_service::work work(work_offload_io_service);
         if (create_off_load_thread)
         {
-            for (size_t i = 0; i < config_schema.service.size(); i++)
+            size_t lua_offload_threads = config_schema.lua_offload_threads ? config_schema.lua_offload_threads :
+                                         std::max(num_threads, static_cast<std::size_t>(1));
+            for (size_t i = 0; i < lua_offload_threads; i++)
             {
                 work_offload_thread_pool.create_thread(boost::bind(&boost::asio::io_service::run, &work_offload_io_service));
             }
         }
 
+        // a few shards per server thread, see H2Server_Resource_Store
+        const size_t resource_store_shards_per_thread = 16;
+        H2Server_Resource_Store resource_store(std::max(num_threads, static_cast<std::size_t>(1)) *
+                                               resource_store_shards_per_thread);
+
         nghttp2::asio_http2::server::http2 server(config_schema);
 
         get_h2_server_instance(ss.str())->second = &server;
 
         std::atomic<uint64_t> threadIndex(0);
 
+        // the same for all the callbacks run by a server thread
+        auto get_thread_index = [&threadIndex]()
+        {
+            static thread_local auto thread_index = threadIndex++;
+            return thread_index;
+        };
+
         server.num_threads(num_threads);
 
-        server.handle("/", [&work_offload_io_service, &config_schema,
-                            &threadIndex,
+        if (!config_schema.always_buffer_request_body)
+        {
+            server.body_needed([get_thread_index, bootstrap_thread_id](const nghttp2::asio_http2::server::request & req)
+            {
+                static thread_local H2Server& h2server = get_H2Server_match_Instances(bootstrap_thread_id)[get_thread_index()];
+                H2Server_Request_Message msg(req);
+                return h2server.payload_needed(msg);
+            });
+        }
+
+        server.handle("/", [&work_offload_io_service, &config_schema, &resource_store,
+                            get_thread_index,
                             &totalReqsReceived,
                             &totalUnMatchedResponses,
                             &respStats,
@@ -294,7 +735,7 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
                             )
         {
 
-            static thread_local auto thread_index = threadIndex++;
+            static thread_local auto thread_index = get_thread_index();
             static thread_local H2Server& h2server = get_H2Server_match_Instances(bootstrap_thread_id)[thread_index];
             static thread_local std::map<std::string, std::string> trailer_headers; // TODO: 
             auto store_io_service_to_H2Server = [handler_id]()
@@ -306,19 +747,6 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
             static thread_local auto store_io_service_ret_code = store_io_service_to_H2Server();
             static thread_local auto& reqReceived = totalReqsReceived[thread_index];
             static thread_local auto& unMatchedresponses = totalUnMatchedResponses[thread_index];
-            auto init_strand = [&work_offload_io_service]()
-            {
-                std::map<const H2Server_Response*, boost::asio::io_service::strand> strands;
-                for (auto& service : h2server.services)
-                {
-                    for (auto& response : service.second.responses)
-                    {
-                        strands.insert(std::make_pair(&response, boost::asio::io_service::strand(work_offload_io_service)));
-                    }
-                }
-                return strands;
-            };
-            static thread_local auto strands = init_strand();
 
             H2Server_Request_Message msg(req);
             reqReceived++;
@@ -338,6 +766,13 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
                                                                    req.unmutable_payload()
                                                                   );
                 }
+                else if (matched_service->second.proxy.enabled())
+                {
+                    // the statistics of the Proxy come after those of the Responses
+                    forward_request_to_upstream(matched_service->second.proxy, msg, req.unmutable_payload(),
+                                                *h2server.io_service, handler_id, stream_id,
+                                                respStats[req_index][matched_service->second.responses.size()][thread_index]);
+                }
                 else
                 {
                     auto matched_response = h2server.get_response_to_return(matched_service, resp_index);
@@ -347,6 +782,17 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
                         respStats[req_index][resp_index][thread_index].response_throttled++;
                         return;
                     }
+                    // a throttled request leaves the store as it is; not found is answered like the response selected
+                    auto& resource_action = matched_service->second.resource_action;
+                    if (resource_action.enabled() && !resource_action.apply(resource_store, msg, req.unmutable_payload()))
+                    {
+                        std::map<std::string, std::string> no_headers;
+                        std::string no_payload;
+                        send_or_delay_response(matched_response, *h2server.io_service, resource_action.not_found_status_code,
+                                               no_headers, no_payload, trailer_headers, handler_id, stream_id,
+                                               respStats[req_index][resp_index][thread_index].response_sent);
+                        return;
+                    }
                     auto response_headers = matched_response->produce_headers(msg);
                     auto response_payload = matched_response->produce_payload(msg);
                     auto status_code = matched_response->status_code;
@@ -356,6 +802,7 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
                         {
                             auto msg_update_routine = std::bind(update_response_with_lua,
                                                                 matched_response,
+                                                                req_index,
                                                                 msg.headers,
                                                                 req.unmutable_payload(),
                                                                 response_headers,
@@ -364,14 +811,20 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
                                                                 h2server.io_service,
                                                                 handler_id,
                                                                 stream_id,
-                                                                std::ref(respStats[req_index][resp_index][thread_index].response_sent));
-                            auto it = strands.find(matched_response);
-                            it->second.post(msg_update_routine);
+                                                                std::ref(respStats[req_index][resp_index][thread_index]));
+                            work_offload_io_service.post(msg_update_routine);
                             return;
                         }
                         else
                         {
-                            matched_response->update_response_with_lua(msg.headers, req.unmutable_payload(), response_headers, trailer_headers, response_payload);
+                            auto lua_start = std::chrono::steady_clock::now();
+                            matched_response->update_response_with_lua(matched_response->luaState.get(), msg.headers,
+                                                                       req.unmutable_payload(), response_headers,
+                                                                       trailer_headers, response_payload);
+                            auto& stats = respStats[req_index][resp_index][thread_index];
+                            stats.lua_calls++;
+                            stats.lua_time_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                                                     std::chrono::steady_clock::now() - lua_start).count();
                             if (response_headers.count(status))
                             {
                                 status_code = atoi(response_headers[status].c_str());
@@ -379,8 +832,9 @@ void asio_svr_entry(const H2Server_Config_Schema& config_schema,
                             response_headers.erase(status);
                         }
                     }
-                    send_response(status_code, response_headers, response_payload, trailer_headers, handler_id, stream_id,
-                                  respStats[req_index][resp_index][thread_index].response_sent);
+                    send_or_delay_response(matched_response, *h2server.io_service, status_code, response_headers, response_payload,
+                                           trailer_headers, handler_id, stream_id,
+                                           respStats[req_index][resp_index][thread_index].response_sent);
                 }
             }
             else
@@ -458,11 +912,18 @@ void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
     {
         std::vector<std::vector<uint64_t>> resp_sent_till_now;
         std::vector<std::vector<uint64_t>> resp_throttled_till_now;
+        std::vector<std::vector<uint64_t>> lua_calls_till_now;
+        std::vector<std::vector<uint64_t>> lua_time_us_till_now;
+        std::vector<std::vector<uint64_t>> upstream_errors_till_now;
         for (size_t i = 0; i < config_schema.service.size(); i++)
         {
-            resp_sent_till_now.emplace_back(std::vector<uint64_t>(config_schema.service[i].responses.size(), 0));
-            resp_throttled_till_now.emplace_back(std::vector<uint64_t>(config_schema.service[i].responses.size(), 0));
+            resp_sent_till_now.emplace_back(std::vector<uint64_t>(respStats[i].size(), 0));
+            resp_throttled_till_now.emplace_back(std::vector<uint64_t>(respStats[i].size(), 0));
+            lua_calls_till_now.emplace_back(std::vector<uint64_t>(respStats[i].size(), 0));
+            lua_time_us_till_now.emplace_back(std::vector<uint64_t>(respStats[i].size(), 0));
+            upstream_errors_till_now.emplace_back(std::vector<uint64_t>(respStats[i].size(), 0));
         }
+        uint64_t total_upstream_errors_till_now = 0;
         uint64_t total_req_received_till_now = 0;
         uint64_t total_resp_sent_till_now = 0;
         uint64_t total_resp_throttled_till_now = 0;
@@ -480,12 +941,14 @@ void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
             std::this_thread::sleep_for(std::chrono::seconds(1));
             if (counter % 10 == 0)
             {
-                SStream << "req-name,   resp-name,   msg-total,   throttled-total, rps,      throttled-rps" << std::endl;
+                SStream << "req-name,   resp-name,   msg-total,   throttled-total, rps,      throttled-rps, lua-us, upstream-errors" << std::endl;
             }
             counter++;
 
             auto resp_sent_till_last = resp_sent_till_now;
             auto resp_throttled_till_last = resp_throttled_till_now;
+            auto lua_calls_till_last = lua_calls_till_now;
+            auto lua_time_us_till_last = lua_time_us_till_now;
 
             auto total_req_received_till_last = total_req_received_till_now;
             auto total_resp_sent_till_last = total_resp_sent_till_now;
@@ -496,11 +959,12 @@ void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
             total_req_received_till_now = std::accumulate(totalReqsReceived.begin(), totalReqsReceived.end(), 0);
             total_unmatched_responses_till_now = std::accumulate(totalUnMatchedResponses.begin(), totalUnMatchedResponses.end(), 0);
             total_resp_sent_till_now = 0;
+            total_upstream_errors_till_now = 0;
             total_resp_throttled_till_now = 0;
 
             for (size_t req_index = 0; req_index < config_schema.service.size(); req_index++)
             {
-                for (size_t resp_index = 0; resp_index < config_schema.service[req_index].responses.size(); resp_index++)
+                for (size_t resp_index = 0; resp_index < respStats[req_index].size(); resp_index++)
                 {
                     resp_sent_till_now[req_index][resp_index] =
                         std::accumulate(respStats[req_index][resp_index].begin(),
@@ -520,6 +984,16 @@ void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
                         return sum + val.response_throttled;
                     }
                                        );
+                    lua_calls_till_now[req_index][resp_index] = 0;
+                    lua_time_us_till_now[req_index][resp_index] = 0;
+                    upstream_errors_till_now[req_index][resp_index] = 0;
+                    for (auto& thread_stats : respStats[req_index][resp_index])
+                    {
+                        lua_calls_till_now[req_index][resp_index] += thread_stats.lua_calls;
+                        lua_time_us_till_now[req_index][resp_index] += thread_stats.lua_time_us;
+                        upstream_errors_till_now[req_index][resp_index] += thread_stats.upstream_errors;
+                    }
+                    total_upstream_errors_till_now += upstream_errors_till_now[req_index][resp_index];
                     total_resp_sent_till_now += resp_sent_till_now[req_index][resp_index];
                     total_resp_throttled_till_now += resp_throttled_till_now[req_index][resp_index];
                 }
@@ -539,16 +1013,21 @@ void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
 
             for (size_t req_index = 0; req_index < config_schema.service.size(); req_index++)
             {
-                for (size_t resp_index = 0; resp_index < config_schema.service[req_index].responses.size(); resp_index++)
+                for (size_t resp_index = 0; resp_index < respStats[req_index].size(); resp_index++)
                 {
+                    // mean time of customize_response in the period
+                    auto lua_calls = lua_calls_till_now[req_index][resp_index] - lua_calls_till_last[req_index][resp_index];
+                    auto lua_time_us = lua_time_us_till_now[req_index][resp_index] - lua_time_us_till_last[req_index][resp_index];
                     SStream <<     std::setw(req_name_width) << config_schema.service[req_index].request.name
-                            << "," << std::setw(resp_name_width) << config_schema.service[req_index].responses[resp_index].name
+                            << "," << std::setw(resp_name_width) << get_resp_name(config_schema, req_index, resp_index)
                             << "," << std::setw(req_name_width) << resp_sent_till_now[req_index][resp_index]
                             << "," << std::setw(req_name_width) << resp_throttled_till_now[req_index][resp_index]
                             << "," << std::setw(req_name_width) << ((resp_sent_till_now[req_index][resp_index] -
                                                                      resp_sent_till_last[req_index][resp_index])*std::milli::den) / period_duration
                             << "," << std::setw(req_name_width) << ((resp_throttled_till_now[req_index][resp_index] -
                                                                      resp_throttled_till_last[req_index][resp_index])*std::milli::den) / period_duration
+                            << "," << std::setw(req_name_width) << (lua_calls ? std::to_string(lua_time_us / lua_calls) : "---")
+                            << "," << std::setw(req_name_width) << upstream_errors_till_now[req_index][resp_index]
                             << std::endl;
                 }
             }
@@ -560,6 +1039,8 @@ void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
                     period_duration
                     << "," << std::setw(req_name_width) << ((total_resp_throttled_till_now - total_resp_throttled_till_last)
                                                             *std::milli::den) / period_duration
+                    << "," << std::setw(req_name_width) << "---"
+                    << "," << std::setw(req_name_width) << total_upstream_errors_till_now
                     << std::endl;
             std::cout << SStream.str();
 
@@ -569,6 +1050,8 @@ void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
                     << "," << std::setw(req_name_width) << "---"
                     << "," << std::setw(req_name_width) << ((total_unmatched_responses_till_now - total_unmatched_responses_till_last)*std::milli::den) / period_duration
                     << "," << std::setw(req_name_width) << "---"
+                    << "," << std::setw(req_name_width) << "---"
+                    << "," << std::setw(req_name_width) << "---"
                     << std::endl;
             std::cout << SStream.str();
 
@@ -585,13 +1068,22 @@ void start_server(const std::string& config_file_name, bool start_stats_thread,
     std::ifstream buffer(config_file_name);
     std::string jsonStr((std::istreambuf_iterator<char>(buffer)), std::istreambuf_iterator<char>());
 
+    H2Server_Config_Schema schema;
     staticjson::ParseStatus result;
-    if (!staticjson::from_json_string(jsonStr.c_str(), &config_schema, &result))
+    if (!staticjson::from_json_string(jsonStr.c_str(), &schema, &result))
     {
         std::cout << "error reading config file:" << result.description() << std::endl;
         exit(1);
     }
 
+    start_server(schema, start_stats_thread, init_complete_callback);
+}
+
+void start_server(const H2Server_Config_Schema& schema, bool start_stats_thread,
+                  std::function<void(void)> init_complete_callback)
+{
+    config_schema = schema;
+
     if (config_schema.verbose)
     {
         std::cerr << "Configuration dump:" << std::endl << staticjson::to_pretty_json_string(config_schema)
@@ -617,7 +1109,9 @@ void start_server(const std::string& config_file_name, bool start_stats_thread,
     static std::vector<std::vector<std::vector<ResponseStatistics>>> respStats;
     for (size_t req_idx = 0; req_idx < config_schema.service.size(); req_idx++)
     {
-        std::vector<std::vector<ResponseStatistics>> perServiceStats(config_schema.service[req_idx].responses.size(),
+        auto& service = config_schema.service[req_idx];
+        std::vector<std::vector<ResponseStatistics>> perServiceStats(service.responses.size() +
+                                                                     (service.proxy.upstreams.size() ? 1 : 0),
                                                                      std::vector<ResponseStatistics>(num_threads));
         respStats.push_back(perServiceStats);
     }
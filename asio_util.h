@@ -22,11 +22,17 @@
 #include "H2Server_Config_Schema.h"
 #include "H2Server_Request.h"
 #include "H2Server.h"
+#include "H2Server_Timer_Wheel.h"
 
 struct ResponseStatistics
 {
     uint64_t response_sent = 0;
     uint64_t response_throttled = 0;
+    // for the Proxy of a service: upstream not reachable, no response in time, or a response cut short
+    uint64_t upstream_errors = 0;
+    // customize_response of luaScript, counted by the server thread, for offloaded calls too
+    uint64_t lua_calls = 0;
+    uint64_t lua_time_us = 0;
 };
 
 void start_statistic_thread(std::vector<uint64_t>& totalReqsReceived,
@@ -40,6 +46,8 @@ size_t get_req_name_max_size(const H2Server_Config_Schema& config_schema);
 
 size_t get_resp_name_max_size(const H2Server_Config_Schema& config_schema);
 
+std::string get_resp_name(const H2Server_Config_Schema& config_schema, size_t req_index, size_t resp_index);
+
 void send_response(uint32_t status_code,
                    std::map<std::string, std::string>& resp_headers,
                    std::string& resp_payload,
@@ -49,6 +57,18 @@ void send_response(uint32_t status_code,
                    uint64_t& matchedResponsesSent
                   );
 
+// sends the response right away, or after the delay of matched_response, from the timer wheel of the calling server thread
+void send_or_delay_response(const H2Server_Response* matched_response,
+                            boost::asio::io_service& ios,
+                            uint32_t status_code,
+                            std::map<std::string, std::string>& resp_headers,
+                            std::string& resp_payload,
+                            std::map<std::string, std::string>& trailer_headers,
+                            uint64_t handler_id,
+                            int32_t stream_id,
+                            uint64_t& matchedResponsesSent
+                           );
+
 void send_response_from_another_thread(boost::asio::io_service* target_io_service,
                                        uint64_t handler_id,
                                        int32_t stream_id,
@@ -57,7 +77,19 @@ void send_response_from_another_thread(boost::asio::io_service* target_io_servic
                                        std::map<std::string, std::string>& trailer_headers
                                       );
 
+// forwards the request to an upstream of proxy, over the connections of the calling server thread to the upstreams,
+// and relays the response of the upstream back as it comes; proxy_stats counts what is sent back, and the upstream errors
+void forward_request_to_upstream(H2Server_Proxy& proxy,
+                                 H2Server_Request_Message& msg,
+                                 const std::string& req_payload,
+                                 boost::asio::io_service& ios,
+                                 uint64_t handler_id,
+                                 int32_t stream_id,
+                                 ResponseStatistics& proxy_stats);
+
+// runs on a lua-offload thread, with a Lua state of that thread, then sends the response from the server thread of ios
 void update_response_with_lua(const H2Server_Response* matched_response,
+                              size_t req_index,
                               std::multimap<std::string, std::string>& req_headers,
                               std::string& req_payload,
                               std::map<std::string, std::string>& resp_headers,
@@ -66,7 +98,7 @@ void update_response_with_lua(const H2Server_Response* matched_response,
                               boost::asio::io_service* ios,
                               uint64_t handler_id,
                               int32_t stream_id,
-                              uint64_t& matchedResponsesSent);
+                              ResponseStatistics& responseStatistics);
 
 void asio_svr_entry(const H2Server_Config_Schema& config_schema,
                          std::vector<uint64_t>& totalReqsReceived,
@@ -85,6 +117,10 @@ void install_request_callback(const std::string& bootstrap_thread_id, size_t ser
 /* this will block */
 void start_server(const std::string& config_file_name, bool start_stats_thread, std::function<void(void)> init_complete_callback);
 
+/* this will block */
+void start_server(const H2Server_Config_Schema& schema, bool start_stats_thread,
+                  std::function<void(void)> init_complete_callback);
+
 void stop_server(const std::string& thread_id);
 
 #endif
@@ -1,6 +1,8 @@
 #ifdef _WINDOWS
 #include <sdkddkver.h>
 #endif
+#include <iomanip>
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/asio/ssl.hpp>
@@ -8,18 +10,75 @@
 #include "base_worker.h"
 #include "asio_client_connection.h"
 #include "asio_worker.h"
+#include "h2load_dns_cache.h"
 #include "h2load_Config.h"
 
 namespace h2load
 {
 
+#ifdef USE_IO_URING
+namespace
+{
+// receive buffers of the io_uring buffer ring of a worker, 16K each
+const size_t uring_buffers_per_connection = 4;
+const size_t min_uring_buffers = 64;
+const size_t max_uring_buffers = 4096;
+}
+#endif
 
 void asio_worker::run_event_loop()
 {
     my_thread_id = std::this_thread::get_id();
+    if (config->json_config_schema.busy_poll_spin_time_us)
+    {
+        run_busy_poll_event_loop(std::chrono::microseconds(config->json_config_schema.busy_poll_spin_time_us));
+        return;
+    }
     io_context.run();
 }
 
+void asio_worker::run_busy_poll_event_loop(std::chrono::microseconds spin_budget)
+{
+    auto loop_start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration spin_time(0);
+    for (;;)
+    {
+        if (io_context.poll())
+        {
+            continue;
+        }
+        auto spin_start = std::chrono::steady_clock::now();
+        auto now = spin_start;
+        size_t handlers_run = 0;
+        while (!handlers_run && !io_context.stopped() && now - spin_start < spin_budget)
+        {
+            auto poll_start = now;
+            handlers_run = io_context.poll();
+            now = std::chrono::steady_clock::now();
+            if (!handlers_run)
+            {
+                spin_time += (now - poll_start);
+            }
+        }
+        // spinning is not work, it is left out of the busy ratio of the worker telemetry
+        telemetry.spin_time_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(spin_time).count(),
+                                     std::memory_order_relaxed);
+        if (handlers_run)
+        {
+            continue;
+        }
+        // nothing within the spin budget, block until the next event
+        if (io_context.stopped() || !io_context.run_one())
+        {
+            break;
+        }
+    }
+    auto loop_time = std::chrono::steady_clock::now() - loop_start;
+    auto spin_fraction = loop_time.count() ? (double)spin_time.count() / loop_time.count() : 0;
+    std::cerr << "worker " << id << " spent " << std::fixed << std::setprecision(2) << spin_fraction * 100
+              << "% of event loop time busy polling" << std::endl;
+}
+
 std::thread::id asio_worker::get_thread_id()
 {
     return my_thread_id;
@@ -38,17 +97,64 @@ std::shared_ptr<base_client> asio_worker::create_new_client(size_t req_todo)
 
 
 asio_worker::asio_worker(uint32_t id, size_t nreq_todo, size_t nclients,
-                         size_t rate, size_t max_samples, Config* config):
+                         size_t rate, size_t max_samples, Config* config,
+                         boost::asio::io_service* external_io_context):
     base_worker(id, nreq_todo, nclients, rate, max_samples, config),
+    own_io_context(external_io_context ? nullptr : new boost::asio::io_service()),
+    io_context(external_io_context ? *external_io_context : *own_io_context),
     rate_mode_period_timer(io_context),
     warmup_timer(io_context),
     duration_timer(io_context),
     tick_timer(io_context),
+    telemetry_timer(io_context),
     ssl_ctx(boost::asio::ssl::context::sslv23),
-    async_resolver(io_context)
+    shared_input_buffer(16 * 1024, 0)
 {
     setup_SSL_CTX(ssl_ctx.native_handle(), *config);
+    if (external_io_context)
+    {
+        // run_event_loop is not called, the caller runs the loop on this thread
+        my_thread_id = std::this_thread::get_id();
+    }
+#ifdef USE_IO_URING
+    if (config->json_config_schema.io_engine == io_engine_io_uring)
+    {
+        // a receive buffer goes back to the kernel as soon as its data is read, so a few per connection are enough
+        size_t connections = nclients;
+        if (config->load_share_policy != Config::LOAD_SHARE_CONNECTIONS && config->load_share_group.size())
+        {
+            connections *= config->load_share_group.size();
+        }
+        auto buffer_count = std::min(std::max(connections * uring_buffers_per_connection, min_uring_buffers),
+                                     max_uring_buffers);
+        uring_engine.reset(new io_uring_engine(io_context));
+        if (!uring_engine->init(4096, buffer_count))
+        {
+            std::cerr << "io_uring not usable, worker " << id << " falls back to asio" << std::endl;
+            uring_engine.reset();
+        }
+    }
+#endif
+}
+
+asio_worker::~asio_worker()
+{
+    // script threads post to io_context
+    stop_lua_script_pool();
+    // and so does the DNS_Cache
+    DNS_Cache::instance().cancel(&io_context);
+#ifdef USE_IO_URING
+    // clients cancel their io_uring operations when destroyed, so they have to go before the engine does
+    managed_clients.clear();
+#endif
+}
+
+#ifdef USE_IO_URING
+io_uring_engine* asio_worker::get_io_uring_engine()
+{
+    return uring_engine.get();
 }
+#endif
 
 bool asio_worker::timer_common_check(boost::asio::deadline_timer& timer, const boost::system::error_code& ec,
                                      void (asio_worker::*handler)(const boost::system::error_code&))
@@ -99,16 +205,47 @@ void asio_worker::stop_tick_timer()
     tick_timer.cancel();
 }
 
+void asio_worker::start_telemetry_timer()
+{
+    next_telemetry_sample = std::chrono::steady_clock::now() + telemetry_interval;
+    telemetry_timer.expires_from_now(boost::posix_time::millisec(telemetry_interval.count()));
+    telemetry_timer.async_wait
+    (
+        [this](const boost::system::error_code & ec)
+    {
+        handle_telemetry_timer_timeout(ec);
+    });
+}
+
+void asio_worker::handle_telemetry_timer_timeout(const boost::system::error_code& ec)
+{
+    if (!timer_common_check(telemetry_timer, ec, &asio_worker::handle_telemetry_timer_timeout))
+    {
+        return;
+    }
+    if (telemetry_timeout_handler())
+    {
+        start_telemetry_timer();
+    }
+}
+
 void asio_worker::stop_rate_mode_period_timer()
 {
     rate_mode_period_timer.cancel();
 }
 
+void asio_worker::post_to_worker_thread(std::function<void(void)> handler)
+{
+    io_context.post(std::move(handler));
+}
+
 void asio_worker::prepare_worker_stop()
 {
     stop_tick_timer();
+    telemetry_timer.cancel();
+    // a pending name resolution holds io_context::work
+    DNS_Cache::instance().cancel(&io_context);
     stop_all_clients();
-    async_resolver.cancel();
 }
 
 void asio_worker::handle_tick_timer_timeout(const boost::system::error_code & ec)
@@ -222,21 +359,22 @@ void asio_worker::process_user_timers()
     }
 }
 
-void asio_worker::resolve_hostname(const std::string& hostname, const std::function<void(std::vector<std::string>&)>& cb_function)
+void asio_worker::resolve_hostname(const std::string& hostname, const std::function<void(std::vector<std::string>&)>& cb_function,
+                                   std::chrono::milliseconds max_age)
 {
-    auto resolve_handler = [cb_function](const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::results_type results)
+    auto resolve_handler = [cb_function](const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::iterator results)
     {
         std::vector<std::string> resolved_addresses;
         if (!ec)
         {
-            for (auto it = results.begin(); it != results.end(); it++)
+            for (boost::asio::ip::tcp::resolver::iterator end; results != end; results++)
             {
-                resolved_addresses.push_back(it->endpoint().address().to_string());
+                resolved_addresses.push_back(results->endpoint().address().to_string());
             }
         }
         cb_function(resolved_addresses);
     };
-    async_resolver.async_resolve(hostname, "", resolve_handler);
+    DNS_Cache::instance().resolve(io_context, hostname, "", resolve_handler, max_age);
 }
 
 }
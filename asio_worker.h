@@ -5,12 +5,16 @@
 #include <sdkddkver.h>
 #endif
 #include <chrono>
+#include <memory>
 
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/asio/ssl.hpp>
 
 #include "base_worker.h"
+#ifdef USE_IO_URING
+#include "io_uring_engine.h"
+#endif
 
 namespace h2load
 {
@@ -19,11 +23,18 @@ class asio_worker: public h2load::base_worker, private boost::noncopyable
 {
 public:
 
+    // with external_io_context, the worker runs on the event loop of its caller instead of a thread of its own
     asio_worker(uint32_t id, size_t nreq_todo, size_t nclients,
-                size_t rate, size_t max_samples, Config* config);
+                size_t rate, size_t max_samples, Config* config,
+                boost::asio::io_service* external_io_context = nullptr);
+
+    virtual ~asio_worker();
 
     virtual void run_event_loop();
 
+    // polls for up to spin_budget before blocking, see busy-poll-spin-time-us
+    void run_busy_poll_event_loop(std::chrono::microseconds spin_budget);
+
     virtual std::shared_ptr<base_client> create_new_client(size_t req_todo);
 
     bool timer_common_check(boost::asio::deadline_timer & timer, const boost::system::error_code & ec,
@@ -49,6 +60,12 @@ public:
 
     virtual void start_graceful_stop_timer();
 
+    virtual void start_telemetry_timer();
+
+    void handle_telemetry_timer_timeout(const boost::system::error_code& ec);
+
+    virtual void post_to_worker_thread(std::function<void(void)> handler);
+
     boost::asio::io_service& get_io_context();
 
     void enqueue_user_timer(uint64_t ms_to_expire, std::function<void(void)>);
@@ -63,21 +80,39 @@ public:
 
     std::thread::id get_thread_id();
 
-    void resolve_hostname(const std::string& hostname, const std::function<void(std::vector<std::string>&)>& cb_function);
+    // served from the process wide DNS_Cache; max_age, if non-zero, bounds the age of a cached answer
+    void resolve_hostname(const std::string& hostname, const std::function<void(std::vector<std::string>&)>& cb_function,
+                          std::chrono::milliseconds max_age = std::chrono::milliseconds(0));
+
+    std::vector<uint8_t>& get_shared_input_buffer()
+    {
+        return shared_input_buffer;
+    }
+
+#ifdef USE_IO_URING
+    // nullptr if io-engine is not io_uring, or io_uring is not usable on this kernel
+    io_uring_engine* get_io_uring_engine();
+#endif
 
 private:
 
     void process_user_timers();
 
-    boost::asio::io_service io_context;
+    std::unique_ptr<boost::asio::io_service> own_io_context;
+    boost::asio::io_service& io_context;
     boost::asio::deadline_timer rate_mode_period_timer;
     boost::asio::deadline_timer warmup_timer;
     boost::asio::deadline_timer duration_timer;
     boost::asio::deadline_timer tick_timer;
+    boost::asio::deadline_timer telemetry_timer;
     boost::asio::ssl::context ssl_ctx;
     std::multimap<std::chrono::steady_clock::time_point, std::function<void(void)>> user_timers;
     std::thread::id my_thread_id;
-    boost::asio::ip::tcp::resolver async_resolver;
+    // read buffer of all cleartext and kernel-tls connections of this worker, see asio_client_connection
+    std::vector<uint8_t> shared_input_buffer;
+#ifdef USE_IO_URING
+    std::unique_ptr<io_uring_engine> uring_engine;
+#endif
 
 };
 
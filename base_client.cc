@@ -20,6 +20,7 @@
 
 #include "h2load_utils.h"
 #include "h2load_lua.h"
+#include "h2load_lua_script_pool.h"
 
 
 namespace h2load
@@ -55,14 +56,20 @@ base_client::base_client(uint32_t id, base_worker* wrker, size_t req_todo, Confi
     rps(conf->rps),
     this_client_id(),
     rps_duration_started(),
-    ssl(nullptr)
+    ssl(nullptr),
+    script_jobs_in_flight(0),
+    script_job_guard(std::make_shared<bool>(true)),
+    load_share_host_index(conf->load_share_group.size()),
+    outstanding_in_host_stats(0),
+    latency_ewma_us(0),
+    load_share_cursor(0),
+    last_load_share_reconnect(),
+    concurrency_limit(1)
 {
     init_req_left();
 
     slice_user_id();
 
-    init_lua_states();
-
     update_this_in_dest_client_map();
 
 }
@@ -124,6 +131,12 @@ uint64_t base_client::get_total_pending_streams()
     }
 }
 
+size_t base_client::get_max_concurrent_streams()
+{
+    auto max_streams = session->max_concurrent_streams();
+    return config->json_config_schema.adaptive_concurrency ? std::min(max_streams, concurrency_limit) : max_streams;
+}
+
 void base_client::try_new_connection()
 {
     new_connection_requested = true;
@@ -139,82 +152,40 @@ void base_client::record_ttfb()
     cstat.ttfb = std::chrono::steady_clock::now();
 }
 
-void base_client::log_failed_request(const h2load::Config& config, const h2load::Request_Data& failed_req,
-                                     int32_t stream_id)
-{
-    if (config.json_config_schema.failed_request_log_file.empty())
-    {
-        return;
-    }
-
-    auto req_stat = get_req_stat(stream_id);
-    if (!req_stat)
-    {
-        return;
-    }
-
-    static boost::asio::io_service work_offload_io_service;
-    static boost::thread_group work_offload_thread_pool;
-    static boost::asio::io_service::work work(work_offload_io_service);
-    auto create_log_thread = []()
-    {
-        work_offload_thread_pool.create_thread(boost::bind(&boost::asio::io_service::run, &work_offload_io_service));
-        return true;
-    };
-    static bool dummyCode = create_log_thread();
-    static std::ofstream log_file(config.json_config_schema.failed_request_log_file);
-
-    std::stringstream ss;
-
-    auto start_c = std::chrono::system_clock::to_time_t(req_stat->request_wall_time);
-    ss << "start timestamp: " << std::put_time(std::localtime(&start_c), "%F %T") << std::endl;
-
-    auto now = std::chrono::system_clock::now();
-    auto now_c = std::chrono::system_clock::to_time_t(now);
-    ss << "current time: " << std::put_time(std::localtime(&now_c), "%F %T") << std::endl;
-
-    auto stream_response_interval_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                           req_stat->stream_close_time - req_stat->request_time).count();
-    ss << "duration(ms): " << stream_response_interval_ms << std::endl;
-
-    ss << failed_req;
-
-
-    auto log_func = [](const std::string & msg)
-    {
-        log_file << msg;
-        log_file << std::endl;
-    };
-    auto log_routine = std::bind(log_func, ss.str());
-
-    work_offload_io_service.post(log_routine);
-}
-
-bool base_client::validate_response_with_lua(lua_State* L, const Request_Data& finished_request)
+bool base_client::validate_response_with_lua(lua_State* L, const Request_Data& finished_request, bool zero_copy)
 {
     lua_getglobal(L, validate_response);
     bool retCode = true;
     if (lua_isfunction(L, -1))
     {
-        lua_createtable(L, 0, std::accumulate(finished_request.resp_headers.begin(),
-                                              finished_request.resp_headers.end(),
-                                              0,
-                                              [](uint64_t sum, const std::map<std::string, std::string, ci_less>& val)
+        int nargs = 1;
+        if (zero_copy)
         {
-            return sum + val.size();
-        }));
-        for (auto& header_map : finished_request.resp_headers)
+            push_request_data_handle(L, finished_request);
+        }
+        else
         {
-            for (auto& header : header_map)
+            lua_createtable(L, 0, std::accumulate(finished_request.resp_headers.begin(),
+                                                  finished_request.resp_headers.end(),
+                                                  0,
+                                                  [](uint64_t sum, const std::map<std::string, std::string, ci_less>& val)
+            {
+                return sum + val.size();
+            }));
+            for (auto& header_map : finished_request.resp_headers)
             {
-                lua_pushlstring(L, header.first.c_str(), header.first.size());
-                lua_pushlstring(L, header.second.c_str(), header.second.size());
-                lua_rawset(L, -3);
+                for (auto& header : header_map)
+                {
+                    lua_pushlstring(L, header.first.c_str(), header.first.size());
+                    lua_pushlstring(L, header.second.c_str(), header.second.size());
+                    lua_rawset(L, -3);
+                }
             }
-        }
 
-        lua_pushlstring(L, finished_request.resp_payload.c_str(), finished_request.resp_payload.size());
-        lua_pcall(L, 2, 1, 0);
+            lua_pushlstring(L, finished_request.resp_payload.c_str(), finished_request.resp_payload.size());
+            nargs = 2;
+        }
+        lua_pcall(L, nargs, 1, 0);
         int top = lua_gettop(L);
         for (int i = 0; i < top; i++)
         {
@@ -453,41 +424,19 @@ void base_client::init_connection_targert()
         }
     }
 
-    if (is_controller_client() && (config->no_tls_proto != Config::PROTO_HTTP1_1) &&
-        config->json_config_schema.load_share_hosts.size())
+    // the group is left empty for HTTP/1.1, see init_load_share_group
+    if (is_controller_client() && config->load_share_group.size())
     {
-        auto init_hosts = [this]()
+        auto& group = config->load_share_group;
+        auto start_index = config->load_share_schedule[this_client_id.my_id % config->load_share_schedule.size()];
+        authority = group[start_index].authority;
+        clear_default_addr_info();
+        for (size_t index = 0; index < group.size(); index++)
         {
-            std::vector<std::string> hosts;
-            for (auto& host_item : config->json_config_schema.load_share_hosts)
+            if (index != start_index)
             {
-                std::string host = host_item.host;
-                if (is_it_an_ipv6_address(host))
-                {
-                    std::string buffer = "[";
-                    buffer.append(host).append("]");
-                    host = buffer;
-                }
-
-                hosts.push_back(host);
-                if (host_item.port)
-                {
-                    hosts.back().append(":").append(std::to_string(host_item.port));
-                }
+                candidate_addresses.push_back(group[index].authority);
             }
-            if (std::find(std::begin(hosts), std::end(hosts), authority) == std::end(hosts))
-            {
-                hosts.push_back(authority);
-            }
-            return hosts;
-        };
-        static std::vector<std::string> hosts = init_hosts();
-        auto startIndex = this_client_id.my_id % hosts.size();
-        authority = hosts[startIndex];
-        clear_default_addr_info();
-        for (auto count = 0; count < hosts.size() - 1; count++)
-        {
-            candidate_addresses.push_back(hosts[(++startIndex) % hosts.size()]);
         }
         std::random_device random_device;
         std::mt19937 generator(random_device());
@@ -503,6 +452,55 @@ void base_client::set_prefered_authority(const std::string& authority)
     preferred_authority = authority;
 }
 
+Host_Stats* base_client::get_host_stats()
+{
+    return load_share_host_index < worker->host_stats.size() ? worker->host_stats[load_share_host_index].get() : nullptr;
+}
+
+void base_client::update_host_outstanding()
+{
+    auto host_stats = get_host_stats();
+    if (host_stats)
+    {
+        host_stats->outstanding += streams.size();
+        host_stats->outstanding -= outstanding_in_host_stats;
+    }
+    outstanding_in_host_stats = streams.size();
+}
+
+void base_client::record_load_share_response(int32_t stream_id, bool success)
+{
+    auto host_stats = get_host_stats();
+    auto stream = streams.find(stream_id);
+    if (!host_stats || stream == streams.end() ||
+        stream->second.req_stat.request_time == std::chrono::steady_clock::time_point())
+    {
+        return;
+    }
+    auto& req_stat = stream->second.req_stat;
+    uint64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(req_stat.stream_close_time -
+                                                                                req_stat.request_time).count();
+    // status_success is -1 while a script thread validates the response
+    bool failed = !success || stream->second.status_success == 0;
+    if (config->load_share_policy == Config::LOAD_SHARE_LEAST_LATENCY)
+    {
+        // a failure counts as slow as a stream timeout, so a host failing fast does not draw the load
+        const double alpha = 0.1;
+        double sample = failed ? std::max(latency_us, static_cast<uint64_t>(config->json_config_schema.stream_timeout_in_ms) *
+                                          1000) : latency_us;
+        latency_ewma_us = latency_ewma_us > 0 ? latency_ewma_us + alpha * (sample - latency_ewma_us) : sample;
+    }
+    if (stream->second.statistics_eligible)
+    {
+        ++host_stats->req_done;
+        if (failed)
+        {
+            ++host_stats->req_error;
+        }
+        host_stats->record_latency(latency_us);
+    }
+}
+
 void base_client::on_status_code(int32_t stream_id, uint16_t status)
 {
     auto request_data = requests_awaiting_response.find(stream_id);
@@ -551,20 +549,20 @@ bool base_client::should_reconnect_on_disconnect()
     return false;
 }
 
-void base_client::inc_status_counter_and_validate_response(int32_t stream_id)
+bool base_client::inc_status_counter_and_validate_response(int32_t stream_id)
 {
     uint16_t status = 0;
     auto itr = streams.find(stream_id);
     if (itr == std::end(streams))
     {
-        return;
+        return false;
     }
     auto& stream = (*itr).second;
 
     if (!stream.statistics_eligible)
     {
         stream.status_success = 1;
-        return;
+        return false;
     }
 
     status = stream.req_stat.status;
@@ -583,6 +581,7 @@ void base_client::inc_status_counter_and_validate_response(int32_t stream_id)
         stream.status_success = 0;
     }
 
+    auto failure_reason = FAILURE_STATUS_CODE;
     auto request_data = requests_awaiting_response.find(stream_id);
     if (request_data != requests_awaiting_response.end())
     {
@@ -597,11 +596,18 @@ void base_client::inc_status_counter_and_validate_response(int32_t stream_id)
         }
         if (config->json_config_schema.scenarios[scenario_index].requests[request_index].validate_response_function_present)
         {
-            stream.status_success = validate_response_with_lua(lua_states[scenario_index][request_index], request_data->second);
+            if (config->json_config_schema.lua_script_threads)
+            {
+                return true;
+            }
+            stream.status_success = validate_response_with_lua(get_lua_state(scenario_index, request_index),
+                                                               request_data->second, config->json_config_schema.lua_zero_copy);
+            failure_reason = FAILURE_VALIDATE_RESPONSE;
         }
         else if (config->json_config_schema.scenarios[scenario_index].requests[request_index].response_match_rules.size())
         {
             auto& request = config->json_config_schema.scenarios[scenario_index].requests[request_index];
+            failure_reason = FAILURE_RESPONSE_MATCH;
             bool run_match_rule = true;
             bool matched = false;
             rapidjson::Document json_payload;
@@ -645,10 +651,11 @@ void base_client::inc_status_counter_and_validate_response(int32_t stream_id)
             }
         }
     }
-    if (stream.status_success == 0)
+    if (stream.status_success == 0 && request_data != requests_awaiting_response.end())
     {
-        log_failed_request(*config, request_data->second, stream_id);
+        worker->failure_log.record(get_error_class(failure_reason, status), request_data->second, stream.req_stat);
     }
+    return false;
 }
 
 
@@ -768,17 +775,35 @@ void base_client::final_cleanup()
     {
         for (auto& L : V)
         {
-            lua_close(L);
+            if (L)
+            {
+                lua_close(L);
+            }
         }
     }
     lua_states.clear();
 
+    auto host_stats = get_host_stats();
+    if (host_stats)
+    {
+        if (CLIENT_CONNECTED == state)
+        {
+            --host_stats->connections;
+        }
+        host_stats->outstanding -= outstanding_in_host_stats;
+    }
+
     std::string dest = schema;
     dest.append("://").append(authority);
     if (parent_client && parent_client->dest_clients.count(dest) && parent_client->dest_clients[dest] == this)
     {
         parent_client->dest_clients.erase(dest);
     }
+    if (parent_client)
+    {
+        std::replace(parent_client->load_share_clients.begin(), parent_client->load_share_clients.end(), this,
+                     static_cast<base_client*>(nullptr));
+    }
 }
 
 void base_client::cleanup_due_to_disconnect()
@@ -786,6 +811,11 @@ void base_client::cleanup_due_to_disconnect()
     if (CLIENT_CONNECTED == state)
     {
         std::cerr << "===============disconnected from " << authority << "===============" << std::endl;
+        auto host_stats = get_host_stats();
+        if (host_stats)
+        {
+            --host_stats->connections;
+        }
     }
 
     worker->get_client_ids().erase(this->get_client_unique_id());
@@ -796,6 +826,7 @@ void base_client::cleanup_due_to_disconnect()
 
     record_client_end_time();
     streams.clear();
+    update_host_outstanding();
     session.reset();
     state = CLIENT_IDLE;
 
@@ -867,16 +898,20 @@ bool base_client::prepare_next_request(Request_Data& finished_request)
 
     auto& request_template = scenario.requests[curr_index];
     new_request.user_id = finished_request.user_id;
+    capture_variable_values(config, finished_request, new_request);
     populate_request_from_config_template(new_request, scenario_index, curr_index);
 
     switch (request_template.uri.uri_action)
     {
         case INPUT_URI:
         {
-            new_request.string_collection.emplace_back(reassemble_str_with_variable(config, scenario_index, curr_index,
-                                                                                    request_template.tokenized_path,
-                                                                                    new_request.user_id));
-            new_request.path = &(new_request.string_collection.back());
+            new_request.path = request_template.path_template.literal();
+            if (!new_request.path)
+            {
+                new_request.string_collection.emplace_back();
+                render_request_template(config, request_template.path_template, new_request, new_request.string_collection.back());
+                new_request.path = &(new_request.string_collection.back());
+            }
 
             break;
         }
@@ -891,56 +926,17 @@ bool base_client::prepare_next_request(Request_Data& finished_request)
             break;
         }
         case FROM_RESPONSE_HEADER:
+        case FROM_JSON_POINTER:
+        case FROM_X_PATH:
         {
-            std::string* uri_header_value = nullptr;
-            for (auto& header_map : finished_request.resp_headers)
-            {
-                auto header = header_map.find(request_template.uri.input);
-                if (header != header_map.end())
-                {
-                    uri_header_value = &header->second;
-                }
-            }
-            if (uri_header_value && uri_header_value->size())
-            {
-                http_parser_url u {};
-                if (http_parser_parse_url(uri_header_value->c_str(), uri_header_value->size(), 0, &u) != 0)
-                {
-                    std::cerr << "abort whole scenario sequence, as invalid URI found in header: " << *uri_header_value << std::endl;
-                    return false;
-                }
-                else
-                {
-                    new_request.string_collection.emplace_back(get_reqline(uri_header_value->c_str(), u));
-                    new_request.path = &(new_request.string_collection.back());
-                    if (util::has_uri_field(u, UF_SCHEMA) && util::has_uri_field(u, UF_HOST))
-                    {
-                        new_request.string_collection.emplace_back(util::get_uri_field(uri_header_value->c_str(), u, UF_SCHEMA).str());
-                        util::inp_strlower(new_request.string_collection.back());
-                        new_request.schema = &(new_request.string_collection.back());
-                        new_request.string_collection.emplace_back(util::get_uri_field(uri_header_value->c_str(), u, UF_HOST).str());
-                        util::inp_strlower(new_request.string_collection.back());
-                        if (util::has_uri_field(u, UF_PORT))
-                        {
-                            new_request.string_collection.back().append(":").append(util::utos(u.port));
-                        }
-                        new_request.authority = &(new_request.string_collection.back());
-                    }
-                    else
-                    {
-                        new_request.string_collection.emplace_back(*finished_request.schema);
-                        new_request.schema = &(new_request.string_collection.back());
-                        new_request.string_collection.emplace_back(*finished_request.authority);
-                        new_request.authority = &(new_request.string_collection.back());
-                    }
-                }
-            }
-            else
+            std::string extracted_value;
+            if (!extract_value_for_next_request(request_template, finished_request, extracted_value))
             {
                 if (config->verbose)
                 {
                     std::cout << "response status code:" << finished_request.status_code << std::endl;
-                    std::cerr << "abort whole scenario sequence, as header not found: " << request_template.uri.input << std::endl;
+                    std::cerr << "abort whole scenario sequence, as value not found with " << request_template.uri.typeOfAction
+                              << ": " << request_template.uri.input << std::endl;
                     for (auto& header_map : finished_request.resp_headers)
                     {
                         for (auto& header : header_map)
@@ -952,6 +948,20 @@ bool base_client::prepare_next_request(Request_Data& finished_request)
                 }
                 return false;
             }
+            if (request_template.uri.value_placeholder.size())
+            {
+                replace_value_placeholder(request_template, extracted_value, new_request);
+                std::string uri = request_template.uri.tokenized_uri_template[0];
+                for (size_t i = 1; i < request_template.uri.tokenized_uri_template.size(); i++)
+                {
+                    uri.append(extracted_value).append(request_template.uri.tokenized_uri_template[i]);
+                }
+                extracted_value = std::move(uri);
+            }
+            if (!update_request_uri(extracted_value, finished_request, new_request))
+            {
+                return false;
+            }
             break;
         }
         default:
@@ -968,9 +978,16 @@ bool base_client::prepare_next_request(Request_Data& finished_request)
         produce_request_cookie_header(new_request);
     }
 
+    if (request_template.make_request_function_present && config->json_config_schema.lua_script_threads)
+    {
+        offload_make_request(finished_request, std::move(new_request));
+        return true;
+    }
+
     if (request_template.luaScript.size())
     {
-        if (!update_request_with_lua(lua_states[scenario_index][curr_index], finished_request, new_request))
+        if (!update_request_with_lua(get_lua_state(scenario_index, curr_index), finished_request, new_request,
+                                     config->json_config_schema.lua_zero_copy))
         {
             return false; // lua script returns error or kills the request, abort this scenario
         }
@@ -983,6 +1000,99 @@ bool base_client::prepare_next_request(Request_Data& finished_request)
     return true;
 }
 
+bool base_client::extract_value_for_next_request(const Request& request_template,
+                                                 const Request_Data& finished_request,
+                                                 std::string& value)
+{
+    if (request_template.uri.uri_action == FROM_RESPONSE_HEADER)
+    {
+        const std::string* header_value = nullptr;
+        for (auto& header_map : finished_request.resp_headers)
+        {
+            auto header = header_map.find(request_template.uri.input);
+            if (header != header_map.end())
+            {
+                header_value = &header->second;
+            }
+        }
+        if (header_value)
+        {
+            value = *header_value;
+        }
+        return value.size();
+    }
+    return request_template.uri.value_extractor.extract(finished_request.resp_payload, value) && value.size();
+}
+
+bool base_client::update_request_uri(const std::string& uri, const Request_Data& finished_request,
+                                     Request_Data& new_request)
+{
+    http_parser_url u {};
+    if (http_parser_parse_url(uri.c_str(), uri.size(), 0, &u) != 0)
+    {
+        std::cerr << "abort whole scenario sequence, as invalid URI found: " << uri << std::endl;
+        return false;
+    }
+    new_request.string_collection.emplace_back(get_reqline(uri.c_str(), u));
+    new_request.path = &(new_request.string_collection.back());
+    if (util::has_uri_field(u, UF_SCHEMA) && util::has_uri_field(u, UF_HOST))
+    {
+        new_request.string_collection.emplace_back(util::get_uri_field(uri.c_str(), u, UF_SCHEMA).str());
+        util::inp_strlower(new_request.string_collection.back());
+        new_request.schema = &(new_request.string_collection.back());
+        new_request.string_collection.emplace_back(util::get_uri_field(uri.c_str(), u, UF_HOST).str());
+        util::inp_strlower(new_request.string_collection.back());
+        if (util::has_uri_field(u, UF_PORT))
+        {
+            new_request.string_collection.back().append(":").append(util::utos(u.port));
+        }
+        new_request.authority = &(new_request.string_collection.back());
+    }
+    else
+    {
+        new_request.string_collection.emplace_back(*finished_request.schema);
+        new_request.schema = &(new_request.string_collection.back());
+        new_request.string_collection.emplace_back(*finished_request.authority);
+        new_request.authority = &(new_request.string_collection.back());
+    }
+    return true;
+}
+
+void base_client::replace_value_placeholder(const Request& request_template, const std::string& value,
+                                            Request_Data& new_request)
+{
+    auto& placeholder = request_template.uri.value_placeholder;
+    auto replace_all = [&placeholder, &value](std::string & str)
+    {
+        size_t pos = str.find(placeholder);
+        while (pos != std::string::npos)
+        {
+            str.replace(pos, placeholder.size(), value);
+            pos = str.find(placeholder, pos + value.size());
+        }
+    };
+    if (request_template.payload_has_value_placeholder)
+    {
+        replace_all(*new_request.req_payload);
+    }
+    for (auto& header_name : request_template.headers_with_value_placeholder)
+    {
+        auto rendered = new_request.req_headers_of_individual.find(header_name);
+        if (rendered != new_request.req_headers_of_individual.end())
+        {
+            replace_all(rendered->second);
+            continue;
+        }
+        auto iter = request_template.headers_in_map.find(header_name);
+        if (iter != request_template.headers_in_map.end())
+        {
+            std::string header_value = iter->second;
+            replace_all(header_value);
+            new_request.req_headers_of_individual[header_name] = std::move(header_value);
+        }
+    }
+}
+
 void base_client::update_content_length(Request_Data& data)
 {
     if (data.req_payload->size())
@@ -1021,14 +1131,30 @@ void base_client::populate_request_from_config_template(Request_Data& new_reques
     new_request.method = &request_template.method;
     new_request.schema = &request_template.schema;
     new_request.authority = &request_template.authority;
-    new_request.string_collection.emplace_back(reassemble_str_with_variable(config, scenario_index,
-                                                                            index_in_config_template,
-                                                                            request_template.tokenized_payload,
-                                                                            new_request.user_id));
-    new_request.req_payload = &(new_request.string_collection.back());
+    // a payload with no variable is sent from the template itself, unless a value placeholder is to be replaced in it
+    auto payload_literal = request_template.payload_template.literal();
+    if (payload_literal && !request_template.payload_has_value_placeholder)
+    {
+        new_request.req_payload = payload_literal;
+    }
+    else
+    {
+        new_request.string_collection.emplace_back();
+        render_request_template(config, request_template.payload_template, new_request, new_request.string_collection.back());
+        new_request.req_payload = &(new_request.string_collection.back());
+    }
     new_request.req_headers_from_config = &request_template.headers_in_map;
+    for (auto& header_template : request_template.header_templates)
+    {
+        auto& header_value = new_request.req_headers_of_individual[header_template.first];
+        header_value.clear();
+        render_request_template(config, header_template.second, new_request, header_value);
+    }
     new_request.expected_status_code = request_template.expected_status_code;
     new_request.delay_before_executing_next = request_template.delay_before_executing_next;
+    new_request.resp_payload_wanted = request_template.capture_response_payload;
+    new_request.resp_headers_wanted = request_template.capture_all_response_headers ? nullptr :
+                                      &request_template.response_headers_to_capture;
 }
 
 void base_client::move_cookies_to_new_request(Request_Data& finished_request, Request_Data& new_request)
@@ -1081,25 +1207,24 @@ void base_client::update_this_in_dest_client_map()
     clients[dest] = this;
 }
 
-void base_client::init_lua_states()
+lua_State* base_client::get_lua_state(size_t scenario_index, size_t request_index)
 {
-    for (auto scenario_index = 0; scenario_index < config->json_config_schema.scenarios.size(); scenario_index++)
+    // created on first use, so that connections, and requests without a script, do not carry a Lua VM each
+    if (lua_states.empty())
     {
-        std::vector<lua_State*> requests_lua_states;
-        for (auto request_index = 0; request_index < config->json_config_schema.scenarios[scenario_index].requests.size();
-             request_index++)
-        {
-            auto& request = config->json_config_schema.scenarios[scenario_index].requests[request_index];
-            lua_State* L = luaL_newstate();
-            luaL_openlibs(L);
-            if (request.luaScript.size())
-            {
-                luaL_dostring(L, request.luaScript.c_str());
-            }
-            requests_lua_states.push_back(L);
-        }
-        lua_states.push_back(requests_lua_states);
+        lua_states.resize(config->json_config_schema.scenarios.size());
+    }
+    auto& requests_lua_states = lua_states[scenario_index];
+    if (requests_lua_states.empty())
+    {
+        requests_lua_states.resize(config->json_config_schema.scenarios[scenario_index].requests.size(), nullptr);
     }
+    auto& L = requests_lua_states[request_index];
+    if (!L)
+    {
+        L = create_request_lua_state(config->json_config_schema.scenarios[scenario_index].requests[request_index]);
+    }
+    return L;
 }
 
 
@@ -1114,9 +1239,12 @@ void base_client::slice_user_id()
             if (!scenario.variable_range_slicing)
             {
                 std::random_device                  rand_dev;
-                std::mt19937                        generator(rand_dev());
+                std::mt19937                        generator(config->json_config_schema.scenario_schedule_seed ?
+                                                              config->json_config_schema.scenario_schedule_seed + this_client_id.my_id :
+                                                              rand_dev());
                 std::uniform_int_distribution<uint64_t>  distr(scenario.variable_range_start,
-                                                               scenario.variable_range_end);
+                                                               scenario.variable_range_end > scenario.variable_range_start ?
+                                                               scenario.variable_range_end - 1 : scenario.variable_range_start);
                 scenario_data.curr_req_variable_value = distr(generator);
                 scenario_data.req_variable_value_start = scenario.variable_range_start;
                 scenario_data.req_variable_value_end = scenario.variable_range_end;
@@ -1180,7 +1308,7 @@ bool base_client::rps_mode()
 }
 
 void base_client::update_scenario_based_stats(size_t scenario_index, size_t request_index, bool success,
-                                              bool status_success)
+                                              bool status_success, bool validation_pending)
 {
     if (worker->scenario_stats.size() == 0)
     {
@@ -1195,7 +1323,7 @@ void base_client::update_scenario_based_stats(size_t scenario_index, size_t requ
         {
             ++stats->req_status_success;
         }
-        else
+        else if (!validation_pending)
         {
             ++stats->req_failed;
         }
@@ -1214,54 +1342,25 @@ size_t base_client::get_index_of_next_scenario_to_run()
     {
         return 0;
     }
-    auto init_size_vec = [](Config * config)
+    auto& scheduler = worker->scenario_scheduler;
+    if (worker->scenario_schedule_seq_no != config->json_config_schema.config_update_sequence_number)
     {
-        std::vector<size_t> vec;
-        for (size_t scenario_index = 0; scenario_index < config->json_config_schema.scenarios.size(); scenario_index++)
+        worker->scenario_schedule_seq_no = config->json_config_schema.config_update_sequence_number;
+        std::vector<size_t> request_counts;
+        for (auto& scenario : config->json_config_schema.scenarios)
         {
-            vec.push_back(config->json_config_schema.scenarios[scenario_index].requests.size());;
+            request_counts.push_back(scenario.requests.size());
         }
-        return vec;
-    };
-    auto init_schedule_map = [](Config * config, uint64_t common_multiple)
-    {
-        std::map<uint64_t, size_t> schedule_map;
-        uint64_t totalWeight = 0;
-        for (size_t scenario_index = 0; scenario_index < config->json_config_schema.scenarios.size(); scenario_index++)
+        // weight is about the share of requests, scale it down by the number of requests of the scenario
+        auto common_multiple = find_common_multiple(request_counts);
+        std::vector<uint64_t> weights;
+        for (auto& scenario : config->json_config_schema.scenarios)
         {
-            auto& scenario = config->json_config_schema.scenarios[scenario_index];
-            if (scenario.weight > 0)
-            {
-                totalWeight += ((scenario.weight * common_multiple) / scenario.requests.size());
-                schedule_map[totalWeight] = scenario_index;
-            }
+            weights.push_back((scenario.weight * common_multiple) / scenario.requests.size());
         }
-        return schedule_map;
-    };
-    static thread_local auto seq_no = config->json_config_schema.config_update_sequence_number;
-    static thread_local auto schedule_map = init_schedule_map(config, find_common_multiple(init_size_vec(config)));
-    static thread_local auto total_weight = (schedule_map.rbegin()->first);
-    static thread_local std::random_device                  randDev;
-    static thread_local std::mt19937_64                     generator(randDev());
-    static thread_local std::uniform_int_distribution<int>  distr(0, total_weight - 1);
-
-    if (seq_no != config->json_config_schema.config_update_sequence_number)
-    {
-        seq_no = config->json_config_schema.config_update_sequence_number;
-        schedule_map = init_schedule_map(config, find_common_multiple(init_size_vec(config)));
-        total_weight = (schedule_map.rbegin()->first);
-        distr.param(std::uniform_int_distribution<>::param_type(0, total_weight - 1));
+        scheduler.update_weights(weights);
     }
-
-    size_t scenario_index = 0;
-    uint64_t randomNumber = distr(generator);
-    auto iter = schedule_map.upper_bound(randomNumber);
-    if (iter != schedule_map.end())
-    {
-        scenario_index = iter->second;
-    }
-    return scenario_index;
-
+    return scheduler.next();
 }
 
 void base_client::submit_ping()
@@ -1322,44 +1421,53 @@ void base_client::produce_request_cookie_header(Request_Data& req_to_be_sent)
 }
 
 bool base_client::update_request_with_lua(lua_State* L, const Request_Data& finished_request,
-                                          Request_Data& request_to_send)
+                                          Request_Data& request_to_send, bool zero_copy)
 {
     lua_getglobal(L, make_request);
     bool retCode = true;
     if (lua_isfunction(L, -1))
     {
-        lua_createtable(L, 0, std::accumulate(finished_request.resp_headers.begin(),
-                                              finished_request.resp_headers.end(),
-                                              0,
-                                              [](uint64_t sum, const std::map<std::string, std::string, ci_less>& val)
+        int nargs = 3;
+        if (zero_copy)
         {
-            return sum + val.size();
-        }));
-        for (auto& header_map : finished_request.resp_headers)
+            push_request_data_handle(L, finished_request);
+        }
+        else
         {
-            for (auto& header : header_map)
+            lua_createtable(L, 0, std::accumulate(finished_request.resp_headers.begin(),
+                                                  finished_request.resp_headers.end(),
+                                                  0,
+                                                  [](uint64_t sum, const std::map<std::string, std::string, ci_less>& val)
             {
-                lua_pushlstring(L, header.first.c_str(), header.first.size());
-                lua_pushlstring(L, header.second.c_str(), header.second.size());
-                lua_rawset(L, -3);
+                return sum + val.size();
+            }));
+            for (auto& header_map : finished_request.resp_headers)
+            {
+                for (auto& header : header_map)
+                {
+                    lua_pushlstring(L, header.first.c_str(), header.first.size());
+                    lua_pushlstring(L, header.second.c_str(), header.second.size());
+                    lua_rawset(L, -3);
+                }
             }
-        }
 
-        lua_pushlstring(L, method_header.c_str(), method_header.size());
-        lua_pushlstring(L, finished_request.method->c_str(), finished_request.method->size());
-        lua_rawset(L, -3);
-        lua_pushlstring(L, path_header.c_str(), path_header.size());
-        lua_pushlstring(L, finished_request.path->c_str(), finished_request.path->size());
-        lua_rawset(L, -3);
-        lua_pushlstring(L, scheme_header.c_str(), scheme_header.size());
-        lua_pushlstring(L, finished_request.schema->c_str(), finished_request.schema->size());
-        lua_rawset(L, -3);
-        lua_pushlstring(L, authority_header.c_str(), authority_header.size());
-        lua_pushlstring(L, finished_request.authority->c_str(), finished_request.authority->size());
-        lua_rawset(L, -3);
+            lua_pushlstring(L, method_header.c_str(), method_header.size());
+            lua_pushlstring(L, finished_request.method->c_str(), finished_request.method->size());
+            lua_rawset(L, -3);
+            lua_pushlstring(L, path_header.c_str(), path_header.size());
+            lua_pushlstring(L, finished_request.path->c_str(), finished_request.path->size());
+            lua_rawset(L, -3);
+            lua_pushlstring(L, scheme_header.c_str(), scheme_header.size());
+            lua_pushlstring(L, finished_request.schema->c_str(), finished_request.schema->size());
+            lua_rawset(L, -3);
+            lua_pushlstring(L, authority_header.c_str(), authority_header.size());
+            lua_pushlstring(L, finished_request.authority->c_str(), finished_request.authority->size());
+            lua_rawset(L, -3);
 
 
-        lua_pushlstring(L, finished_request.resp_payload.c_str(), finished_request.resp_payload.size());
+            lua_pushlstring(L, finished_request.resp_payload.c_str(), finished_request.resp_payload.size());
+            nargs = 4;
+        }
 
         lua_createtable(L, 0, request_to_send.req_headers_from_config->size());
         for (auto& header : * (request_to_send.req_headers_from_config))
@@ -1368,6 +1476,13 @@ bool base_client::update_request_with_lua(lua_State* L, const Request_Data& fini
             lua_pushlstring(L, header.second.c_str(), header.second.size());
             lua_rawset(L, -3);
         }
+        // rendered template headers override the raw ones from config
+        for (auto& header : request_to_send.req_headers_of_individual)
+        {
+            lua_pushlstring(L, header.first.c_str(), header.first.size());
+            lua_pushlstring(L, header.second.c_str(), header.second.size());
+            lua_rawset(L, -3);
+        }
         lua_pushlstring(L, method_header.c_str(), method_header.size());
         lua_pushlstring(L, request_to_send.method->c_str(), request_to_send.method->size());
         lua_rawset(L, -3);
@@ -1383,7 +1498,7 @@ bool base_client::update_request_with_lua(lua_State* L, const Request_Data& fini
 
         lua_pushlstring(L, request_to_send.req_payload->c_str(), request_to_send.req_payload->size());
 
-        lua_pcall(L, 4, 2, 0);
+        lua_pcall(L, nargs, 2, 0);
         int top = lua_gettop(L);
         for (int i = 0; i < top; i++)
         {
@@ -1450,6 +1565,93 @@ bool base_client::update_request_with_lua(lua_State* L, const Request_Data& fini
     return retCode;
 }
 
+void base_client::offload_response_validation(int32_t stream_id, const Request_Data& finished_request,
+                                              bool count_result)
+{
+    auto req_stat = get_req_stat(stream_id);
+    if (!req_stat)
+    {
+        return;
+    }
+    auto snapshot = std::make_shared<Request_Data>(finished_request.snapshot());
+    auto stat = *req_stat;
+    auto wrker = worker;
+    auto conf = config;
+    auto& pool = worker->get_lua_script_pool();
+    pool.post([&pool, wrker, conf, snapshot, stat, count_result]()
+    {
+        auto L = pool.get_lua_state(snapshot->scenario_index, snapshot->curr_request_idx);
+        bool status_success = base_client::validate_response_with_lua(L, *snapshot,
+                                                                      conf->json_config_schema.lua_zero_copy);
+        wrker->post_to_worker_thread([wrker, snapshot, stat, count_result, status_success]()
+        {
+            if (count_result)
+            {
+                std::vector<Stats*> all_stats {&wrker->stats};
+                if (wrker->scenario_stats.size())
+                {
+                    all_stats.push_back(wrker->scenario_stats[snapshot->scenario_index][snapshot->curr_request_idx].get());
+                }
+                for (auto stats : all_stats)
+                {
+                    if (status_success)
+                    {
+                        ++stats->req_status_success;
+                    }
+                    else
+                    {
+                        ++stats->req_failed;
+                    }
+                }
+            }
+            if (!status_success)
+            {
+                wrker->failure_log.record(get_error_class(FAILURE_VALIDATE_RESPONSE, stat.status), *snapshot, stat);
+            }
+        });
+    });
+}
+
+void base_client::offload_make_request(const Request_Data& finished_request, Request_Data&& new_request)
+{
+    auto snapshot = std::make_shared<Request_Data>(finished_request.snapshot());
+    auto request_to_send = std::make_shared<Request_Data>(std::move(new_request));
+    std::weak_ptr<bool> guard = script_job_guard;
+    auto client = this;
+    auto wrker = worker;
+    auto zero_copy = config->json_config_schema.lua_zero_copy;
+    auto& pool = worker->get_lua_script_pool();
+    ++script_jobs_in_flight;
+    pool.post([&pool, wrker, zero_copy, snapshot, request_to_send, guard, client]()
+    {
+        auto L = pool.get_lua_state(request_to_send->scenario_index, request_to_send->curr_request_idx);
+        bool success = base_client::update_request_with_lua(L, *snapshot, *request_to_send, zero_copy);
+        wrker->post_to_worker_thread([snapshot, request_to_send, guard, client, success]()
+        {
+            if (guard.expired())
+            {
+                return; // the connection is gone
+            }
+            client->on_make_request_done(*snapshot, std::move(*request_to_send), success);
+        });
+    });
+}
+
+void base_client::on_make_request_done(Request_Data& finished_request, Request_Data&& new_request, bool success)
+{
+    --script_jobs_in_flight;
+    if (success)
+    {
+        update_content_length(new_request);
+        enqueue_request(finished_request, std::move(new_request));
+    }
+    // lua script returns error or kills the request, this scenario is aborted, and another is started instead
+    if (state == CLIENT_CONNECTED)
+    {
+        submit_after_stream_close();
+    }
+}
+
 
 void base_client::terminate_session()
 {
@@ -1510,18 +1712,24 @@ void base_client::on_rps_timer()
     {
         return;
     }
-    auto n = static_cast<size_t>(round(duration * config->rps));
+    auto rps_of_client = worker->get_rps_per_client();
+    auto n = static_cast<size_t>(round(duration * rps_of_client));
     rps_req_pending = n; // += n; do not accumulate to avoid burst of load
-    rps_duration_started = now - d + std::chrono::duration<double>(static_cast<double>(n) / config->rps);
+    rps_duration_started = now - d + std::chrono::duration<double>(static_cast<double>(n) / rps_of_client);
 
     if (rps_req_pending == 0)
     {
         return;
     }
 
-    auto nreq = session->max_concurrent_streams() - streams.size();
+    auto max_streams = get_max_concurrent_streams();
+    size_t nreq = max_streams > streams.size() ? max_streams - streams.size() : 0;
     if (nreq == 0)
     {
+        if (config->json_config_schema.adaptive_concurrency)
+        {
+            worker->concurrency_controller.on_limited();
+        }
         return;
     }
 
@@ -1539,6 +1747,10 @@ void base_client::on_rps_timer()
         rps_req_inflight++;
         rps_req_pending--;
     }
+    if (rps_req_pending && config->json_config_schema.adaptive_concurrency)
+    {
+        worker->concurrency_controller.on_limited();
+    }
     // client->signal_write(); // submit_request already calls signal_write()
 }
 void base_client::process_timedout_streams()
@@ -1568,7 +1780,19 @@ void base_client::on_stream_close(int32_t stream_id, bool success, bool final)
 
     brief_log_to_file(stream_id, success);
 
-    inc_status_counter_and_validate_response(stream_id);
+    bool validation_offloaded = inc_status_counter_and_validate_response(stream_id);
+    // the outcome of an offloaded validation is counted when it arrives
+    bool count_validation_result = false;
+
+    record_load_share_response(stream_id, success);
+
+    auto closed_req_stat = get_req_stat(stream_id);
+    if (config->json_config_schema.adaptive_concurrency && closed_req_stat &&
+        closed_req_stat->request_time != std::chrono::steady_clock::time_point())
+    {
+        worker->concurrency_controller.on_response(std::chrono::duration_cast<std::chrono::microseconds>
+                                                   (closed_req_stat->stream_close_time - closed_req_stat->request_time).count());
+    }
 
     auto finished_request = requests_awaiting_response.find(stream_id);
 
@@ -1596,7 +1820,11 @@ void base_client::on_stream_close(int32_t stream_id, bool success, bool final)
                 ++worker->stats.req_success;
                 ++cstat.req_success;
 
-                if (streams.count(stream_id) && streams.at(stream_id).status_success == 1)
+                if (validation_offloaded)
+                {
+                    count_validation_result = true;
+                }
+                else if (streams.count(stream_id) && streams.at(stream_id).status_success == 1)
                 {
                     ++worker->stats.req_status_success;
                 }
@@ -1621,10 +1849,11 @@ void base_client::on_stream_close(int32_t stream_id, bool success, bool final)
 
             if (finished_request != requests_awaiting_response.end())
             {
-                bool status_success = (streams.count(stream_id) && streams.at(stream_id).status_success == 1) ? true : false;
+                bool status_success = (!validation_offloaded && streams.count(stream_id) &&
+                                       streams.at(stream_id).status_success == 1) ? true : false;
                 update_scenario_based_stats(finished_request->second.scenario_index,
                                             finished_request->second.curr_request_idx,
-                                            success, status_success);
+                                            success, status_success, validation_offloaded);
             }
         }
 
@@ -1632,13 +1861,25 @@ void base_client::on_stream_close(int32_t stream_id, bool success, bool final)
 
     worker->report_progress();
 
+    auto script_jobs_before = script_jobs_in_flight;
     if (finished_request != requests_awaiting_response.end())
     {
+        if (validation_offloaded)
+        {
+            offload_response_validation(stream_id, finished_request->second, count_validation_result);
+        }
         prepare_next_request(finished_request->second);
-        process_stream_user_callback(stream_id);
+        process_stream_user_callback(stream_id, success);
+        if (session && finished_request->second.resp_data_held)
+        {
+            // the stream is done, what is still held by its relay gives the connection window back
+            session->consume(stream_id, finished_request->second.resp_data_held);
+            signal_write();
+        }
         requests_awaiting_response.erase(finished_request);
     }
     streams.erase(stream_id);
+    update_host_outstanding();
 
     if (req_left == 0 && req_inflight == 0)
     {
@@ -1646,6 +1887,15 @@ void base_client::on_stream_close(int32_t stream_id, bool success, bool final)
         return;
     }
 
+    // the next request is being made by a script thread, which submits it when done, see on_make_request_done
+    if (script_jobs_in_flight == script_jobs_before)
+    {
+        submit_after_stream_close();
+    }
+}
+
+void base_client::submit_after_stream_close()
+{
     if (!final && req_left > 0)
     {
         if (config->timing_script)
@@ -1680,6 +1930,35 @@ void base_client::on_header_frame_begin(int32_t stream_id, uint8_t flags)
     }
 }
 
+void base_client::on_header_frame_end(int32_t stream_id)
+{
+    auto request = requests_awaiting_response.find(stream_id);
+    if (request == requests_awaiting_response.end() || !request->second.resp_headers_callback)
+    {
+        return;
+    }
+    auto& resp_headers = request->second.resp_headers;
+    if (resp_headers.empty())
+    {
+        resp_headers.emplace_back();
+    }
+    uint16_t status = request->second.status_code;
+    auto status_header = resp_headers.back().find(":status");
+    if (status_header != resp_headers.back().end())
+    {
+        status = atoi(status_header->second.c_str());
+    }
+    if (status / 100 == 1)
+    {
+        // interim response, the final one is yet to come
+        resp_headers.pop_back();
+        return;
+    }
+    // the headers are relayed once, a trailer comes with the rest of the response on stream close
+    request->second.resp_headers_callback(status, resp_headers.back());
+    auto dummy = std::move(request->second.resp_headers_callback);
+}
+
 void base_client::on_prefered_host_up()
 {
     std::cerr << "preferred host is up: " << preferred_authority << std::endl;
@@ -1710,6 +1989,24 @@ int base_client::connection_made()
 
     state = CLIENT_CONNECTED;
 
+    auto same_authority = [this](const Load_Share_Target & target)
+    {
+        return target.authority == authority;
+    };
+    size_t host_index = std::find_if(config->load_share_group.begin(), config->load_share_group.end(), same_authority) -
+                        config->load_share_group.begin();
+    if (host_index != load_share_host_index)
+    {
+        // the controller client may have failed over to another host
+        load_share_host_index = host_index;
+        latency_ewma_us = 0;
+    }
+    auto host_stats = get_host_stats();
+    if (host_stats)
+    {
+        ++host_stats->connections;
+    }
+
     session->on_connect();
 
     record_connect_time();
@@ -1806,18 +2103,66 @@ int base_client::connection_made()
     return 0;
 }
 
-void base_client::on_data_chunk(int32_t stream_id, const uint8_t* data, size_t len)
+bool base_client::on_data_chunk(int32_t stream_id, const uint8_t* data, size_t len)
 {
+    bool held = false;
     auto request = requests_awaiting_response.find(stream_id);
-    if (request != requests_awaiting_response.end())
+    if (request != requests_awaiting_response.end() && request->second.resp_data_callback)
+    {
+        request->second.resp_data_held += len;
+        held = true;
+        request->second.resp_data_callback(data, len);
+    }
+    else if (request != requests_awaiting_response.end() && request->second.resp_payload_wanted &&
+             !request->second.resp_payload_truncated)
+    {
+        auto limit = request->second.resp_payload_limit;
+        if (limit && request->second.resp_payload.size() + len > limit)
+        {
+            // the rest is not wanted, the stream is reset to stop it
+            request->second.resp_payload_truncated = true;
+            std::string().swap(request->second.resp_payload);
+            session->submit_rst_stream(stream_id);
+            signal_write();
+        }
+        else
+        {
+            request->second.resp_payload.append((const char*)data, len);
+        }
+    }
+    auto host_stats = get_host_stats();
+    if (host_stats)
     {
-        request->second.resp_payload.append((const char*)data, len);
+        host_stats->bytes_body += len;
     }
     if (config->verbose)
     {
         std::string str((const char*)data, len);
         std::cout << "received data: " << std::endl << str << std::endl;
     }
+    return held;
+}
+
+void base_client::consume_response_data(int32_t stream_id, size_t len)
+{
+    auto request = requests_awaiting_response.find(stream_id);
+    if (request == requests_awaiting_response.end() || !session)
+    {
+        return;
+    }
+    len = std::min(len, request->second.resp_data_held);
+    request->second.resp_data_held -= len;
+    session->consume(stream_id, len);
+    signal_write();
+}
+
+void base_client::reset_stream(int32_t stream_id)
+{
+    if (session && requests_awaiting_response.count(stream_id))
+    {
+        session->submit_rst_stream(stream_id);
+        signal_write();
+    }
 }
 
 void base_client::resume_delayed_request_execution()
@@ -1861,6 +2206,7 @@ void base_client::on_request_start(int32_t stream_id)
     bool stats_eligible = (worker->current_phase == Phase::MAIN_DURATION
                            || worker->current_phase == Phase::MAIN_DURATION_GRACEFUL_SHUTDOWN);
     streams.insert(std::make_pair(stream_id, Stream(scenario_index, request_index, stats_eligible)));
+    update_host_outstanding();
     auto curr_timepoint = std::chrono::steady_clock::now();
     auto timeout_interval = request_data->second.stream_timeout_in_ms;
     if (!timeout_interval)
@@ -1914,21 +2260,25 @@ void base_client::on_header(int32_t stream_id, const uint8_t* name, size_t namel
     auto request = requests_awaiting_response.find(stream_id);
     if (request != requests_awaiting_response.end())
     {
-        std::string header_name;
-        header_name.assign((const char*)name, namelen);
-        std::string header_value;
-        header_value.assign((const char*)value, valuelen);
-        header_value.erase(0, header_value.find_first_not_of(' '));
-        assert(request->second.resp_headers.size());
-        auto it = request->second.resp_headers.back().find(header_name);
-        if (it != request->second.resp_headers.back().end())
-        {
-            // Set-Cookie case most likely
-            it->second.append("; ").append(header_value);
-        }
-        else
-        {
-            request->second.resp_headers.back()[header_name] = header_value;
+        // headers nobody reads are not kept, see build_response_capture_plan
+        auto wanted_headers = request->second.resp_headers_wanted;
+        if (!wanted_headers || wanted_headers->count(StringRef(name, namelen)))
+        {
+            std::string header_name((const char*)name, namelen);
+            std::string header_value;
+            header_value.assign((const char*)value, valuelen);
+            header_value.erase(0, header_value.find_first_not_of(' '));
+            assert(request->second.resp_headers.size());
+            auto it = request->second.resp_headers.back().find(header_name);
+            if (it != request->second.resp_headers.back().end())
+            {
+                // Set-Cookie case most likely
+                it->second.append("; ").append(header_value);
+            }
+            else
+            {
+                request->second.resp_headers.back()[header_name] = header_value;
+            }
         }
     }
 
@@ -2022,6 +2372,63 @@ base_client* base_client::find_or_create_dest_client(Request_Data& request_to_se
     }
 }
 
+base_client* base_client::select_load_share_client()
+{
+    auto& group = config->load_share_group;
+    auto now = std::chrono::steady_clock::now();
+    // a connection lost is retried once a second at most
+    bool reconnect = (now - last_load_share_reconnect) >= std::chrono::seconds(1);
+    base_client* selected = nullptr;
+    double selected_score = 0;
+    // ties go round robin
+    load_share_cursor++;
+    if (load_share_clients.size() != group.size())
+    {
+        load_share_clients.assign(group.size(), nullptr);
+    }
+    for (size_t count = 0; count < group.size(); count++)
+    {
+        auto index = (load_share_cursor + count) % group.size();
+        auto client = load_share_clients[index];
+        if (!client)
+        {
+            // once per host, until its client goes, see final_cleanup
+            std::string dest = schema;
+            dest.append("://").append(group[index].authority);
+            auto it = dest_clients.find(dest);
+            if (it == dest_clients.end())
+            {
+                auto new_client = create_dest_client(schema, group[index].authority);
+                worker->check_in_client(new_client);
+                dest_clients[dest] = new_client.get();
+                load_share_clients[index] = new_client.get();
+                new_client->connect_to_host(new_client->schema, new_client->authority);
+                continue;
+            }
+            client = load_share_clients[index] = it->second;
+        }
+        if (client->state != CLIENT_CONNECTED)
+        {
+            if (client != this && client->state == CLIENT_IDLE && reconnect)
+            {
+                last_load_share_reconnect = now;
+                client->connect_to_host(client->schema, client->authority);
+            }
+            continue;
+        }
+        double score = (client->streams.size() + 1.0) / group[index].weight;
+        if (config->load_share_policy == Config::LOAD_SHARE_LEAST_LATENCY && client->latency_ewma_us > 0)
+        {
+            score *= client->latency_ewma_us;
+        }
+        if (!selected || score < selected_score)
+        {
+            selected = client;
+            selected_score = score;
+        }
+    }
+    return selected ? selected : this;
+}
 
 bool base_client::is_controller_client()
 {
@@ -2061,14 +2468,19 @@ Request_Data base_client::prepare_first_request()
     populate_request_from_config_template(new_request, scenario_index, curr_index);
 
     auto& request_template = scenario.requests[curr_index];
-    new_request.string_collection.emplace_back(reassemble_str_with_variable(config, scenario_index, curr_index,
-                                                                            request_template.tokenized_path,
-                                                                            new_request.user_id));
-    new_request.path = &(new_request.string_collection.back());
+    new_request.path = request_template.path_template.literal();
+    if (!new_request.path)
+    {
+        new_request.string_collection.emplace_back();
+        render_request_template(config, request_template.path_template, new_request, new_request.string_collection.back());
+        new_request.path = &(new_request.string_collection.back());
+    }
 
     if (scenario.requests[curr_index].make_request_function_present)
     {
-        if (!update_request_with_lua(lua_states[scenario_index][curr_index], dummy_data, new_request))
+        // not offloaded, the first request is needed right away
+        if (!update_request_with_lua(get_lua_state(scenario_index, curr_index), dummy_data, new_request,
+                                     config->json_config_schema.lua_zero_copy))
         {
             std::cerr << "lua script failure for first request, cannot continue, exit" << std::endl;
             exit(EXIT_FAILURE);
@@ -2091,7 +2503,7 @@ int base_client::submit_request()
         return parent_client->submit_request();
     }
 
-    if (session->max_concurrent_streams() <= get_total_pending_streams())
+    if (get_max_concurrent_streams() <= get_total_pending_streams())
     {
         return -1;
     }
@@ -2116,6 +2528,16 @@ int base_client::submit_request()
             requests_to_submit.pop_front();
         }
     }
+    else if (config->load_share_policy != Config::LOAD_SHARE_CONNECTIONS && config->load_share_group.size() &&
+             requests_to_submit.size())
+    {
+        destination_client = select_load_share_client();
+        if (destination_client != this)
+        {
+            destination_client->requests_to_submit.push_back(std::move(requests_to_submit.front()));
+            requests_to_submit.pop_front();
+        }
+    }
 
     if (destination_client->state == CLIENT_CONNECTED)
     {
@@ -2385,14 +2807,16 @@ void base_client::queue_stream_for_user_callback(int32_t stream_id)
 {
     const size_t MAX_STREAM_SAVED_FOR_CALLBACK = 500;
 
-    if (stream_user_callback_queue.size() > MAX_STREAM_SAVED_FOR_CALLBACK)
+    // a stream still awaited by its callback is not dropped, it is removed when its response comes
+    if (stream_user_callback_queue.size() > MAX_STREAM_SAVED_FOR_CALLBACK &&
+        !stream_user_callback_queue.begin()->second.response_callback)
     {
         stream_user_callback_queue.erase(stream_user_callback_queue.begin());
     }
     stream_user_callback_queue[stream_id].stream_id = stream_id;
 }
 
-void base_client::process_stream_user_callback(int32_t stream_id)
+void base_client::process_stream_user_callback(int32_t stream_id, bool success)
 {
     if (requests_awaiting_response.count(stream_id) && stream_user_callback_queue.count(stream_id))
     {
@@ -2400,6 +2824,9 @@ void base_client::process_stream_user_callback(int32_t stream_id)
         stream_user_callback_queue[stream_id].resp_payload = std::move(requests_awaiting_response[stream_id].resp_payload);
         stream_user_callback_queue[stream_id].response_available = true;
         stream_user_callback_queue[stream_id].resp_trailer_present = requests_awaiting_response[stream_id].resp_trailer_present;
+        stream_user_callback_queue[stream_id].resp_payload_truncated =
+            requests_awaiting_response[stream_id].resp_payload_truncated;
+        stream_user_callback_queue[stream_id].resp_complete = success;
         if (stream_user_callback_queue[stream_id].response_callback)
         {
             stream_user_callback_queue[stream_id].response_callback();
@@ -2490,4 +2917,26 @@ void base_client::pass_response_to_lua(int32_t stream_id, lua_State* L)
     }
 }
 
+void base_client::pass_response_to_callback(int32_t stream_id, std::function<void(Stream_Callback_Data*)> callback)
+{
+    auto iter = stream_user_callback_queue.find(stream_id);
+    if (iter == stream_user_callback_queue.end())
+    {
+        callback(nullptr);
+        return;
+    }
+    if (iter->second.response_available)
+    {
+        callback(&iter->second);
+        stream_user_callback_queue.erase(iter);
+        return;
+    }
+    // also called on disconnect, with no response available
+    iter->second.response_callback = [this, stream_id, callback]()
+    {
+        auto& data = stream_user_callback_queue[stream_id];
+        callback(data.response_available ? &data : nullptr);
+    };
+}
+
 }
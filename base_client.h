@@ -17,6 +17,7 @@ extern "C" {
 
 #include "config_schema.h"
 #include "h2load_stats.h"
+#include "h2load_stream_map.h"
 //#include "base_worker.h"
 #include "h2load_session.h"
 #include "h2load.h"
@@ -46,6 +47,10 @@ public:
     std::vector<std::map<std::string, std::string, ci_less>> resp_headers;
     bool response_available = false;
     bool resp_trailer_present = false;
+    // over resp_payload_limit of the request, resp_payload is incomplete
+    bool resp_payload_truncated = false;
+    // the stream ended with no error
+    bool resp_complete = false;
 };
 
 using time_point_in_seconds_double =
@@ -124,7 +129,11 @@ public:
     void on_header(int32_t stream_id, const uint8_t* name, size_t namelen,
                    const uint8_t* value, size_t valuelen);
     void record_ttfb();
-    void on_data_chunk(int32_t stream_id, const uint8_t* data, size_t len);
+    // returns true if the chunk is held by resp_data_callback, and so not to be given back to flow control yet
+    bool on_data_chunk(int32_t stream_id, const uint8_t* data, size_t len);
+    // gives len bytes held by resp_data_callback of the request back to the flow control window
+    void consume_response_data(int32_t stream_id, size_t len);
+    void reset_stream(int32_t stream_id);
     void on_stream_close(int32_t stream_id, bool success, bool final = false);
     RequestStat* get_req_stat(int32_t stream_id);
     void record_request_time(RequestStat* req_stat);
@@ -141,8 +150,12 @@ public:
     Stats& get_stats();
 
     uint64_t get_total_pending_streams();
+    // max-concurrent-streams, or the streams set by adaptive-concurrency
+    size_t get_max_concurrent_streams();
     base_client* get_controller_client();
     base_client* find_or_create_dest_client(Request_Data& request_to_send);
+    // the connection of the load share group to send the next request on, see load-share-policy
+    base_client* select_load_share_client();
     bool is_controller_client();
     int submit_request();
     Request_Data prepare_first_request();
@@ -156,8 +169,14 @@ public:
     void record_client_end_time();
 
     bool prepare_next_request(Request_Data& data);
+    bool extract_value_for_next_request(const Request& request_template, const Request_Data& finished_request,
+                                        std::string& value);
+    bool update_request_uri(const std::string& uri, const Request_Data& finished_request, Request_Data& new_request);
+    void replace_value_placeholder(const Request& request_template, const std::string& value, Request_Data& new_request);
     void update_content_length(Request_Data& data);
-    bool update_request_with_lua(lua_State* L, const Request_Data& finished_request, Request_Data& request_to_send);
+    // both Lua hooks may run on a script thread of the worker, see lua-script-threads, so they do not touch the client
+    static bool update_request_with_lua(lua_State* L, const Request_Data& finished_request, Request_Data& request_to_send,
+                                        bool zero_copy);
     void produce_request_cookie_header(Request_Data& req_to_be_sent);
     void parse_and_save_cookies(Request_Data& finished_request);
     void move_cookies_to_new_request(Request_Data& finished_request, Request_Data& new_request);
@@ -171,17 +190,22 @@ public:
 
     void submit_ping();
     size_t get_index_of_next_scenario_to_run();
-    void update_scenario_based_stats(size_t scenario_index, size_t request_index, bool success, bool status_success);
+    void update_scenario_based_stats(size_t scenario_index, size_t request_index, bool success, bool status_success,
+                                     bool validation_pending = false);
     bool rps_mode();
     void slice_user_id();
-    void init_lua_states();
+    lua_State* get_lua_state(size_t scenario_index, size_t request_index);
     void init_connection_targert();
-    void log_failed_request(const h2load::Config& config, const h2load::Request_Data& failed_req, int32_t stream_id);
-    bool validate_response_with_lua(lua_State* L, const Request_Data& finished_request);
+    static bool validate_response_with_lua(lua_State* L, const Request_Data& finished_request, bool zero_copy);
+    void offload_response_validation(int32_t stream_id, const Request_Data& finished_request, bool count_result);
+    void offload_make_request(const Request_Data& finished_request, Request_Data&& new_request);
+    void on_make_request_done(Request_Data& finished_request, Request_Data&& new_request, bool success);
+    void submit_after_stream_close();
     void record_stream_close_time(int32_t stream_id);
     void brief_log_to_file(int32_t stream_id, bool success);
     void enqueue_request(Request_Data& finished_request, Request_Data&& new_request);
-    void inc_status_counter_and_validate_response(int32_t stream_id);
+    // returns true if the validation is left to a script thread, see offload_response_validation
+    bool inc_status_counter_and_validate_response(int32_t stream_id);
     bool should_reconnect_on_disconnect();
     int select_protocol_and_allocate_session();
     void report_tls_info();
@@ -190,16 +214,23 @@ public:
     void call_connected_callbacks(bool success);
     void install_connected_callback(std::function<void(bool, h2load::base_client*)> callback);
     void queue_stream_for_user_callback(int32_t stream_id);
-    void process_stream_user_callback(int32_t stream_id);
+    void process_stream_user_callback(int32_t stream_id, bool success);
     void on_header_frame_begin(int32_t stream_id, uint8_t flags);
+    void on_header_frame_end(int32_t stream_id);
     void pass_response_to_lua(int32_t stream_id, lua_State *L);
+    // callback gets the response of stream_id once it is complete, or nullptr if there is none
+    void pass_response_to_callback(int32_t stream_id, std::function<void(Stream_Callback_Data*)> callback);
     uint64_t get_client_unique_id();
     void set_prefered_authority(const std::string& authority);
+    // nullptr if the host of this connection is not in the load share group
+    Host_Stats* get_host_stats();
+    void update_host_outstanding();
+    void record_load_share_response(int32_t stream_id, bool success);
 
     base_worker* worker;
     ClientStat cstat;
     std::multimap<std::chrono::steady_clock::time_point, int32_t> stream_timestamp;
-    std::unordered_map<int32_t, Stream> streams;
+    Stream_Map streams;
     std::unique_ptr<Session> session;
     ClientState state;
     size_t reqidx;
@@ -248,6 +279,23 @@ public:
     SSL* ssl;
     std::vector<std::function<void(bool, h2load::base_client*)>> connected_callbacks;
     std::map<int32_t, Stream_Callback_Data> stream_user_callback_queue;
+    // make_request calls running on script threads for this client
+    size_t script_jobs_in_flight;
+    // results of script threads are dropped once this is gone
+    std::shared_ptr<bool> script_job_guard;
+    // index into config->load_share_group of the host connected to
+    size_t load_share_host_index;
+    // streams.size() as counted in the outstanding of get_host_stats()
+    size_t outstanding_in_host_stats;
+    // response time of the host in microseconds, moving average, for load-share-policy least-latency
+    double latency_ewma_us;
+    // of the controller client, see select_load_share_client
+    size_t load_share_cursor;
+    // of the controller client, the client of each host of config->load_share_group, nullptr until looked up
+    std::vector<base_client*> load_share_clients;
+    std::chrono::steady_clock::time_point last_load_share_reconnect;
+    // streams allowed by adaptive-concurrency, see base_worker::adapt_concurrency
+    size_t concurrency_limit;
 };
 
 }
@@ -1,3 +1,5 @@
+#include <limits>
+
 #include "h2load.h"
 #include "h2load_utils.h"
 #include "base_worker.h"
@@ -28,8 +30,22 @@ base_worker::base_worker(uint32_t id, size_t req_todo, size_t nclients,
       nreqs_rem(req_todo % nclients),
       rate(rate),
       max_samples(max_samples),
-      next_client_id(0)
+      next_client_id(0),
+      scenario_schedule_seq_no(std::numeric_limits<uint64_t>::max()),
+      cpu_time(0),
+      failure_log(config->json_config_schema, id),
+      active_clients(0),
+      concurrency_control_ticks(0)
 {
+    concurrency_controller.init(config->max_concurrent_streams, nclients,
+                                config->json_config_schema.adaptive_concurrency_latency_tolerance);
+
+    scenario_scheduler.set_exact_ratio(config->json_config_schema.scenario_schedule_mode == scenario_schedule_exact_ratio);
+    if (config->json_config_schema.scenario_schedule_seed)
+    {
+        scenario_scheduler.set_seed(config->json_config_schema.scenario_schedule_seed + id);
+    }
+
     if (!config->is_rate_mode() && !config->is_timing_based_mode())
     {
         progress_interval = std::max(static_cast<size_t>(1), req_todo / 10);
@@ -61,6 +77,10 @@ base_worker::base_worker(uint32_t id, size_t req_todo, size_t nclients,
     {
         current_phase = Phase::MAIN_DURATION;
     }
+    for (size_t host_index = 0; host_index < config->load_share_group.size(); host_index++)
+    {
+        host_stats.emplace_back(new Host_Stats());
+    }
     for (size_t scenario_index = 0; scenario_index < config->json_config_schema.scenarios.size(); scenario_index++)
     {
         std::vector<std::unique_ptr<Stats>> requests_stats;
@@ -123,6 +143,7 @@ void base_worker::free_client(base_client* deleted_client)
 
 void base_worker::run()
 {
+    auto cpu_time_at_start = get_thread_cpu_time();
     if (!config->is_rate_mode() && !config->is_timing_based_mode())
     {
         for (size_t i = 0; i < nclients; ++i)
@@ -150,12 +171,36 @@ void base_worker::run()
         // call callback so that we don't waste the first rate_period
         rate_period_timeout_handler();
     }
+    else if (adaptive_connections())
+    {
+        // the rest are opened by adapt_concurrency as needed
+        open_client();
+    }
     else
     {
         // call the callback to start for one single time
         rate_period_timeout_handler();
     }
+    start_telemetry_timer();
     run_event_loop();
+    stop_lua_script_pool();
+    failure_log.flush(std::chrono::steady_clock::now(), true);
+    cpu_time = get_thread_cpu_time() - cpu_time_at_start;
+}
+
+Lua_Script_Pool& base_worker::get_lua_script_pool()
+{
+    if (!lua_script_pool)
+    {
+        lua_script_pool.reset(new Lua_Script_Pool(config->json_config_schema,
+                                                  config->json_config_schema.lua_script_threads));
+    }
+    return *lua_script_pool;
+}
+
+void base_worker::stop_lua_script_pool()
+{
+    lua_script_pool.reset();
 }
 
 void base_worker::rate_period_timeout_handler()
@@ -227,6 +272,135 @@ void base_worker::duration_timeout_handler()
     }
 }
 
+bool base_worker::telemetry_timeout_handler()
+{
+    auto lag = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                      next_telemetry_sample).count();
+    if (lag < 0)
+    {
+        lag = 0;
+    }
+    telemetry.loop_lag_total_us += lag;
+    // the statistics thread resets the max with exchange(0) concurrently, so it is not a plain compare and store
+    uint64_t loop_lag_max = telemetry.loop_lag_max_us;
+    while (static_cast<uint64_t>(lag) > loop_lag_max &&
+           !telemetry.loop_lag_max_us.compare_exchange_weak(loop_lag_max, lag))
+    {
+    }
+    ++telemetry.samples;
+    telemetry.cpu_time_ns = get_thread_cpu_time().count();
+    telemetry.allocations = get_thread_allocation_count();
+
+    uint64_t requests_queued = 0;
+    for (auto& client : managed_clients)
+    {
+        requests_queued += client.first->requests_to_submit.size() + client.first->delayed_requests_to_submit.size();
+    }
+    telemetry.requests_queued = requests_queued;
+
+    failure_log.flush(std::chrono::steady_clock::now());
+
+    adapt_concurrency();
+
+    return !managed_clients.empty() || (config->is_rate_mode() && nconns_made < nclients) ||
+           (adaptive_connections() && current_phase <= Phase::MAIN_DURATION);
+}
+
+bool base_worker::adaptive_connections()
+{
+    return config->json_config_schema.adaptive_concurrency && config->is_timing_based_mode();
+}
+
+double base_worker::get_rps_per_client()
+{
+    if (!config->json_config_schema.adaptive_concurrency || active_clients == 0)
+    {
+        return config->rps;
+    }
+    return config->rps * nclients / active_clients;
+}
+
+void base_worker::open_client()
+{
+    auto client = create_new_client(nreqs_per_client);
+    ++nconns_made;
+    if (client->do_connect() != 0)
+    {
+        std::cerr << "client could not connect to host" << std::endl;
+        client->fail();
+    }
+    else
+    {
+        clients.push_back(client.get());
+        check_in_client(client);
+    }
+}
+
+void base_worker::adapt_concurrency()
+{
+    if (!config->json_config_schema.adaptive_concurrency || !config->rps_enabled() ||
+        (current_phase != Phase::WARM_UP && current_phase != Phase::MAIN_DURATION))
+    {
+        return;
+    }
+    std::vector<base_client*> active;
+    for (auto& client : managed_clients)
+    {
+        if (client.first->is_controller_client() && !client.first->is_test_finished())
+        {
+            active.push_back(client.first);
+        }
+    }
+    active_clients = active.size();
+    telemetry.active_connections = active.size();
+
+    if (++concurrency_control_ticks < concurrency_control_interval)
+    {
+        return;
+    }
+    concurrency_control_ticks = 0;
+
+    concurrency_controller.update(config->rps * nclients, active.size());
+    telemetry.concurrency_limit = concurrency_controller.get_concurrency();
+    auto streams_per_connection = concurrency_controller.get_streams_per_connection(active.size());
+    for (auto client : active)
+    {
+        client->concurrency_limit = streams_per_connection;
+    }
+
+    if (!adaptive_connections())
+    {
+        return;
+    }
+    auto connections_wanted = concurrency_controller.get_connections_wanted(active.size());
+    if (connections_wanted > active.size())
+    {
+        open_client();
+    }
+    else if (connections_wanted < active.size() && current_phase == Phase::MAIN_DURATION)
+    {
+        // the least busy one, if it has no connections of its own to the load-share-hosts, which would be left behind
+        base_client* retired = nullptr;
+        for (auto client : active)
+        {
+            if (client->dest_clients.size() <= 1 &&
+                (!retired || client->get_total_pending_streams() < retired->get_total_pending_streams()))
+            {
+                retired = client;
+            }
+        }
+        if (retired)
+        {
+            // no more requests, it disconnects when its last stream closes, see on_stream_close
+            retired->req_left = 0;
+            if (retired->streams.empty() && retired->session)
+            {
+                retired->terminate_session();
+            }
+        }
+    }
+}
+
 void base_worker::warmup_timeout_handler()
 {
     std::cerr << "Warm-up phase is over for thread #" << id << "."
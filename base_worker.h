@@ -13,15 +13,43 @@
 #include "h2load_stats.h"
 #include "h2load_Config.h"
 #include "base_client.h"
+#include "h2load_scenario_scheduler.h"
+#include "h2load_concurrency_controller.h"
+#include "h2load_lua_script_pool.h"
+#include "h2load_failure_log.h"
 
 
 #include <memory>
+#include <atomic>
+#include <chrono>
 #include "template.h"
 #include "h2load.h"
 
 namespace h2load
 {
 
+// sampled by the worker thread every telemetry_interval, read by the statistics thread
+struct Worker_Telemetry
+{
+    // how late the telemetry timer fired, i.e., how long events wait for the worker thread
+    std::atomic<uint64_t> loop_lag_total_us{0};
+    std::atomic<uint64_t> loop_lag_max_us{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> cpu_time_ns{0};
+    // time spent polling without finding work, with busy-poll-spin-time-us
+    std::atomic<uint64_t> spin_time_ns{0};
+    std::atomic<uint64_t> allocations{0};
+    // requests prepared but not submitted yet, waiting for a stream, or for delay-before-executing-next
+    std::atomic<uint64_t> requests_queued{0};
+    // see adaptive-concurrency
+    std::atomic<uint64_t> active_connections{0};
+    std::atomic<uint64_t> concurrency_limit{0};
+};
+
+constexpr std::chrono::milliseconds telemetry_interval(100);
+// telemetry intervals per control interval of adaptive-concurrency
+constexpr size_t concurrency_control_interval = 5;
+
 class base_worker
 {
 public:
@@ -57,6 +85,23 @@ public:
 
     std::map<std::string, std::set<base_client*>> client_pool;
     std::map<size_t, base_client*> client_ids;
+    Scenario_Scheduler scenario_scheduler;
+    // config_update_sequence_number the scenario_scheduler weights are built from
+    uint64_t scenario_schedule_seq_no;
+    // CPU time of the worker thread spent in run()
+    std::chrono::nanoseconds cpu_time;
+    Worker_Telemetry telemetry;
+    // per host of config->load_share_group
+    std::vector<std::unique_ptr<Host_Stats>> host_stats;
+    // when the telemetry timer is due
+    std::chrono::steady_clock::time_point next_telemetry_sample;
+    // see lua-script-threads, created on first use
+    std::unique_ptr<Lua_Script_Pool> lua_script_pool;
+    Failure_Log failure_log;
+    Concurrency_Controller concurrency_controller;
+    // clients still sending, see adapt_concurrency
+    size_t active_clients;
+    size_t concurrency_control_ticks;
 
     base_worker(uint32_t id, size_t nreq_todo, size_t nclients,
                      size_t rate, size_t max_samples, Config* config);
@@ -71,10 +116,25 @@ public:
     virtual void run_event_loop() = 0;
     virtual std::shared_ptr<base_client> create_new_client(size_t req_todo) = 0;
     virtual void start_graceful_stop_timer() = 0;
+    virtual void start_telemetry_timer() = 0;
+    // thread safe, the handler is run by the event loop of this worker
+    virtual void post_to_worker_thread(std::function<void(void)> handler) = 0;
 
     void rate_period_timeout_handler();
     void warmup_timeout_handler();
     void duration_timeout_handler();
+    // returns false once the worker has no clients left to watch
+    bool telemetry_timeout_handler();
+    // with adaptive-concurrency, sets the streams of the clients, and opens or closes clients in a test with duration
+    void adapt_concurrency();
+    // true if adapt_concurrency opens and closes the clients
+    bool adaptive_connections();
+    // request-per-second of each client, the target rate of the worker shared by its active clients
+    double get_rps_per_client();
+    void open_client();
+    Lua_Script_Pool& get_lua_script_pool();
+    // to be called before the event loop goes, as the script threads post to it
+    void stop_lua_script_pool();
     void run();
     void sample_req_stat(RequestStat* req_stat);
     void sample_client_stat(ClientStat* cstat);
@@ -0,0 +1,57 @@
+# shared by the benchmark scripts of this directory, sourced from the bench directory after binary is set:
+# the builtin server of h2loadrunner over loopback, variants of the bench configs, and parsing of the results
+
+tmp_dir=$(mktemp -d)
+server_pid=""
+
+function cleanup {
+    if [ -n "$server_pid" ]; then
+        kill $server_pid 2>/dev/null
+        wait $server_pid 2>/dev/null
+    fi
+    rm -rf $tmp_dir
+}
+trap cleanup EXIT
+
+# starts the builtin server with the given server config, in the background; h2loadrunner keeps running until it is stopped
+function start_builtin_server {
+    local script=$tmp_dir/server.lua
+    echo "start_server(\"$1\")" > $script
+    $binary --script=$script &>/dev/null &
+    server_pid=$!
+    sleep 1
+}
+
+function stop_builtin_server {
+    kill $server_pid 2>/dev/null
+    wait $server_pid 2>/dev/null
+    server_pid=""
+}
+
+# writes a copy of a config with a top level field set, and prints its path, e.g.:
+# with_field h2load_bench.json io-engine '"io_uring"'
+# with_field $(with_field h2load_bench.json schema '"https"') kernel-tls true
+function with_field {
+    local output=$(mktemp -p $tmp_dir --suffix=.json)
+    if grep -q "^\s*\"$2\":" $1; then
+        sed "0,\|^\\(\\s*\"$2\":\\).*$|s||\\1 $3,|" $1 > $output
+    else
+        sed "0,\|{|s||{\\n  \"$2\": $3,|" $1 > $output
+    fi
+    echo $output
+}
+
+# user, system, and children CPU ticks of a process
+function cpu_ticks {
+    awk '{print $14+$15+$16+$17}' /proc/$1/stat
+}
+
+# h2loadrunner prints durations as 850us, 1.25ms or 1.02s
+function to_us {
+    echo "$1" | awk '/us$/ { print $0 + 0; next } /ms$/ { print $0 * 1000; next } /s$/ { print $0 * 1000000; next } { print 0 }'
+}
+
+# total bytes of the "traffic:" line of the summary of h2loadrunner
+function traffic_bytes {
+    echo "$1" | grep "^traffic:" | sed 's/[^(]*(\([0-9]*\)) total.*/\1/'
+}
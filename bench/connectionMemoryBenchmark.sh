@@ -0,0 +1,34 @@
+#!/bin/bash
+# resident memory per client connection of h2loadrunner, with idle and with active connections,
+# against the builtin server over loopback
+# usage: ./connectionMemoryBenchmark.sh [h2loadrunner binary] [number of connections] [threads] [seconds to settle]
+# run from the bench directory; for large numbers of connections raise the open file limit (ulimit -n) first
+binary=${1:-../build/h2loadrunner}
+clients=${2:-10000}
+threads=${3:-1}
+settle=${4:-10}
+
+source ./benchmarkCommon.sh
+start_builtin_server maock_bench.json
+
+# prints VmRSS in kB of h2loadrunner once the given number of connections is up
+function measure_rss {
+    $binary --config-file=h2load_bench.json -t $threads -c $1 -D $((settle * 2)) ${@:2} &>/dev/null &
+    local pid=$!
+    sleep $settle
+    awk '/^VmRSS/ {print $2}' /proc/$pid/status
+    kill $pid
+    wait $pid 2>/dev/null
+}
+
+for mode in idle active; do
+    # idle: one request per connection every 100 seconds; active: as many as the config allows
+    extra_options=""
+    if [ "$mode" == "idle" ]; then
+        extra_options="--rps 0.01"
+    fi
+    base_rss=$(measure_rss $threads $extra_options)
+    rss=$(measure_rss $clients $extra_options)
+    echo "$mode: $clients connections, RSS $rss kB, baseline with $threads connections $base_rss kB"
+    echo "$mode: bytes of RSS per connection: $(echo "$rss $base_rss $clients $threads" | awk '{ printf "%.0f", ($1 - $2) * 1024 / ($3 - $4) }')"
+done
@@ -0,0 +1,385 @@
+// microbenchmarks of the hot paths of h2loadrunner and the builtin server
+// usage: h2loadrunner_bench [--config-file=h2load_bench.json] [--server-config-file=maock_bench.json]
+//                           [--min-time-ms=200] [--output=file]
+// results are printed as JSON, to stdout unless --output is given
+
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <getopt.h>
+
+#include "staticjson/document.hpp"
+#include "staticjson/staticjson.hpp"
+
+#include "h2load.h"
+#include "h2load_Config.h"
+#include "h2load_utils.h"
+#include "h2load_Cookie.h"
+#include "h2load_http2_session.h"
+#include "asio_worker.h"
+#include "tls.h"
+#include "util.h"
+#include "H2Server.h"
+#include "H2Server_Request.h"
+#include "H2Server_Request_Message.h"
+#include "asio_server_request_impl.h"
+
+using namespace nghttp2;
+
+namespace
+{
+
+class Bench_Result
+{
+public:
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_op = 0;
+    void staticjson_init(staticjson::ObjectHandler* h)
+    {
+        h->add_property("name", &this->name);
+        h->add_property("iterations", &this->iterations);
+        h->add_property("ns-per-op", &this->ns_per_op);
+    }
+};
+
+class Bench_Report
+{
+public:
+    uint64_t min_time_ms = 200;
+    std::vector<Bench_Result> benchmarks;
+    void staticjson_init(staticjson::ObjectHandler* h)
+    {
+        h->add_property("min-time-ms", &this->min_time_ms);
+        h->add_property("benchmarks", &this->benchmarks);
+    }
+};
+
+Bench_Report report;
+
+// keeps results alive, so the compiler cannot drop the work being measured
+volatile size_t sink;
+
+// batch(n) runs the operation n times; the batch size grows until one batch takes at least min-time-ms
+void run_benchmark(const std::string& name, const std::function<void(uint64_t)>& batch)
+{
+    batch(1); // warm up caches and lazily created state
+    uint64_t iterations = 1;
+    std::chrono::nanoseconds elapsed(0);
+    auto min_time = std::chrono::milliseconds(report.min_time_ms);
+    while (true)
+    {
+        auto start = std::chrono::steady_clock::now();
+        batch(iterations);
+        elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed >= min_time || iterations >= (1ULL << 40))
+        {
+            break;
+        }
+        auto scale = elapsed.count() ? (min_time.count() * 1.2) / elapsed.count() : 100.0;
+        iterations = static_cast<uint64_t>(iterations * std::min(std::max(scale, 1.5), 100.0));
+    }
+    Bench_Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.ns_per_op = static_cast<double>(elapsed.count()) / iterations;
+    report.benchmarks.push_back(result);
+    std::cerr << name << ": " << result.ns_per_op << " ns/op" << std::endl;
+}
+
+std::string read_file(const std::string& file_name)
+{
+    std::ifstream buffer(file_name);
+    if (!buffer.is_open())
+    {
+        std::cerr << "file open error: " << file_name << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return std::string((std::istreambuf_iterator<char>(buffer)), std::istreambuf_iterator<char>());
+}
+
+// same steps as h2load::main takes for --config-file
+void load_client_config(h2load::Config& config, const std::string& config_file_name)
+{
+    staticjson::ParseStatus result;
+    if (!staticjson::from_json_string(read_file(config_file_name).c_str(), &config.json_config_schema, &result))
+    {
+        std::cerr << "error reading config file:" << result.description() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (config.json_config_schema.scenarios.empty() || config.json_config_schema.scenarios[0].requests.size() < 2)
+    {
+        std::cerr << "the first scenario of " << config_file_name << " needs at least 2 requests" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    post_process_json_config_schema(config);
+    populate_config_from_json(config);
+    if (config.npn_list.empty())
+    {
+        config.npn_list = util::parse_config_str_list(StringRef::from_lit("h2,h2-16,h2-14,http/1.1"));
+    }
+    for (auto& proto : config.npn_list)
+    {
+        proto.insert(proto.begin(), static_cast<unsigned char>(proto.size()));
+    }
+    insert_customized_headers_to_Json_scenarios(config);
+    normalize_request_templates(&config);
+    compile_request_templates(config);
+    build_response_capture_plan(config);
+}
+
+void bench_client(h2load::Config& config)
+{
+    h2load::asio_worker worker(0, 0, 1, 0, 1000, &config);
+    auto client = worker.create_new_client(0);
+
+    // a finished first request of the scenario, with the response the loopback server sends
+    auto finished_request = client->prepare_first_request();
+    finished_request.status_code = 201;
+    finished_request.resp_headers.emplace_back();
+    finished_request.resp_headers.back()[":status"] = "201";
+    finished_request.resp_headers.back()["content-type"] = "application/json";
+    finished_request.resp_headers.back()["set-cookie"] = "session=0123456789abcdef; Path=/bench; HttpOnly";
+    finished_request.resp_payload = "{\"id\": \"bench\", \"status\": \"created\"}";
+
+    run_benchmark("prepare_next_request", [&](uint64_t n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            client->prepare_next_request(finished_request);
+            sink = client->requests_to_submit.size();
+            client->requests_to_submit.clear();
+            client->delayed_requests_to_submit.clear();
+        }
+    });
+
+    auto& path_template = config.json_config_schema.scenarios[0].requests[0].path_template;
+    std::string rendered;
+    run_benchmark("render_request_template", [&](uint64_t n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            finished_request.user_id = i;
+            rendered.clear();
+            render_request_template(&config, path_template, finished_request, rendered);
+            sink = rendered.size();
+        }
+    });
+
+    run_benchmark("Cookie::parse_cookie_string", [&](uint64_t n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            auto cookies = h2load::Cookie::parse_cookie_string(finished_request.resp_headers.back()["set-cookie"],
+                                                               *finished_request.authority, *finished_request.schema);
+            sink = cookies.size();
+        }
+    });
+
+    // requests are prepared outside of the timed section, which only covers the submission to nghttp2
+    constexpr uint64_t submit_batch = 1000;
+    std::chrono::nanoseconds submit_elapsed(0);
+    uint64_t submitted = 0;
+    auto submit_requests = [&](uint64_t n)
+    {
+        while (n)
+        {
+            auto count = std::min(n, submit_batch);
+            client->requests_awaiting_response.clear();
+            client->streams.clear();
+            client->stream_timestamp.clear();
+            h2load::Http2Session session(client.get());
+            session.on_connect();
+            for (uint64_t i = 0; i < count; i++)
+            {
+                client->requests_to_submit.emplace_back(client->prepare_first_request());
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < count; i++)
+            {
+                session.submit_request();
+            }
+            submit_elapsed += std::chrono::steady_clock::now() - start;
+            submitted += count;
+            n -= count;
+        }
+    };
+    submit_requests(1);
+    uint64_t iterations = submit_batch;
+    do
+    {
+        submit_elapsed = std::chrono::nanoseconds(0);
+        submitted = 0;
+        submit_requests(iterations);
+        iterations *= 2;
+    }
+    while (submit_elapsed < std::chrono::milliseconds(report.min_time_ms));
+    Bench_Result result;
+    result.name = "Http2Session::_submit_request";
+    result.iterations = submitted;
+    result.ns_per_op = static_cast<double>(submit_elapsed.count()) / submitted;
+    report.benchmarks.push_back(result);
+    std::cerr << result.name << ": " << result.ns_per_op << " ns/op" << std::endl;
+
+    client->requests_awaiting_response.clear();
+    client->streams.clear();
+    client->stream_timestamp.clear();
+    client->session.reset();
+}
+
+void bench_server(const std::string& config_file_name)
+{
+    H2Server_Config_Schema server_config;
+    staticjson::ParseStatus result;
+    if (!staticjson::from_json_string(read_file(config_file_name).c_str(), &server_config, &result))
+    {
+        std::cerr << "error reading config file:" << result.description() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    Schema_Header_Match starts_with;
+    starts_with.matchType = "StartsWith";
+    starts_with.header = ":path";
+    starts_with.input = "/bench/users/";
+    Match_Rule starts_with_rule(starts_with);
+
+    Schema_Header_Match regex_match;
+    regex_match.matchType = "RegexMatch";
+    regex_match.header = ":path";
+    regex_match.input = "^/bench/users/[0-9]+$";
+    Match_Rule regex_rule(regex_match);
+
+    std::string subject = "/bench/users/12345678";
+    run_benchmark("Match_Rule::match StartsWith", [&](uint64_t n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            sink = starts_with_rule.match(subject);
+        }
+    });
+    run_benchmark("Match_Rule::match RegexMatch", [&](uint64_t n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            sink = regex_rule.match(subject);
+        }
+    });
+
+    H2Server server(server_config);
+    nghttp2::asio_http2::server::request req;
+    auto& impl = req.impl();
+    impl.method("GET");
+    impl.uri().scheme = "http";
+    impl.uri().host = "127.0.0.1:18081";
+    impl.uri().path = subject;
+    impl.header(nghttp2::asio_http2::header_map
+    {
+        {"user-agent", {"h2loadrunner-bench", false}},
+        {"cookie", {"session=0123456789abcdef", false}}
+    });
+    run_benchmark("H2Server::get_matched_request", [&](uint64_t n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            H2Server_Request_Message msg(req);
+            int64_t matched_request_index;
+            server.get_matched_request(msg, matched_request_index);
+            sink = matched_request_index;
+        }
+    });
+}
+
+void bench_stats()
+{
+    std::vector<double> samples;
+    samples.reserve(100000);
+    std::mt19937 generator(1);
+    std::exponential_distribution<double> latency(1.0 / 2000);
+    for (size_t i = 0; i < 100000; i++)
+    {
+        samples.push_back(latency(generator));
+    }
+    run_benchmark("compute_time_stat 100k samples", [&](uint64_t n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            auto stat = compute_time_stat(samples);
+            sink = static_cast<size_t>(stat.mean);
+        }
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    tls::libssl_init();
+
+#ifndef NOTHREADS
+    tls::LibsslGlobalLock lock;
+#endif // NOTHREADS
+
+    std::string config_file_name = "h2load_bench.json";
+    std::string server_config_file_name = "maock_bench.json";
+    std::string output_file_name;
+    while (1)
+    {
+        constexpr static option long_options[] =
+        {
+            {"config-file", required_argument, nullptr, 'c'},
+            {"server-config-file", required_argument, nullptr, 's'},
+            {"min-time-ms", required_argument, nullptr, 'm'},
+            {"output", required_argument, nullptr, 'o'},
+            {nullptr, 0, nullptr, 0}
+        };
+        int option_index = 0;
+        auto c = getopt_long(argc, argv, "c:s:m:o:", long_options, &option_index);
+        if (c == -1)
+        {
+            break;
+        }
+        switch (c)
+        {
+            case 'c':
+                config_file_name = optarg;
+                break;
+            case 's':
+                server_config_file_name = optarg;
+                break;
+            case 'm':
+                report.min_time_ms = strtoul(optarg, nullptr, 10);
+                break;
+            case 'o':
+                output_file_name = optarg;
+                break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [--config-file=file] [--server-config-file=file]"
+                          << " [--min-time-ms=ms] [--output=file]" << std::endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    h2load::Config config;
+    load_client_config(config, config_file_name);
+
+    bench_client(config);
+    bench_server(server_config_file_name);
+    bench_stats();
+
+    auto json = staticjson::to_pretty_json_string(report);
+    if (output_file_name.size())
+    {
+        std::ofstream output(output_file_name);
+        output << json << std::endl;
+    }
+    else
+    {
+        std::cout << json << std::endl;
+    }
+    return 0;
+}
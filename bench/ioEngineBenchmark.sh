@@ -0,0 +1,21 @@
+#!/bin/bash
+# A/B comparison of io-engine asio and io_uring against the builtin server over loopback, with h2c
+# usage: ./ioEngineBenchmark.sh [h2loadrunner binary] [duration in seconds] [clients] [threads]
+# run from the bench directory; h2loadrunner has to be built with -DUSE_IO_URING=1
+binary=${1:-../build/h2loadrunner}
+duration=${2:-10}
+clients=${3:-10}
+threads=${4:-1}
+
+source ./benchmarkCommon.sh
+start_builtin_server maock_bench.json
+
+for engine in asio io_uring; do
+    config=$(with_field h2load_bench.json io-engine "\"$engine\"")
+    start_cpu=$(cpu_ticks $server_pid)
+    result=$( { /usr/bin/time -f "cpu: %U user %S sys" $binary --config-file=$config -t $threads -c $clients -D $duration; } 2>&1 )
+    end_cpu=$(cpu_ticks $server_pid)
+    echo "io-engine: $engine"
+    echo "$result" | grep -E "^finished in|^requests:|^cpu:"
+    echo "server cpu ticks: $((end_cpu - start_cpu))"
+done
@@ -0,0 +1,34 @@
+#!/bin/bash
+# CPU per GB of h2loadrunner with and without kernel-tls, against the builtin server over loopback with https
+# usage: ./kernelTlsBenchmark.sh [h2loadrunner binary] [duration in seconds] [clients] [threads]
+# run from the bench directory; the server offloads to the kernel as the client does, so the Linux tls module is needed
+binary=${1:-../build/h2loadrunner}
+duration=${2:-10}
+clients=${3:-10}
+threads=${4:-1}
+
+if ! grep -q "^tls " /proc/modules; then
+    echo "kernel-tls benchmark skipped, load the kernel module first: modprobe tls"
+    exit 0
+fi
+
+source ./benchmarkCommon.sh
+
+# a throwaway self-signed certificate for the builtin server
+openssl req -x509 -newkey rsa:2048 -nodes -days 1 -subj "/CN=127.0.0.1" \
+        -keyout $tmp_dir/server.key -out $tmp_dir/server.crt &>/dev/null
+https_server_config=$(with_field $(with_field maock_bench.json cert-file "\"$tmp_dir/server.crt\"") \
+                      private-key-file "\"$tmp_dir/server.key\"")
+https_config=$(with_field h2load_bench.json schema '"https"')
+
+for kernel_tls in false true; do
+    start_builtin_server $(with_field $https_server_config kernel-tls $kernel_tls)
+    config=$(with_field $https_config kernel-tls $kernel_tls)
+    result=$( { /usr/bin/time -f "cpu: %U %S" $binary --config-file=$config -t $threads -c $clients -D $duration; } 2>&1 )
+    stop_builtin_server
+    bytes=$(traffic_bytes "$result")
+    cpu=$(echo "$result" | grep "^cpu:" | awk '{print $2 + $3}')
+    echo "kernel-tls: $kernel_tls"
+    echo "$result" | grep -E "^finished in|^traffic:"
+    echo "client cpu seconds: $cpu, cpu seconds per GB: $(echo "$cpu $bytes" | awk '{ if ($2 > 0) printf "%.3f", $1 * 1073741824 / $2; else print "n/a" }')"
+done
@@ -0,0 +1,57 @@
+#!/bin/bash
+# end to end run of h2loadrunner against the builtin server over loopback, results written as JSON
+# usage: ./loopbackBenchmark.sh [h2loadrunner binary] [output file] [duration in seconds] [clients] [threads]
+# run from the bench directory; the server listens on the port given in maock_bench.json
+binary=${1:-../build/h2loadrunner}
+output=${2:-loopback.json}
+duration=${3:-10}
+clients=${4:-10}
+threads=${5:-1}
+
+source ./benchmarkCommon.sh
+start_builtin_server maock_bench.json
+
+result=$( { /usr/bin/time -f "cpu: %U %S" $binary --config-file=h2load_bench.json -t $threads -c $clients -D $duration; } 2>&1 )
+echo "$result" | grep -E "^finished in|^requests:|^time for request:"
+
+rps=$(echo "$result" | grep "^finished in" | awk '{print $4}')
+requests=$(echo "$result" | grep "^requests:")
+started=$(echo "$requests" | awk '{print $2}')
+req_done=$(echo "$requests" | awk '{print $4}')
+succeeded=$(echo "$requests" | awk '{print $6}')
+failed=$(echo "$requests" | awk '{print $8}')
+errored=$(echo "$requests" | awk '{print $10}')
+timeout=$(echo "$requests" | awk '{print $12}')
+bytes=$(traffic_bytes "$result")
+latency=$(echo "$result" | grep "^time for request:")
+min=$(to_us $(echo "$latency" | awk '{print $4}'))
+max=$(to_us $(echo "$latency" | awk '{print $5}'))
+mean=$(to_us $(echo "$latency" | awk '{print $6}'))
+sd=$(to_us $(echo "$latency" | awk '{print $7}'))
+cpu=$(echo "$result" | grep "^cpu:" | awk '{print $2 + $3}')
+
+cat > $output <<JSON
+{
+  "duration": $duration,
+  "clients": $clients,
+  "threads": $threads,
+  "requests-per-second": ${rps:-0},
+  "requests": {
+    "started": ${started:-0},
+    "done": ${req_done:-0},
+    "succeeded": ${succeeded:-0},
+    "failed": ${failed:-0},
+    "errored": ${errored:-0},
+    "timeout": ${timeout:-0}
+  },
+  "traffic-bytes": ${bytes:-0},
+  "time-for-request-us": {
+    "min": ${min:-0},
+    "max": ${max:-0},
+    "mean": ${mean:-0},
+    "sd": ${sd:-0}
+  },
+  "client-cpu-seconds": ${cpu:-0}
+}
+JSON
+echo "results written to $output"
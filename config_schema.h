@@ -3,8 +3,11 @@
 
 #include <iostream>
 #include <map>
+#include <set>
 #include <fstream>
 #include <regex>
+#include <atomic>
+#include <memory>
 
 #include "staticjson/document.hpp"
 #include "staticjson/staticjson.hpp"
@@ -13,6 +16,9 @@
 
 #include "h2load.h"
 #include "H2Server_Request.h"
+#include "h2load_value_extractor.h"
+#include "h2load_request_template.h"
+#include "h2load_dataset.h"
 
 static const char* validate_response = "validate_response";
 static const char* make_request = "make_request";
@@ -24,6 +30,38 @@ const std::string from_lua_script = "fromLuaScript";
 const std::string from_x_path = "fromXPath";
 const std::string from_json_pointer = "fromJsonPointer";
 
+const std::string scenario_schedule_random = "random";
+const std::string scenario_schedule_exact_ratio = "exact-ratio";
+const std::string io_engine_asio = "asio";
+const std::string io_engine_io_uring = "io_uring";
+const std::string load_share_policy_connections = "connections";
+const std::string load_share_policy_least_outstanding = "least-outstanding";
+const std::string load_share_policy_least_latency = "least-latency";
+
+enum VARIABLE_TYPE
+{
+    VARIABLE_COUNTER = 0,
+    VARIABLE_RANGE,
+    VARIABLE_RANDOM_INT,
+    VARIABLE_RANDOM_STRING,
+    VARIABLE_UUID,
+    VARIABLE_TIMESTAMP,
+    VARIABLE_CSV_COLUMN,
+    VARIABLE_CAPTURED
+};
+
+const std::map<std::string, VARIABLE_TYPE> variable_type_map =
+{
+    {"counter", VARIABLE_COUNTER},
+    {"range", VARIABLE_RANGE},
+    {"random-int", VARIABLE_RANDOM_INT},
+    {"random-string", VARIABLE_RANDOM_STRING},
+    {"uuid", VARIABLE_UUID},
+    {"timestamp", VARIABLE_TIMESTAMP},
+    {"csv-column", VARIABLE_CSV_COLUMN},
+    {"captured", VARIABLE_CAPTURED},
+};
+
 enum URI_ACTION
 {
     INPUT_URI = 0,
@@ -49,11 +87,67 @@ class Uri
 public:
     std::string typeOfAction;
     std::string input;
+    std::string value_placeholder;
+    std::string uri_template;
     URI_ACTION uri_action;
+    h2load::Value_Extractor value_extractor;
+    std::vector<std::string> tokenized_uri_template;
     void staticjson_init(staticjson::ObjectHandler* h)
     {
         h->add_property("typeOfAction", &this->typeOfAction);
         h->add_property("input", &this->input, staticjson::Flags::Optional);
+        h->add_property("value-placeholder", &this->value_placeholder, staticjson::Flags::Optional);
+        h->add_property("uri-template", &this->uri_template, staticjson::Flags::Optional);
+    }
+};
+
+class Variable
+{
+public:
+    std::string name;
+    std::string type;
+    uint64_t start;
+    uint64_t end;
+    uint64_t step;
+    uint32_t width;
+    uint32_t length;
+    uint32_t column;
+    std::string format;
+    std::string source;
+    std::string input;
+    uint32_t capture_from_request;
+    VARIABLE_TYPE variable_type;
+    std::shared_ptr<std::atomic<uint64_t>> counter;
+    h2load::Value_Extractor value_extractor;
+    size_t capture_slot;
+    void staticjson_init(staticjson::ObjectHandler* h)
+    {
+        h->add_property("name", &this->name);
+        h->add_property("type", &this->type);
+        h->add_property("start", &this->start, staticjson::Flags::Optional);
+        h->add_property("end", &this->end, staticjson::Flags::Optional);
+        h->add_property("step", &this->step, staticjson::Flags::Optional);
+        h->add_property("width", &this->width, staticjson::Flags::Optional);
+        h->add_property("length", &this->length, staticjson::Flags::Optional);
+        h->add_property("column", &this->column, staticjson::Flags::Optional);
+        h->add_property("format", &this->format, staticjson::Flags::Optional);
+        h->add_property("source", &this->source, staticjson::Flags::Optional);
+        h->add_property("input", &this->input, staticjson::Flags::Optional);
+        h->add_property("capture-from-request", &this->capture_from_request, staticjson::Flags::Optional);
+    }
+    explicit Variable():
+        start(0),
+        end(0),
+        step(1),
+        width(0),
+        length(16),
+        column(0),
+        format("epoch-ms"),
+        source("header"),
+        capture_from_request(0),
+        variable_type(VARIABLE_COUNTER),
+        capture_slot(0)
+    {
     }
 };
 
@@ -87,8 +181,15 @@ public:
     Schema_Response_Match response_match;
     std::vector<Match_Rule> response_match_rules;
     std::map<std::string, std::string, ci_less> headers_in_map;
-    std::vector<std::string> tokenized_path;
-    std::vector<std::string> tokenized_payload;
+    h2load::Template_String path_template;
+    h2load::Template_String payload_template;
+    std::vector<std::pair<std::string, h2load::Template_String>> header_templates;
+    bool payload_has_value_placeholder;
+    std::vector<std::string> headers_with_value_placeholder;
+    // response capture plan: what of the response is read by match rules, lua, cookies or the requests after
+    bool capture_response_payload;
+    bool capture_all_response_headers;
+    std::set<std::string, ci_less_transparent> response_headers_to_capture;
     uint32_t delay_before_executing_next;
     void staticjson_init(staticjson::ObjectHandler* h)
     {
@@ -107,6 +208,9 @@ public:
         clear_old_cookies = false;
         expected_status_code = 0;
         delay_before_executing_next = 0;
+        payload_has_value_placeholder = false;
+        capture_response_payload = true;
+        capture_all_response_headers = true;
         make_request_function_present = false;
         validate_response_function_present = false;
     }
@@ -119,11 +223,15 @@ public:
     uint32_t weight;
     std::string variable_name_in_path_and_data;
     std::string user_id_list_file;
-    std::vector<std::vector<std::string>> user_ids;
+    bool user_id_list_file_index;
+    std::shared_ptr<h2load::User_Id_Dataset> user_ids;
     uint32_t interval_to_wait_before_start;
     uint64_t variable_range_start;
     uint64_t variable_range_end;
     bool variable_range_slicing;
+    std::vector<Variable> variables;
+    std::vector<size_t> captured_variables;
+    size_t user_id_width;
     std::vector<Request> requests;
     void staticjson_init(staticjson::ObjectHandler* h)
     {
@@ -132,17 +240,21 @@ public:
         h->add_property("user-id-variable-in-path-and-data", &this->variable_name_in_path_and_data,
                         staticjson::Flags::Optional);
         h->add_property("user-id-list-file", &this->user_id_list_file, staticjson::Flags::Optional);
+        h->add_property("user-id-list-file-index", &this->user_id_list_file_index, staticjson::Flags::Optional);
         h->add_property("user-id-range-start", &this->variable_range_start, staticjson::Flags::Optional);
         h->add_property("user-id-range-end", &this->variable_range_end, staticjson::Flags::Optional);
         h->add_property("user-id-range-slicing", &this->variable_range_slicing, staticjson::Flags::Optional);
         h->add_property("interval-to-wait-before-start", &this->interval_to_wait_before_start, staticjson::Flags::Optional);
+        h->add_property("variables", &this->variables, staticjson::Flags::Optional);
         h->add_property("Requests", &this->requests);
     }
     explicit Scenario():
         variable_name_in_path_and_data(""),
+        user_id_list_file_index(false),
         variable_range_start(0),
         variable_range_end(0),
         variable_range_slicing(false),
+        user_id_width(0),
         weight(100),
         interval_to_wait_before_start(0)
     {
@@ -154,10 +266,19 @@ class Load_Share_Host
 public:
     std::string host;
     uint32_t port;
+    uint32_t weight;
+
+    explicit Load_Share_Host():
+        port(0),
+        weight(1)
+    {
+    }
+
     void staticjson_init(staticjson::ObjectHandler* h)
     {
         h->add_property("host", &this->host);
         h->add_property("port", &this->port, staticjson::Flags::Optional);
+        h->add_property("weight", &this->weight, staticjson::Flags::Optional);
     }
 };
 
@@ -199,13 +320,29 @@ public:
     bool open_new_connection_based_on_authority_header;
     bool connection_retry_on_disconnect;
     std::vector<Load_Share_Host> load_share_hosts;
+    std::string load_share_policy;
     bool connect_back_to_preferred_host;
     double interval_to_send_ping;
     std::vector<Scenario> scenarios;
     uint32_t builtin_server_port;
     std::string failed_request_log_file;
+    uint32_t failed_request_log_samples_per_class;
+    uint32_t failed_request_log_reservoir_size;
+    uint32_t failed_request_log_ring_size;
     uint64_t skt_recv_buffer_size;
     uint64_t skt_send_buffer_size;
+    std::string scenario_schedule_mode;
+    uint64_t scenario_schedule_seed;
+    std::string io_engine;
+    bool kernel_tls;
+    uint64_t busy_poll_spin_time_us;
+    uint32_t socket_busy_poll_time_us;
+    uint64_t dns_cache_ttl;
+    uint64_t dns_negative_cache_ttl;
+    uint32_t lua_script_threads;
+    bool lua_zero_copy;
+    bool adaptive_concurrency;
+    double adaptive_concurrency_latency_tolerance;
     uint64_t config_update_sequence_number;
 
     explicit Config_Schema():
@@ -236,11 +373,27 @@ public:
         max_tls_version("TLSv1.3"),
         open_new_connection_based_on_authority_header(false),
         connection_retry_on_disconnect(false),
+        load_share_policy(load_share_policy_connections),
         connect_back_to_preferred_host(false),
         interval_to_send_ping(0),
         builtin_server_port(8888),
+        failed_request_log_samples_per_class(10),
+        failed_request_log_reservoir_size(100),
+        failed_request_log_ring_size(1000),
         skt_recv_buffer_size(4194304),
         skt_send_buffer_size(4194304),
+        scenario_schedule_mode(scenario_schedule_random),
+        scenario_schedule_seed(0),
+        io_engine(io_engine_asio),
+        kernel_tls(false),
+        busy_poll_spin_time_us(0),
+        socket_busy_poll_time_us(0),
+        dns_cache_ttl(30000),
+        dns_negative_cache_ttl(1000),
+        lua_script_threads(0),
+        lua_zero_copy(false),
+        adaptive_concurrency(false),
+        adaptive_concurrency_latency_tolerance(2.0),
         config_update_sequence_number(0)
     {
     }
@@ -282,14 +435,33 @@ public:
         h->add_property("max-tls-version", &this->max_tls_version, staticjson::Flags::Optional);
         h->add_property("connection-retry", &this->connection_retry_on_disconnect, staticjson::Flags::Optional);
         h->add_property("load-share-hosts", &this->load_share_hosts, staticjson::Flags::Optional);
+        h->add_property("load-share-policy", &this->load_share_policy, staticjson::Flags::Optional);
         h->add_property("switch-back-after-connection-retry", &this->connect_back_to_preferred_host,
                         staticjson::Flags::Optional);
         h->add_property("interval-between-ping-frames", &this->interval_to_send_ping, staticjson::Flags::Optional);
         h->add_property("builtin-server-listening-port", &this->builtin_server_port, staticjson::Flags::Optional);
         h->add_property("failed-request-log-file", &this->failed_request_log_file, staticjson::Flags::Optional);
+        h->add_property("failed-request-log-samples-per-class", &this->failed_request_log_samples_per_class,
+                        staticjson::Flags::Optional);
+        h->add_property("failed-request-log-reservoir-size", &this->failed_request_log_reservoir_size,
+                        staticjson::Flags::Optional);
+        h->add_property("failed-request-log-ring-size", &this->failed_request_log_ring_size, staticjson::Flags::Optional);
         h->add_property("statistics-file", &this->statistics_file, staticjson::Flags::Optional);
         h->add_property("socket-receive-buffer-size", &this->skt_recv_buffer_size, staticjson::Flags::Optional);
         h->add_property("socket-send-buffer-size", &this->skt_send_buffer_size, staticjson::Flags::Optional);
+        h->add_property("scenario-schedule-mode", &this->scenario_schedule_mode, staticjson::Flags::Optional);
+        h->add_property("scenario-schedule-seed", &this->scenario_schedule_seed, staticjson::Flags::Optional);
+        h->add_property("io-engine", &this->io_engine, staticjson::Flags::Optional);
+        h->add_property("kernel-tls", &this->kernel_tls, staticjson::Flags::Optional);
+        h->add_property("busy-poll-spin-time-us", &this->busy_poll_spin_time_us, staticjson::Flags::Optional);
+        h->add_property("socket-busy-poll-time-us", &this->socket_busy_poll_time_us, staticjson::Flags::Optional);
+        h->add_property("dns-cache-ttl", &this->dns_cache_ttl, staticjson::Flags::Optional);
+        h->add_property("dns-negative-cache-ttl", &this->dns_negative_cache_ttl, staticjson::Flags::Optional);
+        h->add_property("lua-script-threads", &this->lua_script_threads, staticjson::Flags::Optional);
+        h->add_property("lua-zero-copy", &this->lua_zero_copy, staticjson::Flags::Optional);
+        h->add_property("adaptive-concurrency", &this->adaptive_concurrency, staticjson::Flags::Optional);
+        h->add_property("adaptive-concurrency-latency-tolerance", &this->adaptive_concurrency_latency_tolerance,
+                        staticjson::Flags::Optional);
     }
 };
 
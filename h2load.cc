@@ -68,11 +68,6 @@
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
-#ifdef USE_LIBEV
-extern "C" {
-#include <ares.h>
-}
-#endif
 #include "nghttp2_config.h"
 #include <nghttp2/nghttp2.h>
 
@@ -98,6 +93,9 @@ extern "C" {
 #include "rapidjson/prettywriter.h"
 #include "config_schema.h"
 #include "h2load_lua.h"
+#include "h2load_dns_cache.h"
+#include "h2load_calibration.h"
+#include "h2load_failure_log.h"
 
 
 #ifndef O_BINARY
@@ -364,6 +362,12 @@ Options:
               And the actual connection and request will be controlled
               by the script.
               Multiple scripts are acceptable w/ multiple --script arg
+  --calibrate
+              Run the Scenarios of  --config-file against  a builtin
+              responder which does  no work, over loopback,  and print
+              the CPU cost per request, the max req/s of each worker,
+              and the latency  floor of each request of the Scenarios,
+              i.e., the overhead of h2loadrunner itself.
   -v, --verbose
               Output debug information.
   --version   Display version information and exit.
@@ -387,16 +391,6 @@ int main(int argc, char** argv)
 {
     tls::libssl_init();
 
-#ifdef USE_LIBEV
-    auto status = ares_library_init(ARES_LIB_INIT_ALL);
-    if (status != ARES_SUCCESS)
-    {
-        std::cerr << "ares_library_init failed" << std::endl;
-        exit(EXIT_FAILURE);
-        return 1;
-    }
-#endif
-
 #ifndef NOTHREADS
     tls::LibsslGlobalLock lock;
 #endif // NOTHREADS
@@ -404,6 +398,7 @@ int main(int argc, char** argv)
     std::string datafile;
     std::vector<std::string> script_files;
     bool nreqs_set_manually = false;
+    bool calibrate = false;
     while (1)
     {
         static int flag = 0;
@@ -442,6 +437,7 @@ int main(int argc, char** argv)
             {"rps-input-file", required_argument, &flag, 24},
             {"config-file", required_argument, &flag, 25},
             {"script", required_argument, &flag, 26},
+            {"calibrate", no_argument, &flag, 27},
             {nullptr, 0, nullptr, 0}
         };
         int option_index = 0;
@@ -763,6 +759,10 @@ int main(int argc, char** argv)
                         script_files.push_back(script_file);
                     }
                     break;
+                    case 27:
+                        // --calibrate
+                        calibrate = true;
+                        break;
                 }
                 break;
             default:
@@ -908,6 +908,12 @@ int main(int argc, char** argv)
         exit(EXIT_FAILURE);
     }
 
+    if (config.json_config_schema.adaptive_concurrency && !config.rps_enabled())
+    {
+        std::cerr << "adaptive-concurrency: request-per-second is required." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     if (config.nreqs == 0 && !config.is_timing_based_mode())
     {
         std::cerr << "-n: the number of requests must be strictly greater than 0 "
@@ -1132,6 +1138,16 @@ int main(int argc, char** argv)
         exit(EXIT_FAILURE);
     }
 
+    if (calibrate)
+    {
+        if (config.json_config_schema.scenarios.empty())
+        {
+            std::cerr << "--calibrate: Scenarios from --config-file are required" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        start_calibration_responder(config);
+    }
+
     insert_customized_headers_to_Json_scenarios(config);
 
     normalize_request_templates(&config);
@@ -1142,7 +1158,14 @@ int main(int argc, char** argv)
                   << std::endl;
     }
 
-    tokenize_path_and_payload_for_fast_var_replace(config);
+    compile_request_templates(config);
+
+    build_response_capture_plan(config);
+
+    DNS_Cache::instance().set_ttl(std::chrono::milliseconds(config.json_config_schema.dns_cache_ttl),
+                                  std::chrono::milliseconds(config.json_config_schema.dns_negative_cache_ttl));
+
+    init_load_share_group(config);
 
     resolve_host(config);
 
@@ -1233,18 +1256,21 @@ int main(int argc, char** argv)
     std::atomic<bool> workers_stopped(false);
 
     std::stringstream dataStream;
+    std::stringstream workerDataStream;
+    std::stringstream hostDataStream;
 
     if (config.json_config_schema.scenarios.size() > 0)
     {
         std::thread statThread(output_realtime_stats, std::ref(config), std::ref(workers), std::ref(workers_stopped),
-                               std::ref(dataStream));
+                               std::ref(dataStream), std::ref(workerDataStream), std::ref(hostDataStream));
         statThread.detach();
     }
 
     std::thread monThread(rpsUpdateFunc, std::ref(workers_stopped), std::ref(config));
     monThread.detach();
 
-    std::thread serverThread(integrated_http2_server, std::ref(dataStream), std::ref(config));
+    std::thread serverThread(integrated_http2_server, std::ref(dataStream), std::ref(workerDataStream),
+                             std::ref(hostDataStream), std::ref(config));
     serverThread.detach();
 
     process_delayed_scenario(config);
@@ -1390,18 +1416,28 @@ time for request: )"
 
     print_extended_stats_summary(stats, config, workers);
 
-    SSL_CTX_free(ssl_ctx);
+    print_failure_class_summary(workers);
+    if (config.json_config_schema.failed_request_log_file.size())
+    {
+        drain_failure_log();
+    }
 
-#ifdef USE_LIBEV
-    ares_library_cleanup();
-#endif
+    if (calibrate)
+    {
+        print_calibration_summary(config, workers);
+    }
+
+    SSL_CTX_free(ssl_ctx);
 
     return 0;
 }
 
 } // namespace h2load
 
+// the benchmark executable links the same sources, with a main of its own
+#ifndef H2LOADRUNNER_NO_MAIN
 int main(int argc, char** argv)
 {
     return h2load::main(argc, argv);
 }
+#endif
@@ -26,6 +26,7 @@
 #define H2LOAD_H
 #include <string>
 #include <map>
+#include <set>
 #include <iostream>
 #include <vector>
 #include "h2load_Cookie.h"
@@ -38,6 +39,21 @@
 
 using namespace nghttp2;
 
+// ci_less that also compares with a StringRef, so that a set of it is searched with no std::string made for the key
+struct ci_less_transparent: ci_less
+{
+    using is_transparent = void;
+    using ci_less::operator();
+    bool operator()(const StringRef& s1, const std::string& s2) const
+    {
+        return std::lexicographical_compare(s1.begin(), s1.end(), s2.begin(), s2.end(), nocase_compare());
+    }
+    bool operator()(const std::string& s1, const StringRef& s2) const
+    {
+        return std::lexicographical_compare(s1.begin(), s1.end(), s2.begin(), s2.end(), nocase_compare());
+    }
+};
+
 namespace h2load
 {
 
@@ -67,7 +83,19 @@ struct Request_Data
     std::map<std::string, std::string, ci_less> req_headers_of_individual;
     std::string resp_payload;
     std::vector<std::map<std::string, std::string, ci_less>> resp_headers;
+    bool resp_payload_wanted = true;
+    // the stream is reset once resp_payload would grow over this, 0: no limit
+    uint64_t resp_payload_limit = 0;
+    bool resp_payload_truncated = false;
+    // headers to keep from the response, nullptr means all
+    const std::set<std::string, ci_less_transparent>* resp_headers_wanted = nullptr;
     bool resp_trailer_present = false;
+    // set to have the response relayed as it arrives instead of kept in resp_payload, see forward_request_to_upstream:
+    // resp_headers_callback gets the status and the headers once they are complete, resp_data_callback each chunk of the payload,
+    // which is held out of the flow control window until given back with base_client::consume_response_data
+    std::function<void(uint16_t, std::map<std::string, std::string, ci_less>&)> resp_headers_callback;
+    std::function<void(const uint8_t*, size_t)> resp_data_callback;
+    size_t resp_data_held = 0;
     uint16_t status_code;
     uint16_t expected_status_code;
     uint32_t delay_before_executing_next;
@@ -75,6 +103,7 @@ struct Request_Data
     size_t curr_request_idx;
     size_t scenario_index;
     std::vector<std::string> string_collection;
+    std::vector<std::string> captured_values;
     std::function<void(int32_t, h2load::base_client*)> request_sent_callback;
     uint32_t stream_timeout_in_ms;
     explicit Request_Data():
@@ -95,6 +124,33 @@ struct Request_Data
         string_collection.reserve(12); // (path, authority, method, schema, payload, xx) * 2
     };
 
+    // a copy to be handed to another thread; unlike the implicit copy, it does not point into the original
+    Request_Data snapshot() const
+    {
+        Request_Data copy;
+        copy.scenario_index = scenario_index;
+        copy.curr_request_idx = curr_request_idx;
+        copy.user_id = user_id;
+        copy.status_code = status_code;
+        copy.expected_status_code = expected_status_code;
+        copy.delay_before_executing_next = delay_before_executing_next;
+        copy.req_headers_from_config = req_headers_from_config;
+        copy.req_headers_of_individual = req_headers_of_individual;
+        copy.resp_headers = resp_headers;
+        copy.resp_payload = resp_payload;
+        copy.string_collection.emplace_back(*method);
+        copy.method = &(copy.string_collection.back());
+        copy.string_collection.emplace_back(*path);
+        copy.path = &(copy.string_collection.back());
+        copy.string_collection.emplace_back(*schema);
+        copy.schema = &(copy.string_collection.back());
+        copy.string_collection.emplace_back(*authority);
+        copy.authority = &(copy.string_collection.back());
+        copy.string_collection.emplace_back(*req_payload);
+        copy.req_payload = &(copy.string_collection.back());
+        return copy;
+    }
+
     friend std::ostream& operator<<(std::ostream& o, const Request_Data& request_data)
     {
         o << "Request_Data: { " << std::endl
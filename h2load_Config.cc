@@ -66,7 +66,8 @@ Config::Config()
       //      crud_delete_method(""),
       //      crud_create_data_file_name(""),
       //      crud_update_data_file_name(""),
-      stream_timeout_in_ms(5000) {}
+      stream_timeout_in_ms(5000),
+      load_share_policy(LOAD_SHARE_CONNECTIONS) {}
 
 Config::~Config()
 {
@@ -15,6 +15,14 @@
 namespace h2load
 {
 
+// a host of the load-share-hosts group, the main host included
+struct Load_Share_Target
+{
+    // host:port, IPv6 address in brackets, port omitted if default
+    std::string authority;
+    uint32_t weight;
+};
+
 struct Config
 {
     std::vector<std::vector<nghttp2_nv>> nva;
@@ -73,6 +81,11 @@ struct Config
     Config_Schema json_config_schema;
     std::vector<std::string> reqlines;
     std::string payload_data;
+    // see init_load_share_group, empty if there is no load share group
+    std::vector<Load_Share_Target> load_share_group;
+    // index into load_share_group of the host of each connection, in weighted round robin order
+    std::vector<size_t> load_share_schedule;
+    enum { LOAD_SHARE_CONNECTIONS, LOAD_SHARE_LEAST_OUTSTANDING, LOAD_SHARE_LEAST_LATENCY } load_share_policy;
 
     Config();
     ~Config();
@@ -0,0 +1,111 @@
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+#include "h2load_utils.h"
+
+// global operator new/delete counting the allocations of each thread, for the worker telemetry;
+// left out with AddressSanitizer, which has its own
+#if defined(__SANITIZE_ADDRESS__)
+#define H2LOAD_NO_ALLOCATION_COUNTER
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define H2LOAD_NO_ALLOCATION_COUNTER
+#endif
+#endif
+
+#ifndef H2LOAD_NO_ALLOCATION_COUNTER
+
+namespace
+{
+thread_local uint64_t thread_allocation_count = 0;
+}
+
+uint64_t get_thread_allocation_count()
+{
+    return thread_allocation_count;
+}
+
+void* operator new(std::size_t size)
+{
+    ++thread_allocation_count;
+    if (size == 0)
+    {
+        size = 1;
+    }
+    while (true)
+    {
+        void* ptr = std::malloc(size);
+        if (ptr)
+        {
+            return ptr;
+        }
+        auto handler = std::get_new_handler();
+        if (!handler)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+#else
+
+uint64_t get_thread_allocation_count()
+{
+    return 0;
+}
+
+#endif
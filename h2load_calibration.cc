@@ -0,0 +1,143 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <future>
+
+#include <boost/asio.hpp>
+
+#include "h2load_calibration.h"
+#include "h2load_utils.h"
+#include "asio_util.h"
+
+
+namespace h2load
+{
+
+void start_calibration_responder(Config& config)
+{
+    uint16_t port;
+    {
+        // let the OS pick a free port
+        boost::asio::io_service io_context;
+        boost::asio::ip::tcp::acceptor acceptor(io_context,
+                                                boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        port = acceptor.local_endpoint().port();
+    }
+
+    H2Server_Config_Schema responder_schema;
+    responder_schema.address = "127.0.0.1";
+    responder_schema.port = port;
+    responder_schema.threads = config.nthreads;
+
+    Schema_Header_Match any_path;
+    any_path.header = ":path";
+    any_path.matchType = "StartsWith";
+    any_path.input = "/";
+    Schema_Response_To_Return empty_response;
+    empty_response.name = "calibration";
+    empty_response.status_code = 200;
+    empty_response.weight = 100;
+    empty_response.throttle_ratio = 0;
+    Schema_Service service;
+    service.request.name = "calibration";
+    service.request.header_match.push_back(any_path);
+    service.responses.push_back(empty_response);
+    responder_schema.service.push_back(service);
+
+    std::promise<void> ready_promise;
+    std::thread responder_thread([responder_schema, &ready_promise]()
+    {
+        start_server(responder_schema, false, [&ready_promise]()
+        {
+            ready_promise.set_value();
+        });
+    });
+    responder_thread.detach();
+    ready_promise.get_future().wait();
+
+    config.scheme = "http";
+    config.host = "127.0.0.1";
+    config.port = port;
+    config.default_port = 80;
+    config.no_tls_proto = Config::PROTO_HTTP2;
+    config.json_config_schema.schema = config.scheme;
+    config.json_config_schema.host = config.host;
+    config.json_config_schema.port = port;
+    config.json_config_schema.no_tls_proto = "h2c";
+    config.json_config_schema.load_share_hosts.clear();
+    config.json_config_schema.open_new_connection_based_on_authority_header = false;
+    for (auto& scenario : config.json_config_schema.scenarios)
+    {
+        for (auto& request : scenario.requests)
+        {
+            // absolute URIs too go to the responder
+            request.schema.clear();
+            request.authority.clear();
+        }
+    }
+
+    std::cerr << "calibration: scenarios are sent to the builtin responder at 127.0.0.1:" << port
+              << "; TLS is not used, and steps which take their URI from a response are not reached" << std::endl;
+}
+
+void print_calibration_summary(const Config& config, const std::vector<std::shared_ptr<base_worker>>& workers)
+{
+    std::stringstream outputStream;
+    outputStream << std::fixed << std::setprecision(1);
+    outputStream << std::endl << "calibration, cost of h2loadrunner itself:" << std::endl;
+    outputStream << "worker, requests-done, cpu-seconds, cpu-per-request(us), max-req/s" << std::endl;
+    uint64_t total_req_done = 0;
+    double total_cpu_seconds = 0;
+    double total_max_rps = 0;
+    for (auto& w : workers)
+    {
+        auto cpu_seconds = std::chrono::duration<double>(w->cpu_time).count();
+        auto max_rps = cpu_seconds > 0 ? w->stats.req_done / cpu_seconds : 0;
+        outputStream << w->id
+                     << ", " << w->stats.req_done
+                     << ", " << std::setprecision(3) << cpu_seconds << std::setprecision(1)
+                     << ", " << (w->stats.req_done ? cpu_seconds * 1000000 / w->stats.req_done : 0)
+                     << ", " << max_rps
+                     << std::endl;
+        total_req_done += w->stats.req_done;
+        total_cpu_seconds += cpu_seconds;
+        total_max_rps += max_rps;
+    }
+    outputStream << "SUM"
+                 << ", " << total_req_done
+                 << ", " << std::setprecision(3) << total_cpu_seconds << std::setprecision(1)
+                 << ", " << (total_req_done ? total_cpu_seconds * 1000000 / total_req_done : 0)
+                 << ", " << total_max_rps
+                 << std::endl;
+
+    outputStream << "request, requests-done, latency-floor(us), latency-mean(us)" << std::endl;
+    auto latency_stats = produce_requests_latency_stats(workers);
+    for (size_t scenario_index = 0; scenario_index < config.json_config_schema.scenarios.size(); scenario_index++)
+    {
+        auto& scenario = config.json_config_schema.scenarios[scenario_index];
+        for (size_t request_index = 0; request_index < scenario.requests.size(); request_index++)
+        {
+            size_t req_done = 0;
+            for (auto& w : workers)
+            {
+                req_done += w->scenario_stats[scenario_index][request_index]->req_done;
+            }
+            outputStream << scenario.name << "_" << request_index << ", " << req_done;
+            if (req_done)
+            {
+                outputStream << ", " << latency_stats[scenario_index][request_index].min * 1000000
+                             << ", " << latency_stats[scenario_index][request_index].mean * 1000000 << std::endl;
+            }
+            else
+            {
+                outputStream << ", -, -" << std::endl;
+            }
+        }
+    }
+    outputStream << "max-req/s assumes the worker thread is fully busy; run with enough clients and no rate limit to get there"
+                 << std::endl;
+    std::cerr << outputStream.str();
+}
+
+}
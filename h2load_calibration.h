@@ -0,0 +1,24 @@
+#ifndef H2LOAD_CALIBRATION_H
+#define H2LOAD_CALIBRATION_H
+#include <vector>
+#include <memory>
+
+#include "h2load_Config.h"
+#include "base_worker.h"
+
+namespace h2load
+{
+
+/*
+ * --calibrate: the configured scenarios are run against a builtin responder on loopback that does no work,
+ * so the latency and CPU time measured are those of h2loadrunner itself, i.e., its ceiling with this config.
+ */
+
+// starts the responder, and points all scenarios to it with h2c; call before normalize_request_templates
+void start_calibration_responder(Config& config);
+
+// CPU cost per request and the max req/s of each worker, and the latency floor of each scenario step
+void print_calibration_summary(const Config& config, const std::vector<std::shared_ptr<base_worker>>& workers);
+
+}
+#endif
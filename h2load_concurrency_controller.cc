@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cmath>
+
+#include "h2load_concurrency_controller.h"
+
+
+namespace h2load
+{
+
+namespace
+{
+// control intervals of a window of the lowest latency
+const size_t min_latency_window = 60;
+const double multiplicative_decrease = 0.9;
+// headroom over Little's law, for the variance of the latency
+const double concurrency_headroom = 1.1;
+}
+
+Concurrency_Controller::Concurrency_Controller():
+    max_streams_per_connection(1),
+    max_connections(1),
+    latency_tolerance(2.0),
+    concurrency(1),
+    latency_total_us(0),
+    latency_samples(0),
+    latency_us(0),
+    window_min_latency_us(0),
+    previous_window_min_latency_us(0),
+    intervals_in_window(0),
+    limited(false)
+{
+}
+
+void Concurrency_Controller::init(size_t max_streams, size_t max_conns, double tolerance)
+{
+    max_streams_per_connection = std::max(max_streams, static_cast<size_t>(1));
+    max_connections = std::max(max_conns, static_cast<size_t>(1));
+    latency_tolerance = std::max(tolerance, 1.0);
+}
+
+void Concurrency_Controller::on_response(uint64_t response_latency_us)
+{
+    latency_total_us += response_latency_us;
+    ++latency_samples;
+}
+
+void Concurrency_Controller::on_limited()
+{
+    limited = true;
+}
+
+void Concurrency_Controller::update(double target_rate, size_t connections)
+{
+    connections = std::max(connections, static_cast<size_t>(1));
+    if (latency_samples)
+    {
+        latency_us = static_cast<double>(latency_total_us) / latency_samples;
+        latency_total_us = 0;
+        latency_samples = 0;
+        if (window_min_latency_us == 0 || latency_us < window_min_latency_us)
+        {
+            window_min_latency_us = latency_us;
+        }
+    }
+    auto min_latency_us = window_min_latency_us;
+    if (previous_window_min_latency_us > 0 && (min_latency_us == 0 || previous_window_min_latency_us < min_latency_us))
+    {
+        min_latency_us = previous_window_min_latency_us;
+    }
+    if (++intervals_in_window >= min_latency_window)
+    {
+        previous_window_min_latency_us = window_min_latency_us;
+        window_min_latency_us = 0;
+        intervals_in_window = 0;
+    }
+
+    // Little's law
+    auto needed = target_rate * latency_us / 1000000;
+    if (min_latency_us > 0 && latency_us > min_latency_us * latency_tolerance)
+    {
+        concurrency *= multiplicative_decrease;
+    }
+    else if (limited)
+    {
+        concurrency = std::max(concurrency + connections, needed * concurrency_headroom);
+    }
+    else if (latency_us > 0 && concurrency > 2 * needed * concurrency_headroom + connections)
+    {
+        // more than needed, given back gradually
+        concurrency -= connections;
+    }
+    concurrency = std::min(std::max(concurrency, 1.0), static_cast<double>(max_streams_per_connection * max_connections));
+    limited = false;
+}
+
+size_t Concurrency_Controller::get_concurrency() const
+{
+    return static_cast<size_t>(std::ceil(concurrency));
+}
+
+size_t Concurrency_Controller::get_connections_wanted(size_t connections) const
+{
+    connections = std::max(connections, static_cast<size_t>(1));
+    auto wanted = connections;
+    // a new connection when the ones open are nearly full, one less when the rest would be half full
+    if (concurrency > connections * max_streams_per_connection * 0.9)
+    {
+        wanted = connections + 1;
+    }
+    else if (connections > 1 && concurrency < (connections - 1) * max_streams_per_connection * 0.5)
+    {
+        wanted = connections - 1;
+    }
+    return std::min(wanted, max_connections);
+}
+
+size_t Concurrency_Controller::get_streams_per_connection(size_t connections) const
+{
+    connections = std::max(connections, static_cast<size_t>(1));
+    auto streams = static_cast<size_t>(std::ceil(concurrency / connections));
+    return std::min(std::max(streams, static_cast<size_t>(1)), max_streams_per_connection);
+}
+
+}
@@ -0,0 +1,57 @@
+#ifndef H2LOAD_CONCURRENCY_CONTROLLER_H
+#define H2LOAD_CONCURRENCY_CONTROLLER_H
+#include <cstdint>
+#include <cstddef>
+
+
+namespace h2load
+{
+
+/*
+ * The requests in flight of a worker with adaptive-concurrency, and the connections to carry them.
+ * Little's law gives the requests in flight needed for the target rate at the current latency;
+ * the limit grows to it when requests are held back, by AIMD: it grows by one stream per connection at least,
+ * and is cut by a tenth when the latency goes above latency-tolerance times the lowest latency seen recently,
+ * i.e., when more requests in flight only queue up in the server.
+ */
+class Concurrency_Controller
+{
+public:
+    Concurrency_Controller();
+
+    void init(size_t max_streams_per_connection, size_t max_connections, double latency_tolerance);
+
+    void on_response(uint64_t latency_us);
+
+    // requests were due by the target rate, but all the streams allowed were in use
+    void on_limited();
+
+    // once per control interval, target_rate is the requests per second of the worker
+    void update(double target_rate, size_t connections);
+
+    // the limit of requests in flight of the worker
+    size_t get_concurrency() const;
+
+    // one more or one less than connections at most, so the connections change gradually
+    size_t get_connections_wanted(size_t connections) const;
+
+    size_t get_streams_per_connection(size_t connections) const;
+
+private:
+    size_t max_streams_per_connection;
+    size_t max_connections;
+    double latency_tolerance;
+    double concurrency;
+    uint64_t latency_total_us;
+    uint64_t latency_samples;
+    // mean of the last interval with responses
+    double latency_us;
+    // lowest interval mean of the current and the previous window, so it follows a change of the server
+    double window_min_latency_us;
+    double previous_window_min_latency_us;
+    size_t intervals_in_window;
+    bool limited;
+};
+
+}
+#endif
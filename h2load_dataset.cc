@@ -0,0 +1,286 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "h2load_dataset.h"
+
+
+namespace h2load
+{
+
+namespace
+{
+const char index_file_magic[8] = {'H', '2', 'L', 'R', 'I', 'D', 'X', '2'};
+
+struct Index_File_Header
+{
+    char magic[8];
+    uint64_t data_size;
+    int64_t modification_time;
+    uint64_t row_count;
+    uint32_t offset_width;
+    // 0 if the column counts of the rows follow the offsets
+    uint32_t uniform_column_count;
+};
+}
+
+User_Id_Dataset::User_Id_Dataset():
+    data(nullptr),
+    data_size(0),
+    modification_time(0),
+    row_count(0),
+    uniform_column_count(0)
+#ifndef _WINDOWS
+    , mapped_address(nullptr)
+#endif
+{
+}
+
+User_Id_Dataset::~User_Id_Dataset()
+{
+#ifndef _WINDOWS
+    if (mapped_address)
+    {
+        munmap(mapped_address, data_size);
+    }
+#endif
+}
+
+bool User_Id_Dataset::load(const std::string& file_name, bool use_index_file)
+{
+#ifdef _WINDOWS
+    std::ifstream infile(file_name, std::ios::binary);
+    if (!infile)
+    {
+        std::cerr << "cannot open file: " << file_name << std::endl;
+        return false;
+    }
+    file_content.assign((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+    struct _stat64 st;
+    modification_time = (_stat64(file_name.c_str(), &st) == 0) ? st.st_mtime : 0;
+    data = file_content.c_str();
+    data_size = file_content.size();
+#else
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "cannot open file: " << file_name << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        std::cerr << "cannot stat file: " << file_name << std::endl;
+        close(fd);
+        return false;
+    }
+    data_size = st.st_size;
+    modification_time = st.st_mtime;
+    if (data_size)
+    {
+        mapped_address = mmap(nullptr, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped_address == MAP_FAILED)
+        {
+            std::cerr << "cannot map file: " << file_name << ", error: " << strerror(errno) << std::endl;
+            mapped_address = nullptr;
+            close(fd);
+            return false;
+        }
+        madvise(mapped_address, data_size, MADV_RANDOM);
+        data = static_cast<const char*>(mapped_address);
+    }
+    close(fd);
+#endif
+
+    std::string index_file_name = file_name + ".idx";
+    if (use_index_file && load_row_index(index_file_name))
+    {
+        return row_count > 0;
+    }
+    build_row_index();
+    if (use_index_file)
+    {
+        save_row_index(index_file_name);
+    }
+    return row_count > 0;
+}
+
+void User_Id_Dataset::build_row_index()
+{
+    bool use_32_bit_offset = (data_size <= std::numeric_limits<uint32_t>::max());
+    offsets_32.clear();
+    offsets_64.clear();
+    column_counts.clear();
+    uniform_column_count = 0;
+    const char* end = data + data_size;
+    // first row is column name
+    const char* line = data_size ? static_cast<const char*>(memchr(data, '\n', data_size)) : nullptr;
+    while (line && ++line < end)
+    {
+        const char* next = static_cast<const char*>(memchr(line, '\n', end - line));
+        size_t line_len = (next ? next : end) - line;
+        if (line_len && !(line_len == 1 && line[0] == '\r'))
+        {
+            if (use_32_bit_offset)
+            {
+                offsets_32.push_back(static_cast<uint32_t>(line - data));
+            }
+            else
+            {
+                offsets_64.push_back(line - data);
+            }
+            size_t columns = std::count(line, line + line_len, ',') + 1;
+            columns = std::min(columns, static_cast<size_t>(std::numeric_limits<uint16_t>::max()));
+            if (column_counts.size())
+            {
+                column_counts.push_back(columns);
+            }
+            else if (uniform_column_count == 0)
+            {
+                uniform_column_count = columns;
+            }
+            else if (columns != uniform_column_count)
+            {
+                // rows differ, the count of each row is kept from now on
+                auto rows_so_far = (use_32_bit_offset ? offsets_32.size() : offsets_64.size()) - 1;
+                column_counts.assign(rows_so_far, uniform_column_count);
+                column_counts.push_back(columns);
+                uniform_column_count = 0;
+            }
+        }
+        line = next;
+    }
+    offsets_32.shrink_to_fit();
+    offsets_64.shrink_to_fit();
+    column_counts.shrink_to_fit();
+    row_count = use_32_bit_offset ? offsets_32.size() : offsets_64.size();
+}
+
+bool User_Id_Dataset::load_row_index(const std::string& index_file_name)
+{
+    std::ifstream infile(index_file_name, std::ios::binary);
+    if (!infile)
+    {
+        return false;
+    }
+    Index_File_Header header;
+    if (!infile.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, index_file_magic, sizeof(index_file_magic)) != 0 ||
+        header.data_size != data_size || header.modification_time != modification_time ||
+        (header.offset_width != sizeof(uint32_t) && header.offset_width != sizeof(uint64_t)))
+    {
+        std::cerr << "index file is outdated or invalid, rebuild: " << index_file_name << std::endl;
+        return false;
+    }
+    offsets_32.clear();
+    offsets_64.clear();
+    bool read_ok;
+    if (header.offset_width == sizeof(uint32_t))
+    {
+        offsets_32.resize(header.row_count);
+        read_ok = bool(infile.read(reinterpret_cast<char*>(offsets_32.data()), header.row_count * sizeof(uint32_t)));
+    }
+    else
+    {
+        offsets_64.resize(header.row_count);
+        read_ok = bool(infile.read(reinterpret_cast<char*>(offsets_64.data()), header.row_count * sizeof(uint64_t)));
+    }
+    uniform_column_count = header.uniform_column_count;
+    column_counts.clear();
+    if (read_ok && uniform_column_count == 0)
+    {
+        column_counts.resize(header.row_count);
+        read_ok = bool(infile.read(reinterpret_cast<char*>(column_counts.data()), header.row_count * sizeof(uint16_t)));
+    }
+    if (!read_ok)
+    {
+        std::cerr << "index file is truncated, rebuild: " << index_file_name << std::endl;
+        offsets_32.clear();
+        offsets_64.clear();
+        column_counts.clear();
+        return false;
+    }
+    row_count = header.row_count;
+    return true;
+}
+
+void User_Id_Dataset::save_row_index(const std::string& index_file_name) const
+{
+    std::ofstream outfile(index_file_name, std::ios::binary | std::ios::trunc);
+    if (!outfile)
+    {
+        std::cerr << "cannot write index file: " << index_file_name << std::endl;
+        return;
+    }
+    Index_File_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, index_file_magic, sizeof(index_file_magic));
+    header.data_size = data_size;
+    header.modification_time = modification_time;
+    header.row_count = row_count;
+    header.offset_width = offsets_32.size() ? sizeof(uint32_t) : sizeof(uint64_t);
+    header.uniform_column_count = uniform_column_count;
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (offsets_32.size())
+    {
+        outfile.write(reinterpret_cast<const char*>(offsets_32.data()), offsets_32.size() * sizeof(uint32_t));
+    }
+    else
+    {
+        outfile.write(reinterpret_cast<const char*>(offsets_64.data()), offsets_64.size() * sizeof(uint64_t));
+    }
+    if (column_counts.size())
+    {
+        outfile.write(reinterpret_cast<const char*>(column_counts.data()), column_counts.size() * sizeof(uint16_t));
+    }
+}
+
+nghttp2::StringRef User_Id_Dataset::get_row(size_t row) const
+{
+    if (row >= row_count)
+    {
+        return nghttp2::StringRef();
+    }
+    const char* start = data + get_row_offset(row);
+    const char* end = data + data_size;
+    const char* newline = static_cast<const char*>(memchr(start, '\n', end - start));
+    if (newline)
+    {
+        end = newline;
+    }
+    if (end > start && *(end - 1) == '\r')
+    {
+        end--;
+    }
+    return nghttp2::StringRef(start, end - start);
+}
+
+nghttp2::StringRef User_Id_Dataset::get_column(size_t row, size_t column) const
+{
+    auto line = get_row(row);
+    const char* start = line.c_str();
+    const char* end = start + line.size();
+    for (size_t i = 0; i < column; i++)
+    {
+        auto comma = static_cast<const char*>(memchr(start, ',', end - start));
+        if (!comma)
+        {
+            return nghttp2::StringRef();
+        }
+        start = comma + 1;
+    }
+    auto comma = static_cast<const char*>(memchr(start, ',', end - start));
+    return nghttp2::StringRef(start, (comma ? comma : end) - start);
+}
+
+}
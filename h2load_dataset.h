@@ -0,0 +1,76 @@
+#ifndef H2LOAD_DATASET_H
+#define H2LOAD_DATASET_H
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "template.h"
+
+
+namespace h2load
+{
+
+/*
+ * User id list from a CSV file, memory mapped and indexed by row offset only;
+ * columns are located on access and handed out as StringRef pointing into the mapping.
+ * The first row (column names) and empty rows are skipped.
+ */
+class User_Id_Dataset
+{
+public:
+    User_Id_Dataset();
+    ~User_Id_Dataset();
+    User_Id_Dataset(const User_Id_Dataset&) = delete;
+    User_Id_Dataset& operator=(const User_Id_Dataset&) = delete;
+
+    // with use_index_file, the row index is loaded from (or saved to) <file_name>.idx
+    bool load(const std::string& file_name, bool use_index_file);
+
+    size_t size() const
+    {
+        return row_count;
+    }
+
+    nghttp2::StringRef get_row(size_t row) const;
+
+    // returns an empty StringRef if the row has no such column
+    nghttp2::StringRef get_column(size_t row, size_t column) const;
+
+    size_t get_column_count(size_t row) const
+    {
+        if (row >= row_count)
+        {
+            return 0;
+        }
+        return column_counts.size() ? column_counts[row] : uniform_column_count;
+    }
+
+private:
+    void build_row_index();
+    bool load_row_index(const std::string& index_file_name);
+    void save_row_index(const std::string& index_file_name) const;
+    uint64_t get_row_offset(size_t row) const
+    {
+        return offsets_32.size() ? offsets_32[row] : offsets_64[row];
+    }
+
+    const char* data;
+    uint64_t data_size;
+    int64_t modification_time;
+    size_t row_count;
+    // offset of the start of each row; 32 bit offsets are used if the file is smaller than 4G
+    std::vector<uint32_t> offsets_32;
+    std::vector<uint64_t> offsets_64;
+    // counted once when the index is built: the column count shared by all rows,
+    // or the column count of each row if they differ (uniform_column_count is 0 then)
+    size_t uniform_column_count;
+    std::vector<uint16_t> column_counts;
+#ifdef _WINDOWS
+    std::string file_content;
+#else
+    void* mapped_address;
+#endif
+};
+
+}
+#endif
@@ -0,0 +1,361 @@
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "h2load_dns_cache.h"
+
+
+namespace h2load
+{
+
+namespace
+{
+struct Query
+{
+    std::string key;
+    std::string host;
+    std::string port;
+};
+
+boost::system::error_code to_error_code(int ares_status)
+{
+    switch (ares_status)
+    {
+        case ARES_SUCCESS: // but no address
+        case ARES_ENOTFOUND:
+        case ARES_ENODATA:
+        case ARES_ENONAME:
+            return boost::asio::error::host_not_found;
+        case ARES_ENOMEM:
+            return boost::asio::error::no_memory;
+        case ARES_ECANCELLED:
+        case ARES_EDESTRUCTION:
+            return boost::asio::error::operation_aborted;
+        default:
+            return boost::asio::error::host_not_found_try_again;
+    }
+}
+}
+
+DNS_Cache& DNS_Cache::instance()
+{
+    static DNS_Cache dns_cache;
+    return dns_cache;
+}
+
+DNS_Cache::DNS_Cache():
+    positive_ttl(30000),
+    negative_ttl(1000),
+    resolver_work(new boost::asio::io_service::work(resolver_io_context)),
+    timeout_timer(resolver_io_context)
+{
+    auto status = ares_library_init(ARES_LIB_INIT_ALL);
+    if (status != ARES_SUCCESS)
+    {
+        std::cerr << "ares_library_init failed: " << ares_strerror(status) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    struct ares_options options;
+    options.sock_state_cb = on_socket_state;
+    options.sock_state_cb_data = this;
+    status = ares_init_options(&channel, &options, ARES_OPT_SOCK_STATE_CB);
+    if (status != ARES_SUCCESS)
+    {
+        std::cerr << "c-ares ares_init_options failed: " << ares_strerror(status) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    resolver_thread = std::thread([this]()
+    {
+        resolver_io_context.run();
+    });
+}
+
+DNS_Cache::~DNS_Cache()
+{
+    // the channel belongs to the resolver thread; destroying it closes its sockets, which ends their waits
+    resolver_io_context.post([this]()
+    {
+        ares_destroy(channel);
+        timeout_timer.cancel();
+    });
+    resolver_work.reset();
+    if (resolver_thread.joinable())
+    {
+        resolver_thread.join();
+    }
+    ares_library_cleanup();
+}
+
+void DNS_Cache::set_ttl(std::chrono::milliseconds positive, std::chrono::milliseconds negative)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    positive_ttl = positive;
+    negative_ttl = negative;
+}
+
+void DNS_Cache::resolve(boost::asio::io_service& caller_io_context, const std::string& host, const std::string& port,
+                        Resolve_Callback callback, std::chrono::milliseconds max_age)
+{
+    Caller caller;
+    caller.id = &caller_io_context;
+    caller.post = [&caller_io_context](std::function<void(void)> handler)
+    {
+        caller_io_context.post(std::move(handler));
+    };
+    caller.keep_alive = std::make_shared<boost::asio::io_service::work>(caller_io_context);
+    resolve(std::move(caller), host, port, std::move(callback), max_age);
+}
+
+void DNS_Cache::resolve(Caller caller, const std::string& host, const std::string& port,
+                        Resolve_Callback callback, std::chrono::milliseconds max_age)
+{
+    std::string key = host + ":" + port;
+    Waiter waiter {std::move(caller), std::move(callback)};
+    std::lock_guard<std::mutex> guard(mutex);
+    auto& entry = entries[key];
+    if (entry.has_result)
+    {
+        auto ttl = entry.error ? negative_ttl : entry.ttl;
+        if (max_age.count() && max_age < ttl)
+        {
+            ttl = max_age;
+        }
+        auto age = std::chrono::steady_clock::now() - entry.resolved_at;
+        if (age < ttl)
+        {
+            // refresh ahead of expiry, so busy hosts never see a cache miss
+            if (!entry.error && !entry.query_in_flight && age > ttl * 3 / 4)
+            {
+                start_query(entry, key, host, port);
+            }
+            post_answer(waiter, entry.error, entry.result);
+            return;
+        }
+    }
+    entry.waiters.push_back(std::move(waiter));
+    if (!entry.query_in_flight)
+    {
+        start_query(entry, key, host, port);
+    }
+}
+
+void DNS_Cache::cancel(const void* caller_id)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    for (auto& entry : entries)
+    {
+        auto& waiters = entry.second.waiters;
+        waiters.erase(std::remove_if(waiters.begin(), waiters.end(), [caller_id](const Waiter & waiter)
+        {
+            return waiter.caller.id == caller_id;
+        }), waiters.end());
+    }
+}
+
+void DNS_Cache::start_query(Entry& entry, const std::string& key, const std::string& host, const std::string& port)
+{
+    entry.query_in_flight = true;
+    resolver_io_context.post([this, key, host, port]()
+    {
+        ares_addrinfo_hints hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = ARES_AI_ADDRCONFIG;
+        auto query = new Query {key, host, port};
+        ares_getaddrinfo(channel, host.c_str(), port.empty() ? nullptr : port.c_str(), &hints,
+                         [](void* arg, int status, int timeouts, ares_addrinfo * addrinfo)
+        {
+            std::unique_ptr<Query> query(static_cast<Query*>(arg));
+            if (status == ARES_EDESTRUCTION)
+            {
+                return;
+            }
+            DNS_Cache::instance().on_query_result(query->key, query->host, query->port, status, addrinfo);
+        }, query);
+        start_timeout_timer();
+    });
+}
+
+void DNS_Cache::post_answer(Waiter& waiter, const boost::system::error_code& error,
+                            boost::asio::ip::tcp::resolver::iterator result)
+{
+    // keep_alive goes with the handler, so it is released on the thread of the caller, once the handler has run there
+    waiter.caller.post([callback = std::move(waiter.callback), keep_alive = std::move(waiter.caller.keep_alive),
+                                 error, result]()
+    {
+        callback(error, result);
+    });
+}
+
+void DNS_Cache::on_query_result(const std::string& key, const std::string& host, const std::string& port,
+                                int status, ares_addrinfo* addrinfo)
+{
+    std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+    // seconds the shortest lived record is valid for; entries of the hosts file and numeric hosts come with 0
+    int record_ttl = 0;
+    if (addrinfo)
+    {
+        for (auto node = addrinfo->nodes; node; node = node->ai_next)
+        {
+            boost::asio::ip::tcp::endpoint endpoint;
+            if (node->ai_addrlen > endpoint.capacity())
+            {
+                continue;
+            }
+            memcpy(endpoint.data(), node->ai_addr, node->ai_addrlen);
+            endpoint.resize(node->ai_addrlen);
+            endpoints.push_back(endpoint);
+            if (node->ai_ttl > 0 && (record_ttl == 0 || node->ai_ttl < record_ttl))
+            {
+                record_ttl = node->ai_ttl;
+            }
+        }
+        ares_freeaddrinfo(addrinfo);
+    }
+
+    boost::system::error_code error;
+    boost::asio::ip::tcp::resolver::iterator result;
+    if (endpoints.empty())
+    {
+        error = to_error_code(status);
+    }
+    else
+    {
+        result = boost::asio::ip::tcp::resolver::results_type::create(endpoints.begin(), endpoints.end(), host, port);
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    auto& entry = entries[key];
+    entry.query_in_flight = false;
+    auto now = std::chrono::steady_clock::now();
+    bool still_valid = entry.has_result && !entry.error && (now - entry.resolved_at < entry.ttl);
+    if (error && still_valid)
+    {
+        // a failed refresh does not throw away a result that has not expired yet
+        error = entry.error;
+        result = entry.result;
+    }
+    else
+    {
+        entry.has_result = true;
+        entry.error = error;
+        entry.result = result;
+        entry.resolved_at = now;
+        entry.ttl = positive_ttl;
+        if (record_ttl > 0 && std::chrono::seconds(record_ttl) < positive_ttl)
+        {
+            entry.ttl = std::chrono::seconds(record_ttl);
+        }
+    }
+    // posted with the mutex held, so that nothing is posted to a caller once cancel() has returned
+    for (auto& waiter : entry.waiters)
+    {
+        post_answer(waiter, error, result);
+    }
+    entry.waiters.clear();
+}
+
+void DNS_Cache::on_socket_state(void* data, ares_socket_t fd, int readable, int writable)
+{
+    auto dns_cache = static_cast<DNS_Cache*>(data);
+    auto& socket_watchers = dns_cache->socket_watchers;
+    auto it = socket_watchers.find(fd);
+    if (!readable && !writable)
+    {
+        // c-ares is about to close the socket itself
+        if (it != socket_watchers.end())
+        {
+            boost::system::error_code ignored;
+            it->second->closed = true;
+            it->second->descriptor.cancel(ignored);
+            it->second->descriptor.release();
+            socket_watchers.erase(it);
+        }
+        return;
+    }
+    if (it == socket_watchers.end())
+    {
+        auto watcher = std::make_shared<Socket_Watcher>(dns_cache->resolver_io_context);
+        boost::system::error_code ec;
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+        watcher->descriptor.assign(fd, ec);
+#else
+        watcher->descriptor.assign(boost::asio::ip::udp::v4(), fd, ec);
+#endif
+        if (ec)
+        {
+            // the query is then ended by its timeout
+            std::cerr << "dns cache cannot wait on c-ares socket: " << ec.message() << std::endl;
+            return;
+        }
+        it = socket_watchers.emplace(fd, watcher).first;
+    }
+    it->second->want_read = readable;
+    it->second->want_write = writable;
+    dns_cache->wait_for_socket(fd, it->second);
+}
+
+void DNS_Cache::wait_for_socket(ares_socket_t fd, const std::shared_ptr<Socket_Watcher>& watcher)
+{
+    if (watcher->want_read && !watcher->read_pending)
+    {
+        watcher->read_pending = true;
+        watcher->descriptor.async_wait(Socket_Watcher::Descriptor::wait_read,
+                                       [this, fd, watcher](const boost::system::error_code & ec)
+        {
+            watcher->read_pending = false;
+            if (ec || watcher->closed)
+            {
+                return;
+            }
+            ares_process_fd(channel, fd, ARES_SOCKET_BAD);
+            start_timeout_timer();
+            if (!watcher->closed)
+            {
+                wait_for_socket(fd, watcher);
+            }
+        });
+    }
+    if (watcher->want_write && !watcher->write_pending)
+    {
+        watcher->write_pending = true;
+        watcher->descriptor.async_wait(Socket_Watcher::Descriptor::wait_write,
+                                       [this, fd, watcher](const boost::system::error_code & ec)
+        {
+            watcher->write_pending = false;
+            if (ec || watcher->closed)
+            {
+                return;
+            }
+            ares_process_fd(channel, ARES_SOCKET_BAD, fd);
+            start_timeout_timer();
+            if (!watcher->closed)
+            {
+                wait_for_socket(fd, watcher);
+            }
+        });
+    }
+}
+
+void DNS_Cache::start_timeout_timer()
+{
+    struct timeval tv;
+    if (!ares_timeout(channel, nullptr, &tv))
+    {
+        timeout_timer.cancel();
+        return;
+    }
+    timeout_timer.expires_from_now(std::chrono::seconds(tv.tv_sec) + std::chrono::microseconds(tv.tv_usec));
+    timeout_timer.async_wait([this](const boost::system::error_code & ec)
+    {
+        if (ec)
+        {
+            return;
+        }
+        ares_process_fd(channel, ARES_SOCKET_BAD, ARES_SOCKET_BAD);
+        start_timeout_timer();
+    });
+}
+
+}
@@ -0,0 +1,131 @@
+#ifndef H2LOAD_DNS_CACHE_H
+#define H2LOAD_DNS_CACHE_H
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <functional>
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+extern "C" {
+#include <ares.h>
+}
+
+
+namespace h2load
+{
+
+/*
+ * Process wide cache of name resolution results, shared by all workers and connections.
+ * Concurrent lookups of the same host:port are coalesced into one query, results are kept for the TTL of their records
+ * (at most the configured positive TTL), failures for a (shorter) negative TTL, and an entry that is used late in its lifetime
+ * is refreshed in the background, so that a reconnect storm costs at most one query per host.
+ * Queries run with c-ares on a resolver thread of the cache; callbacks are posted to the thread of the caller.
+ */
+class DNS_Cache: private boost::noncopyable
+{
+public:
+    using Resolve_Callback = std::function<void(const boost::system::error_code&,
+                                                boost::asio::ip::tcp::resolver::iterator)>;
+
+    // where the answers for a caller go
+    struct Caller
+    {
+        // identifies the caller to cancel()
+        const void* id;
+        // runs a handler on the thread of the caller
+        std::function<void(std::function<void(void)>)> post;
+        // held until the answer has run on the thread of the caller, or is cancelled, e.g. an io_service::work
+        std::shared_ptr<void> keep_alive;
+    };
+
+    static DNS_Cache& instance();
+
+    // a positive TTL of 0 disables caching, concurrent lookups are still coalesced
+    void set_ttl(std::chrono::milliseconds positive, std::chrono::milliseconds negative);
+
+    // max_age, if non-zero, is the oldest cached result this caller accepts
+    void resolve(boost::asio::io_service& caller_io_context, const std::string& host, const std::string& port,
+                 Resolve_Callback callback, std::chrono::milliseconds max_age = std::chrono::milliseconds(0));
+
+    void resolve(Caller caller, const std::string& host, const std::string& port,
+                 Resolve_Callback callback, std::chrono::milliseconds max_age = std::chrono::milliseconds(0));
+
+    // drops the answers not yet posted to the caller, io_service callers are identified by their io_service;
+    // the queries go on and fill the cache for other callers
+    void cancel(const void* caller_id);
+
+private:
+    struct Waiter
+    {
+        Caller caller;
+        Resolve_Callback callback;
+    };
+
+    struct Entry
+    {
+        bool has_result = false;
+        bool query_in_flight = false;
+        boost::system::error_code error;
+        boost::asio::ip::tcp::resolver::iterator result;
+        std::chrono::steady_clock::time_point resolved_at;
+        std::chrono::milliseconds ttl {0};
+        std::vector<Waiter> waiters;
+    };
+
+    // a socket of c-ares, waited on by the resolver thread until c-ares closes it
+    struct Socket_Watcher
+    {
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+        using Descriptor = boost::asio::posix::stream_descriptor;
+#else
+        using Descriptor = boost::asio::ip::udp::socket;
+#endif
+        Descriptor descriptor;
+        bool want_read = false;
+        bool want_write = false;
+        bool read_pending = false;
+        bool write_pending = false;
+        bool closed = false;
+        explicit Socket_Watcher(boost::asio::io_service& io_context): descriptor(io_context) {}
+    };
+
+    DNS_Cache();
+    ~DNS_Cache();
+
+    // called with mutex held
+    void start_query(Entry& entry, const std::string& key, const std::string& host, const std::string& port);
+
+    // called with mutex held
+    void post_answer(Waiter& waiter, const boost::system::error_code& error,
+                     boost::asio::ip::tcp::resolver::iterator result);
+
+    // the rest runs on the resolver thread
+    void on_query_result(const std::string& key, const std::string& host, const std::string& port,
+                         int status, ares_addrinfo* addrinfo);
+
+    static void on_socket_state(void* data, ares_socket_t fd, int readable, int writable);
+
+    void wait_for_socket(ares_socket_t fd, const std::shared_ptr<Socket_Watcher>& watcher);
+
+    void start_timeout_timer();
+
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    std::chrono::milliseconds positive_ttl;
+    std::chrono::milliseconds negative_ttl;
+    boost::asio::io_service resolver_io_context;
+    std::unique_ptr<boost::asio::io_service::work> resolver_work;
+    ares_channel channel;
+    std::map<ares_socket_t, std::shared_ptr<Socket_Watcher>> socket_watchers;
+    boost::asio::steady_timer timeout_timer;
+    std::thread resolver_thread;
+};
+
+}
+#endif
@@ -0,0 +1,273 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <future>
+#include <ctime>
+
+#include <boost/asio/io_service.hpp>
+
+#include "h2load_failure_log.h"
+#include "base_worker.h"
+
+
+namespace h2load
+{
+
+namespace
+{
+
+// the one thread which formats and writes failed-request-log-file
+class Failure_Log_Writer
+{
+public:
+    static Failure_Log_Writer& instance()
+    {
+        static Failure_Log_Writer writer;
+        return writer;
+    }
+
+    void post(std::function<void(void)> job)
+    {
+        io_service.post(std::move(job));
+    }
+
+    // to be called from the log thread only
+    std::ofstream& get_file(const std::string& file_name)
+    {
+        if (!file.is_open())
+        {
+            file.open(file_name);
+        }
+        return file;
+    }
+
+private:
+    Failure_Log_Writer():
+        work(io_service),
+        writer_thread([this]()
+    {
+        io_service.run();
+    })
+    {
+    }
+
+    ~Failure_Log_Writer()
+    {
+        io_service.stop();
+        writer_thread.join();
+    }
+
+    boost::asio::io_service io_service;
+    boost::asio::io_service::work work;
+    std::ofstream file;
+    // last, so that it starts when the rest is ready
+    std::thread writer_thread;
+};
+
+std::string format_wall_time(std::chrono::system_clock::time_point time_point)
+{
+    auto time_c = std::chrono::system_clock::to_time_t(time_point);
+    std::tm time_tm;
+#ifdef _WINDOWS
+    localtime_s(&time_tm, &time_c);
+#else
+    localtime_r(&time_c, &time_tm);
+#endif
+    std::stringstream ss;
+    ss << std::put_time(&time_tm, "%F %T");
+    return ss.str();
+}
+
+void write_interval(const std::string& file_name, uint32_t worker_id,
+                    std::chrono::system_clock::time_point interval_wall_start,
+                    std::chrono::system_clock::time_point interval_wall_end,
+                    const std::map<uint32_t, uint64_t>& interval_class_counts,
+                    std::vector<Failure_Record>& records)
+{
+    std::sort(records.begin(), records.end(), [](const Failure_Record & a, const Failure_Record & b)
+    {
+        return a.failure_wall_time < b.failure_wall_time;
+    });
+
+    auto& log_file = Failure_Log_Writer::instance().get_file(file_name);
+    log_file << "worker " << worker_id << ", failures from " << format_wall_time(interval_wall_start)
+             << " to " << format_wall_time(interval_wall_end) << ", " << records.size() << " sampled:" << std::endl;
+    for (auto& class_count : interval_class_counts)
+    {
+        log_file << get_error_class_name(class_count.first) << ": " << class_count.second << std::endl;
+    }
+    log_file << std::endl;
+
+    for (auto& record : records)
+    {
+        log_file << "error class: " << get_error_class_name(record.error_class) << std::endl;
+        log_file << "start timestamp: " << format_wall_time(record.request_wall_time) << std::endl;
+        log_file << "current time: " << format_wall_time(record.failure_wall_time) << std::endl;
+        log_file << "duration(ms): " << record.duration.count() << std::endl;
+        log_file << *record.request;
+        log_file << std::endl;
+    }
+    log_file.flush();
+}
+
+}
+
+std::string get_error_class_name(uint32_t error_class)
+{
+    auto status = std::to_string(error_class % 1000);
+    switch (error_class / 1000)
+    {
+        case FAILURE_RESPONSE_MATCH:
+            return "response-match failed, status " + status;
+        case FAILURE_VALIDATE_RESPONSE:
+            return "validate_response failed, status " + status;
+        default:
+            return "status " + status;
+    }
+}
+
+Failure_Log::Failure_Log(const Config_Schema& config_schema, uint32_t worker_id):
+    config_schema(config_schema),
+    worker_id(worker_id),
+    enabled(config_schema.failed_request_log_file.size()),
+    interval_start(std::chrono::steady_clock::now()),
+    interval_wall_start(std::chrono::system_clock::now()),
+    ring_next(0),
+    reservoir_candidates(0),
+    generator(worker_id)
+{
+}
+
+Failure_Record Failure_Log::make_record(uint32_t error_class, const Request_Data& failed_request,
+                                        const RequestStat& req_stat)
+{
+    Failure_Record failure_record;
+    failure_record.error_class = error_class;
+    failure_record.request_wall_time = req_stat.request_wall_time;
+    failure_record.failure_wall_time = std::chrono::system_clock::now();
+    failure_record.duration = std::chrono::duration_cast<std::chrono::milliseconds>(req_stat.stream_close_time -
+                                                                                    req_stat.request_time);
+    failure_record.request = std::make_shared<Request_Data>(failed_request.snapshot());
+    failure_record.request->saved_cookies = failed_request.saved_cookies;
+    return failure_record;
+}
+
+void Failure_Log::record(uint32_t error_class, const Request_Data& failed_request, const RequestStat& req_stat)
+{
+    ++class_counts[error_class];
+    if (!enabled)
+    {
+        return;
+    }
+
+    auto count_in_interval = ++interval_class_counts[error_class];
+    if (count_in_interval <= config_schema.failed_request_log_samples_per_class)
+    {
+        size_t ring_size = config_schema.failed_request_log_ring_size;
+        if (!ring_size)
+        {
+            return;
+        }
+        if (ring.size() < ring_size)
+        {
+            ring.push_back(make_record(error_class, failed_request, req_stat));
+        }
+        else
+        {
+            ring[ring_next] = make_record(error_class, failed_request, req_stat);
+        }
+        ring_next = (ring_next + 1) % ring_size;
+        return;
+    }
+
+    // reservoir sampling of the failures beyond the first ones of their class
+    size_t reservoir_size = config_schema.failed_request_log_reservoir_size;
+    if (!reservoir_size)
+    {
+        return;
+    }
+    ++reservoir_candidates;
+    if (reservoir.size() < reservoir_size)
+    {
+        reservoir.push_back(make_record(error_class, failed_request, req_stat));
+        return;
+    }
+    auto slot = generator() % reservoir_candidates;
+    if (slot < reservoir_size)
+    {
+        reservoir[slot] = make_record(error_class, failed_request, req_stat);
+    }
+}
+
+void Failure_Log::flush(std::chrono::steady_clock::time_point now, bool force)
+{
+    auto interval = std::chrono::seconds(std::max(config_schema.statistics_interval, static_cast<uint32_t>(1)));
+    if (!force && now - interval_start < interval)
+    {
+        return;
+    }
+    interval_start = now;
+    auto interval_wall_end = std::chrono::system_clock::now();
+    auto wall_start = interval_wall_start;
+    interval_wall_start = interval_wall_end;
+
+    if (!enabled || interval_class_counts.empty())
+    {
+        return;
+    }
+
+    auto records = std::make_shared<std::vector<Failure_Record>>(std::move(ring));
+    std::move(reservoir.begin(), reservoir.end(), std::back_inserter(*records));
+    auto counts = std::make_shared<std::map<uint32_t, uint64_t>>(std::move(interval_class_counts));
+    ring.clear();
+    ring_next = 0;
+    reservoir.clear();
+    reservoir_candidates = 0;
+    interval_class_counts.clear();
+
+    auto file_name = config_schema.failed_request_log_file;
+    auto id = worker_id;
+    Failure_Log_Writer::instance().post([file_name, id, wall_start, interval_wall_end, counts, records]()
+    {
+        write_interval(file_name, id, wall_start, interval_wall_end, *counts, *records);
+    });
+}
+
+void drain_failure_log()
+{
+    std::promise<void> drained;
+    Failure_Log_Writer::instance().post([&drained]()
+    {
+        drained.set_value();
+    });
+    drained.get_future().wait();
+}
+
+void print_failure_class_summary(const std::vector<std::shared_ptr<base_worker>>& workers)
+{
+    std::map<uint32_t, uint64_t> class_counts;
+    for (auto& w : workers)
+    {
+        for (auto& class_count : w->failure_log.get_class_counts())
+        {
+            class_counts[class_count.first] += class_count.second;
+        }
+    }
+    if (class_counts.empty())
+    {
+        return;
+    }
+    std::stringstream outputStream;
+    outputStream << "failed responses by class:" << std::endl;
+    for (auto& class_count : class_counts)
+    {
+        outputStream << get_error_class_name(class_count.first) << ": " << class_count.second << std::endl;
+    }
+    std::cerr << outputStream.str();
+}
+
+}
@@ -0,0 +1,91 @@
+#ifndef H2LOAD_FAILURE_LOG_H
+#define H2LOAD_FAILURE_LOG_H
+#include <vector>
+#include <map>
+#include <memory>
+#include <random>
+#include <chrono>
+
+#include "config_schema.h"
+#include "h2load.h"
+#include "h2load_stats.h"
+
+namespace h2load
+{
+
+class base_worker;
+
+enum Failure_Reason
+{
+    FAILURE_STATUS_CODE = 0,
+    FAILURE_RESPONSE_MATCH,
+    FAILURE_VALIDATE_RESPONSE
+};
+
+// the reason and the status code
+inline uint32_t get_error_class(Failure_Reason reason, uint16_t status)
+{
+    return static_cast<uint32_t>(reason) * 1000 + status;
+}
+
+std::string get_error_class_name(uint32_t error_class);
+
+// what is kept of a sampled failure, formatted by the log thread
+struct Failure_Record
+{
+    uint32_t error_class;
+    std::chrono::system_clock::time_point request_wall_time;
+    std::chrono::system_clock::time_point failure_wall_time;
+    std::chrono::milliseconds duration;
+    std::shared_ptr<Request_Data> request;
+};
+
+/*
+ * Failures of a worker: counted by error class, and sampled for failed-request-log-file,
+ * the first failed-request-log-samples-per-class of each class in an interval go to a ring,
+ * and failed-request-log-reservoir-size of the rest are picked at random.
+ * Records are handed to the log thread once every statistics-interval, and formatted there,
+ * so that a storm of failures costs the worker thread little more than a counter.
+ */
+class Failure_Log
+{
+public:
+    explicit Failure_Log(const Config_Schema& config_schema, uint32_t worker_id);
+
+    void record(uint32_t error_class, const Request_Data& failed_request, const RequestStat& req_stat);
+
+    // hands what the interval has to the log thread, if the interval is over, or force is true
+    void flush(std::chrono::steady_clock::time_point now, bool force = false);
+
+    // of the whole test
+    const std::map<uint32_t, uint64_t>& get_class_counts() const
+    {
+        return class_counts;
+    }
+
+private:
+    Failure_Record make_record(uint32_t error_class, const Request_Data& failed_request, const RequestStat& req_stat);
+
+    const Config_Schema& config_schema;
+    uint32_t worker_id;
+    bool enabled;
+    std::map<uint32_t, uint64_t> class_counts;
+    std::map<uint32_t, uint64_t> interval_class_counts;
+    std::chrono::steady_clock::time_point interval_start;
+    std::chrono::system_clock::time_point interval_wall_start;
+    std::vector<Failure_Record> ring;
+    size_t ring_next;
+    std::vector<Failure_Record> reservoir;
+    // failures which were candidates of the reservoir in this interval
+    uint64_t reservoir_candidates;
+    std::mt19937_64 generator;
+};
+
+// waits until the log thread has written all that has been handed to it
+void drain_failure_log();
+
+// failed responses of all workers by error class, nothing if there is none
+void print_failure_class_summary(const std::vector<std::shared_ptr<base_worker>>& workers);
+
+}
+#endif
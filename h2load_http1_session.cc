@@ -54,6 +54,7 @@ int htp_msg_begincb(llhttp_t* htp)
     {
         return -1;
     }
+    session->on_header_frame_callback_called = false;
 
     return 0;
 }
@@ -156,7 +157,7 @@ int htp_hdr_valcb(llhttp_t* htp, const char* data, size_t len)
     if (!session->on_header_frame_callback_called)
     {
         client->on_header_frame_begin(session->stream_resp_counter_, 0);
-        session->on_header_frame_callback_called == true;
+        session->on_header_frame_callback_called = true;
     }
     client->on_header(session->stream_resp_counter_,
                       (uint8_t*)(session->hdr_name.c_str()),
@@ -173,6 +174,11 @@ namespace
 {
 int htp_hdrs_completecb(llhttp_t* htp)
 {
+    if (htp->status_code / 100 != 1)
+    {
+        auto session = static_cast<Http1Session*>(htp->data);
+        session->get_client()->on_header_frame_end(session->stream_resp_counter_);
+    }
     return !http2::expect_response_body(htp->status_code);
 }
 } // namespace
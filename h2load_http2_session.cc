@@ -112,6 +112,7 @@ int on_frame_recv_callback(nghttp2_session* session, const nghttp2_frame* frame,
     {
         client->record_ttfb();
     }
+    client->on_header_frame_end(frame->hd.stream_id);
     return 0;
 }
 } // namespace
@@ -143,7 +144,11 @@ int on_data_chunk_recv_callback(nghttp2_session* session, uint8_t flags,
                                 size_t len, void* user_data)
 {
     auto client = static_cast<base_client*>(user_data);
-    client->on_data_chunk(stream_id, data, len);
+    // the window is given back here, unless the chunk is held, see base_client::consume_response_data
+    if (!client->on_data_chunk(stream_id, data, len))
+    {
+        nghttp2_session_consume(session, stream_id, len);
+    }
     client->record_ttfb();
     client->get_stats().bytes_body += len;
     return 0;
@@ -304,6 +309,9 @@ void Http2Session::on_connect()
 
     //nghttp2_option_set_no_http_messaging(opt, 1);
 
+    // the received data is given back to flow control by on_data_chunk_recv_callback, so that a relayed response can hold it
+    nghttp2_option_set_no_auto_window_update(opt, 1);
+
     if (config->encoder_header_table_size != NGHTTP2_DEFAULT_HEADER_TABLE_SIZE)
     {
         nghttp2_option_set_max_deflate_dynamic_table_size(
@@ -425,6 +433,11 @@ void Http2Session::submit_rst_stream(int32_t stream_id)
     nghttp2_submit_rst_stream(session_, NGHTTP2_FLAG_END_STREAM, stream_id, NGHTTP2_STREAM_CLOSED);
 }
 
+void Http2Session::consume(int32_t stream_id, size_t len)
+{
+    nghttp2_session_consume(session_, stream_id, len);
+}
+
 int Http2Session::_submit_request()
 {
     if (nghttp2_session_check_request_allowed(session_) == 0)
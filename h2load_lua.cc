@@ -1380,63 +1380,17 @@ int resolve_hostname(lua_State* L)
         lua_resume_if_yielded(L, 1);
     };
 
-    if (get_runtime_data(L).host_resolution_data.count(hostname) &&
-        /* get_runtime_data(L).host_resolution_data[hostname].ip_addresses.size() && */ // make it fail early
-        get_runtime_data(L).host_resolution_data[hostname].expire_time_point > std::chrono::steady_clock::now())
+    // lookups are shared with all workers and connections through the DNS cache; ttl caps the age of the answer
+    auto worker = get_worker(L);
+    auto resolve_callback = [return_addresses, L](std::vector<std::string>& resolved_addresses)
     {
-        auto& ip_addresses = get_runtime_data(L).host_resolution_data[hostname].ip_addresses;
-        return_addresses(L, ip_addresses);
-    }
-    else
+        return_addresses(L, resolved_addresses);
+    };
+    auto resolve_in_worker = [hostname, resolve_callback, worker, ttl]()
     {
-        auto worker = get_worker(L);
-        auto worker_id = get_worker_index(L);
-        auto group_id = get_group_id(L);
-        auto resolve_callback = [return_addresses, hostname, L, worker_id, group_id,
-                                                   ttl](std::vector<std::string>& resolved_addresses)
-        {
-            auto& lua_sates_await_result = get_runtime_data(L).host_resolution_data[hostname].lua_sates_await_result;
-            if (lua_sates_await_result.size() && lua_sates_await_result[0] == L)
-            {
-                get_runtime_data(L).host_resolution_data[hostname].ip_addresses = std::move(resolved_addresses);
-                get_runtime_data(L).host_resolution_data[hostname].expire_time_point = std::chrono::steady_clock::now() +
-                                                                                       std::chrono::milliseconds(ttl);
-                auto lua_states_to_resume = std::move(lua_sates_await_result);
-                auto& ip_addresses = get_runtime_data(L).host_resolution_data[hostname].ip_addresses;
-                for (auto& l : lua_states_to_resume)
-                {
-                    return_addresses(l, ip_addresses);
-                }
-            }
-            else
-            {
-                return_addresses(L, resolved_addresses);
-            }
-        };
-        auto resolve_in_worker = [hostname, L, resolve_callback, worker, worker_id, group_id]()
-        {
-            if (get_runtime_data(L).host_resolution_data[hostname].ip_addresses.size() &&
-                get_runtime_data(L).host_resolution_data[hostname].expire_time_point <= std::chrono::steady_clock::now())
-            {
-                get_runtime_data(L).host_resolution_data[hostname].ip_addresses.clear();
-            }
-
-            if (get_runtime_data(L).host_resolution_data[hostname].ip_addresses.size())
-            {
-                resolve_callback(get_runtime_data(L).host_resolution_data[hostname].ip_addresses);
-            }
-            else if (get_runtime_data(L).host_resolution_data[hostname].lua_sates_await_result.size())
-            {
-                get_runtime_data(L).host_resolution_data[hostname].lua_sates_await_result.push_back(L);
-            }
-            else
-            {
-                get_runtime_data(L).host_resolution_data[hostname].lua_sates_await_result.push_back(L);
-                worker->resolve_hostname(hostname, resolve_callback);
-            }
-        };
-        worker->get_io_context().post(resolve_in_worker);
-    }
+        worker->resolve_hostname(hostname, resolve_callback, std::chrono::milliseconds(ttl));
+    };
+    worker->get_io_context().post(resolve_in_worker);
     return leave_c_function(L);
 }
 
@@ -111,17 +111,9 @@ struct Lua_State_Data
     int64_t unique_id_within_group = 0;
 };
 
-struct Host_Resolution_Data
-{
-    std::vector<lua_State*> lua_sates_await_result;
-    std::vector<std::string> ip_addresses;
-    std::chrono::steady_clock::time_point expire_time_point;
-};
-
 struct Data_Per_Worker_Thread
 {
     std::map<lua_State*, int> coroutine_references;
-    std::map<std::string, Host_Resolution_Data> host_resolution_data;
     std::vector<lua_State*> lua_coroutine_pools;
     std::shared_ptr<lua_State> lua_main_states_per_worker;
     std::map<lua_State*, Lua_State_Data> lua_state_data;
@@ -0,0 +1,193 @@
+#include <iostream>
+
+#include <boost/bind/bind.hpp>
+
+#include "h2load_lua_script_pool.h"
+
+
+namespace h2load
+{
+
+namespace
+{
+
+struct Script_Thread_Lua_States
+{
+    std::vector<std::vector<lua_State*>> states;
+    ~Script_Thread_Lua_States()
+    {
+        for (auto& requests_lua_states : states)
+        {
+            for (auto L : requests_lua_states)
+            {
+                if (L)
+                {
+                    lua_close(L);
+                }
+            }
+        }
+    }
+};
+
+// a script thread serves one pool only
+thread_local Script_Thread_Lua_States script_thread_lua_states;
+
+const Request_Data& check_request_data_handle(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TLIGHTUSERDATA);
+    return *static_cast<const Request_Data*>(lua_touserdata(L, 1));
+}
+
+const std::string* find_request_pseudo_header(const Request_Data& request, const std::string& name)
+{
+    if (name == method_header)
+    {
+        return request.method;
+    }
+    else if (name == path_header)
+    {
+        return request.path;
+    }
+    else if (name == scheme_header)
+    {
+        return request.schema;
+    }
+    else if (name == authority_header)
+    {
+        return request.authority;
+    }
+    return nullptr;
+}
+
+// response_header(response, name): value of the header, the pseudo headers of the request included, or nil
+int response_header(lua_State* L)
+{
+    auto& request = check_request_data_handle(L);
+    size_t len;
+    const char* name = luaL_checklstring(L, 2, &len);
+    std::string header_name(name, len);
+    const std::string* value = find_request_pseudo_header(request, header_name);
+    for (auto& header_map : request.resp_headers)
+    {
+        auto header = header_map.find(header_name);
+        if (header != header_map.end())
+        {
+            value = &header->second;
+        }
+    }
+    if (value)
+    {
+        lua_pushlstring(L, value->c_str(), value->size());
+    }
+    else
+    {
+        lua_pushnil(L);
+    }
+    return 1;
+}
+
+// response_body(response)
+int response_body(lua_State* L)
+{
+    auto& request = check_request_data_handle(L);
+    lua_pushlstring(L, request.resp_payload.c_str(), request.resp_payload.size());
+    return 1;
+}
+
+// response_status(response)
+int response_status(lua_State* L)
+{
+    auto& request = check_request_data_handle(L);
+    lua_pushinteger(L, request.status_code);
+    return 1;
+}
+
+// response_headers(response): all the headers in a table, as the scripts get without lua-zero-copy
+int response_headers(lua_State* L)
+{
+    auto& request = check_request_data_handle(L);
+    lua_createtable(L, 0, 4);
+    for (auto& header_map : request.resp_headers)
+    {
+        for (auto& header : header_map)
+        {
+            lua_pushlstring(L, header.first.c_str(), header.first.size());
+            lua_pushlstring(L, header.second.c_str(), header.second.size());
+            lua_rawset(L, -3);
+        }
+    }
+    for (auto name : {&method_header, &path_header, &scheme_header, &authority_header})
+    {
+        auto value = find_request_pseudo_header(request, *name);
+        lua_pushlstring(L, name->c_str(), name->size());
+        lua_pushlstring(L, value->c_str(), value->size());
+        lua_rawset(L, -3);
+    }
+    return 1;
+}
+
+}
+
+Lua_Script_Pool::Lua_Script_Pool(const Config_Schema& config_schema, size_t number_of_threads):
+    config_schema(config_schema),
+    work(new boost::asio::io_service::work(io_service))
+{
+    for (size_t i = 0; i < number_of_threads; i++)
+    {
+        threads.create_thread(boost::bind(&boost::asio::io_service::run, &io_service));
+    }
+}
+
+Lua_Script_Pool::~Lua_Script_Pool()
+{
+    work.reset();
+    io_service.stop();
+    threads.join_all();
+}
+
+void Lua_Script_Pool::post(std::function<void(void)> job)
+{
+    io_service.post(std::move(job));
+}
+
+lua_State* Lua_Script_Pool::get_lua_state(size_t scenario_index, size_t request_index)
+{
+    auto& states = script_thread_lua_states.states;
+    if (states.empty())
+    {
+        states.resize(config_schema.scenarios.size());
+    }
+    auto& requests_lua_states = states[scenario_index];
+    if (requests_lua_states.empty())
+    {
+        requests_lua_states.resize(config_schema.scenarios[scenario_index].requests.size(), nullptr);
+    }
+    auto& L = requests_lua_states[request_index];
+    if (!L)
+    {
+        L = create_request_lua_state(config_schema.scenarios[scenario_index].requests[request_index]);
+    }
+    return L;
+}
+
+lua_State* create_request_lua_state(const Request& request)
+{
+    auto L = luaL_newstate();
+    luaL_openlibs(L);
+    lua_register(L, "response_header", response_header);
+    lua_register(L, "response_body", response_body);
+    lua_register(L, "response_status", response_status);
+    lua_register(L, "response_headers", response_headers);
+    if (request.luaScript.size())
+    {
+        luaL_dostring(L, request.luaScript.c_str());
+    }
+    return L;
+}
+
+void push_request_data_handle(lua_State* L, const Request_Data& finished_request)
+{
+    lua_pushlightuserdata(L, const_cast<Request_Data*>(&finished_request));
+}
+
+}
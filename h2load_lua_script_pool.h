@@ -0,0 +1,55 @@
+#ifndef H2LOAD_LUA_SCRIPT_POOL_H
+#define H2LOAD_LUA_SCRIPT_POOL_H
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/noncopyable.hpp>
+
+extern "C" {
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+}
+
+#include "config_schema.h"
+#include "h2load.h"
+
+namespace h2load
+{
+
+/*
+ * Script threads of a worker, which run the validate_response and make_request functions of the scenarios,
+ * see lua-script-threads. Each script thread has its own Lua state for each request of the scenarios.
+ * The results are delivered back to the worker thread by the jobs themselves.
+ */
+class Lua_Script_Pool: private boost::noncopyable
+{
+public:
+    Lua_Script_Pool(const Config_Schema& config_schema, size_t number_of_threads);
+
+    // jobs which have not started yet are dropped
+    ~Lua_Script_Pool();
+
+    void post(std::function<void(void)> job);
+
+    // Lua state of the calling script thread for the request, created on first use
+    lua_State* get_lua_state(size_t scenario_index, size_t request_index);
+
+private:
+    const Config_Schema& config_schema;
+    boost::asio::io_service io_service;
+    std::unique_ptr<boost::asio::io_service::work> work;
+    boost::thread_group threads;
+};
+
+// new Lua state with the script of the request loaded, and the response accessors of lua-zero-copy registered
+lua_State* create_request_lua_state(const Request& request);
+
+// with lua-zero-copy, the finished request is passed to the script as a light userdata, valid during the call only
+void push_request_data_handle(lua_State* L, const Request_Data& finished_request);
+
+}
+#endif
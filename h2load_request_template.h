@@ -0,0 +1,95 @@
+#ifndef H2LOAD_REQUEST_TEMPLATE_H
+#define H2LOAD_REQUEST_TEMPLATE_H
+#include <string>
+#include <vector>
+#include <limits>
+
+
+namespace h2load
+{
+
+/*
+ * A path, payload or header value of a request template, compiled into literal slices, each followed by an
+ * optional variable reference; rendering appends the slices and the variable values to the output in one pass.
+ */
+class Template_String
+{
+public:
+    static const size_t no_variable = std::numeric_limits<size_t>::max();
+
+    struct Segment
+    {
+        std::string literal;
+        size_t variable_index;
+    };
+
+    void compile(const std::string& source, const std::vector<std::string>& variable_names)
+    {
+        segments.clear();
+        literal_size = 0;
+        size_t start = 0;
+        while (true)
+        {
+            size_t found_pos = std::string::npos;
+            size_t found_index = no_variable;
+            for (size_t i = 0; i < variable_names.size(); i++)
+            {
+                if (variable_names[i].empty())
+                {
+                    continue;
+                }
+                size_t pos = source.find(variable_names[i], start);
+                if (pos < found_pos ||
+                    (pos != std::string::npos && pos == found_pos && variable_names[i].size() > variable_names[found_index].size()))
+                {
+                    found_pos = pos;
+                    found_index = i;
+                }
+            }
+            segments.push_back({source.substr(start, found_pos == std::string::npos ? std::string::npos : found_pos - start), found_index});
+            literal_size += segments.back().literal.size();
+            if (found_pos == std::string::npos)
+            {
+                break;
+            }
+            start = found_pos + variable_names[found_index].size();
+        }
+    }
+
+    bool has_variable() const
+    {
+        return segments.size() > 1;
+    }
+
+    // the source itself if it has no variable, to be used with no rendering, otherwise nullptr
+    std::string* literal()
+    {
+        return segments.size() == 1 ? &segments[0].literal : nullptr;
+    }
+
+    // produce_variable_value(variable_index, output) is expected to append the variable value to output
+    template<typename Variable_Producer>
+    void render(std::string& output, Variable_Producer&& produce_variable_value) const
+    {
+        if (segments.empty())
+        {
+            return;
+        }
+        output.reserve(output.size() + literal_size + (segments.size() - 1) * 16);
+        for (auto& segment : segments)
+        {
+            output.append(segment.literal);
+            if (segment.variable_index != no_variable)
+            {
+                produce_variable_value(segment.variable_index, output);
+            }
+        }
+    }
+
+private:
+    std::vector<Segment> segments;
+    size_t literal_size = 0;
+};
+
+}
+#endif
@@ -0,0 +1,183 @@
+#include <numeric>
+#include <algorithm>
+
+#include "h2load_scenario_scheduler.h"
+
+
+namespace h2load
+{
+
+namespace
+{
+// a precomputed round-robin sequence is used up to this weight period, beyond it the pick is computed per call
+const uint64_t max_exact_sequence_length = 65536;
+}
+
+Scenario_Scheduler::Scenario_Scheduler():
+    exact_ratio(false),
+    generator(std::random_device {}()),
+    total_weight(0),
+    sequence_cursor(0)
+{
+}
+
+void Scenario_Scheduler::set_seed(uint64_t seed)
+{
+    generator.seed(seed);
+}
+
+void Scenario_Scheduler::set_exact_ratio(bool exact)
+{
+    exact_ratio = exact;
+}
+
+void Scenario_Scheduler::update_weights(const std::vector<uint64_t>& new_weights)
+{
+    weights = new_weights;
+    auto gcd = [](uint64_t a, uint64_t b)
+    {
+        while (b)
+        {
+            auto t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    };
+    uint64_t divisor = 0;
+    for (auto w : weights)
+    {
+        divisor = gcd(divisor, w);
+    }
+    total_weight = 0;
+    for (auto& w : weights)
+    {
+        w = divisor ? w / divisor : 0;
+        total_weight += w;
+    }
+    probability.clear();
+    alias.clear();
+    exact_sequence.clear();
+    current_weight.assign(weights.size(), 0);
+    sequence_cursor = 0;
+    if (total_weight == 0)
+    {
+        return;
+    }
+    if (exact_ratio)
+    {
+        build_exact_sequence();
+    }
+    else
+    {
+        build_alias_table();
+    }
+}
+
+size_t Scenario_Scheduler::next()
+{
+    if (total_weight == 0)
+    {
+        return 0;
+    }
+    if (exact_ratio)
+    {
+        if (exact_sequence.empty())
+        {
+            return next_smooth_weighted_round_robin();
+        }
+        size_t index = exact_sequence[sequence_cursor];
+        if (++sequence_cursor == exact_sequence.size())
+        {
+            sequence_cursor = 0;
+        }
+        return index;
+    }
+    uint64_t random_number = generator();
+    size_t column = static_cast<size_t>(((random_number >> 32) * probability.size()) >> 32);
+    double coin = static_cast<double>(random_number & 0xFFFFFFFFULL) / 4294967296.0;
+    return coin < probability[column] ? column : alias[column];
+}
+
+void Scenario_Scheduler::build_alias_table()
+{
+    size_t n = weights.size();
+    probability.assign(n, 0.0);
+    alias.assign(n, 0);
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    for (size_t i = 0; i < n; i++)
+    {
+        scaled[i] = static_cast<double>(weights[i]) * n / total_weight;
+        if (scaled[i] < 1.0)
+        {
+            small.push_back(i);
+        }
+        else
+        {
+            large.push_back(i);
+        }
+    }
+    while (small.size() && large.size())
+    {
+        auto s = small.back();
+        small.pop_back();
+        auto l = large.back();
+        large.pop_back();
+        probability[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0)
+        {
+            small.push_back(l);
+        }
+        else
+        {
+            large.push_back(l);
+        }
+    }
+    // what is left is 1.0 up to rounding error
+    for (auto l : large)
+    {
+        probability[l] = 1.0;
+        alias[l] = l;
+    }
+    auto heaviest = std::max_element(weights.begin(), weights.end()) - weights.begin();
+    for (auto s : small)
+    {
+        probability[s] = weights[s] ? 1.0 : 0.0;
+        alias[s] = weights[s] ? s : heaviest;
+    }
+}
+
+void Scenario_Scheduler::build_exact_sequence()
+{
+    if (total_weight > max_exact_sequence_length)
+    {
+        return;
+    }
+    exact_sequence.reserve(total_weight);
+    for (uint64_t i = 0; i < total_weight; i++)
+    {
+        exact_sequence.push_back(next_smooth_weighted_round_robin());
+    }
+    current_weight.assign(weights.size(), 0);
+}
+
+size_t Scenario_Scheduler::next_smooth_weighted_round_robin()
+{
+    size_t selected = 0;
+    for (size_t i = 0; i < weights.size(); i++)
+    {
+        current_weight[i] += weights[i];
+        if (current_weight[i] > current_weight[selected])
+        {
+            selected = i;
+        }
+    }
+    current_weight[selected] -= total_weight;
+    return selected;
+}
+
+}
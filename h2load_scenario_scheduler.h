@@ -0,0 +1,47 @@
+#ifndef H2LOAD_SCENARIO_SCHEDULER_H
+#define H2LOAD_SCENARIO_SCHEDULER_H
+#include <vector>
+#include <random>
+#include <cstdint>
+
+
+namespace h2load
+{
+
+/*
+ * Picks the scenario to start next, in O(1), according to the scenario weights.
+ * Random mode uses an alias table (Vose) drawn from a seedable generator, so a fixed seed reproduces the mix;
+ * exact-ratio mode uses smooth weighted round-robin, which gives the exact ratio within every weight period.
+ */
+class Scenario_Scheduler
+{
+public:
+    Scenario_Scheduler();
+
+    void set_seed(uint64_t seed);
+
+    void set_exact_ratio(bool exact);
+
+    // weights of zero are never picked; all zero weights make next() always return 0
+    void update_weights(const std::vector<uint64_t>& weights);
+
+    size_t next();
+
+private:
+    void build_alias_table();
+    void build_exact_sequence();
+    size_t next_smooth_weighted_round_robin();
+
+    bool exact_ratio;
+    std::mt19937_64 generator;
+    std::vector<uint64_t> weights;
+    uint64_t total_weight;
+    std::vector<double> probability;
+    std::vector<uint32_t> alias;
+    std::vector<uint32_t> exact_sequence;
+    size_t sequence_cursor;
+    std::vector<int64_t> current_weight;
+};
+
+}
+#endif
@@ -55,6 +55,8 @@ public:
     // Return the maximum concurrency per connection
     virtual size_t max_concurrent_streams() = 0;
     virtual void submit_rst_stream(int32_t stream_id) {};
+    // gives len bytes of data received on stream_id back to the flow control window
+    virtual void consume(int32_t stream_id, size_t len) {};
 
     virtual void submit_ping() {};
 };
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <atomic>
 #include <vector>
+#include <array>
 
 
 namespace h2load
@@ -126,6 +127,56 @@ struct Stats
 };
 
 
+// statistics of a host of the load share group, written by the clients of a worker, read by the statistics thread
+struct Host_Stats
+{
+    // latency buckets, 4 per power of 2 microseconds, i.e., within 25% of the latency; the last one is open ended
+    static constexpr size_t latency_buckets = 152;
+
+    std::atomic<uint64_t> req_done{0};
+    // failed, or with a 4xx/5xx status
+    std::atomic<uint64_t> req_error{0};
+    std::atomic<uint64_t> bytes_body{0};
+    std::atomic<uint64_t> latency_total_us{0};
+    // requests in flight
+    std::atomic<uint64_t> outstanding{0};
+    std::atomic<uint64_t> connections{0};
+    std::array<std::atomic<uint64_t>, latency_buckets> latency_histogram{};
+
+    static size_t get_latency_bucket(uint64_t latency_us)
+    {
+        if (latency_us < 4)
+        {
+            return latency_us;
+        }
+        size_t msb = 2;
+        while (latency_us >> (msb + 1))
+        {
+            msb++;
+        }
+        size_t bucket = (msb - 1) * 4 + ((latency_us >> (msb - 2)) & 3);
+        return bucket < latency_buckets ? bucket : latency_buckets - 1;
+    }
+
+    // latencies in the bucket are below this
+    static uint64_t get_latency_bucket_upper_bound(size_t bucket)
+    {
+        if (bucket < 4)
+        {
+            return bucket + 1;
+        }
+        size_t msb = bucket / 4 + 1;
+        return static_cast<uint64_t>(4 + bucket % 4 + 1) << (msb - 2);
+    }
+
+    void record_latency(uint64_t latency_us)
+    {
+        latency_total_us += latency_us;
+        ++latency_histogram[get_latency_bucket(latency_us)];
+    }
+};
+
+
 struct Stream
 {
     RequestStat req_stat;
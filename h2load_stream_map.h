@@ -0,0 +1,121 @@
+#ifndef H2LOAD_STREAM_MAP_H
+#define H2LOAD_STREAM_MAP_H
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "h2load_stats.h"
+
+
+namespace h2load
+{
+
+/*
+ * The streams in flight of a connection, in one vector sorted by stream id.
+ * A connection opens streams with ascending ids, so a new stream is appended,
+ * and a lookup is a binary search over a few cache lines; there is no node to allocate per stream,
+ * and an idle connection keeps no memory once shrink() is called.
+ */
+class Stream_Map
+{
+public:
+    using value_type = std::pair<int32_t, Stream>;
+    using iterator = std::vector<value_type>::iterator;
+    using const_iterator = std::vector<value_type>::const_iterator;
+
+    iterator begin()
+    {
+        return entries.begin();
+    }
+    iterator end()
+    {
+        return entries.end();
+    }
+    const_iterator begin() const
+    {
+        return entries.begin();
+    }
+    const_iterator end() const
+    {
+        return entries.end();
+    }
+    size_t size() const
+    {
+        return entries.size();
+    }
+    bool empty() const
+    {
+        return entries.empty();
+    }
+    void clear()
+    {
+        entries.clear();
+    }
+    void shrink()
+    {
+        std::vector<value_type>().swap(entries);
+    }
+
+    iterator find(int32_t stream_id)
+    {
+        auto it = lower_bound(stream_id);
+        return (it != entries.end() && it->first == stream_id) ? it : entries.end();
+    }
+    size_t count(int32_t stream_id)
+    {
+        return find(stream_id) != entries.end() ? 1 : 0;
+    }
+    Stream& at(int32_t stream_id)
+    {
+        auto it = find(stream_id);
+        if (it == entries.end())
+        {
+            throw std::out_of_range("stream id not found");
+        }
+        return it->second;
+    }
+
+    // an existing stream of the same id is kept, like std::map::insert
+    std::pair<iterator, bool> insert(value_type&& entry)
+    {
+        if (entries.empty() || entries.back().first < entry.first)
+        {
+            entries.push_back(std::move(entry));
+            return std::make_pair(entries.end() - 1, true);
+        }
+        auto it = lower_bound(entry.first);
+        if (it != entries.end() && it->first == entry.first)
+        {
+            return std::make_pair(it, false);
+        }
+        return std::make_pair(entries.insert(it, std::move(entry)), true);
+    }
+
+    size_t erase(int32_t stream_id)
+    {
+        auto it = find(stream_id);
+        if (it == entries.end())
+        {
+            return 0;
+        }
+        entries.erase(it);
+        return 1;
+    }
+
+private:
+    iterator lower_bound(int32_t stream_id)
+    {
+        return std::lower_bound(entries.begin(), entries.end(), stream_id,
+                                [](const value_type & entry, int32_t id)
+        {
+            return entry.first < id;
+        });
+    }
+
+    std::vector<value_type> entries;
+};
+
+}
+#endif
@@ -1,11 +1,15 @@
 #include <algorithm>
 #include <numeric>
+#include <cmath>
 #include <cctype>
 #include <mutex>
 #ifndef _WINDOWS
 #include <execinfo.h>
+#include <time.h>
 #endif
 #include <iomanip>
+#include <random>
+#include <cinttypes>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -13,9 +17,6 @@
 #include <openssl/ssl.h>
 
 #ifdef USE_LIBEV
-extern "C" {
-#include <ares.h>
-}
 #include "libev_client.h"
 #endif
 
@@ -306,37 +307,6 @@ void ping_w_cb(struct ev_loop* loop, ev_timer* w, int revents)
     client->submit_ping();
 }
 
-void ares_addrinfo_query_callback(void* arg, int status, int timeouts, struct ares_addrinfo* res)
-{
-    libev_client* client = static_cast<libev_client*>(arg);
-
-    if (status == ARES_SUCCESS)
-    {
-        if (client->ares_address)
-        {
-            ares_freeaddrinfo(client->ares_address);
-        }
-        client->next_addr = nullptr;
-        client->current_addr = nullptr;
-        client->ares_address = res;
-        client->connect();
-        ares_freeaddrinfo(client->ares_address);
-        client->ares_address = nullptr;
-    }
-    else
-    {
-        client->fail();
-    }
-}
-
-void ares_io_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
-{
-    libev_client* client = static_cast<libev_client*>(watcher->data);
-    ares_process_fd(client->channel,
-                    revents & EV_READ ? watcher->fd : ARES_SOCKET_BAD,
-                    revents & EV_WRITE ? watcher->fd : ARES_SOCKET_BAD);
-}
-
 void reconnect_to_used_host_cb(struct ev_loop* loop, ev_timer* w, int revents)
 {
     auto client = static_cast<libev_client*>(w->data);
@@ -344,16 +314,6 @@ void reconnect_to_used_host_cb(struct ev_loop* loop, ev_timer* w, int revents)
     client->reconnect_to_used_host();
 }
 
-void ares_addrinfo_query_callback_for_probe(void* arg, int status, int timeouts, struct ares_addrinfo* res)
-{
-    libev_client* client = static_cast<libev_client*>(arg);
-    if (status == ARES_SUCCESS)
-    {
-        client->probe_address(res);
-        ares_freeaddrinfo(res);
-    }
-}
-
 void connect_to_prefered_host_cb(struct ev_loop* loop, ev_timer* w, int revents)
 {
     auto client = static_cast<libev_client*>(w->data);
@@ -381,29 +341,6 @@ void probe_writecb(struct ev_loop* loop, ev_io* w, int revents)
     }
 }
 
-void ares_socket_state_cb(void* data, int s, int read, int write)
-{
-    libev_client* client = static_cast<libev_client*>(data);
-    auto worker = static_cast<libev_worker*>(client->worker);
-    if (read != 0 || write != 0)
-    {
-        if (client->ares_io_watchers.find(s) == client->ares_io_watchers.end())
-        {
-            ev_io watcher;
-            watcher.data = client;
-            client->ares_io_watchers[s] = watcher;
-            ev_init(&client->ares_io_watchers[s], ares_io_cb);
-        }
-        ev_io_set(&client->ares_io_watchers[s], s, (read ? EV_READ : 0) | (write ? EV_WRITE : 0));
-        ev_io_start(worker->loop, &client->ares_io_watchers[s]);
-    }
-    else if (client->ares_io_watchers.find(s) != client->ares_io_watchers.end())
-    {
-        ev_io_stop(worker->loop, &client->ares_io_watchers[s]);
-        client->ares_io_watchers.erase(s);
-    }
-}
-
 #endif
 
 bool recorded(const std::chrono::steady_clock::time_point& t)
@@ -709,6 +646,110 @@ bool is_null_destination(h2load::Config& config)
     return (!config.base_uri_unix && config.connect_to_host.empty() && config.host.empty());
 }
 
+void init_load_share_group(h2load::Config& config)
+{
+    config.load_share_group.clear();
+    config.load_share_schedule.clear();
+    if (config.json_config_schema.load_share_hosts.empty() || config.no_tls_proto == h2load::Config::PROTO_HTTP1_1)
+    {
+        return;
+    }
+    auto bracket_ipv6 = [](const std::string & host)
+    {
+        return is_it_an_ipv6_address(host) ? std::string("[").append(host).append("]") : host;
+    };
+    for (auto& host_item : config.json_config_schema.load_share_hosts)
+    {
+        h2load::Load_Share_Target target;
+        target.authority = bracket_ipv6(host_item.host);
+        if (host_item.port)
+        {
+            target.authority.append(":").append(std::to_string(host_item.port));
+        }
+        target.weight = host_item.weight;
+        config.load_share_group.push_back(target);
+    }
+
+    auto host = config.connect_to_host.empty() ? config.host : config.connect_to_host;
+    std::string authority = bracket_ipv6(host);
+    if (config.port != config.default_port)
+    {
+        authority.append(":").append(util::utos(config.port));
+    }
+    auto same_authority = [&authority](const h2load::Load_Share_Target & target)
+    {
+        return target.authority == authority;
+    };
+    if (std::find_if(config.load_share_group.begin(), config.load_share_group.end(), same_authority) ==
+        config.load_share_group.end())
+    {
+        config.load_share_group.push_back(h2load::Load_Share_Target {authority, 1});
+    }
+
+    // the schedule has one entry per unit of weight, so the weights are taken down to their lowest ratio, e.g., 200:100 to 2:1
+    uint32_t common_divisor = 0;
+    for (auto& target : config.load_share_group)
+    {
+        if (target.weight == 0)
+        {
+            std::cerr << "weight of load-share-hosts must be at least 1: " << target.authority << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        auto a = target.weight;
+        auto b = common_divisor;
+        while (b)
+        {
+            auto r = a % b;
+            a = b;
+            b = r;
+        }
+        common_divisor = a;
+    }
+    const uint64_t max_total_weight = 10000;
+    uint64_t total_weight = 0;
+    for (auto& target : config.load_share_group)
+    {
+        target.weight /= common_divisor;
+        total_weight += target.weight;
+    }
+    if (total_weight > max_total_weight)
+    {
+        std::cerr << "weights of load-share-hosts add up to " << total_weight << " even at their lowest ratio, at most "
+                  << max_total_weight << " expected" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // smooth weighted round robin, so the hosts are interleaved, e.g., A B A C A B A for weights 4, 2, 1
+    std::vector<int64_t> current_weights(config.load_share_group.size(), 0);
+    for (uint64_t round = 0; round < total_weight; round++)
+    {
+        size_t selected = 0;
+        for (size_t index = 0; index < config.load_share_group.size(); index++)
+        {
+            current_weights[index] += config.load_share_group[index].weight;
+            if (current_weights[index] > current_weights[selected])
+            {
+                selected = index;
+            }
+        }
+        current_weights[selected] -= total_weight;
+        config.load_share_schedule.push_back(selected);
+    }
+
+    if (config.json_config_schema.load_share_policy == load_share_policy_least_outstanding)
+    {
+        config.load_share_policy = h2load::Config::LOAD_SHARE_LEAST_OUTSTANDING;
+    }
+    else if (config.json_config_schema.load_share_policy == load_share_policy_least_latency)
+    {
+        config.load_share_policy = h2load::Config::LOAD_SHARE_LEAST_LATENCY;
+    }
+    else
+    {
+        config.load_share_policy = h2load::Config::LOAD_SHARE_CONNECTIONS;
+    }
+}
+
 void resolve_host(h2load::Config& config)
 {
 #ifndef _WINDOWS
@@ -826,82 +867,379 @@ void insert_customized_headers_to_Json_scenarios(h2load::Config& config)
     }
 }
 
-void tokenize_path_and_payload_for_fast_var_replace(h2load::Config& config)
+void compile_request_templates(h2load::Config& config)
 {
     for (auto& scenario : config.json_config_schema.scenarios)
     {
         assert(scenario.requests.size());
+        std::vector<std::string> variable_names;
+        for (auto& variable : scenario.variables)
+        {
+            auto iter = variable_type_map.find(variable.type);
+            if (iter == variable_type_map.end() || variable.name.empty())
+            {
+                std::cerr << "invalid variable: " << staticjson::to_pretty_json_string(variable) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            variable.variable_type = iter->second;
+            switch (variable.variable_type)
+            {
+                case VARIABLE_COUNTER:
+                case VARIABLE_RANGE:
+                {
+                    if (variable.variable_type == VARIABLE_RANGE && variable.end <= variable.start)
+                    {
+                        std::cerr << "invalid range of variable: " << variable.name << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    variable.counter = std::make_shared<std::atomic<uint64_t>>(0);
+                    break;
+                }
+                case VARIABLE_RANDOM_INT:
+                {
+                    if (variable.end < variable.start)
+                    {
+                        std::cerr << "invalid range of variable: " << variable.name << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                }
+                case VARIABLE_TIMESTAMP:
+                {
+                    static const std::set<std::string> formats {"epoch-s", "epoch-ms", "epoch-us", "iso8601"};
+                    if (formats.count(variable.format) == 0)
+                    {
+                        std::cerr << "invalid timestamp format of variable: " << variable.name << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                }
+                case VARIABLE_CSV_COLUMN:
+                {
+                    if (!scenario.user_ids)
+                    {
+                        std::cerr << "csv-column variable requires user-id-list-file: " << variable.name << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                }
+                case VARIABLE_CAPTURED:
+                {
+                    bool compiled = true;
+                    if (variable.source == "json-pointer")
+                    {
+                        compiled = variable.value_extractor.compile_json_pointer(variable.input);
+                    }
+                    else if (variable.source == "x-path")
+                    {
+                        compiled = variable.value_extractor.compile_x_path(variable.input);
+                    }
+                    else if (variable.source != "header" || variable.input.empty())
+                    {
+                        compiled = false;
+                    }
+                    if (!compiled || variable.capture_from_request >= scenario.requests.size())
+                    {
+                        std::cerr << "invalid captured variable: " << staticjson::to_pretty_json_string(variable) << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    variable.capture_slot = scenario.captured_variables.size();
+                    scenario.captured_variables.push_back(&variable - &scenario.variables[0]);
+                    break;
+                }
+                default:
+                {
+                }
+            }
+            variable_names.push_back(variable.name);
+        }
+        // user id variable is the last one, referenced by index scenario.variables.size()
+        variable_names.push_back(scenario.variable_name_in_path_and_data);
+        scenario.user_id_width = scenario.user_ids ? 0 : std::to_string(scenario.variable_range_end).size();
+
         for (auto& request : scenario.requests)
         {
-            request.tokenized_path = tokenize_string(request.path, scenario.variable_name_in_path_and_data);
-            request.tokenized_payload = tokenize_string(request.payload, scenario.variable_name_in_path_and_data);
+            request.path_template.compile(request.path, variable_names);
+            request.payload_template.compile(request.payload, variable_names);
+            request.header_templates.clear();
+            for (auto& header : request.headers_in_map)
+            {
+                h2load::Template_String header_template;
+                header_template.compile(header.second, variable_names);
+                if (header_template.has_variable())
+                {
+                    request.header_templates.emplace_back(header.first, std::move(header_template));
+                }
+            }
         }
     }
 }
 
-std::string reassemble_str_with_variable(h2load::Config* config,
-                                         size_t scenario_index,
-                                         size_t request_index,
-                                         const std::vector<std::string>& tokenized_source,
-                                         uint64_t variable_value)
-
+void append_variable_value(const Scenario& scenario, size_t variable_index,
+                           const h2load::Request_Data& request, std::string& output)
 {
-    auto init_full_var_len = [config]()
+    static thread_local std::mt19937_64 generator(std::random_device {}());
+    auto append_padded = [&output](uint64_t value, size_t width)
+    {
+        char buf[32];
+        auto len = snprintf(buf, sizeof(buf), "%" PRIu64, value);
+        if (width > static_cast<size_t>(len))
+        {
+            output.append(width - len, '0');
+        }
+        output.append(buf, len);
+    };
+
+    if (variable_index >= scenario.variables.size())
+    {
+        if (scenario.user_ids)
+        {
+            assert(request.user_id < scenario.user_ids->size());
+            auto column = (request.curr_request_idx < scenario.user_ids->get_column_count(request.user_id)) ?
+                          request.curr_request_idx : 0;
+            auto user_id = scenario.user_ids->get_column(request.user_id, column);
+            output.append(user_id.c_str(), user_id.size());
+        }
+        else
+        {
+            append_padded(request.user_id, scenario.user_id_width);
+        }
+        return;
+    }
+
+    auto& variable = scenario.variables[variable_index];
+    switch (variable.variable_type)
     {
-        std::vector<size_t> str_len_vec;
-        for (size_t index = 0; index < config->json_config_schema.scenarios.size(); index++)
+        case VARIABLE_COUNTER:
+        {
+            append_padded(variable.start + variable.step * variable.counter->fetch_add(1, std::memory_order_relaxed),
+                          variable.width);
+            break;
+        }
+        case VARIABLE_RANGE:
+        {
+            auto n = variable.counter->fetch_add(1, std::memory_order_relaxed);
+            append_padded(variable.start + ((n * variable.step) % (variable.end - variable.start)), variable.width);
+            break;
+        }
+        case VARIABLE_RANDOM_INT:
+        {
+            std::uniform_int_distribution<uint64_t> distribution(variable.start, variable.end);
+            append_padded(distribution(generator), variable.width);
+            break;
+        }
+        case VARIABLE_RANDOM_STRING:
+        {
+            static const char charset[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+            for (size_t i = 0; i < variable.length; i++)
+            {
+                output.push_back(charset[generator() % (sizeof(charset) - 1)]);
+            }
+            break;
+        }
+        case VARIABLE_UUID:
         {
-            if (config->json_config_schema.scenarios[index].user_ids.size())
+            static const char hex[] = "0123456789abcdef";
+            uint64_t high = (generator() & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL;
+            uint64_t low = (generator() & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+            for (int i = 15; i >= 0; i--)
             {
-                str_len_vec.push_back(0);
+                output.push_back(hex[(high >> (i * 4)) & 0xF]);
+                if (i == 8 || i == 4)
+                {
+                    output.push_back('-');
+                }
+            }
+            output.push_back('-');
+            for (int i = 15; i >= 0; i--)
+            {
+                output.push_back(hex[(low >> (i * 4)) & 0xF]);
+                if (i == 12)
+                {
+                    output.push_back('-');
+                }
+            }
+            break;
+        }
+        case VARIABLE_TIMESTAMP:
+        {
+            auto now = std::chrono::system_clock::now();
+            if (variable.format == "iso8601")
+            {
+                auto t = std::chrono::system_clock::to_time_t(now);
+                struct tm tm_buf;
+#ifdef _WINDOWS
+                gmtime_s(&tm_buf, &t);
+#else
+                gmtime_r(&t, &tm_buf);
+#endif
+                char buf[32];
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+                auto len = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm_buf);
+                len += snprintf(buf + len, sizeof(buf) - len, ".%03dZ", static_cast<int>(ms));
+                output.append(buf, len);
+            }
+            else if (variable.format == "epoch-s")
+            {
+                append_padded(std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count(), 0);
+            }
+            else if (variable.format == "epoch-us")
+            {
+                append_padded(std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count(), 0);
             }
             else
             {
-                str_len_vec.push_back(std::to_string(config->json_config_schema.scenarios[index].variable_range_end).size());
+                append_padded(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count(), 0);
             }
+            break;
         }
-        return str_len_vec;
-    };
+        case VARIABLE_CSV_COLUMN:
+        {
+            assert(request.user_id < scenario.user_ids->size());
+            auto column = scenario.user_ids->get_column(request.user_id, variable.column);
+            output.append(column.c_str(), column.size());
+            break;
+        }
+        case VARIABLE_CAPTURED:
+        {
+            if (variable.capture_slot < request.captured_values.size())
+            {
+                output.append(request.captured_values[variable.capture_slot]);
+            }
+            break;
+        }
+        default:
+        {
+        }
+    }
+}
 
-    static thread_local auto str_len_vec = init_full_var_len();
-    std::string retStr = tokenized_source[0];
-    auto& config_scenario = config->json_config_schema.scenarios[scenario_index];
+void render_request_template(const h2load::Config* config, const h2load::Template_String& template_string,
+                             const h2load::Request_Data& request, std::string& output)
+{
+    auto& scenario = config->json_config_schema.scenarios[request.scenario_index];
+    template_string.render(output, [&scenario, &request](size_t variable_index, std::string & out)
+    {
+        append_variable_value(scenario, variable_index, request, out);
+    });
+}
 
-    if (tokenized_source.size() > 1)
+void build_response_capture_plan(h2load::Config& config)
+{
+    bool capture_everything = config.verbose || config.json_config_schema.failed_request_log_file.size();
+    for (auto& scenario : config.json_config_schema.scenarios)
     {
-        std::string curr_var_value_str;
-        if (config_scenario.user_ids.size())
+        for (size_t index = 0; index < scenario.requests.size(); index++)
         {
-            assert(variable_value < config_scenario.user_ids.size());
-            if (request_index < config_scenario.user_ids[variable_value].size())
+            auto& request = scenario.requests[index];
+            if (capture_everything || request.validate_response_function_present)
             {
-                curr_var_value_str = config_scenario.user_ids[variable_value][request_index];
+                request.capture_response_payload = true;
+                request.capture_all_response_headers = true;
+                continue;
             }
-            else
+            request.capture_response_payload = false;
+            request.capture_all_response_headers = false;
+            request.response_headers_to_capture.clear();
+            for (auto& match_rule : request.response_match_rules)
             {
-                curr_var_value_str = config_scenario.user_ids[variable_value][0];
+                if (match_rule.header_name.size())
+                {
+                    request.response_headers_to_capture.insert(match_rule.header_name);
+                }
+            }
+            if (request.response_match.payload_match.size())
+            {
+                request.capture_response_payload = true;
+            }
+            for (auto variable_index : scenario.captured_variables)
+            {
+                auto& variable = scenario.variables[variable_index];
+                if (variable.capture_from_request != index)
+                {
+                    continue;
+                }
+                if (variable.source == "header")
+                {
+                    request.response_headers_to_capture.insert(variable.input);
+                }
+                else
+                {
+                    request.capture_response_payload = true;
+                }
+            }
+            // what the next request of the scenario reads from this response
+            if (index + 1 < scenario.requests.size())
+            {
+                auto& next_request = scenario.requests[index + 1];
+                if (next_request.make_request_function_present || next_request.uri.uri_action == FROM_LUA_SCRIPT)
+                {
+                    request.capture_response_payload = true;
+                    request.capture_all_response_headers = true;
+                    continue;
+                }
+                if (!next_request.clear_old_cookies)
+                {
+                    request.response_headers_to_capture.insert("Set-Cookie");
+                }
+                switch (next_request.uri.uri_action)
+                {
+                    case FROM_RESPONSE_HEADER:
+                    {
+                        request.response_headers_to_capture.insert(next_request.uri.input);
+                        break;
+                    }
+                    case FROM_JSON_POINTER:
+                    case FROM_X_PATH:
+                    {
+                        request.capture_response_payload = true;
+                        break;
+                    }
+                    default:
+                    {
+                        break;
+                    }
+                }
             }
         }
-        else
+    }
+}
+
+void capture_variable_values(const h2load::Config* config, const h2load::Request_Data& finished_request,
+                             h2load::Request_Data& new_request)
+{
+    auto& scenario = config->json_config_schema.scenarios[finished_request.scenario_index];
+    if (scenario.captured_variables.empty())
+    {
+        return;
+    }
+    new_request.captured_values = finished_request.captured_values;
+    new_request.captured_values.resize(scenario.captured_variables.size());
+    for (auto variable_index : scenario.captured_variables)
+    {
+        auto& variable = scenario.variables[variable_index];
+        if (variable.capture_from_request != finished_request.curr_request_idx)
+        {
+            continue;
+        }
+        auto& value = new_request.captured_values[variable.capture_slot];
+        value.clear();
+        if (variable.source == "header")
         {
-            curr_var_value_str = std::to_string(variable_value);
-            std::string padding;
-            padding.reserve(str_len_vec[scenario_index] - curr_var_value_str.size());
-            for (size_t i = 0; i < str_len_vec[scenario_index] - curr_var_value_str.size(); i++)
+            for (auto& header_map : finished_request.resp_headers)
             {
-                padding.append("0");
+                auto header = header_map.find(variable.input);
+                if (header != header_map.end())
+                {
+                    value = header->second;
+                }
             }
-            curr_var_value_str.insert(0, padding);
         }
-
-        std::string variable;
-        for (size_t i = 1; i < tokenized_source.size(); i++)
+        else
         {
-            retStr.append(curr_var_value_str);
-            retStr.append(tokenized_source[i]);
+            variable.value_extractor.extract(finished_request.resp_payload, value);
         }
     }
-    return retStr;
 }
 
 void normalize_request_templates(h2load::Config* config)
@@ -1038,7 +1376,8 @@ size_t get_request_name_max_width(h2load::Config& config)
 
 void output_realtime_stats(h2load::Config& config,
                            std::vector<std::shared_ptr<h2load::base_worker>>& workers,
-                           std::atomic<bool>& workers_stopped, std::stringstream& dataStream)
+                           std::atomic<bool>& workers_stopped, std::stringstream& dataStream,
+                           std::stringstream& workerDataStream, std::stringstream& hostDataStream)
 {
     std::vector<std::vector<size_t>> scenario_req_sent_till_now;
     std::vector<std::vector<size_t>> scenario_req_done_till_now;
@@ -1059,6 +1398,42 @@ void output_realtime_stats(h2load::Config& config,
         scenario_5xx_till_now.push_back(req_vec);
     }
 
+    // worker telemetry at the end of the last interval
+    std::vector<uint64_t> loop_lag_total_till_now(workers.size(), 0);
+    std::vector<uint64_t> telemetry_samples_till_now(workers.size(), 0);
+    std::vector<uint64_t> cpu_time_till_now(workers.size(), 0);
+    std::vector<uint64_t> spin_time_till_now(workers.size(), 0);
+    std::vector<uint64_t> allocations_till_now(workers.size(), 0);
+    std::vector<uint64_t> req_started_till_now(workers.size(), 0);
+
+    // load share group hosts at the end of the last interval
+    auto& load_share_group = config.load_share_group;
+    std::vector<uint64_t> host_req_done_till_now(load_share_group.size(), 0);
+    std::vector<uint64_t> host_req_error_till_now(load_share_group.size(), 0);
+    std::vector<uint64_t> host_bytes_body_till_now(load_share_group.size(), 0);
+    std::vector<uint64_t> host_latency_total_till_now(load_share_group.size(), 0);
+    std::vector<std::vector<uint64_t>> host_latency_histogram_till_now(load_share_group.size(),
+                                                                       std::vector<uint64_t>(h2load::Host_Stats::latency_buckets, 0));
+
+    // the worker rows have columns of their own, and go to their own file next to statistics-file, or to stderr;
+    // so do the rows of the load share group hosts; the builtin server serves the last rows of each at /workers and /hosts
+    const std::string worker_stats_header =
+        "time, worker, loop-lag-mean(ms), loop-lag-max(ms), busy, queued-requests, sent/s, target/s, deficit/s, allocations/s, connections, concurrency";
+    const std::string host_stats_header =
+        "time, host, weight, connections, outstanding, done/s, errors/s, KB/s, latency-mean(ms), p50, p90, p99";
+    std::ofstream worker_stats_file;
+    std::ofstream host_stats_file;
+    if (config.json_config_schema.statistics_file.size())
+    {
+        worker_stats_file.open(config.json_config_schema.statistics_file + ".workers.csv");
+        if (load_share_group.size())
+        {
+            host_stats_file.open(config.json_config_schema.statistics_file + ".hosts.csv");
+        }
+    }
+    std::ostream& worker_stats_output = worker_stats_file.is_open() ? worker_stats_file : std::cerr;
+    std::ostream& host_stats_output = host_stats_file.is_open() ? host_stats_file : std::cerr;
+
     auto period_start = std::chrono::steady_clock::now();
     while (!workers_stopped)
     {
@@ -1242,6 +1617,141 @@ void output_realtime_stats(h2load::Config& config,
                                                                                                                          double)total_req_success / total_req_done) * 100) : 0).append("%")
                 ;
         outputStream << std::endl;
+
+        // whether the generator itself keeps up: a lagging event loop, a busy ratio near 1, or a growing queue
+        // mean the numbers above are limited by h2loadrunner, not by the server
+        std::stringstream workerStream;
+        for (size_t worker_index = 0; worker_index < workers.size(); worker_index++)
+        {
+            auto& telemetry = workers[worker_index]->telemetry;
+            uint64_t loop_lag_total = telemetry.loop_lag_total_us;
+            uint64_t telemetry_samples = telemetry.samples;
+            uint64_t cpu_time = telemetry.cpu_time_ns;
+            uint64_t spin_time = telemetry.spin_time_ns;
+            uint64_t allocations = telemetry.allocations;
+            uint64_t req_started = workers[worker_index]->stats.req_started;
+            uint64_t loop_lag_max = telemetry.loop_lag_max_us.exchange(0);
+
+            auto delta_samples = telemetry_samples - telemetry_samples_till_now[worker_index];
+            auto loop_lag_mean = delta_samples ? (double)(loop_lag_total - loop_lag_total_till_now[worker_index]) /
+                                 delta_samples : 0;
+            // the CPU time spent spinning in busy poll mode is not counted as busy
+            auto busy_time = (double)(cpu_time - cpu_time_till_now[worker_index]) -
+                             (double)(spin_time - spin_time_till_now[worker_index]);
+            auto busy = period_duration ? std::max(busy_time, 0.0) / (period_duration * 1000000) : 0;
+            auto sent_per_second = round((double)(1000 * (req_started - req_started_till_now[worker_index])) / period_duration);
+            auto allocations_per_second = round((double)(1000 * (allocations - allocations_till_now[worker_index])) /
+                                                period_duration);
+
+            workerStream
+                    << std::put_time(std::localtime(&now_c), "%F %T")
+                    << ", " << "worker_" << workers[worker_index]->id
+                    << ", " << to_string_with_precision_3(loop_lag_mean / 1000)
+                    << ", " << to_string_with_precision_3((double)loop_lag_max / 1000)
+                    << ", " << to_string_with_precision_3(busy)
+                    << ", " << telemetry.requests_queued
+                    << ", " << sent_per_second;
+            if (config.rps_enabled())
+            {
+                auto target_per_second = round(config.rps * workers[worker_index]->nclients);
+                workerStream << ", " << target_per_second
+                             << ", " << (target_per_second > sent_per_second ? target_per_second - sent_per_second : 0);
+            }
+            else
+            {
+                workerStream << ", -, -";
+            }
+            workerStream << ", " << allocations_per_second;
+            if (config.json_config_schema.adaptive_concurrency)
+            {
+                workerStream << ", " << telemetry.active_connections << ", " << telemetry.concurrency_limit;
+            }
+            else
+            {
+                workerStream << ", -, -";
+            }
+            workerStream << std::endl;
+
+            loop_lag_total_till_now[worker_index] = loop_lag_total;
+            telemetry_samples_till_now[worker_index] = telemetry_samples;
+            cpu_time_till_now[worker_index] = cpu_time;
+            spin_time_till_now[worker_index] = spin_time;
+            allocations_till_now[worker_index] = allocations;
+            req_started_till_now[worker_index] = req_started;
+        }
+
+        // each host of the load share group, to see at once a host which slows down or fails
+        std::stringstream hostStream;
+        for (size_t host_index = 0; host_index < load_share_group.size(); host_index++)
+        {
+            uint64_t connections = 0;
+            uint64_t outstanding = 0;
+            uint64_t req_done = 0;
+            uint64_t req_error = 0;
+            uint64_t bytes_body = 0;
+            uint64_t latency_total = 0;
+            std::vector<uint64_t> latency_histogram(h2load::Host_Stats::latency_buckets, 0);
+            for (auto& w : workers)
+            {
+                auto& host_stats = *(w->host_stats[host_index]);
+                connections += host_stats.connections;
+                outstanding += host_stats.outstanding;
+                req_done += host_stats.req_done;
+                req_error += host_stats.req_error;
+                bytes_body += host_stats.bytes_body;
+                latency_total += host_stats.latency_total_us;
+                for (size_t bucket = 0; bucket < latency_histogram.size(); bucket++)
+                {
+                    latency_histogram[bucket] += host_stats.latency_histogram[bucket];
+                }
+            }
+
+            auto delta_done = req_done - host_req_done_till_now[host_index];
+            std::vector<uint64_t> delta_histogram(latency_histogram.size(), 0);
+            uint64_t delta_samples = 0;
+            for (size_t bucket = 0; bucket < latency_histogram.size(); bucket++)
+            {
+                delta_histogram[bucket] = latency_histogram[bucket] - host_latency_histogram_till_now[host_index][bucket];
+                delta_samples += delta_histogram[bucket];
+            }
+            auto latency_percentile = [&delta_histogram, delta_samples](double percentile)
+            {
+                uint64_t rank = std::max(static_cast<uint64_t>(std::ceil(delta_samples * percentile)), static_cast<uint64_t>(1));
+                uint64_t samples = 0;
+                for (size_t bucket = 0; bucket < delta_histogram.size(); bucket++)
+                {
+                    samples += delta_histogram[bucket];
+                    if (samples >= rank)
+                    {
+                        return (double)h2load::Host_Stats::get_latency_bucket_upper_bound(bucket) / 1000;
+                    }
+                }
+                return 0.0;
+            };
+
+            hostStream
+                    << std::put_time(std::localtime(&now_c), "%F %T")
+                    << ", " << load_share_group[host_index].authority
+                    << ", " << load_share_group[host_index].weight
+                    << ", " << connections
+                    << ", " << outstanding
+                    << ", " << round((double)(1000 * delta_done) / period_duration)
+                    << ", " << round((double)(1000 * (req_error - host_req_error_till_now[host_index])) / period_duration)
+                    << ", " << round((double)(bytes_body - host_bytes_body_till_now[host_index]) / period_duration)
+                    << ", " << to_string_with_precision_3(delta_done ? (double)(latency_total -
+                                                                                 host_latency_total_till_now[host_index]) / delta_done / 1000 : 0)
+                    << ", " << to_string_with_precision_3(delta_samples ? latency_percentile(0.5) : 0)
+                    << ", " << to_string_with_precision_3(delta_samples ? latency_percentile(0.9) : 0)
+                    << ", " << to_string_with_precision_3(delta_samples ? latency_percentile(0.99) : 0)
+                    << std::endl;
+
+            host_req_done_till_now[host_index] = req_done;
+            host_req_error_till_now[host_index] = req_error;
+            host_bytes_body_till_now[host_index] = bytes_body;
+            host_latency_total_till_now[host_index] = latency_total;
+            host_latency_histogram_till_now[host_index] = latency_histogram;
+        }
+
         if (config.json_config_schema.statistics_file.size())
         {
             static std::ofstream log_file(config.json_config_schema.statistics_file);
@@ -1251,12 +1761,30 @@ void output_realtime_stats(h2load::Config& config,
         {
             std::cout << outputStream.str();
         }
+        if (counter % 10 == 1)
+        {
+            worker_stats_output << worker_stats_header << std::endl;
+        }
+        worker_stats_output << workerStream.str() << std::flush;
+        if (load_share_group.size())
+        {
+            if (counter % 10 == 1)
+            {
+                host_stats_output << host_stats_header << std::endl;
+            }
+            host_stats_output << hostStream.str() << std::flush;
+        }
 
         rps_width = std::to_string(delta_RPS_sent).size() > rps_width ? std::to_string(delta_RPS_sent).size() : rps_width;
         total_req_width = std::to_string(total_req_sent).size() > total_req_width ? std::to_string(
                               total_req_sent).size() : total_req_width;
 
         dataStream.str(outputStream.str());
+        workerDataStream.str(worker_stats_header + "\n" + workerStream.str());
+        if (load_share_group.size())
+        {
+            hostDataStream.str(host_stats_header + "\n" + hostStream.str());
+        }
     }
 }
 
@@ -1339,6 +1867,43 @@ void post_process_json_config_schema(h2load::Config& config)
     util::inp_strlower(config.json_config_schema.host);
     util::inp_strlower(config.json_config_schema.schema);
 
+    if (config.json_config_schema.scenario_schedule_mode != scenario_schedule_random &&
+        config.json_config_schema.scenario_schedule_mode != scenario_schedule_exact_ratio)
+    {
+        std::cerr << "invalid scenario-schedule-mode: " << config.json_config_schema.scenario_schedule_mode << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (config.json_config_schema.io_engine != io_engine_asio &&
+        config.json_config_schema.io_engine != io_engine_io_uring)
+    {
+        std::cerr << "invalid io-engine: " << config.json_config_schema.io_engine << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (config.json_config_schema.load_share_policy != load_share_policy_connections &&
+        config.json_config_schema.load_share_policy != load_share_policy_least_outstanding &&
+        config.json_config_schema.load_share_policy != load_share_policy_least_latency)
+    {
+        std::cerr << "invalid load-share-policy: " << config.json_config_schema.load_share_policy << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    for (auto& host_item : config.json_config_schema.load_share_hosts)
+    {
+        if (host_item.weight == 0)
+        {
+            std::cerr << "invalid weight 0 of load-share-hosts: " << host_item.host << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+#ifndef USE_IO_URING
+    if (config.json_config_schema.io_engine == io_engine_io_uring)
+    {
+        std::cerr << "io-engine io_uring is not available, rebuild with -DUSE_IO_URING=1" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+#endif
+
     auto load_file_content = [](std::string & source)
     {
         if (source.size())
@@ -1356,14 +1921,14 @@ void post_process_json_config_schema(h2load::Config& config)
     {
         if (scenario.user_id_list_file.size())
         {
-            scenario.user_ids = read_csv_file(scenario.user_id_list_file);
-            if (scenario.user_ids.empty())
+            scenario.user_ids = std::make_shared<h2load::User_Id_Dataset>();
+            if (!scenario.user_ids->load(scenario.user_id_list_file, scenario.user_id_list_file_index))
             {
                 std::cerr << "cannot read user IDs from: " << scenario.user_id_list_file << std::endl;
                 exit(EXIT_FAILURE);
             }
             scenario.variable_range_start = 0;
-            scenario.variable_range_end = scenario.user_ids.size();
+            scenario.variable_range_end = scenario.user_ids->size();
         }
         for (auto& request : scenario.requests)
         {
@@ -1428,6 +1993,28 @@ void post_process_json_config_schema(h2load::Config& config)
                     }
                 }
             }
+            if ((request.uri.uri_action == FROM_JSON_POINTER && !request.uri.value_extractor.compile_json_pointer(request.uri.input)) ||
+                (request.uri.uri_action == FROM_X_PATH && !request.uri.value_extractor.compile_x_path(request.uri.input)))
+            {
+                std::cerr << "Please check this request: " << std::endl << staticjson::to_pretty_json_string(request) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            if (request.uri.value_placeholder.size())
+            {
+                if (request.uri.uri_template.empty())
+                {
+                    request.uri.uri_template = request.uri.value_placeholder;
+                }
+                request.uri.tokenized_uri_template = tokenize_string(request.uri.uri_template, request.uri.value_placeholder);
+                request.payload_has_value_placeholder = (request.payload.find(request.uri.value_placeholder) != std::string::npos);
+                for (auto& header : request.headers_in_map)
+                {
+                    if (header.second.find(request.uri.value_placeholder) != std::string::npos)
+                    {
+                        request.headers_with_value_placeholder.push_back(header.first);
+                    }
+                }
+            }
             for (auto& schema_header_match : request.response_match.header_match)
             {
                 request.response_match_rules.emplace_back(Match_Rule(schema_header_match));
@@ -1463,36 +2050,6 @@ void post_process_json_config_schema(h2load::Config& config)
     load_file_content(config.json_config_schema.private_key);
 }
 
-std::vector<std::vector<std::string>> read_csv_file(const std::string& csv_file_name)
-{
-    std::vector<std::vector<std::string>> result;
-    std::ifstream infile(csv_file_name);
-    if (!infile)
-    {
-        std::cerr << "cannot open file: " << csv_file_name << std::endl;
-        return result;
-    }
-    std::string line;
-    std::getline(infile, line); // remove first row which is column name;
-    while (std::getline(infile, line))
-    {
-        if (line.size() && line[line.size() - 1] == '\r')
-        {
-            line = line.substr(0, line.size() - 1);
-        }
-        std::vector<std::string> row;
-        std::stringstream lineStream(line);
-        std::string cell;
-        while (std::getline(lineStream, cell, ','))
-        {
-            row.push_back(cell);
-        }
-        result.push_back(row);
-    }
-
-    return result;
-}
-
 void rpsUpdateFunc(std::atomic<bool>& workers_stopped, h2load::Config& config)
 {
     while (!config.rps_file.empty() && !workers_stopped)
@@ -1520,7 +2077,8 @@ void rpsUpdateFunc(std::atomic<bool>& workers_stopped, h2load::Config& config)
     }
 };
 
-void integrated_http2_server(std::stringstream& dataStream, h2load::Config& config)
+void integrated_http2_server(std::stringstream& dataStream, std::stringstream& workerDataStream,
+                             std::stringstream& hostDataStream, h2load::Config& config)
 {
     uint32_t serverPort = config.json_config_schema.builtin_server_port;
     std::cerr << "builtin server listening at port: " << serverPort << std::endl;
@@ -1529,19 +2087,26 @@ void integrated_http2_server(std::stringstream& dataStream, h2load::Config& conf
     nghttp2::asio_http2::server::http2 server(config_schema);
     boost::system::error_code ec;
     server.num_threads(1);
-    server.handle("/stat", [&](const nghttp2::asio_http2::server::request & req,
-                               const nghttp2::asio_http2::server::response & res,
-                               uint64_t handler_id, int32_t stream_id)
+    auto serve_stream = [](std::stringstream & stream)
     {
-        nghttp2::asio_http2::header_map headers;
-        nghttp2::asio_http2::header_value hdr_val;
-        hdr_val.sensitive = false;
-        std::string payload = dataStream.str();
-        hdr_val.value = std::to_string(payload.size());
-        headers.insert(std::make_pair("Content-Length", hdr_val));
-        res.write_head(200, headers);
-        res.end(payload);
-    });
+        return [&stream](const nghttp2::asio_http2::server::request & req,
+                         const nghttp2::asio_http2::server::response & res,
+                         uint64_t handler_id, int32_t stream_id)
+        {
+            nghttp2::asio_http2::header_map headers;
+            nghttp2::asio_http2::header_value hdr_val;
+            hdr_val.sensitive = false;
+            std::string payload = stream.str();
+            hdr_val.value = std::to_string(payload.size());
+            headers.insert(std::make_pair("Content-Length", hdr_val));
+            res.write_head(200, headers);
+            res.end(payload);
+        };
+    };
+    server.handle("/stat", serve_stream(dataStream));
+    // the worker telemetry and the load share group hosts of the last interval, with their header row
+    server.handle("/workers", serve_stream(workerDataStream));
+    server.handle("/hosts", serve_stream(hostDataStream));
     server.handle("/config", [&](const nghttp2::asio_http2::server::request & req,
                                  const nghttp2::asio_http2::server::response & res,
                                  uint64_t handler_id, int32_t stream_id)
@@ -1874,5 +2439,25 @@ void process_delayed_scenario(h2load::Config& config)
     }
 }
 
-
-
+std::chrono::nanoseconds get_thread_cpu_time()
+{
+#ifdef _WINDOWS
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+    {
+        return std::chrono::nanoseconds(0);
+    }
+    auto to_100ns = [](const FILETIME & t)
+    {
+        return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+    };
+    return std::chrono::nanoseconds((to_100ns(kernel_time) + to_100ns(user_time)) * 100);
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+}
@@ -4,6 +4,7 @@
 #include <atomic>
 #include <set>
 #include <thread>
+#include <chrono>
 #include <vector>
 #include <sstream>
 #include <stdlib.h>
@@ -11,9 +12,6 @@
 #include <openssl/ssl.h>
 
 #ifdef USE_LIBEV
-extern "C" {
-#include <ares.h>
-}
 #include <ev.h>
 #include "memchunk.h"
 #endif
@@ -82,6 +80,9 @@ std::vector<std::string> read_uri_from_file(std::istream& infile);
 h2load::SDStats
 process_time_stats(const std::vector<std::shared_ptr<h2load::base_worker>>& workers);
 
+// the load-share-hosts together with the main host, and the order connections are spread over them
+void init_load_share_group(h2load::Config& config);
+
 void resolve_host(h2load::Config& config);
 
 #ifndef OPENSSL_NO_NEXTPROTONEG
@@ -95,13 +96,19 @@ void populate_config_from_json(h2load::Config& config);
 
 void insert_customized_headers_to_Json_scenarios(h2load::Config& config);
 
-void tokenize_path_and_payload_for_fast_var_replace(h2load::Config& config);
+void compile_request_templates(h2load::Config& config);
+
+// decide per request which parts of the response are read later on, the rest is not buffered
+void build_response_capture_plan(h2load::Config& config);
 
-std::string reassemble_str_with_variable(h2load::Config* config,
-                                         size_t scenario_index,
-                                         size_t request_index,
-                                         const std::vector<std::string>& tokenized_source,
-                                         uint64_t variable_value);
+void append_variable_value(const Scenario& scenario, size_t variable_index,
+                           const h2load::Request_Data& request, std::string& output);
+
+void render_request_template(const h2load::Config* config, const h2load::Template_String& template_string,
+                             const h2load::Request_Data& request, std::string& output);
+
+void capture_variable_values(const h2load::Config* config, const h2load::Request_Data& finished_request,
+                             h2load::Request_Data& new_request);
 
 std::vector<h2load::Cookie> parse_cookie_string(const std::string& cookie_string, const std::string& origin_authority,
                                                 const std::string& origin_schema);
@@ -137,18 +144,10 @@ void client_request_timeout_cb(struct ev_loop* loop, ev_timer* w, int revents);
 
 void client_connection_timeout_cb(struct ev_loop* loop, ev_timer* w, int revents);
 
-void ares_addrinfo_query_callback(void* arg, int status, int timeouts, struct ares_addrinfo* res);
-
-void ares_socket_state_cb(void* data, int s, int read, int write);
-
-void ares_io_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
-
 void delayed_request_cb(struct ev_loop* loop, ev_timer* w, int revents);
 
 void reconnect_to_used_host_cb(struct ev_loop* loop, ev_timer* w, int revents);
 
-void ares_addrinfo_query_callback_for_probe(void* arg, int status, int timeouts, struct ares_addrinfo* res);
-
 void connect_to_prefered_host_cb(struct ev_loop* loop, ev_timer* w, int revents);
 
 void probe_writecb(struct ev_loop* loop, ev_io* w, int revents);
@@ -167,7 +166,8 @@ std::vector<std::vector<h2load::SDStat>>
                                       produce_requests_latency_stats(const std::vector<std::shared_ptr<h2load::base_worker>>& workers);
 
 void output_realtime_stats(h2load::Config& config, std::vector<std::shared_ptr<h2load::base_worker>>& workers,
-                           std::atomic<bool>& workers_stopped, std::stringstream& DatStream);
+                           std::atomic<bool>& workers_stopped, std::stringstream& DatStream,
+                           std::stringstream& workerDataStream, std::stringstream& hostDataStream);
 
 template<typename T>
 std::string to_string_with_precision_3(const T a_value);
@@ -176,11 +176,10 @@ size_t get_request_name_max_width(h2load::Config& config);
 
 void post_process_json_config_schema(h2load::Config& config);
 
-std::vector<std::vector<std::string>> read_csv_file(const std::string& csv_file_name);
-
 void rpsUpdateFunc(std::atomic<bool>& workers_stopped, h2load::Config& config);
 
-void integrated_http2_server(std::stringstream& DatStream, h2load::Config& config);
+void integrated_http2_server(std::stringstream& DatStream, std::stringstream& workerDataStream,
+                             std::stringstream& hostDataStream, h2load::Config& config);
 
 void print_extended_stats_summary(const h2load::Stats& stats, h2load::Config& config,
                                   const std::vector<std::shared_ptr<h2load::base_worker>>& workers);
@@ -203,4 +202,10 @@ bool is_null_destination(h2load::Config& config);
 
 void process_delayed_scenario(h2load::Config& config);
 
+// CPU time consumed so far by the calling thread
+std::chrono::nanoseconds get_thread_cpu_time();
+
+// number of operator new calls made so far by the calling thread, 0 if not counted (AddressSanitizer builds)
+uint64_t get_thread_allocation_count();
+
 #endif
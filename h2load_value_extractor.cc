@@ -0,0 +1,601 @@
+#include <iostream>
+#include <cstring>
+
+#include "rapidjson/reader.h"
+#include "rapidjson/stream.h"
+
+#include "h2load_value_extractor.h"
+
+
+namespace h2load
+{
+
+namespace
+{
+
+/*
+ * SAX handler walking the Json document along the compiled pointer;
+ * it tells the reader to stop (by returning false) once the target value is captured,
+ * or once a container on the pointer path is closed without the target being found.
+ */
+class Json_Pointer_Sax_Handler: public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Json_Pointer_Sax_Handler>
+{
+public:
+    Json_Pointer_Sax_Handler(const std::vector<Value_Extractor::Path_Step>& pointer_steps,
+                             const std::string& json_payload,
+                             rapidjson::StringStream& json_stream,
+                             std::string& extracted_value):
+        steps(pointer_steps),
+        payload(json_payload),
+        stream(json_stream),
+        value(extracted_value)
+    {
+        frames.reserve(steps.size() + 1);
+    }
+
+    bool Null()
+    {
+        return scalar("null", 4);
+    }
+    bool Bool(bool b)
+    {
+        return b ? scalar("true", 4) : scalar("false", 5);
+    }
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool)
+    {
+        return scalar(str, length);
+    }
+    bool String(const char* str, rapidjson::SizeType length, bool)
+    {
+        return scalar(str, length);
+    }
+    bool StartObject()
+    {
+        return start_container(false);
+    }
+    bool Key(const char* str, rapidjson::SizeType length, bool)
+    {
+        auto& top = frames.back();
+        top.child_selected = top.on_path &&
+                             steps[frames.size() - 1].name.size() == length &&
+                             memcmp(steps[frames.size() - 1].name.c_str(), str, length) == 0;
+        return true;
+    }
+    bool EndObject(rapidjson::SizeType)
+    {
+        return end_container();
+    }
+    bool StartArray()
+    {
+        return start_container(true);
+    }
+    bool EndArray(rapidjson::SizeType)
+    {
+        return end_container();
+    }
+
+    bool found = false;
+
+private:
+    struct Frame
+    {
+        bool is_array;
+        bool on_path;
+        bool child_selected;
+        size_t next_index;
+    };
+
+    bool current_value_selected()
+    {
+        if (frames.empty())
+        {
+            return true; // document root
+        }
+        auto& top = frames.back();
+        if (top.is_array)
+        {
+            top.child_selected = top.on_path && (top.next_index == steps[frames.size() - 1].index);
+            top.next_index++;
+        }
+        return top.on_path && top.child_selected;
+    }
+
+    bool scalar(const char* str, size_t length)
+    {
+        if (current_value_selected() && frames.size() == steps.size())
+        {
+            value.assign(str, length);
+            found = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool start_container(bool is_array)
+    {
+        bool selected = current_value_selected();
+        if (selected && frames.size() == steps.size())
+        {
+            // the reader has consumed the opening bracket already
+            target_start = stream.Tell() - 1;
+            target_depth = frames.size() + 1;
+        }
+        frames.push_back({is_array, selected && frames.size() < steps.size(), false, 0});
+        return true;
+    }
+
+    bool end_container()
+    {
+        bool on_path = frames.back().on_path;
+        frames.pop_back();
+        if (target_depth && frames.size() + 1 == target_depth)
+        {
+            value.assign(payload, target_start, stream.Tell() - target_start);
+            found = true;
+            return false;
+        }
+        // container on the path is closed, the target is not in this document
+        return !on_path;
+    }
+
+    const std::vector<Value_Extractor::Path_Step>& steps;
+    const std::string& payload;
+    rapidjson::StringStream& stream;
+    std::string& value;
+    std::vector<Frame> frames;
+    size_t target_start = 0;
+    size_t target_depth = 0;
+};
+
+bool starts_with(const std::string& str, size_t pos, const char* prefix)
+{
+    return str.compare(pos, strlen(prefix), prefix) == 0;
+}
+
+void append_xml_decoded(const std::string& source, size_t start, size_t end, std::string& output)
+{
+    static const std::vector<std::pair<std::string, char>> entities =
+    {
+        {"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}, {"&quot;", '"'}, {"&apos;", '\''}
+    };
+    while (start < end)
+    {
+        size_t amp = source.find('&', start);
+        if (amp == std::string::npos || amp >= end)
+        {
+            output.append(source, start, end - start);
+            return;
+        }
+        output.append(source, start, amp - start);
+        start = amp + 1;
+        bool decoded = false;
+        for (auto& entity : entities)
+        {
+            if (starts_with(source, amp, entity.first.c_str()))
+            {
+                output.push_back(entity.second);
+                start = amp + entity.first.size();
+                decoded = true;
+                break;
+            }
+        }
+        if (!decoded && starts_with(source, amp, "&#"))
+        {
+            size_t semicolon = source.find(';', amp);
+            if (semicolon != std::string::npos && semicolon < end)
+            {
+                bool hex = (source[amp + 2] == 'x' || source[amp + 2] == 'X');
+                std::string digits = source.substr(amp + (hex ? 3 : 2), semicolon - amp - (hex ? 3 : 2));
+                char* endptr = nullptr;
+                auto code = strtoul(digits.c_str(), &endptr, hex ? 16 : 10);
+                if (digits.size() && *endptr == '\0' && code < 0x80)
+                {
+                    output.push_back(static_cast<char>(code));
+                    start = semicolon + 1;
+                    decoded = true;
+                }
+            }
+        }
+        if (!decoded)
+        {
+            output.push_back('&');
+        }
+    }
+}
+
+// returns the position of the closing '>' of the tag starting at tag_start, quoted attribute values respected
+size_t find_tag_end(const std::string& payload, size_t tag_start)
+{
+    char quote = 0;
+    for (size_t pos = tag_start; pos < payload.size(); pos++)
+    {
+        char c = payload[pos];
+        if (quote)
+        {
+            if (c == quote)
+            {
+                quote = 0;
+            }
+        }
+        else if (c == '"' || c == '\'')
+        {
+            quote = c;
+        }
+        else if (c == '>')
+        {
+            return pos;
+        }
+    }
+    return std::string::npos;
+}
+
+// skips comment, CDATA, processing instruction and declaration; returns npos if pos does not point to one of them
+size_t skip_xml_non_element(const std::string& payload, size_t pos, std::string* cdata_output)
+{
+    size_t end = std::string::npos;
+    if (starts_with(payload, pos, "<!--"))
+    {
+        end = payload.find("-->", pos + 4);
+        return end == std::string::npos ? payload.size() : end + 3;
+    }
+    else if (starts_with(payload, pos, "<![CDATA["))
+    {
+        end = payload.find("]]>", pos + 9);
+        if (cdata_output)
+        {
+            cdata_output->append(payload, pos + 9, (end == std::string::npos ? payload.size() : end) - pos - 9);
+        }
+        return end == std::string::npos ? payload.size() : end + 3;
+    }
+    else if (starts_with(payload, pos, "<?"))
+    {
+        end = payload.find("?>", pos + 2);
+        return end == std::string::npos ? payload.size() : end + 2;
+    }
+    else if (starts_with(payload, pos, "<!"))
+    {
+        end = payload.find('>', pos + 2);
+        return end == std::string::npos ? payload.size() : end + 1;
+    }
+    return std::string::npos;
+}
+
+// string value of the element whose content starts at pos: all descendant text, entities decoded
+void collect_xml_text(const std::string& payload, size_t pos, std::string& value)
+{
+    size_t level = 0;
+    while (pos < payload.size())
+    {
+        size_t lt = payload.find('<', pos);
+        if (lt == std::string::npos)
+        {
+            return;
+        }
+        append_xml_decoded(payload, pos, lt, value);
+        size_t next = skip_xml_non_element(payload, lt, &value);
+        if (next != std::string::npos)
+        {
+            pos = next;
+            continue;
+        }
+        size_t gt = find_tag_end(payload, lt);
+        if (gt == std::string::npos)
+        {
+            return;
+        }
+        if (payload[lt + 1] == '/')
+        {
+            if (level == 0)
+            {
+                return;
+            }
+            level--;
+        }
+        else if (payload[gt - 1] != '/')
+        {
+            level++;
+        }
+        pos = gt + 1;
+    }
+}
+
+bool find_xml_attribute(const std::string& payload, size_t attr_start, size_t tag_end,
+                        const std::string& attr_name, std::string& value)
+{
+    size_t pos = attr_start;
+    while (pos < tag_end)
+    {
+        while (pos < tag_end && (isspace(payload[pos]) || payload[pos] == '/'))
+        {
+            pos++;
+        }
+        size_t name_start = pos;
+        while (pos < tag_end && payload[pos] != '=' && !isspace(payload[pos]))
+        {
+            pos++;
+        }
+        std::string name = payload.substr(name_start, pos - name_start);
+        while (pos < tag_end && (isspace(payload[pos]) || payload[pos] == '='))
+        {
+            pos++;
+        }
+        if (pos >= tag_end || (payload[pos] != '"' && payload[pos] != '\''))
+        {
+            return false;
+        }
+        char quote = payload[pos];
+        size_t value_end = payload.find(quote, pos + 1);
+        if (value_end == std::string::npos || value_end > tag_end)
+        {
+            return false;
+        }
+        size_t colon = name.find(':');
+        if (name == attr_name ||
+            (attr_name.find(':') == std::string::npos && colon != std::string::npos && name.substr(colon + 1) == attr_name))
+        {
+            append_xml_decoded(payload, pos + 1, value_end, value);
+            return true;
+        }
+        pos = value_end + 1;
+    }
+    return false;
+}
+
+bool xml_name_matches(const std::string& step_name, const char* name, size_t name_len)
+{
+    if (step_name == "*")
+    {
+        return true;
+    }
+    if (step_name.size() == name_len && memcmp(step_name.c_str(), name, name_len) == 0)
+    {
+        return true;
+    }
+    if (step_name.find(':') == std::string::npos)
+    {
+        const char* colon = static_cast<const char*>(memchr(name, ':', name_len));
+        if (colon)
+        {
+            size_t local_len = name_len - (colon + 1 - name);
+            return step_name.size() == local_len && memcmp(step_name.c_str(), colon + 1, local_len) == 0;
+        }
+    }
+    return false;
+}
+
+}
+
+Value_Extractor::Value_Extractor():
+    type(NONE)
+{
+}
+
+bool Value_Extractor::compile_json_pointer(const std::string& json_pointer)
+{
+    type = JSON_POINTER;
+    steps.clear();
+    if (json_pointer.empty())
+    {
+        return true;
+    }
+    if (json_pointer[0] != '/')
+    {
+        std::cerr << "invalid json pointer, must start with '/': " << json_pointer << std::endl;
+        return false;
+    }
+    size_t start = 1;
+    while (true)
+    {
+        size_t end = json_pointer.find('/', start);
+        std::string token = json_pointer.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        Path_Step step;
+        for (size_t i = 0; i < token.size(); i++)
+        {
+            if (token[i] == '~')
+            {
+                if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1'))
+                {
+                    step.name.push_back(token[i + 1] == '0' ? '~' : '/');
+                    i++;
+                }
+                else
+                {
+                    std::cerr << "invalid escape in json pointer: " << json_pointer << std::endl;
+                    return false;
+                }
+            }
+            else
+            {
+                step.name.push_back(token[i]);
+            }
+        }
+        if (step.name.size() && (step.name == "0" || step.name[0] != '0') &&
+            step.name.find_first_not_of("0123456789") == std::string::npos)
+        {
+            step.index = std::stoul(step.name);
+        }
+        steps.emplace_back(std::move(step));
+        if (end == std::string::npos)
+        {
+            break;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+bool Value_Extractor::compile_x_path(const std::string& x_path)
+{
+    type = X_PATH;
+    steps.clear();
+    x_path_attribute.clear();
+    if (x_path.size() < 2 || x_path[0] != '/' || x_path[1] == '/')
+    {
+        std::cerr << "invalid or unsupported xpath, absolute location path expected: " << x_path << std::endl;
+        return false;
+    }
+    size_t start = 1;
+    while (start != std::string::npos)
+    {
+        size_t end = x_path.find('/', start);
+        std::string token = x_path.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        start = (end == std::string::npos ? std::string::npos : end + 1);
+        bool last_step = (start == std::string::npos);
+        if (token.empty())
+        {
+            std::cerr << "unsupported xpath, descendant axis is not supported: " << x_path << std::endl;
+            return false;
+        }
+        if (last_step && token[0] == '@')
+        {
+            x_path_attribute = token.substr(1);
+            break;
+        }
+        if (last_step && token == "text()")
+        {
+            break;
+        }
+        Path_Step step;
+        size_t bracket = token.find('[');
+        step.name = token.substr(0, bracket);
+        step.index = 0;
+        if (bracket != std::string::npos)
+        {
+            std::string position = token.substr(bracket + 1, token.size() - bracket - 2);
+            if (token.back() != ']' || position.empty() ||
+                position.find_first_not_of("0123456789") != std::string::npos || std::stoul(position) == 0)
+            {
+                std::cerr << "unsupported xpath predicate, only position is supported: " << x_path << std::endl;
+                return false;
+            }
+            step.index = std::stoul(position);
+        }
+        steps.emplace_back(std::move(step));
+    }
+    if (steps.empty())
+    {
+        std::cerr << "invalid xpath, no element given: " << x_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Value_Extractor::extract(const std::string& payload, std::string& value) const
+{
+    value.clear();
+    switch (type)
+    {
+        case JSON_POINTER:
+        {
+            return extract_with_json_pointer(payload, value);
+        }
+        case X_PATH:
+        {
+            return extract_with_x_path(payload, value);
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+bool Value_Extractor::extract_with_json_pointer(const std::string& payload, std::string& value) const
+{
+    if (steps.empty())
+    {
+        value = payload;
+        return !value.empty();
+    }
+    rapidjson::StringStream stream(payload.c_str());
+    Json_Pointer_Sax_Handler handler(steps, payload, stream, value);
+    rapidjson::Reader reader;
+    reader.Parse<rapidjson::kParseNumbersAsStringsFlag>(stream, handler);
+    return handler.found;
+}
+
+bool Value_Extractor::extract_with_x_path(const std::string& payload, std::string& value) const
+{
+    std::vector<size_t> sibling_count(steps.size(), 0);
+    size_t depth = 0;
+    size_t matched = 0;
+    size_t pos = 0;
+    while (pos < payload.size())
+    {
+        size_t lt = payload.find('<', pos);
+        if (lt == std::string::npos)
+        {
+            break;
+        }
+        size_t next = skip_xml_non_element(payload, lt, nullptr);
+        if (next != std::string::npos)
+        {
+            pos = next;
+            continue;
+        }
+        size_t gt = find_tag_end(payload, lt);
+        if (gt == std::string::npos)
+        {
+            break;
+        }
+        pos = gt + 1;
+        if (payload[lt + 1] == '/')
+        {
+            if (depth == 0)
+            {
+                break;
+            }
+            depth--;
+            matched = std::min(matched, depth);
+            if (depth == 0)
+            {
+                break; // root element closed
+            }
+            continue;
+        }
+        bool self_closing = (payload[gt - 1] == '/');
+        size_t name_end = lt + 1;
+        while (name_end < gt && !isspace(payload[name_end]) && payload[name_end] != '/')
+        {
+            name_end++;
+        }
+        if (matched == depth && depth < steps.size() &&
+            xml_name_matches(steps[depth].name, payload.c_str() + lt + 1, name_end - lt - 1))
+        {
+            sibling_count[depth]++;
+            if (steps[depth].index == 0 || sibling_count[depth] == steps[depth].index)
+            {
+                if (depth + 1 == steps.size())
+                {
+                    if (x_path_attribute.size())
+                    {
+                        if (find_xml_attribute(payload, name_end, self_closing ? gt - 1 : gt, x_path_attribute, value))
+                        {
+                            return true;
+                        }
+                    }
+                    else
+                    {
+                        if (!self_closing)
+                        {
+                            collect_xml_text(payload, gt + 1, value);
+                        }
+                        return true;
+                    }
+                }
+                else if (!self_closing)
+                {
+                    matched = depth + 1;
+                    sibling_count[depth + 1] = 0;
+                }
+            }
+        }
+        if (!self_closing)
+        {
+            depth++;
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef H2LOAD_VALUE_EXTRACTOR_H
+#define H2LOAD_VALUE_EXTRACTOR_H
+#include <string>
+#include <vector>
+#include <limits>
+
+
+namespace h2load
+{
+
+/*
+ * Extracts one value from a response body, either with a Json pointer (RFC 6901)
+ * or with a simple XPath expression.
+ * The expression is compiled once at config load; extraction is done with a SAX/streaming pass over
+ * the body, which stops as soon as the value is found, so no DOM is ever built.
+ */
+class Value_Extractor
+{
+public:
+    enum EXTRACTOR_TYPE
+    {
+        NONE = 0,
+        JSON_POINTER,
+        X_PATH
+    };
+
+    struct Path_Step
+    {
+        std::string name;
+        // for Json pointer: array index represented by this token, or npos if the token is not a number
+        // for XPath: 1-based position predicate, e.g., 2 for /a/b[2]; 0 if not given
+        size_t index = std::numeric_limits<size_t>::max();
+    };
+
+    Value_Extractor();
+
+    // returns false if the expression is malformed, error is printed to std::cerr
+    bool compile_json_pointer(const std::string& json_pointer);
+
+    // supported syntax: /a/b[2]/c, /a/*/c, /a/b/@attr, /a/b/text(), and namespace prefix is ignored if not given
+    bool compile_x_path(const std::string& x_path);
+
+    bool extract(const std::string& payload, std::string& value) const;
+
+    EXTRACTOR_TYPE get_type() const
+    {
+        return type;
+    }
+
+private:
+    bool extract_with_json_pointer(const std::string& payload, std::string& value) const;
+    bool extract_with_x_path(const std::string& payload, std::string& value) const;
+
+    EXTRACTOR_TYPE type;
+    std::vector<Path_Step> steps;
+    std::string x_path_attribute;
+};
+
+}
+#endif
@@ -66,6 +66,13 @@ public:
   std::string& payload();
   const std::string& unmutable_payload() const;
 
+  // Returns the number of bytes of the request body received, which
+  // is counted even if the body is not kept in payload().
+  uint64_t payload_length() const;
+
+  // Returns the FNV-1a hash of the request body received.
+  uint64_t payload_digest() const;
+
 private:
   std::unique_ptr<request_impl> impl_;
 };
@@ -135,6 +142,11 @@ private:
 // the application must not access to those objects.
 typedef std::function<void(const request &, const response &, uint64_t, int32_t)> request_cb;
 
+// Called when the header fields of a request with a body are received,
+// before the body.  If it returns false, the body is not kept in
+// payload(), only counted and hashed as it is received.
+typedef std::function<bool(const request &)> body_needed_cb;
+
 class http2_impl;
 
 class http2 {
@@ -197,6 +209,10 @@ public:
   // equivalent .- and ..-free URL.
   bool handle(std::string pattern, request_cb cb);
 
+  // Sets callback which decides, for each request with a body, if the
+  // body is kept.  By default, it is always kept.
+  void body_needed(body_needed_cb cb);
+
   // Sets number of native threads to handle incoming HTTP request.
   // It defaults to 1.
   void num_threads(size_t num_threads);
@@ -0,0 +1,371 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "io_uring_engine.h"
+
+namespace h2load
+{
+
+namespace
+{
+const uint16_t receive_buffer_group = 0;
+// user_data of cancel requests, their completions are of no interest
+const uint64_t internal_operation_id = 0;
+const size_t max_completions_per_batch = 256;
+}
+
+io_uring_engine::io_uring_engine(boost::asio::io_service& io_ctx):
+    io_context(io_ctx),
+    event_descriptor(io_ctx),
+    event_count(0),
+    waiting_for_completions(false),
+    ring_ready(false),
+    buffer_ring(nullptr),
+    buffer_count(0),
+    buffer_size(0),
+    next_operation_id(internal_operation_id + 1),
+    submit_scheduled(false),
+    submit_count(0),
+    cqe_batch(max_completions_per_batch, nullptr)
+{
+    memset(&ring, 0, sizeof(ring));
+}
+
+io_uring_engine::~io_uring_engine()
+{
+    boost::system::error_code ignored_ec;
+    event_descriptor.close(ignored_ec);
+    if (buffer_ring)
+    {
+        io_uring_free_buf_ring(&ring, buffer_ring, buffer_count, receive_buffer_group);
+    }
+    if (ring_ready)
+    {
+        io_uring_queue_exit(&ring);
+    }
+}
+
+bool io_uring_engine::init(uint32_t queue_depth, uint32_t number_of_buffers, uint32_t size_of_buffer)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = queue_depth * 4;
+    int ret = io_uring_queue_init_params(queue_depth, &ring, &params);
+    if (ret == -EINVAL)
+    {
+        // IORING_SETUP_COOP_TASKRUN needs 5.19
+        params.flags &= ~IORING_SETUP_COOP_TASKRUN;
+        ret = io_uring_queue_init_params(queue_depth, &ring, &params);
+    }
+    if (ret < 0)
+    {
+        std::cerr << "io_uring_queue_init failed: " << strerror(-ret) << std::endl;
+        return false;
+    }
+    ring_ready = true;
+
+    // buffer rings want a power of 2
+    buffer_count = 1;
+    while (buffer_count < number_of_buffers)
+    {
+        buffer_count <<= 1;
+    }
+    buffer_size = size_of_buffer;
+    buffer_ring = io_uring_setup_buf_ring(&ring, buffer_count, receive_buffer_group, 0, &ret);
+    if (!buffer_ring)
+    {
+        std::cerr << "io_uring_setup_buf_ring failed: " << strerror(-ret) << std::endl;
+        return false;
+    }
+    buffer_memory.resize(static_cast<size_t>(buffer_count) * buffer_size);
+    for (uint32_t i = 0; i < buffer_count; i++)
+    {
+        io_uring_buf_ring_add(buffer_ring, buffer_memory.data() + static_cast<size_t>(i) * buffer_size, buffer_size, i,
+                              io_uring_buf_ring_mask(buffer_count), i);
+    }
+    io_uring_buf_ring_advance(buffer_ring, buffer_count);
+
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0)
+    {
+        std::cerr << "eventfd failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    ret = io_uring_register_eventfd(&ring, event_fd);
+    if (ret < 0)
+    {
+        std::cerr << "io_uring_register_eventfd failed: " << strerror(-ret) << std::endl;
+        close(event_fd);
+        return false;
+    }
+    event_descriptor.assign(event_fd);
+    return true;
+}
+
+uint64_t io_uring_engine::start_receive(int fd, receive_handler handler)
+{
+    auto operation_id = next_operation_id++;
+    auto& operation = operations[operation_id];
+    operation.type = RECEIVE;
+    operation.fd = fd;
+    operation.data = nullptr;
+    operation.length = 0;
+    operation.bytes_sent = 0;
+    operation.cancelled = false;
+    operation.on_receive = std::move(handler);
+    prepare_receive(operation_id, fd);
+    wait_for_completions();
+    return operation_id;
+}
+
+uint64_t io_uring_engine::send(int fd, const uint8_t* data, size_t length, send_handler handler)
+{
+    auto operation_id = next_operation_id++;
+    auto& operation = operations[operation_id];
+    operation.type = SEND;
+    operation.fd = fd;
+    operation.data = data;
+    operation.length = length;
+    operation.bytes_sent = 0;
+    operation.cancelled = false;
+    operation.on_send = std::move(handler);
+    prepare_send(operation_id, operation);
+    wait_for_completions();
+    return operation_id;
+}
+
+void io_uring_engine::cancel(uint64_t operation_id, std::vector<uint8_t>&& buffer_in_use)
+{
+    auto it = operations.find(operation_id);
+    if (it == operations.end() || it->second.cancelled)
+    {
+        return;
+    }
+    auto& operation = it->second;
+    operation.cancelled = true;
+    operation.on_receive = nullptr;
+    operation.on_send = nullptr;
+    operation.orphaned_buffer = std::move(buffer_in_use);
+    auto sqe = get_sqe();
+    io_uring_prep_cancel64(sqe, operation_id, 0);
+    io_uring_sqe_set_data64(sqe, internal_operation_id);
+    schedule_submit();
+}
+
+io_uring_sqe* io_uring_engine::get_sqe()
+{
+    auto sqe = io_uring_get_sqe(&ring);
+    if (!sqe)
+    {
+        // submission queue is full, flush this batch early
+        submit();
+        sqe = io_uring_get_sqe(&ring);
+    }
+    if (!sqe)
+    {
+        std::cerr << "io_uring submission queue exhausted" << std::endl;
+        abort();
+    }
+    return sqe;
+}
+
+void io_uring_engine::prepare_receive(uint64_t operation_id, int fd)
+{
+    auto sqe = get_sqe();
+    io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = receive_buffer_group;
+    io_uring_sqe_set_data64(sqe, operation_id);
+    schedule_submit();
+}
+
+void io_uring_engine::prepare_send(uint64_t operation_id, Operation& operation)
+{
+    auto sqe = get_sqe();
+    io_uring_prep_send(sqe, operation.fd, operation.data + operation.bytes_sent, operation.length - operation.bytes_sent,
+                       MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, operation_id);
+    schedule_submit();
+}
+
+void io_uring_engine::schedule_submit()
+{
+    if (submit_scheduled)
+    {
+        return;
+    }
+    submit_scheduled = true;
+    io_context.post([this]()
+    {
+        submit_scheduled = false;
+        submit();
+    });
+}
+
+void io_uring_engine::submit()
+{
+    if (!io_uring_sq_ready(&ring))
+    {
+        return;
+    }
+    int ret;
+    do
+    {
+        ret = io_uring_submit(&ring);
+    }
+    while (ret == -EINTR);
+    submit_count++;
+    if (ret < 0 && ret != -EBUSY && ret != -EAGAIN)
+    {
+        std::cerr << "io_uring_submit failed: " << strerror(-ret) << std::endl;
+        abort();
+    }
+    if (io_uring_sq_ready(&ring))
+    {
+        // completion queue is backed up, try again after the completions are processed
+        schedule_submit();
+    }
+}
+
+void io_uring_engine::wait_for_completions()
+{
+    if (waiting_for_completions)
+    {
+        return;
+    }
+    waiting_for_completions = true;
+    event_descriptor.async_read_some(boost::asio::buffer(&event_count, sizeof(event_count)),
+                                     [this](const boost::system::error_code & ec, std::size_t bytes_transferred)
+    {
+        waiting_for_completions = false;
+        if (ec == boost::asio::error::operation_aborted)
+        {
+            return;
+        }
+        process_completions();
+        if (operations.size())
+        {
+            wait_for_completions();
+        }
+    });
+}
+
+void io_uring_engine::process_completions()
+{
+    for (;;)
+    {
+        // copy out the batch first, so handlers are free to submit and the kernel can reuse the slots
+        auto count = io_uring_peek_batch_cqe(&ring, cqe_batch.data(), cqe_batch.size());
+        if (!count)
+        {
+            break;
+        }
+        completions.clear();
+        for (unsigned i = 0; i < count; i++)
+        {
+            completions.push_back({io_uring_cqe_get_data64(cqe_batch[i]), cqe_batch[i]->res, cqe_batch[i]->flags});
+        }
+        io_uring_cq_advance(&ring, count);
+        for (auto& completion : completions)
+        {
+            handle_completion(completion);
+        }
+    }
+    submit();
+}
+
+void io_uring_engine::handle_completion(const Completion& completion)
+{
+    if (completion.operation_id == internal_operation_id)
+    {
+        return;
+    }
+    bool has_buffer = (completion.flags & IORING_CQE_F_BUFFER);
+    uint16_t buffer_id = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+    auto it = operations.find(completion.operation_id);
+    if (it == operations.end())
+    {
+        if (has_buffer)
+        {
+            recycle_buffer(buffer_id);
+        }
+        return;
+    }
+    auto& operation = it->second;
+    bool final = !(completion.flags & IORING_CQE_F_MORE);
+
+    if (operation.type == RECEIVE)
+    {
+        if (has_buffer)
+        {
+            if (!operation.cancelled && completion.result > 0)
+            {
+                // the handler may cancel the operation, which drops its handler, so it runs from a local
+                auto handler = std::move(operation.on_receive);
+                handler(completion.result, buffer_memory.data() + static_cast<size_t>(buffer_id) * buffer_size,
+                        completion.result);
+                if (!operation.cancelled)
+                {
+                    operation.on_receive = std::move(handler);
+                }
+            }
+            recycle_buffer(buffer_id);
+        }
+        if (!final)
+        {
+            return;
+        }
+        // the handler above may have cancelled the operation
+        if (!operation.cancelled && (completion.result > 0 || completion.result == -ENOBUFS))
+        {
+            // multishot receive ended without error (e.g. ran out of buffers), arm it again
+            prepare_receive(completion.operation_id, operation.fd);
+            return;
+        }
+        if (!operation.cancelled)
+        {
+            auto handler = std::move(operation.on_receive);
+            operations.erase(completion.operation_id);
+            handler(completion.result, nullptr, 0);
+            return;
+        }
+        // the receive handler may have added operations, so it is not safe to reuse the iterator
+        operations.erase(completion.operation_id);
+        return;
+    }
+
+    if (!operation.cancelled && completion.result > 0 &&
+        operation.bytes_sent + completion.result < operation.length)
+    {
+        operation.bytes_sent += completion.result;
+        prepare_send(completion.operation_id, operation);
+        return;
+    }
+    if (operation.cancelled)
+    {
+        operations.erase(it);
+        return;
+    }
+    int result = completion.result;
+    if (result >= 0)
+    {
+        result = (operation.bytes_sent + result < operation.length) ? -EPIPE : static_cast<int>(operation.length);
+    }
+    auto handler = std::move(operation.on_send);
+    operations.erase(it);
+    handler(result);
+}
+
+void io_uring_engine::recycle_buffer(uint16_t buffer_id)
+{
+    io_uring_buf_ring_add(buffer_ring, buffer_memory.data() + static_cast<size_t>(buffer_id) * buffer_size, buffer_size,
+                          buffer_id, io_uring_buf_ring_mask(buffer_count), 0);
+    io_uring_buf_ring_advance(buffer_ring, 1);
+}
+
+}
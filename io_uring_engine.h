@@ -0,0 +1,111 @@
+#ifndef IO_URING_ENGINE_H
+#define IO_URING_ENGINE_H
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include <liburing.h>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace h2load
+{
+
+/*
+ * Per worker io_uring instance used as the read/write path of cleartext client connections.
+ * Reads are multishot receives into a ring of provided buffers registered with the kernel,
+ * writes are plain sends; all submissions made during one round of the worker's event loop go to the kernel
+ * with a single io_uring_submit, and completions are picked up through an eventfd watched by the asio io_service,
+ * so timers, DNS, connect and TLS keep running on asio.
+ */
+class io_uring_engine: private boost::noncopyable
+{
+public:
+    // result is the byte count, 0 for end of stream or -errno; the receive handler gets data only if result > 0
+    using receive_handler = std::function<void(int result, const uint8_t* data, size_t length)>;
+    using send_handler = std::function<void(int result)>;
+
+    explicit io_uring_engine(boost::asio::io_service& io_ctx);
+
+    ~io_uring_engine();
+
+    // false if the kernel or liburing lacks what is needed (multishot receive, buffer rings)
+    // buffer_count is rounded up to a power of 2, the buffers take buffer_count * buffer_size of memory
+    bool init(uint32_t queue_depth = 4096, uint32_t buffer_count = 256, uint32_t buffer_size = 16 * 1024);
+
+    // keeps receiving until the handler is called with result <= 0, or the operation is cancelled
+    uint64_t start_receive(int fd, receive_handler handler);
+
+    // data must be valid until the handler is called; the handler is called once, after all of data is sent or on error
+    uint64_t send(int fd, const uint8_t* data, size_t length, send_handler handler);
+
+    // the handler of the operation is not called any more, it is safe to call from within that handler;
+    // buffer_in_use, if the operation still refers to it, is kept until the kernel is done with the operation
+    void cancel(uint64_t operation_id, std::vector<uint8_t>&& buffer_in_use = std::vector<uint8_t>());
+
+    uint64_t get_submit_count() const
+    {
+        return submit_count;
+    }
+
+private:
+    enum OPERATION_TYPE
+    {
+        RECEIVE,
+        SEND
+    };
+
+    struct Operation
+    {
+        OPERATION_TYPE type;
+        int fd;
+        const uint8_t* data;
+        size_t length;
+        size_t bytes_sent;
+        bool cancelled;
+        receive_handler on_receive;
+        send_handler on_send;
+        std::vector<uint8_t> orphaned_buffer;
+    };
+
+    struct Completion
+    {
+        uint64_t operation_id;
+        int32_t result;
+        uint32_t flags;
+    };
+
+    io_uring_sqe* get_sqe();
+    void prepare_receive(uint64_t operation_id, int fd);
+    void prepare_send(uint64_t operation_id, Operation& operation);
+    void schedule_submit();
+    void submit();
+    void wait_for_completions();
+    void process_completions();
+    void handle_completion(const Completion& completion);
+    void recycle_buffer(uint16_t buffer_id);
+
+    boost::asio::io_service& io_context;
+    boost::asio::posix::stream_descriptor event_descriptor;
+    uint64_t event_count;
+    // completions are only waited for while there are operations, so the io_service can run out of work
+    bool waiting_for_completions;
+    io_uring ring;
+    bool ring_ready;
+    io_uring_buf_ring* buffer_ring;
+    std::vector<uint8_t> buffer_memory;
+    uint32_t buffer_count;
+    uint32_t buffer_size;
+    uint64_t next_operation_id;
+    bool submit_scheduled;
+    uint64_t submit_count;
+    std::unordered_map<uint64_t, Operation> operations;
+    std::vector<io_uring_cqe*> cqe_batch;
+    std::vector<Completion> completions;
+};
+
+}
+
+#endif
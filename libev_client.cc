@@ -6,13 +6,11 @@
 #include <execinfo.h>
 #include <iomanip>
 #include <string>
+#include <cstring>
 #include <boost/asio/io_service.hpp>
 #include <boost/thread/thread.hpp>
 
 #ifdef USE_LIBEV
-extern "C" {
-#include <ares.h>
-}
 #include "memchunk.h"
 #endif
 
@@ -29,6 +27,19 @@ extern "C" {
 namespace h2load
 {
 
+namespace
+{
+addrinfo to_addrinfo(const boost::asio::ip::tcp::endpoint& endpoint)
+{
+    addrinfo addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ai_family = endpoint.protocol().family();
+    addr.ai_socktype = SOCK_STREAM;
+    addr.ai_addr = const_cast<sockaddr*>(endpoint.data());
+    addr.ai_addrlen = endpoint.size();
+    return addr;
+}
+}
 
 libev_client::libev_client(uint32_t id, libev_worker* wrker, size_t req_todo, Config* conf,
                libev_client* parent, const std::string& dest_schema,
@@ -37,7 +48,7 @@ libev_client::libev_client(uint32_t id, libev_worker* wrker, size_t req_todo, Co
       wb(&static_cast<libev_worker*>(worker)->mcpool),
       next_addr(conf->addrs),
       current_addr(nullptr),
-      ares_address(nullptr),
+      dns_query_guard(std::make_shared<bool>(true)),
       fd(-1),
       probe_skt_fd(-1),
       connectfn(&libev_client::connect)
@@ -55,25 +66,10 @@ libev_client::libev_client(uint32_t id, libev_worker* wrker, size_t req_todo, Co
 
     init_timer_watchers();
 
-    init_ares();
     // TODO: move this to base class, but this calls a virtual func
     init_connection_targert();
 }
 
-void libev_client::init_ares()
-{
-    struct ares_options options;
-    options.sock_state_cb = ares_socket_state_cb;
-    options.sock_state_cb_data = this;
-    auto optmask = ARES_OPT_SOCK_STATE_CB;
-    auto status = ares_init_options(&channel, &options, optmask);
-    if (status)
-    {
-        std::cerr << "c-ares ares_init_options failed: " << status << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
 void libev_client::init_timer_watchers()
 {
     ev_timer_init(&conn_inactivity_watcher, conn_activity_timeout_cb, 0.,
@@ -120,8 +116,6 @@ libev_client::~libev_client()
     }
 
     final_cleanup();
-
-    ares_freeaddrinfo(ares_address);
 }
 
 int libev_client::do_read()
@@ -184,7 +178,7 @@ int libev_client::make_socket(T* addr)
 
 void libev_client::clear_default_addr_info()
 {
-    ares_address = nullptr;
+    resolved_address = boost::asio::ip::tcp::resolver::iterator();
     next_addr = nullptr;
     current_addr = nullptr;
 }
@@ -232,9 +226,10 @@ int libev_client::make_async_connection()
 
         current_addr = addr;
     }
-    else if (ares_address)
+    else if (resolved_address != boost::asio::ip::tcp::resolver::iterator())
     {
-        rv = make_socket(ares_address->nodes);
+        auto addr = to_addrinfo(resolved_address->endpoint());
+        rv = make_socket(&addr);
     }
     /*
     else
@@ -259,7 +254,7 @@ int libev_client::make_async_connection()
 
 void libev_client::probe_and_connect_to(const std::string& schema, const std::string& authority)
 {
-    resolve_fqdn_and_connect(schema, authority, ares_addrinfo_query_callback_for_probe);
+    resolve_fqdn_and_connect(schema, authority, &libev_client::on_probe_resolve_result);
 
 }
 
@@ -318,10 +313,6 @@ void libev_client::disconnect()
     wb.reset();
     stop_io_watcher(wev);
     stop_io_watcher(rev);
-    for (auto& it : ares_io_watchers)
-    {
-        stop_io_watcher(it.second);
-    }
     if (probe_skt_fd != -1)
     {
         if (ev_is_active(&probe_wev))
@@ -704,7 +695,7 @@ std::shared_ptr<base_client> libev_client::create_dest_client(const std::string&
 }
 
 int libev_client::resolve_fqdn_and_connect(const std::string& schema, const std::string& authority,
-                                     ares_addrinfo_callback callback)
+                                     Resolve_Handler handler)
 {
     std::string port;
     std::string host;
@@ -713,15 +704,44 @@ int libev_client::resolve_fqdn_and_connect(const std::string& schema, const std:
         return 1;
     }
 
-    ares_addrinfo_hints hints;
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_protocol = 0;
-    hints.ai_flags = AI_ADDRCONFIG;
-    ares_getaddrinfo(channel, host.c_str(), port.c_str(), &hints, callback, this);
+    std::weak_ptr<bool> guard = dns_query_guard;
+    DNS_Cache::instance().resolve(static_cast<libev_worker*>(worker)->get_dns_cache_caller(), host, port,
+                                  [this, guard, handler](const boost::system::error_code & err,
+                                                         boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
+    {
+        if (guard.expired())
+        {
+            return;
+        }
+        (this->*handler)(err, endpoint_iterator);
+    });
     return 0;
 }
 
+void libev_client::on_resolve_result(const boost::system::error_code& err,
+                                     boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
+{
+    if (err)
+    {
+        fail();
+        return;
+    }
+    next_addr = nullptr;
+    current_addr = nullptr;
+    resolved_address = endpoint_iterator;
+    connect();
+    resolved_address = boost::asio::ip::tcp::resolver::iterator();
+}
+
+void libev_client::on_probe_resolve_result(const boost::system::error_code& err,
+                                           boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
+{
+    if (!err)
+    {
+        probe_address(endpoint_iterator->endpoint());
+    }
+}
+
 int libev_client::connect_to_host(const std::string& schema, const std::string& authority)
 {
     //if (config->verbose)
@@ -736,7 +756,7 @@ void libev_client::start_delayed_reconnect_timer()
     ev_timer_start(static_cast<libev_worker*>(worker)->loop, &delayed_reconnect_watcher);
 }
 
-bool libev_client::probe_address(ares_addrinfo* ares_address)
+bool libev_client::probe_address(const boost::asio::ip::tcp::endpoint& endpoint)
 {
     if (probe_skt_fd != -1)
     {
@@ -747,24 +767,21 @@ bool libev_client::probe_address(ares_addrinfo* ares_address)
         close(probe_skt_fd);
         probe_skt_fd = -1;
     }
-    if (ares_address)
+    auto addr = to_addrinfo(endpoint);
+    probe_skt_fd = util::create_nonblock_socket(addr.ai_family);
+    if (probe_skt_fd != -1)
     {
-        auto& addr = ares_address->nodes;
-        probe_skt_fd = util::create_nonblock_socket(addr->ai_family);
-        if (probe_skt_fd != -1)
+        auto rv = ::connect(probe_skt_fd, addr.ai_addr, addr.ai_addrlen);
+        if (rv != 0 && errno != EINPROGRESS)
         {
-            auto rv = ::connect(probe_skt_fd, addr->ai_addr, addr->ai_addrlen);
-            if (rv != 0 && errno != EINPROGRESS)
-            {
-                close(probe_skt_fd);
-                probe_skt_fd = -1;
-            }
-            else
-            {
-                ev_io_set(&probe_wev, probe_skt_fd, EV_WRITE);
-                ev_io_start(static_cast<libev_worker*>(worker)->loop, &probe_wev);
-                return true;
-            }
+            close(probe_skt_fd);
+            probe_skt_fd = -1;
+        }
+        else
+        {
+            ev_io_set(&probe_wev, probe_skt_fd, EV_WRITE);
+            ev_io_start(static_cast<libev_worker*>(worker)->loop, &probe_wev);
+            return true;
         }
     }
     return false;
@@ -10,10 +10,6 @@
 
 #include <ev.h>
 
-extern "C" {
-#include <ares.h>
-}
-
 #include "memchunk.h"
 #include "template.h"
 
@@ -24,6 +20,7 @@ extern "C" {
 #include "h2load_Cookie.h"
 #include "h2load_utils.h"
 #include "base_client.h"
+#include "h2load_dns_cache.h"
 
 
 namespace h2load
@@ -86,17 +83,21 @@ public:
     int on_read(const uint8_t* data, size_t len);
     int on_write();
 
+    using Resolve_Handler = void (libev_client::*)(const boost::system::error_code&,
+                                                   boost::asio::ip::tcp::resolver::iterator);
     int resolve_fqdn_and_connect(const std::string& schema, const std::string& authority,
-                                 ares_addrinfo_callback callback = ares_addrinfo_query_callback);
+                                 Resolve_Handler handler = &libev_client::on_resolve_result);
+    void on_resolve_result(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpoint_iterator);
+    void on_probe_resolve_result(const boost::system::error_code& err,
+                                 boost::asio::ip::tcp::resolver::iterator endpoint_iterator);
 
     void init_timer_watchers();
 
-    bool probe_address(ares_addrinfo* ares_address);
+    bool probe_address(const boost::asio::ip::tcp::endpoint& endpoint);
 
     int write_clear_with_callback();
     void restore_connectfn();
     int connect_with_async_fqdn_lookup();
-    void init_ares();
 
     template<class T>
     int make_socket(T* addr);
@@ -113,7 +114,10 @@ public:
     // trying next address though next_addr.  To try new address, set
     // nullptr to current_addr before calling connect().
     addrinfo* current_addr;
-    ares_addrinfo* ares_address;
+    // the address resolved by the DNS_Cache, only set while connect() is called with it
+    boost::asio::ip::tcp::resolver::iterator resolved_address;
+    // resolution results come from the shared DNS_Cache, and are dropped if this client is gone by then
+    std::shared_ptr<bool> dns_query_guard;
     int fd;
     ev_timer conn_active_watcher;
     ev_timer conn_inactivity_watcher;
@@ -126,8 +130,6 @@ public:
     // The number of requests allowed by rps, but limited by stream
     // concurrency.
     ev_timer send_ping_watcher;
-    ares_channel channel;
-    std::map<int, ev_io> ares_io_watchers;
     ev_timer delayed_request_watcher;
     ev_timer delayed_reconnect_watcher;
     ev_timer connect_to_preferred_host_watcher;
@@ -8,6 +8,22 @@
 namespace h2load
 {
 
+namespace
+{
+void telemetry_timeout_cb(struct ev_loop* loop, ev_timer* w, int revents)
+{
+    auto worker = static_cast<libev_worker*>(w->data);
+    worker->telemetry_timeout_handler();
+    worker->next_telemetry_sample = std::chrono::steady_clock::now() + telemetry_interval;
+}
+
+void posted_handlers_cb(struct ev_loop* loop, ev_async* w, int revents)
+{
+    auto worker = static_cast<libev_worker*>(w->data);
+    worker->run_posted_handlers();
+}
+}
+
 libev_worker::libev_worker(uint32_t id, SSL_CTX* ssl_ctx, size_t nreq_todo, size_t nclients,
            size_t rate, size_t max_samples, Config* config):
            base_worker(id, nreq_todo, nclients, rate, max_samples, config),
@@ -15,14 +31,31 @@ libev_worker::libev_worker(uint32_t id, SSL_CTX* ssl_ctx, size_t nreq_todo, size
            ssl_ctx(ssl_ctx)
 {
   init_timers();
+  ev_async_init(&posted_handlers_watcher, posted_handlers_cb);
+  posted_handlers_watcher.data = this;
+  ev_async_start(loop, &posted_handlers_watcher);
+  // does not keep the loop running by itself
+  ev_unref(loop);
 }
 
 
 libev_worker::~libev_worker()
 {
+    // script threads post to the loop
+    stop_lua_script_pool();
+    // and so does the DNS_Cache; what it has posted already holds a reference on the loop
+    DNS_Cache::instance().cancel(this);
+    posted_handlers.clear();
+    ev_ref(loop);
+    ev_async_stop(loop, &posted_handlers_watcher);
     ev_timer_stop(loop, &rate_mode_period_watcher);
     ev_timer_stop(loop, &duration_watcher);
     ev_timer_stop(loop, &warmup_watcher);
+    if (ev_is_active(&telemetry_watcher))
+    {
+        ev_ref(loop);
+        ev_timer_stop(loop, &telemetry_watcher);
+    }
     ev_loop_destroy(loop);
 }
 
@@ -42,6 +75,10 @@ void libev_worker::init_timers()
 
     ev_timer_init(&warmup_watcher, warmup_timeout_cb, config->warm_up_time, 0.);
     warmup_watcher.data = this;
+
+    ev_timer_init(&telemetry_watcher, telemetry_timeout_cb, 0.,
+                  std::chrono::duration<double>(telemetry_interval).count());
+    telemetry_watcher.data = this;
 }
 
 void libev_worker::start_rate_mode_period_timer()
@@ -56,6 +93,53 @@ void libev_worker::start_graceful_stop_timer()
     start_duration_timer();
 }
 
+void libev_worker::start_telemetry_timer()
+{
+    next_telemetry_sample = std::chrono::steady_clock::now() + telemetry_interval;
+    ev_timer_again(loop, &telemetry_watcher);
+    // does not keep the loop running once the clients are done
+    ev_unref(loop);
+}
+
+void libev_worker::post_to_worker_thread(std::function<void(void)> handler)
+{
+    {
+        std::lock_guard<std::mutex> guard(posted_handlers_mutex);
+        posted_handlers.push_back(std::move(handler));
+    }
+    ev_async_send(loop, &posted_handlers_watcher);
+}
+
+void libev_worker::run_posted_handlers()
+{
+    std::vector<std::function<void(void)>> handlers;
+    {
+        std::lock_guard<std::mutex> guard(posted_handlers_mutex);
+        handlers.swap(posted_handlers);
+    }
+    for (auto& handler : handlers)
+    {
+        handler();
+    }
+}
+
+DNS_Cache::Caller libev_worker::get_dns_cache_caller()
+{
+    // the c-ares watchers of the clients used to keep the loop running while a query is pending
+    ev_ref(loop);
+    DNS_Cache::Caller caller;
+    caller.id = this;
+    caller.post = [this](std::function<void(void)> handler)
+    {
+        post_to_worker_thread(std::move(handler));
+    };
+    caller.keep_alive = std::shared_ptr<void>(loop, [](struct ev_loop * loop)
+    {
+        ev_unref(loop);
+    });
+    return caller;
+}
+
 void libev_worker::start_warmup_timer()
 {
     ev_timer_start(loop, &warmup_watcher);
@@ -3,6 +3,8 @@
 
 
 #include <vector>
+#include <mutex>
+#include <functional>
 #include <ev.h>
 #include <openssl/ssl.h>
 
@@ -12,6 +14,7 @@
 #include "h2load_stats.h"
 #include "h2load_Config.h"
 #include "base_worker.h"
+#include "h2load_dns_cache.h"
 
 
 #include "memory"
@@ -30,6 +33,11 @@ public:
     ev_timer rate_mode_period_watcher;
     ev_timer duration_watcher;
     ev_timer warmup_watcher;
+    ev_timer telemetry_watcher;
+    // handlers posted by other threads, see post_to_worker_thread
+    ev_async posted_handlers_watcher;
+    std::mutex posted_handlers_mutex;
+    std::vector<std::function<void(void)>> posted_handlers;
 
     libev_worker(uint32_t id, SSL_CTX* ssl_ctx, size_t nreq_todo, size_t nclients,
            size_t rate, size_t max_samples, Config* config);
@@ -44,6 +52,11 @@ public:
     virtual void stop_duration_timer();
     virtual void run_event_loop();
     virtual void start_graceful_stop_timer();
+    virtual void start_telemetry_timer();
+    virtual void post_to_worker_thread(std::function<void(void)> handler);
+    void run_posted_handlers();
+    // answers of the DNS_Cache come back through post_to_worker_thread, and keep the loop running until then
+    DNS_Cache::Caller get_dns_cache_caller();
     virtual std::shared_ptr<base_client> create_new_client(size_t req_todo);
 
 
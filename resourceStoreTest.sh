@@ -0,0 +1,27 @@
+#!/bin/bash
+# a document stored with a ttl still expires after an update with no ttl
+function cleanup {
+    kill $!
+    wait $! 2>/dev/null
+}
+trap cleanup EXIT
+./maock examples/maock_resource_store.json &>/dev/null &
+sleep 1
+
+url=http://127.0.0.1:8081/resources/test-1
+
+function status {
+    curl -s -o /dev/null -w "%{http_code}" --http2-prior-knowledge "$@"
+}
+
+stored=$(status -X PUT -d '{"a": 1}' $url)
+updated=$(status -X PATCH -d '{"b": 2}' $url)
+sleep 3
+fetched=$(status $url)
+
+if [ "$stored" = "201" ] && [ "$updated" = "200" ] && [ "$fetched" = "404" ]; then
+    echo "test pass"
+    exit 0
+fi
+echo "test fail: store $stored, update $updated, fetch after ttl $fetched"
+exit 1